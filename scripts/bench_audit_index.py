@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+"""
+Benchmark the queries issued by the `audit.get` websocket handler
+against a SQLite AuditEntry table, before and after the creation
+of the secondary indexes (see src/tools/db/SchemaIndexes.cpp).
+
+Usage: bench_audit_index.py [row_count]
+"""
+
+import random
+import sqlite3
+import sys
+import time
+
+TYPES = ['Leosac::Audit::WSAPICall'] * 90 + [
+    'Leosac::Audit::UserEvent',
+    'Leosac::Audit::GroupEvent',
+    'Leosac::Audit::CredentialEvent',
+    'Leosac::Audit::DoorEvent',
+    'Leosac::Audit::ZoneEvent',
+    'Leosac::Audit::UpdateEvent',
+]
+
+# Those are the statements generated by AuditGet::process_impl()
+IN_CLAUSES = {
+    'one type': "WHERE typeid IN ('Leosac::Audit::DoorEvent')",
+    'two types': "WHERE typeid IN ('Leosac::Audit::DoorEvent','Leosac::Audit::ZoneEvent')",
+}
+QUERIES = {}
+for label, clause in IN_CLAUSES.items():
+    QUERIES[label + ', count'] = 'SELECT count(id) FROM AuditEntry ' + clause
+    QUERIES[label + ', page 1'] = ('SELECT id FROM AuditEntry ' + clause +
+                                   ' ORDER BY id DESC LIMIT 20 OFFSET 0')
+    QUERIES[label + ', page 100'] = ('SELECT id FROM AuditEntry ' + clause +
+                                     ' ORDER BY id DESC LIMIT 20 OFFSET 1980')
+
+INDEXES = [
+    'CREATE INDEX IF NOT EXISTS "AuditEntry_typeid_id_i" ON "AuditEntry" ("typeid", "id")',
+    'CREATE INDEX IF NOT EXISTS "AuditEntry_timestamp_i" ON "AuditEntry" ("timestamp")',
+]
+
+
+def populate(db, count):
+    db.execute('CREATE TABLE "AuditEntry" ("id" INTEGER NOT NULL PRIMARY KEY, '
+               '"typeid" TEXT NOT NULL, "timestamp" TEXT NOT NULL, '
+               '"msg" TEXT NOT NULL, "version" INTEGER NOT NULL)')
+    rows = ((i, random.choice(TYPES), '2017-01-01 00:00:00', '', 1)
+            for i in range(1, count + 1))
+    db.executemany('INSERT INTO "AuditEntry" VALUES (?, ?, ?, ?, ?)', rows)
+    db.commit()
+
+
+def run_queries(db, label):
+    print('--- {}'.format(label))
+    for name, sql in QUERIES.items():
+        plan = db.execute('EXPLAIN QUERY PLAN ' + sql).fetchall()
+        start = time.perf_counter()
+        for _ in range(10):
+            db.execute(sql).fetchall()
+        elapsed = (time.perf_counter() - start) / 10
+        print('{:>22}: {:8.2f} ms  [{}]'.format(
+            name, elapsed * 1000, '; '.join(p[-1] for p in plan)))
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+    random.seed(42)
+    db = sqlite3.connect(':memory:')
+    populate(db, count)
+    print('{} audit entries'.format(count))
+
+    run_queries(db, 'without index')
+    for stmt in INDEXES:
+        db.execute(stmt)
+    db.execute('ANALYZE')
+    run_queries(db, 'with index')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+"""
+Print the application bus messages recorded by the Monitor module's
+binary capture (see src/modules/monitor/BusCapture.hpp).
+
+Each message is printed on one line, in the format of the text bus log:
+frames holding non printable characters are z85 encoded.
+
+Usage: decode_bus_capture.py <segment file or capture directory>...
+"""
+
+import datetime
+import os
+import struct
+import sys
+
+MAGIC = b'LEOSACBC'
+VERSION = 1
+Z85 = ('0123456789abcdefghijklmnopqrstuvwxyz'
+       'ABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#')
+
+
+def z85_encode(data):
+    # Pad with NUL bytes, like the Monitor module does.
+    data += b'\0' * (-len(data) % 4)
+    out = []
+    for i in range(0, len(data), 4):
+        value = struct.unpack('>I', data[i:i + 4])[0]
+        chunk = []
+        for _ in range(5):
+            value, digit = divmod(value, 85)
+            chunk.append(Z85[digit])
+        out.extend(reversed(chunk))
+    return ''.join(out)
+
+
+def format_frame(frame):
+    if all(0x20 <= c < 0x7f for c in frame):
+        return frame.decode('ascii')
+    return z85_encode(frame)
+
+
+def read_segment(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError('{}: not a bus capture segment'.format(path))
+    version = struct.unpack_from('<I', data, 8)[0]
+    if version != VERSION:
+        raise ValueError('{}: unsupported version {}'.format(path, version))
+
+    pos = 12
+    while pos + 4 <= len(data):
+        size = struct.unpack_from('<I', data, pos)[0]
+        if pos + 4 + size > len(data):
+            # The module stopped while writing this record.
+            sys.stderr.write('{}: truncated record at offset {}\n'.format(
+                path, pos))
+            return
+        timestamp, count = struct.unpack_from('<QH', data, pos + 4)
+        offset = pos + 14
+        frames = []
+        for _ in range(count):
+            frame_size = struct.unpack_from('<I', data, offset)[0]
+            frames.append(data[offset + 4:offset + 4 + frame_size])
+            offset += 4 + frame_size
+        yield timestamp, frames
+        pos += 4 + size
+
+
+def segment_paths(args):
+    for arg in args:
+        if os.path.isdir(arg):
+            for name in sorted(os.listdir(arg)):
+                if name.endswith('.cap'):
+                    yield os.path.join(arg, name)
+        else:
+            yield arg
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in segment_paths(sys.argv[1:]):
+        for timestamp, frames in read_segment(path):
+            when = datetime.datetime.fromtimestamp(timestamp / 1e6)
+            line = ''.join('F{}: {{{}}} ; '.format(i, format_frame(frame))
+                           for i, frame in enumerate(frames))
+            print('[{}] {}'.format(when.isoformat(sep=' '), line))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
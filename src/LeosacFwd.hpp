@@ -34,6 +34,9 @@ using ConfigCheckerPtr = std::shared_ptr<ConfigChecker>;
 class CoreUtils;
 using CoreUtilsPtr = std::shared_ptr<CoreUtils>;
 
+class RemoteConnection;
+using RemoteConnectionPtr = std::shared_ptr<RemoteConnection>;
+
 using ByteVector = std::vector<uint8_t>;
 
 class SecurityContext;
@@ -49,6 +52,9 @@ using SyncConfigPtr = std::shared_ptr<SyncConfig>;
 
 class FetchRemoteConfig;
 using FetchRemoteConfigPtr = std::shared_ptr<FetchRemoteConfig>;
+
+class ExportHistory;
+using ExportHistoryPtr = std::shared_ptr<ExportHistory>;
 }
 
 /**
@@ -19,7 +19,6 @@
 
 #include "CoreAPI.hpp"
 #include "Scheduler.hpp"
-#include "core/tasks/GetLocalConfigVersion.hpp"
 #include "kernel.hpp"
 #include "tools/GenGuid.h"
 #include "tools/Mail.hpp"
@@ -35,11 +34,8 @@ CoreAPI::CoreAPI(Kernel &k)
 
 uint64_t CoreAPI::config_version() const
 {
-    auto t = std::make_shared<Tasks::GetLocalConfigVersion>(kernel_);
-    kernel_.core_utils()->scheduler().enqueue(t, TargetThread::MAIN);
-    t->wait();
-    ASSERT_LOG(t->succeed(), "Tasks::GetLocalConfigVersion failed.");
-    return t->config_version_;
+    // Thread safe, no need to go through the main thread.
+    return kernel_.config_manager().config_version();
 }
 
 boost::property_tree::ptree CoreAPI::kernel_config() const
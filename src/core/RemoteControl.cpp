@@ -19,11 +19,16 @@
 
 #include "RemoteControl.hpp"
 #include "core/CoreUtils.hpp"
+#include "core/auth/ChangeLog.hpp"
 #include "core/config/RemoteConfigCollector.hpp"
+#include "core/config/RemoteConnection.hpp"
 #include "core/tasks/FetchRemoteConfig.hpp"
+#include "core/tasks/GenericTask.hpp"
 #include "core/tasks/RemoteControlAsyncResponse.hpp"
 #include "core/tasks/SyncConfig.hpp"
 #include "kernel.hpp"
+#include "tools/Compression.hpp"
+#include "tools/Digest.hpp"
 #include "tools/XmlPropertyTree.hpp"
 #include "tools/log.hpp"
 #include <boost/archive/binary_iarchive.hpp>
@@ -32,16 +37,35 @@
 #include <boost/property_tree/ptree_serialization.hpp>
 #include <boost/regex.hpp>
 #include <cassert>
+#include <odb/transaction.hxx>
 #include <zmqpp/curve.hpp>
 
 using namespace Leosac;
 
+/**
+ * Paths of the additional files embedded in a module's serialized
+ * configuration: the config frame is followed by (file_name, file_content)
+ * pairs.
+ */
+static std::vector<std::string>
+additional_files(const ConfigManager::SnapshotFrames &frames)
+{
+    std::vector<std::string> files;
+    for (size_t i = 1; i + 1 < frames.size(); i += 2)
+        files.push_back(frames[i]);
+    return files;
+}
+
+constexpr int RemoteControl::publish_interval_sec;
+constexpr uint32_t RemoteControl::change_log_batch;
+
 RemoteControl::RemoteControl(zmqpp::context &ctx, Kernel &kernel,
                              const boost::property_tree::ptree &cfg)
     : kernel_(kernel)
     , socket_(ctx, zmqpp::socket_type::router)
     , auth_(ctx)
     , context_(ctx)
+    , published_version_(0)
     , security_(cfg)
 {
     auth_.configure_curve("CURVE_ALLOW_ANY");
@@ -85,10 +109,33 @@ void RemoteControl::process_config(const boost::property_tree::ptree &cfg)
         std::bind(&RemoteControl::handle_config_version, this, std::placeholders::_1,
                   std::placeholders::_2);
 
+    command_handlers_["CONFIG_VERSIONS"] =
+        std::bind(&RemoteControl::handle_config_versions, this,
+                  std::placeholders::_1, std::placeholders::_2);
+
+    command_handlers_["MODULE_HASHES"] =
+        std::bind(&RemoteControl::handle_module_hashes, this, std::placeholders::_1,
+                  std::placeholders::_2);
+
+    command_handlers_["CHANGE_LOG"] =
+        std::bind(&RemoteControl::handle_change_log, this, std::placeholders::_1,
+                  std::placeholders::_2);
+
     socket_.set(zmqpp::socket_option::curve_server, true);
     socket_.set(zmqpp::socket_option::curve_secret_key, secret_key_);
     socket_.set(zmqpp::socket_option::curve_public_key, public_key_);
     socket_.bind("tcp://*:" + std::to_string(port));
+
+    if (auto publish_port = cfg.get_optional<int>("publish_port"))
+    {
+        INFO("Publishing configuration version changes on port " << *publish_port);
+        publisher_ =
+            std::make_unique<zmqpp::socket>(context_, zmqpp::socket_type::publish);
+        publisher_->set(zmqpp::socket_option::curve_server, true);
+        publisher_->set(zmqpp::socket_option::curve_secret_key, secret_key_);
+        publisher_->set(zmqpp::socket_option::curve_public_key, public_key_);
+        publisher_->bind("tcp://*:" + std::to_string(*publish_port));
+    }
 }
 
 void RemoteControl::handle_msg()
@@ -172,26 +219,36 @@ void RemoteControl::module_config(const std::string &module,
     if (std::find(modules_names.begin(), modules_names.end(), module) !=
         modules_names.end())
     {
-        zmqpp::socket sock(context_, zmqpp::socket_type::req);
-        sock.connect("inproc://module-" + module);
+        // Serve the snapshot of the current configuration version, if
+        // any, rather than having the module serialize it again.
+        auto &config_manager = kernel_.config_manager();
+        auto variant         = std::to_string(static_cast<int>(cfg_format));
+        ConfigManager::SnapshotFrames frames;
+        if (!config_manager.snapshot(module, variant, frames))
+        {
+            zmqpp::socket sock(context_, zmqpp::socket_type::req);
+            sock.connect("inproc://module-" + module);
 
-        bool ret = sock.send(zmqpp::message() << "DUMP_CONFIG" << cfg_format);
-        ASSERT_LOG(ret, "Failed to send");
+            bool ret = sock.send(zmqpp::message() << "DUMP_CONFIG" << cfg_format);
+            ASSERT_LOG(ret, "Failed to send");
 
-        zmqpp::message rep;
+            zmqpp::message rep;
+
+            sock.receive(rep);
+            while (rep.remaining())
+            {
+                std::string tmp;
+                rep >> tmp;
+                frames.push_back(std::move(tmp));
+            }
+            config_manager.snapshot(module, variant, frames,
+                                    additional_files(frames));
+        }
 
-        sock.receive(rep);
         *message_out << "OK";
         *message_out << module;
-
-        // extract data from received configuration
-        // fixme this is poor code and involve lots of copying.
-        while (rep.remaining())
-        {
-            std::string tmp;
-            rep >> tmp;
-            *message_out << tmp;
-        }
+        for (const auto &frame : frames)
+            *message_out << frame;
     }
     else
     {
@@ -209,21 +266,32 @@ void RemoteControl::general_config(ConfigManager::ConfigFormat cfg_format,
 {
     assert(msg_out);
 
-    auto cfg = kernel_.config_manager().get_exportable_general_config();
-
-    if (cfg_format == ConfigManager::ConfigFormat::BOOST_ARCHIVE)
+    auto &config_manager = kernel_.config_manager();
+    auto variant         = std::to_string(static_cast<int>(cfg_format));
+    ConfigManager::SnapshotFrames frames;
+    if (!config_manager.snapshot("", variant, frames))
     {
-        std::ostringstream oss;
-        boost::archive::text_oarchive archive(oss);
-        boost::property_tree::save(archive, cfg, 1);
-        msg_out->add("OK");
-        msg_out->add(oss.str());
-    }
-    else
-    {
-        msg_out->add("OK");
-        msg_out->add(Tools::propertyTreeToXml(cfg));
+        auto cfg = config_manager.get_exportable_general_config();
+
+        if (cfg_format == ConfigManager::ConfigFormat::BOOST_ARCHIVE ||
+            cfg_format == ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB)
+        {
+            std::ostringstream oss;
+            boost::archive::text_oarchive archive(oss);
+            boost::property_tree::save(archive, cfg, 1);
+            if (cfg_format == ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB)
+                frames.push_back(Tools::zlib_compress(oss.str()));
+            else
+                frames.push_back(oss.str());
+        }
+        else
+        {
+            frames.push_back(Tools::propertyTreeToXml(cfg));
+        }
+        config_manager.snapshot("", variant, frames);
     }
+    msg_out->add("OK");
+    msg_out->add(frames.front());
 }
 
 bool RemoteControl::handle_module_config(zmqpp::message *msg_in,
@@ -276,8 +344,22 @@ bool RemoteControl::handle_sync_from(zmqpp::message *msg_in, zmqpp::message *msg
         *msg_in >> sync_general_config;
 
 
+        auto &connection = sync_connections_[endpoint];
+        if (!connection || connection->server_pk() != remote_server_pubkey)
+            connection =
+                std::make_shared<RemoteConnection>(endpoint, remote_server_pubkey);
+
+        // Forget about the connection once the synchronization is over, unless
+        // another one replaced it. The tasks hold their own reference.
+        auto release_connection = [this, endpoint, conn = connection.get()]() {
+            auto itr = sync_connections_.find(endpoint);
+            if (itr != sync_connections_.end() && itr->second.get() == conn)
+                sync_connections_.erase(itr);
+            return true;
+        };
+
         auto fetch_task = std::make_shared<Tasks::FetchRemoteConfig>(
-            endpoint, remote_server_pubkey);
+            connection, kernel_.config_manager().module_hashes());
 
         auto sync_task = std::make_shared<Tasks::SyncConfig>(
             kernel_, fetch_task, sync_general_config, autocommit);
@@ -299,15 +381,19 @@ bool RemoteControl::handle_sync_from(zmqpp::message *msg_in, zmqpp::message *msg
                 zmqpp::message() << "Aborted" << sync_task->get_guid(), socket_);
 
         sync_task->set_on_success([=]() {
+            release_connection();
             success_response_task->run();
             ASSERT_LOG(success_response_task->succeed(), "TASK FAILED");
         });
         sync_task->set_on_failure([=]() {
+            release_connection();
             failure_response_task->run();
             ASSERT_LOG(failure_response_task->succeed(), "TASK FAILED");
         });
         fetch_task->set_on_failure([=]() {
             // not run on main thread, need to be queued.
+            sched->enqueue(Tasks::GenericTask::build(release_connection),
+                           TargetThread::MAIN);
             sched->enqueue(abort_response_task, TargetThread::MAIN);
         });
 
@@ -331,11 +417,12 @@ bool RemoteControl::handle_save(zmqpp::message *msg_in, zmqpp::message *msg_out)
 
     if (msg_in->remaining() == 0)
     {
-        if (kernel_.save_config())
+        // Only reply once the configuration is on disk.
+        if (kernel_.save_config() && kernel_.flush_config())
             *msg_out << "OK";
         else
             *msg_out << "KO"
-                     << "Saving config failed for some unkown reason.";
+                     << "Failed to write the configuration file. See the logs.";
 
         return true;
     }
@@ -372,6 +459,130 @@ bool RemoteControl::handle_config_version(zmqpp::message *msg_in,
     return false;
 }
 
+bool RemoteControl::handle_config_versions(zmqpp::message *msg_in,
+                                           zmqpp::message *msg_out)
+{
+    assert(msg_in);
+    assert(msg_out);
+
+    if (msg_in->remaining() == 0)
+    {
+        auto versions = kernel_.config_manager().version_vector();
+        *msg_out << "OK" << versions->version << versions->general;
+        for (const auto &name : kernel_.module_manager().modules_names())
+        {
+            auto itr         = versions->modules.find(name);
+            uint64_t version = itr != versions->modules.end() ? itr->second : 0;
+            *msg_out << name << version << module_config_hash(name);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool RemoteControl::handle_module_hashes(zmqpp::message *msg_in,
+                                         zmqpp::message *msg_out)
+{
+    assert(msg_in);
+    assert(msg_out);
+
+    if (msg_in->remaining() == 0)
+    {
+        *msg_out << "OK";
+        for (const auto &name : kernel_.module_manager().modules_names())
+            *msg_out << name << module_config_hash(name);
+        return true;
+    }
+    return false;
+}
+
+bool RemoteControl::handle_change_log(zmqpp::message *msg_in,
+                                      zmqpp::message *msg_out)
+{
+    assert(msg_in);
+    assert(msg_out);
+
+    if (msg_in->remaining() != 2)
+        return false;
+
+    uint64_t after;
+    uint32_t max_entries;
+    *msg_in >> after >> max_entries;
+
+    auto db = kernel_.database();
+    if (!db)
+    {
+        *msg_out << "KO"
+                 << "Database is not enabled.";
+        return true;
+    }
+
+    odb::transaction t(db->begin());
+    uint64_t head = Auth::ChangeLog::head(*db);
+    uint64_t upto = std::min<uint64_t>(
+        head, after + std::min<uint32_t>(max_entries, change_log_batch));
+
+    // If `after` is greater than `head`, our log was reset. Replying
+    // with a lower sequence number lets the client know.
+    *msg_out << "OK" << upto << head;
+    if (upto > after)
+    {
+        for (const auto &entry : Auth::ChangeLog::fetch(*db, after, upto))
+        {
+            *msg_out << static_cast<uint64_t>(entry.seq) << entry.entity
+                     << static_cast<uint64_t>(entry.entity_id) << entry.operation
+                     << entry.payload;
+        }
+    }
+    t.commit();
+    return true;
+}
+
+std::string RemoteControl::module_config_hash(const std::string &module)
+{
+    auto &config_manager = kernel_.config_manager();
+    ConfigManager::SnapshotFrames hash;
+    if (config_manager.snapshot(module, "hash", hash))
+        return hash.front();
+
+    zmqpp::message config;
+    module_config(module, ConfigManager::ConfigFormat::BOOST_ARCHIVE, &config);
+
+    std::string status;
+    config >> status;
+    if (status != "OK")
+        return "";
+
+    // Length-prefix each frame so that moving bytes between the config
+    // tree and the additional files changes the hash.
+    std::string module_name;
+    config >> module_name;
+    ConfigManager::SnapshotFrames frames;
+    std::string content = std::to_string(module_name.size()) + ":" + module_name;
+    while (config.remaining())
+    {
+        std::string frame;
+        config >> frame;
+        content += std::to_string(frame.size()) + ":" + frame;
+        frames.push_back(std::move(frame));
+    }
+    hash.push_back(Tools::sha256_hex(content));
+    config_manager.snapshot(module, "hash", hash, additional_files(frames));
+    return hash.front();
+}
+
 void RemoteControl::update()
 {
+    if (!publisher_)
+        return;
+
+    uint64_t version = kernel_.config_manager().config_version();
+    auto now         = std::chrono::steady_clock::now();
+    if (version == published_version_ &&
+        now - last_publish_ < std::chrono::seconds(publish_interval_sec))
+        return;
+
+    publisher_->send(zmqpp::message() << "CONFIG_VERSION" << version);
+    published_version_ = version;
+    last_publish_      = now;
 }
@@ -19,9 +19,12 @@
 
 #pragma once
 
+#include "LeosacFwd.hpp"
 #include "RemoteControlSecurity.hpp"
 #include "core/config/ConfigManager.hpp"
 #include <boost/property_tree/ptree_fwd.hpp>
+#include <chrono>
+#include <memory>
 #include <zmqpp/zmqpp.hpp>
 
 namespace Leosac
@@ -43,8 +46,24 @@ class RemoteControl
     RemoteControl(zmqpp::context &ctx, Kernel &kernel,
                   const boost::property_tree::ptree &cfg);
 
+    /**
+    * Called by the kernel on each main loop iteration.
+    *
+    * If publishing is enabled, this publishes the configuration version
+    * when it changes, and periodically otherwise.
+    */
     void update();
 
+    /**
+    * Interval between two publications of an unchanged configuration version.
+    */
+    static constexpr int publish_interval_sec = 60;
+
+    /**
+    * Maximum number of ChangeLog entries returned by a CHANGE_LOG command.
+    */
+    static constexpr uint32_t change_log_batch = 500;
+
   private:
     /**
     * Extract and verify content from user-message and call implementation.
@@ -89,6 +108,42 @@ class RemoteControl
      */
     bool handle_config_version(zmqpp::message *msg_in, zmqpp::message *msg_out);
 
+    /**
+     * Command handler for CONFIG_VERSIONS command.
+     *
+     * Returns the configuration version vector, along with the content
+     * hash of each loaded module's configuration: everything a client
+     * needs to know what changed, in a single round-trip.
+     * Returning false means the source message was malformed.
+     */
+    bool handle_config_versions(zmqpp::message *msg_in, zmqpp::message *msg_out);
+
+    /**
+     * Command handler for MODULE_HASHES command.
+     *
+     * Returns the content hash of the configuration of each loaded module.
+     * Returning false means the source message was malformed.
+     */
+    bool handle_module_hashes(zmqpp::message *msg_in, zmqpp::message *msg_out);
+
+    /**
+     * Command handler for CHANGE_LOG command.
+     *
+     * Returns the entries of the authentication data ChangeLog that
+     * follow the sequence number provided by the client.
+     * Returning false means the source message was malformed.
+     */
+    bool handle_change_log(zmqpp::message *msg_in, zmqpp::message *msg_out);
+
+    /**
+     * Compute the content hash of the configuration of a module: its
+     * configuration tree and its additional files, as sent by MODULE_CONFIG.
+     *
+     * Returns an empty string if the module is not loaded.
+     * The hash is cached until the configuration version changes.
+     */
+    std::string module_config_hash(const std::string &module);
+
     /**
     * Implements the module list command.
     *
@@ -98,6 +153,9 @@ class RemoteControl
 
     /**
     * Implements the MODULE_CONFIG command.
+    *
+    * The serialized configuration is cached in the ConfigManager, so
+    * the module is only asked to dump it once per configuration version.
     */
     void module_config(const std::string &module,
                        ConfigManager::ConfigFormat cfg_format,
@@ -168,6 +226,19 @@ class RemoteControl
     zmqpp::auth auth_;
     zmqpp::context &context_;
 
+    /**
+    * PUB socket that notifies subscribers (replicating units) of
+    * configuration version changes. Null unless `publish_port` is configured.
+    */
+    std::unique_ptr<zmqpp::socket> publisher_;
+
+    /**
+    * Last published configuration version.
+    */
+    uint64_t published_version_;
+
+    std::chrono::steady_clock::time_point last_publish_;
+
     // Function is not really void (), we use placeholder and bind.
     using CommandHandlerMap =
         std::map<std::string, std::function<bool(zmqpp::message *msg_in,
@@ -175,6 +246,14 @@ class RemoteControl
 
     CommandHandlerMap command_handlers_;
 
+    /**
+    * Connections to the units we are synchronizing from (SYNC_FROM),
+    * indexed by endpoint. Concurrent synchronizations from the same unit
+    * share the same authenticated connection. An entry is removed once
+    * the synchronization that created it is over.
+    */
+    std::map<std::string, RemoteConnectionPtr> sync_connections_;
+
     /**
     * Object to check remote user permission before processing their request.
     */
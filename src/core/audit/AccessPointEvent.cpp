@@ -73,13 +73,13 @@ void AccessPointEvent::target(Auth::IAccessPointPtr ap)
 void AccessPointEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void AccessPointEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Auth::AccessPointId AccessPointEvent::target_id() const
@@ -89,14 +89,14 @@ Auth::AccessPointId AccessPointEvent::target_id() const
     return target_ap_id_;
 }
 
-const std::string &AccessPointEvent::before() const
+std::string AccessPointEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &AccessPointEvent::after() const
+std::string AccessPointEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string AccessPointEvent::generate_description() const
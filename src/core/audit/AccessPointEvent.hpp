@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IAccessPointEvent.hpp"
+#include "Snapshot.hpp"
 
 namespace Leosac
 {
@@ -54,9 +55,9 @@ class AccessPointEvent : virtual public IAccessPointEvent, public AuditEntry
 
     virtual void after(const std::string &repr) override;
 
-    const std::string &before() const override;
+    std::string before() const override;
 
-    const std::string &after() const override;
+    std::string after() const override;
 
     std::string generate_description() const override;
 
@@ -71,15 +72,11 @@ class AccessPointEvent : virtual public IAccessPointEvent, public AuditEntry
 
     Auth::AccessPointId target_ap_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
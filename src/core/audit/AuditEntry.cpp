@@ -19,6 +19,7 @@
 
 #include "AuditEntry.hpp"
 #include "core/audit/AuditEntry_odb.h"
+#include "core/audit/StatsRollup.hpp"
 #include "core/auth/User.hpp"
 #include "core/auth/User_odb.h"
 #include "tools/db/OptionalTransaction.hpp"
@@ -67,6 +68,10 @@ void AuditEntry::finalize()
     ASSERT_LOG(database_, "Null database pointer for AuditEntry.");
     duration_ += etc_.elapsed();
     database_->update(*this);
+    // timestamp_ is local time, while rollups are bucketed in UTC.
+    StatsRollup::record_audit(*database_,
+                              boost::posix_time::second_clock::universal_time(),
+                              event_mask_, author_id());
 }
 
 bool AuditEntry::finalized() const
@@ -152,6 +152,10 @@ class AuditEntry : virtual public IAuditEntry,
 #pragma db version
     const size_t version_;
 
+// The index on the `typeid` discriminator column cannot be declared
+// here. See db::ensure_core_indexes().
+#pragma db index("AuditEntry_timestamp_i") member(timestamp_)
+
     friend class odb::access;
 
     /**
@@ -88,6 +88,7 @@ using AuditTrackerWPtr = std::weak_ptr<AuditTracker>;
 class WSAPICall;
 using WSAPICallUPtr = std::unique_ptr<WSAPICall>;
 using WSAPICallPtr  = std::shared_ptr<WSAPICall>;
+struct WSAPICallRow;
 
 class UserEvent;
 using UserEventPtr = std::shared_ptr<UserEvent>;
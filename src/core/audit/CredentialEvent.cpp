@@ -68,13 +68,13 @@ void CredentialEvent::target(Cred::ICredentialPtr cred)
 void CredentialEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void CredentialEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Cred::CredentialId CredentialEvent::target_id() const
@@ -86,14 +86,14 @@ Cred::CredentialId CredentialEvent::target_id() const
     return 0;
 }
 
-const std::string &CredentialEvent::before() const
+std::string CredentialEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &CredentialEvent::after() const
+std::string CredentialEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string CredentialEvent::generate_description() const
@@ -21,6 +21,7 @@
 
 #include "core/audit/AuditEntry.hpp"
 #include "core/audit/ICredentialEvent.hpp"
+#include "core/audit/Snapshot.hpp"
 #include "core/credentials/CredentialFwd.hpp"
 #include "core/credentials/ICredential.hpp"
 
@@ -56,9 +57,9 @@ class CredentialEvent : virtual public ICredentialEvent, public AuditEntry
 
     Cred::CredentialId target_id() const override;
 
-    const std::string &before() const override;
+    std::string before() const override;
 
-    const std::string &after() const override;
+    std::string after() const override;
 
     std::string generate_description() const override;
 
@@ -70,15 +71,11 @@ class CredentialEvent : virtual public ICredentialEvent, public AuditEntry
 
     Cred::CredentialId target_cred_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
@@ -75,13 +75,13 @@ void DoorEvent::target(Auth::IDoorPtr door)
 void DoorEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void DoorEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Auth::DoorId DoorEvent::target_id() const
@@ -91,14 +91,14 @@ Auth::DoorId DoorEvent::target_id() const
     return target_door_id_;
 }
 
-const std::string &DoorEvent::before() const
+std::string DoorEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &DoorEvent::after() const
+std::string DoorEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string DoorEvent::generate_description() const
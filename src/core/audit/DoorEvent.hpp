@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IDoorEvent.hpp"
+#include "Snapshot.hpp"
 
 namespace Leosac
 {
@@ -53,9 +54,9 @@ class DoorEvent : virtual public IDoorEvent, public AuditEntry
 
     virtual void after(const std::string &repr) override;
 
-    virtual const std::string &before() const override;
+    virtual std::string before() const override;
 
-    virtual const std::string &after() const override;
+    virtual std::string after() const override;
 
     virtual Auth::AccessPointId access_point_id_before() const override;
 
@@ -78,15 +79,11 @@ class DoorEvent : virtual public IDoorEvent, public AuditEntry
 
     Auth::DoorId target_door_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     /**
      * The id of the associated AP before the event.
@@ -64,13 +64,13 @@ void GroupEvent::target(Auth::GroupPtr grp)
 void GroupEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void GroupEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Auth::GroupId GroupEvent::target_id() const
@@ -82,14 +82,14 @@ Auth::GroupId GroupEvent::target_id() const
     return target_group_id_;
 }
 
-const std::string &GroupEvent::before() const
+std::string GroupEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &GroupEvent::after() const
+std::string GroupEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string GroupEvent::generate_description() const
@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IGroupEvent.hpp"
+#include "Snapshot.hpp"
 
 namespace Leosac
 {
@@ -53,9 +54,9 @@ class GroupEvent : virtual public IGroupEvent, public AuditEntry
 
     Auth::GroupId target_id() const override;
 
-    const std::string &before() const override;
+    std::string before() const override;
 
-    const std::string &after() const override;
+    std::string after() const override;
 
     std::string generate_description() const override;
 
@@ -77,15 +78,11 @@ class GroupEvent : virtual public IGroupEvent, public AuditEntry
      */
     Auth::GroupId target_group_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
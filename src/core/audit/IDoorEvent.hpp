@@ -46,7 +46,7 @@ class IDoorEvent : virtual public IAuditEntry
      */
     virtual void before(const std::string &repr) = 0;
 
-    virtual const std::string &before() const = 0;
+    virtual std::string before() const = 0;
 
     /**
      * An optional JSON representation of the object
@@ -54,7 +54,7 @@ class IDoorEvent : virtual public IAuditEntry
      */
     virtual void after(const std::string &repr) = 0;
 
-    virtual const std::string &after() const = 0;
+    virtual std::string after() const = 0;
 
     /**
      * Return the id of the associated access_point before
@@ -50,7 +50,7 @@ class IGroupEvent : virtual public IAuditEntry
      */
     virtual void before(const std::string &repr) = 0;
 
-    virtual const std::string &before() const = 0;
+    virtual std::string before() const = 0;
 
     /**
      * An optional JSON representation of the object
@@ -58,7 +58,7 @@ class IGroupEvent : virtual public IAuditEntry
      */
     virtual void after(const std::string &repr) = 0;
 
-    virtual const std::string &after() const = 0;
+    virtual std::string after() const = 0;
 };
 }
 }
@@ -73,13 +73,13 @@ void ScheduleEvent::target(Tools::ISchedulePtr sched)
 void ScheduleEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void ScheduleEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Tools::ScheduleId ScheduleEvent::target_id() const
@@ -91,14 +91,14 @@ Tools::ScheduleId ScheduleEvent::target_id() const
     return target_sched_id_;
 }
 
-const std::string &ScheduleEvent::before() const
+std::string ScheduleEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &ScheduleEvent::after() const
+std::string ScheduleEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string ScheduleEvent::generate_description() const
@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IScheduleEvent.hpp"
+#include "Snapshot.hpp"
 #include "tools/ToolsFwd.hpp"
 
 namespace Leosac
@@ -58,9 +59,9 @@ class ScheduleEvent : virtual public IScheduleEvent, public AuditEntry
 
     Tools::ScheduleId target_id() const override;
 
-    const std::string &before() const override;
+    std::string before() const override;
 
-    const std::string &after() const override;
+    std::string after() const override;
 
     std::string generate_description() const override;
 
@@ -72,15 +73,11 @@ class ScheduleEvent : virtual public IScheduleEvent, public AuditEntry
 
     Tools::ScheduleId target_sched_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
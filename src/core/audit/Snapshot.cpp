@@ -0,0 +1,156 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Snapshot.hpp"
+#include "exception/leosacexception.hpp"
+#include "tools/Compression.hpp"
+#include "tools/log.hpp"
+#include <json.hpp>
+#include <zmqpp/z85.hpp>
+
+using namespace Leosac;
+using namespace Leosac::Audit;
+
+namespace
+{
+/**
+ * Prefix of a snapshot stored as a JSON Patch against `before`.
+ */
+const std::string patch_prefix = "P:";
+
+/**
+ * Prefix of compressed data.
+ * Format is "Z:<raw_size>:<compressed_size>:<z85 data>"
+ */
+const std::string zlib_prefix = "Z:";
+
+/**
+ * Don't bother compressing below this size.
+ */
+constexpr size_t compress_threshold = 512;
+
+bool starts_with(const std::string &str, const std::string &prefix)
+{
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+}
+
+void Snapshot::before(const std::string &repr)
+{
+    // `after` is relative to `before`, so it must be re-encoded.
+    auto current_after = after();
+    before_            = compress(repr);
+    after_.clear();
+    if (!current_after.empty())
+        after(current_after);
+}
+
+void Snapshot::after(const std::string &repr)
+{
+    auto current_before = before();
+    if (current_before.empty() || repr.empty())
+    {
+        after_ = compress(repr);
+        return;
+    }
+
+    try
+    {
+        auto patch = nlohmann::json::diff(nlohmann::json::parse(current_before),
+                                          nlohmann::json::parse(repr))
+                         .dump();
+        if (patch.size() + patch_prefix.size() < repr.size())
+        {
+            after_ = compress(patch_prefix + patch);
+            return;
+        }
+    }
+    catch (const std::invalid_argument &)
+    {
+        // Not JSON: store the snapshot as is.
+    }
+    after_ = compress(repr);
+}
+
+std::string Snapshot::before() const
+{
+    return decompress(before_);
+}
+
+std::string Snapshot::after() const
+{
+    auto stored = decompress(after_);
+    if (!starts_with(stored, patch_prefix))
+        return stored;
+
+    auto patch = nlohmann::json::parse(stored.substr(patch_prefix.size()));
+    return nlohmann::json::parse(before()).patch(patch).dump(4);
+}
+
+std::string Snapshot::compress(const std::string &in)
+{
+    if (in.size() < compress_threshold)
+        return in;
+
+    std::string compressed;
+    try
+    {
+        compressed = Tools::zlib_compress(in);
+    }
+    catch (const LEOSACException &)
+    {
+        WARN("Failed to compress audit snapshot. Storing it as is.");
+        return in;
+    }
+
+    // z85 requires the input size to be a multiple of 4.
+    std::string padded = compressed;
+    padded.resize((padded.size() + 3) / 4 * 4, '\0');
+
+    auto out = zlib_prefix + std::to_string(in.size()) + ":" +
+               std::to_string(compressed.size()) + ":" +
+               zmqpp::z85::encode(padded);
+    if (out.size() >= in.size())
+        return in;
+    return out;
+}
+
+std::string Snapshot::decompress(const std::string &in)
+{
+    if (!starts_with(in, zlib_prefix))
+        return in;
+
+    auto sep1 = in.find(':', zlib_prefix.size());
+    auto sep2 = in.find(':', sep1 + 1);
+    if (sep1 == std::string::npos || sep2 == std::string::npos)
+        throw LEOSACException("Malformed compressed audit snapshot.");
+
+    auto raw_size =
+        std::stoul(in.substr(zlib_prefix.size(), sep1 - zlib_prefix.size()));
+    auto compressed_size = std::stoul(in.substr(sep1 + 1, sep2 - sep1 - 1));
+    auto compressed      = zmqpp::z85::decode(in.substr(sep2 + 1));
+    if (compressed.size() < compressed_size)
+        throw LEOSACException("Malformed compressed audit snapshot.");
+
+    auto out = Tools::zlib_decompress(
+        std::string(compressed.begin(), compressed.begin() + compressed_size));
+    if (out.size() != raw_size)
+        throw LEOSACException("Failed to decompress audit snapshot.");
+    return out;
+}
@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <odb/core.hxx>
+#include <string>
+
+namespace Leosac
+{
+namespace Audit
+{
+/**
+ * The before/after JSON snapshots of an audit entry.
+ *
+ * Snapshots are stored in a compact form:
+ *     + The `after` snapshot is stored as a JSON Patch (RFC 6902) against
+ *       the `before` snapshot, when both are present and the patch is
+ *       shorter.
+ *     + Large snapshots are zlib-compressed.
+ *
+ * Decoding happens on read, so users of this class only ever see complete
+ * JSON documents. Rows written before this class existed hold plain JSON
+ * and are returned as is.
+ *
+ * When embedded in an audit entry with an empty column prefix, the
+ * columns are named `before` and `after`.
+ */
+#pragma db value
+class Snapshot
+{
+  public:
+    void before(const std::string &repr);
+
+    void after(const std::string &repr);
+
+    std::string before() const;
+
+    std::string after() const;
+
+    /**
+     * Compress `in` if it is large enough for this to be worth it.
+     * The result is printable and can be stored in a TEXT column.
+     */
+    static std::string compress(const std::string &in);
+
+    /**
+     * Reverse of compress(). Input that wasn't compressed is
+     * returned as is.
+     */
+    static std::string decompress(const std::string &in);
+
+  private:
+    /**
+     * Encoded form of the `before` snapshot.
+     */
+    std::string before_;
+
+    /**
+     * Encoded form of the `after` snapshot.
+     */
+    std::string after_;
+
+    friend class odb::access;
+};
+}
+}
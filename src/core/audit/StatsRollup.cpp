@@ -0,0 +1,195 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/audit/StatsRollup.hpp"
+#include "core/audit/StatsRollup_odb.h"
+#include "tools/db/Savepoint.hpp"
+#include "tools/log.hpp"
+#include <boost/algorithm/string/replace.hpp>
+#include <odb/transaction.hxx>
+#include <spdlog/fmt/fmt.h>
+
+using namespace Leosac;
+using namespace Leosac::Audit;
+
+namespace
+{
+/**
+ * Quote a string so it can be embedded in a SQL statement.
+ */
+std::string sql_quote(const std::string &str)
+{
+    return "'" + boost::replace_all_copy(str, "'", "''") + "'";
+}
+}
+
+constexpr long long StatsRollup::bucket_duration;
+
+void StatsRollup::ensure_table(odb::database &db)
+{
+    db.execute("CREATE TABLE IF NOT EXISTS \"StatsRollup\" ("
+               "\"metric\" TEXT NOT NULL, "
+               "\"dimension\" TEXT NOT NULL, "
+               "\"bucket\" BIGINT NOT NULL, "
+               "\"key\" TEXT NOT NULL, "
+               "\"count\" BIGINT NOT NULL, "
+               "PRIMARY KEY (\"metric\", \"dimension\", \"bucket\", \"key\"))");
+}
+
+long long StatsRollup::bucket_of(const boost::posix_time::ptime &when)
+{
+    long long ts = boost::posix_time::to_time_t(when);
+    return ts - ts % bucket_duration;
+}
+
+void StatsRollup::increment(odb::database &db, const boost::posix_time::ptime &when,
+                            const std::string &metric, const std::string &dimension,
+                            const std::string &key, long long count)
+{
+    increment(db, bucket_of(when), metric, dimension, key, count);
+}
+
+void StatsRollup::increment(odb::database &db, long long bucket,
+                            const std::string &metric, const std::string &dimension,
+                            const std::string &key, long long count)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    auto update = fmt::format("UPDATE \"StatsRollup\" SET "
+                              "\"count\" = \"count\" + {} WHERE \"metric\" = {} "
+                              "AND \"dimension\" = {} AND \"bucket\" = {} AND "
+                              "\"key\" = {}",
+                              count, sql_quote(metric), sql_quote(dimension), bucket,
+                              sql_quote(key));
+    if (db.execute(update))
+        return;
+
+    // First event of the bucket. A concurrent transaction may create
+    // the row before us, in which case we fallback to updating it.
+    db::Savepoint savepoint(db);
+    try
+    {
+        db.execute(fmt::format("INSERT INTO \"StatsRollup\" (\"metric\", "
+                               "\"dimension\", \"bucket\", \"key\", \"count\") "
+                               "VALUES ({}, {}, {}, {}, {})",
+                               sql_quote(metric), sql_quote(dimension), bucket,
+                               sql_quote(key), count));
+    }
+    catch (const odb::exception &)
+    {
+        savepoint.rollback_to();
+        db.execute(update);
+    }
+}
+
+void StatsRollup::record_access(odb::database &db,
+                                const boost::posix_time::ptime &when,
+                                const std::string &door, const std::string &username,
+                                bool granted)
+{
+    std::string metric = granted ? "access.granted" : "access.denied";
+    increment(db, when, metric, "door", door);
+    increment(db, when, metric, "user", username);
+}
+
+void StatsRollup::record_audit(odb::database &db,
+                               const boost::posix_time::ptime &when,
+                               const EventMask &mask, Auth::UserId author)
+{
+    const auto &bits = mask.get_bitset();
+    for (size_t i = 0; i < bits.size(); ++i)
+    {
+        if (bits[i])
+            increment(db, when, "audit", "type", std::to_string(i));
+    }
+    increment(db, when, "audit", "user", std::to_string(author));
+}
+
+std::vector<StatsRollupRow> StatsRollup::fetch(odb::database &db,
+                                               const std::string &metric,
+                                               const std::string &dimension,
+                                               long long from, long long to)
+{
+    using Query = odb::query<StatsRollupRow>;
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+
+    Query q("\"metric\" =" + Query::_val(metric) + "AND \"dimension\" =" +
+            Query::_val(dimension) + "AND \"bucket\" >=" + Query::_val(from) +
+            "AND \"bucket\" <" + Query::_val(to));
+
+    std::vector<StatsRollupRow> rows;
+    for (const auto &row : db.query<StatsRollupRow>(q))
+        rows.push_back(row);
+    return rows;
+}
+
+std::vector<StatsRollupRow>
+StatsRollup::aggregate(odb::database &db, const std::string &metric,
+                       const std::string &dimension, long long from, long long to,
+                       long long resolution)
+{
+    ASSERT_LOG(resolution > 0 && resolution % bucket_duration == 0,
+               "Resolution must be a multiple of the bucket duration.");
+    from = from - from % bucket_duration;
+
+    std::map<std::pair<long long, std::string>, long long> buckets;
+    for (const auto &row : fetch(db, metric, dimension, from, to))
+    {
+        auto bucket = from + (row.bucket - from) / resolution * resolution;
+        buckets[std::make_pair(bucket, row.key)] += row.count;
+    }
+
+    std::vector<StatsRollupRow> rows;
+    rows.reserve(buckets.size());
+    for (const auto &entry : buckets)
+        rows.push_back({entry.first.first, entry.first.second, entry.second});
+    return rows;
+}
+
+void StatsBatch::record_access(const boost::posix_time::ptime &when,
+                               const std::string &door, const std::string &username,
+                               bool granted)
+{
+    std::string metric = granted ? "access.granted" : "access.denied";
+    add(when, metric, "door", door);
+    add(when, metric, "user", username);
+}
+
+bool StatsBatch::empty() const
+{
+    return counters_.empty();
+}
+
+void StatsBatch::write(odb::database &db) const
+{
+    for (const auto &counter : counters_)
+    {
+        const auto &k = counter.first;
+        StatsRollup::increment(db, std::get<0>(k), std::get<1>(k), std::get<2>(k),
+                               std::get<3>(k), counter.second);
+    }
+}
+
+void StatsBatch::add(const boost::posix_time::ptime &when, const std::string &metric,
+                     const std::string &dimension, const std::string &key)
+{
+    ++counters_[std::make_tuple(StatsRollup::bucket_of(when), metric, dimension,
+                                key)];
+}
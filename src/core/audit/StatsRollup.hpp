@@ -0,0 +1,192 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "core/audit/AuditFwd.hpp"
+#include "core/auth/AuthFwd.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <map>
+#include <odb/core.hxx>
+#include <odb/database.hxx>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Leosac
+{
+namespace Audit
+{
+
+/**
+ * A row of the `StatsRollup` table.
+ *
+ * Each row counts how many events of a given `metric` (eg "access.denied")
+ * happened during the hour starting at `bucket` (a UNIX timestamp), for one
+ * value (`key`) of a given `dimension` (eg "door" or "user").
+ */
+#pragma db view query("SELECT \"bucket\", \"key\", \"count\" " \
+                      "FROM \"StatsRollup\" WHERE (?) " \
+                      "ORDER BY \"bucket\", \"key\"")
+struct StatsRollupRow
+{
+    long long bucket;
+
+    std::string key;
+
+    long long count;
+};
+
+/**
+ * Maintain pre-aggregated statistics about access decisions and
+ * audit entries.
+ *
+ * Counters are incremented as events are recorded, so that dashboards
+ * can be served by reading a bounded number of rows instead of scanning
+ * the raw audit and log tables.
+ *
+ * Recorded metrics:
+ *     + `access.granted` and `access.denied`, along the `door` and
+ *       `user` (username) dimensions.
+ *     + `audit`, along the `type` (integer value of Audit::EventType) and
+ *       `user` (user id, 0 for anonymous) dimensions.
+ *
+ * The `StatsRollup` table is not part of the ODB "core" schema: it is
+ * created by ensure_table() so that existing databases gain it without
+ * requiring a schema migration.
+ *
+ * Timestamps are expected in UTC (see `second_clock::universal_time()`).
+ *
+ * All functions must be called from within a transaction.
+ */
+class StatsRollup
+{
+  public:
+    /**
+     * Duration of a bucket, in seconds.
+     */
+    static constexpr long long bucket_duration = 3600;
+
+    /**
+     * Create the `StatsRollup` table if it doesn't exist.
+     */
+    static void ensure_table(odb::database &db);
+
+    /**
+     * Returns the bucket (UNIX timestamp of the start of the hour)
+     * `when` falls in.
+     */
+    static long long bucket_of(const boost::posix_time::ptime &when);
+
+    /**
+     * Increment by `count` the counter for (`metric`, `dimension`, `key`) in
+     * the bucket `when` falls in.
+     */
+    static void increment(odb::database &db, const boost::posix_time::ptime &when,
+                          const std::string &metric, const std::string &dimension,
+                          const std::string &key, long long count = 1);
+
+    /**
+     * Increment by `count` the counter for (`metric`, `dimension`, `key`) in
+     * `bucket`.
+     */
+    static void increment(odb::database &db, long long bucket,
+                          const std::string &metric, const std::string &dimension,
+                          const std::string &key, long long count);
+
+    /**
+     * Record an access decision.
+     *
+     * @param door Name of the auth target (or auth context if there is no target).
+     * @param username Name of the user, or empty if unknown.
+     */
+    static void record_access(odb::database &db,
+                              const boost::posix_time::ptime &when,
+                              const std::string &door, const std::string &username,
+                              bool granted);
+
+    /**
+     * Record a (finalized) audit entry.
+     */
+    static void record_audit(odb::database &db, const boost::posix_time::ptime &when,
+                             const EventMask &mask, Auth::UserId author);
+
+    /**
+     * Retrieve the counters of `metric` along `dimension` for all buckets
+     * in [`from`, `to`).
+     *
+     * `from` and `to` are UNIX timestamp.
+     */
+    static std::vector<StatsRollupRow> fetch(odb::database &db,
+                                             const std::string &metric,
+                                             const std::string &dimension,
+                                             long long from, long long to);
+
+    /**
+     * Same as fetch(), but sum the counters of each key into buckets of
+     * `resolution` seconds.
+     *
+     * `from` is rounded down to the start of its hour, and the returned
+     * buckets are aligned on it. `resolution` must be a multiple of
+     * `bucket_duration`.
+     */
+    static std::vector<StatsRollupRow>
+    aggregate(odb::database &db, const std::string &metric,
+              const std::string &dimension, long long from, long long to,
+              long long resolution);
+};
+
+/**
+ * Counter increments accumulated in memory, so that many events can be
+ * recorded with a single transaction.
+ *
+ * This class is not thread-safe.
+ */
+class StatsBatch
+{
+  public:
+    /**
+     * Same as StatsRollup::record_access(), but only in memory.
+     */
+    void record_access(const boost::posix_time::ptime &when,
+                       const std::string &door, const std::string &username,
+                       bool granted);
+
+    bool empty() const;
+
+    /**
+     * Apply the accumulated increments.
+     *
+     * Must be called from within a transaction.
+     */
+    void write(odb::database &db) const;
+
+  private:
+    void add(const boost::posix_time::ptime &when, const std::string &metric,
+             const std::string &dimension, const std::string &key);
+
+    /**
+     * Map (bucket, metric, dimension, key) to the increment.
+     */
+    std::map<std::tuple<long long, std::string, std::string, std::string>,
+             long long>
+        counters_;
+};
+}
+}
@@ -63,13 +63,13 @@ void UserEvent::target(Auth::UserPtr user)
 void UserEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void UserEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Auth::UserId UserEvent::target_id() const
@@ -79,14 +79,14 @@ Auth::UserId UserEvent::target_id() const
     return 0;
 }
 
-const std::string &UserEvent::before() const
+std::string UserEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &UserEvent::after() const
+std::string UserEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string UserEvent::generate_description() const
@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IUserEvent.hpp"
+#include "Snapshot.hpp"
 
 namespace Leosac
 {
@@ -53,9 +54,9 @@ class UserEvent : virtual public IUserEvent, public AuditEntry
 
     virtual void before(const std::string &repr) override;
 
-    const std::string &before() const override;
+    std::string before() const override;
 
-    const std::string &after() const override;
+    std::string after() const override;
 
     virtual void after(const std::string &repr) override;
 
@@ -71,15 +72,11 @@ class UserEvent : virtual public IUserEvent, public AuditEntry
 #pragma db not_null
     Auth::UserLWPtr target_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
@@ -18,6 +18,7 @@
 */
 
 #include "WSAPICall.hpp"
+#include "core/audit/Snapshot.hpp"
 #include "core/audit/WSAPICall_odb.h"
 #include "core/auth/User.hpp"
 #include "tools/db/MultiplexedTransaction.hpp"
@@ -77,7 +78,7 @@ void WSAPICall::source_endpoint(const std::string &str)
 void WSAPICall::request_content(const std::string &str)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    request_content_ = str;
+    request_content_ = Snapshot::compress(str);
 }
 
 void WSAPICall::response_content(const std::string &str)
@@ -119,18 +120,28 @@ const std::string &WSAPICall::source_endpoint() const
 
 std::string WSAPICall::generate_description() const
 {
-    std::stringstream ss;
+    boost::optional<std::string> author_username;
 
     auto author = author_.load();
+    if (author)
+        author_username = author->username();
+    return describe(author_username, method(), duration_);
+}
+
+std::string WSAPICall::describe(const boost::optional<std::string> &author,
+                                const std::string &method, size_t duration)
+{
+    std::stringstream ss;
+
     if (author)
     {
-        ss << "Websocket API call by user " << author->username() << " to "
-           << method() << " took " << duration_ << " milliseconds.";
+        ss << "Websocket API call by user " << *author << " to " << method
+           << " took " << duration << " milliseconds.";
     }
     else
     {
-        ss << "Websocket API call by anonymous to " << method() << " took "
-           << duration_ << " milliseconds.";
+        ss << "Websocket API call by anonymous to " << method << " took "
+           << duration << " milliseconds.";
     }
     return ss.str();
 }
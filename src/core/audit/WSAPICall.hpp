@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "core/audit/IWSAPICall.hpp"
+#include <boost/optional.hpp>
 
 namespace Leosac
 {
@@ -70,6 +71,15 @@ class WSAPICall : virtual public IWSAPICall, public AuditEntry
 
     virtual std::string generate_description() const override;
 
+    /**
+     * Build the description of an API call.
+     *
+     * This is shared between generate_description() and the
+     * serialization of WSAPICallRow.
+     */
+    static std::string describe(const boost::optional<std::string> &author,
+                                const std::string &method, size_t duration);
+
 #pragma db not_null
     std::string api_method_;
 
@@ -100,6 +110,8 @@ class WSAPICall : virtual public IWSAPICall, public AuditEntry
 
     /**
      * Copy of the JSON content of the request.
+     *
+     * Large requests are stored compressed. See Snapshot::compress().
      */
     std::string request_content_;
 
@@ -117,6 +129,61 @@ class WSAPICall : virtual public IWSAPICall, public AuditEntry
   private:
     friend class odb::access;
 };
+
+/**
+ * A flat, read-only, projection of a WSAPICall audit entry.
+ *
+ * WSAPICall is by far the most common type of audit entry. Loading
+ * them through the polymorphic AuditEntry hierarchy costs additional
+ * SELECTs per row (for the derived table and the author), as well
+ * as a visitor dispatch to serialize each entry.
+ *
+ * This view retrieves a page of API calls with a single statement,
+ * walking both tables by primary key. It does not include the
+ * request and response content.
+ *
+ * Queries against this view must qualify the columns they use,
+ * because `id` is present in all joined tables.
+ */
+#pragma db view query("SELECT \"AuditEntry\".\"id\", \"AuditEntry\".\"timestamp\", " \
+                      "\"AuditEntry\".\"event_mask\", \"AuditEntry\".\"duration\", " \
+                      "\"AuditEntry\".\"finalized\", \"AuditEntry\".\"author\", " \
+                      "\"User\".\"username\", \"WSAPICall\".\"api_method\", " \
+                      "\"WSAPICall\".\"uuid\", \"WSAPICall\".\"status_code\", " \
+                      "\"WSAPICall\".\"status_string\", " \
+                      "\"WSAPICall\".\"source_endpoint\" " \
+                      "FROM \"AuditEntry\" " \
+                      "INNER JOIN \"WSAPICall\" " \
+                      "ON \"WSAPICall\".\"id\" = \"AuditEntry\".\"id\" " \
+                      "LEFT JOIN \"User\" " \
+                      "ON \"User\".\"id\" = \"AuditEntry\".\"author\"")
+struct WSAPICallRow
+{
+    AuditEntryId id;
+
+    boost::posix_time::ptime timestamp;
+
+#pragma db type("TEXT")
+    EventMask event_mask;
+
+    size_t duration;
+
+    bool finalized;
+
+    boost::optional<Auth::UserId> author_id;
+
+    boost::optional<std::string> author_username;
+
+    std::string method;
+
+    std::string uuid;
+
+    APIStatusCode status_code;
+
+    std::string status_string;
+
+    std::string source_endpoint;
+};
 }
 }
 
@@ -74,13 +74,13 @@ void ZoneEvent::target(Auth::IZonePtr zone)
 void ZoneEvent::before(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    before_ = repr;
+    snapshot_.before(repr);
 }
 
 void ZoneEvent::after(const std::string &repr)
 {
     ASSERT_LOG(!finalized(), "Audit entry is already finalized.");
-    after_ = repr;
+    snapshot_.after(repr);
 }
 
 Auth::ZoneId ZoneEvent::target_id() const
@@ -90,14 +90,14 @@ Auth::ZoneId ZoneEvent::target_id() const
     return target_zone_id_;
 }
 
-const std::string &ZoneEvent::before() const
+std::string ZoneEvent::before() const
 {
-    return before_;
+    return snapshot_.before();
 }
 
-const std::string &ZoneEvent::after() const
+std::string ZoneEvent::after() const
 {
-    return after_;
+    return snapshot_.after();
 }
 
 std::string ZoneEvent::generate_description() const
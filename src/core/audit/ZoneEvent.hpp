@@ -21,6 +21,7 @@
 
 #include "AuditEntry.hpp"
 #include "IZoneEvent.hpp"
+#include "Snapshot.hpp"
 
 namespace Leosac
 {
@@ -53,9 +54,9 @@ class ZoneEvent : virtual public IZoneEvent, public AuditEntry
 
     virtual void after(const std::string &repr) override;
 
-    virtual const std::string &before() const override;
+    virtual std::string before() const override;
 
-    virtual const std::string &after() const override;
+    virtual std::string after() const override;
 
     virtual std::string generate_description() const override;
 
@@ -70,15 +71,11 @@ class ZoneEvent : virtual public IZoneEvent, public AuditEntry
 
     Auth::ZoneId target_zone_id_;
 
-    /**
-     * Optional JSON dump of the object before the event took place.
-     */
-    std::string before_;
-
-    /**
-     * Optional JSON dump of the object after the event took place.
-     */
-    std::string after_;
+/**
+ * Optional JSON dumps of the object before and after the event took place.
+ */
+#pragma db column("")
+    Snapshot snapshot_;
 
     friend class odb::access;
 };
@@ -29,23 +29,30 @@ namespace Serializer
 {
 json AuditJSON::serialize(const Audit::IAuditEntry &in, const SecurityContext &)
 {
-    auto timestamp = boost::posix_time::to_time_t(in.timestamp());
+    return serialize(in.id(), in.timestamp(), in.event_mask(),
+                     in.generate_description(), in.finalized(), in.author_id());
+}
 
+json AuditJSON::serialize(AuditEntryId id, const boost::posix_time::ptime &timestamp,
+                          const EventMask &event_mask,
+                          const std::string &description, bool finalized,
+                          Auth::UserId author_id)
+{
     json serialized = {
-        {"id", in.id()},
+        {"id", id},
         {"type", "audit-entry"},
         {"attributes",
          {
-             {"event-mask", static_cast<unsigned long>(in.event_mask())},
-             {"timestamp", timestamp},
-             {"description", in.generate_description()},
-             {"finalized", in.finalized()},
+             {"event-mask", static_cast<unsigned long>(event_mask)},
+             {"timestamp", boost::posix_time::to_time_t(timestamp)},
+             {"description", description},
+             {"finalized", finalized},
          }}};
 
-    if (in.author_id())
+    if (author_id)
     {
         serialized["relationships"]["author"] = {
-            {"data", {{"id", in.author_id()}, {"type", "user"}}}};
+            {"data", {{"id", author_id}, {"type", "user"}}}};
     }
     return serialized;
 }
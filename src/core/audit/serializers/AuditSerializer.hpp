@@ -21,6 +21,8 @@
 
 #include "LeosacFwd.hpp"
 #include "core/audit/AuditFwd.hpp"
+#include "core/auth/AuthFwd.hpp"
+#include <boost/date_time/posix_time/ptime.hpp>
 #include <json.hpp>
 #include <string>
 
@@ -36,6 +38,17 @@ struct AuditJSON
 {
     static json serialize(const Audit::IAuditEntry &in, const SecurityContext &sc);
 
+    /**
+     * Build the serialization of an audit entry from its fields.
+     *
+     * This is what serialize() does, for serializers of flat rows that
+     * have no IAuditEntry at hand. An `author_id` of 0 means no author.
+     */
+    static json serialize(AuditEntryId id, const boost::posix_time::ptime &timestamp,
+                          const EventMask &event_mask,
+                          const std::string &description, bool finalized,
+                          Auth::UserId author_id);
+
     static void unserialize(Audit::IAuditEntry &out, const json &in,
                             const SecurityContext &sc);
 };
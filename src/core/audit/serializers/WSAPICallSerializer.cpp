@@ -20,6 +20,7 @@
 #include "WSAPICallSerializer.hpp"
 #include "AuditSerializer.hpp"
 #include "core/audit/IWSAPICall.hpp"
+#include "core/audit/WSAPICall.hpp"
 #include "tools/log.hpp"
 
 namespace Leosac
@@ -28,21 +29,52 @@ namespace Audit
 {
 namespace Serializer
 {
-json WSAPICallJSON::serialize(const Audit::IWSAPICall &in, const SecurityContext &sc)
+namespace
+{
+/**
+ * Turn the serialization of an audit entry into the one of an API call.
+ *
+ * Both serialize() overloads go through this, so that they can't drift
+ * apart.
+ */
+json add_wsapicall_fields(json serialized, const std::string &uuid,
+                          const std::string &method,
+                          const std::string &status_string,
+                          APIStatusCode status_code,
+                          const std::string &source_endpoint)
 {
-    auto serialized = Audit::Serializer::AuditJSON::serialize(in, sc);
     // Now we override the type.
     ASSERT_LOG(serialized.at("type").is_string(),
                "Base audit serialization did something unexpected.");
     serialized["type"] = "audit-wsapicall-event";
 
-    serialized["attributes"]["uuid"]            = in.uuid();
-    serialized["attributes"]["method"]          = in.method();
-    serialized["attributes"]["status-string"]   = in.status_string();
-    serialized["attributes"]["status-code"]     = static_cast<int>(in.status_code());
-    serialized["attributes"]["source-endpoint"] = in.source_endpoint();
+    serialized["attributes"]["uuid"]            = uuid;
+    serialized["attributes"]["method"]          = method;
+    serialized["attributes"]["status-string"]   = status_string;
+    serialized["attributes"]["status-code"]     = static_cast<int>(status_code);
+    serialized["attributes"]["source-endpoint"] = source_endpoint;
     return serialized;
 }
 }
+
+json WSAPICallJSON::serialize(const Audit::IWSAPICall &in, const SecurityContext &sc)
+{
+    return add_wsapicall_fields(Audit::Serializer::AuditJSON::serialize(in, sc),
+                                in.uuid(), in.method(), in.status_string(),
+                                in.status_code(), in.source_endpoint());
+}
+
+json WSAPICallJSON::serialize(const Audit::WSAPICallRow &in, const SecurityContext &)
+{
+    auto description =
+        Audit::WSAPICall::describe(in.author_username, in.method, in.duration);
+    auto base = Audit::Serializer::AuditJSON::serialize(
+        in.id, in.timestamp, in.event_mask, description, in.finalized,
+        in.author_id ? *in.author_id : 0);
+    return add_wsapicall_fields(std::move(base), in.uuid, in.method,
+                                in.status_string, in.status_code,
+                                in.source_endpoint);
+}
+}
 }
 }
@@ -35,6 +35,13 @@ namespace Serializer
 struct WSAPICallJSON
 {
     static json serialize(const Audit::IWSAPICall &in, const SecurityContext &sc);
+
+    /**
+     * Serialize a flat WSAPICall row.
+     *
+     * The output is identical to the one of the overload above.
+     */
+    static json serialize(const Audit::WSAPICallRow &in, const SecurityContext &sc);
 };
 }
 }
@@ -0,0 +1,557 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/auth/ChangeLog.hpp"
+#include "core/SecurityContext.hpp"
+#include "core/auth/ChangeLog_odb.h"
+#include "core/auth/Group.hpp"
+#include "core/auth/Group_odb.h"
+#include "core/auth/User.hpp"
+#include "core/auth/UserGroupMembership_odb.h"
+#include "core/auth/User_odb.h"
+#include "core/auth/serializers/GroupSerializer.hpp"
+#include "core/auth/serializers/UserSerializer.hpp"
+#include "core/credentials/Credential.hpp"
+#include "core/credentials/Credential_odb.h"
+#include "core/credentials/PinCode.hpp"
+#include "core/credentials/RFIDCard.hpp"
+#include "core/credentials/serializers/PolymorphicCredentialSerializer.hpp"
+#include "exception/leosacexception.hpp"
+#include "tools/Schedule.hpp"
+#include "tools/Schedule_odb.h"
+#include "tools/db/Savepoint.hpp"
+#include "tools/log.hpp"
+#include "tools/serializers/ScheduleSerializer.hpp"
+#include <ctime>
+#include <date/date.h>
+#include <odb/transaction.hxx>
+
+using namespace Leosac;
+using namespace Leosac::Auth;
+
+namespace
+{
+void append(odb::database &db, const std::string &entity,
+            unsigned long long entity_id, bool erased, const json &payload)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    ChangeLogEntry entry{0,
+                         static_cast<long long>(std::time(nullptr)),
+                         entity,
+                         entity_id,
+                         erased ? "erase" : "upsert",
+                         payload.dump()};
+    db.persist(entry);
+}
+
+/**
+ * The websocket serializers format validity dates with a numeric
+ * UTC offset, which their unserializers don't parse back.
+ */
+void set_validity(json &attributes, const ValidityInfo &validity)
+{
+    using namespace std::chrono;
+
+    attributes.erase("validity-start");
+    attributes.erase("validity-end");
+    if (validity.start() != system_clock::time_point::min())
+        attributes["validity-start"] = date::format(
+            "%FT%TZ", time_point_cast<seconds>(validity.start()));
+    if (validity.end() != system_clock::time_point::max())
+        attributes["validity-end"] =
+            date::format("%FT%TZ", time_point_cast<seconds>(validity.end()));
+}
+
+template <typename Builder>
+void record_entity(odb::database &db, const std::string &entity,
+                   unsigned long long entity_id, bool erased, Builder &&build)
+{
+    json payload = json::object();
+    if (!erased)
+    {
+        try
+        {
+            payload = build();
+        }
+        catch (const std::exception &e)
+        {
+            WARN("Cannot describe " << entity << " " << entity_id
+                                    << " for the change log: " << e.what());
+            return;
+        }
+    }
+    append(db, entity, entity_id, erased, payload);
+}
+
+unsigned long long local_id(odb::database &db, const std::string &source,
+                            const std::string &entity, unsigned long long remote_id)
+{
+    auto mapping =
+        db.find<ChangeLogIdMap>(ChangeLogIdKey{source, entity, remote_id});
+    return mapping ? mapping->local_id : 0;
+}
+
+void unmap_id(odb::database &db, const std::string &source,
+              const std::string &entity, unsigned long long remote_id)
+{
+    if (auto mapping =
+            db.find<ChangeLogIdMap>(ChangeLogIdKey{source, entity, remote_id}))
+        db.erase(mapping);
+}
+
+void map_id(odb::database &db, const std::string &source, const std::string &entity,
+            unsigned long long remote_id, unsigned long long local)
+{
+    ChangeLogIdKey key{source, entity, remote_id};
+    if (auto mapping = db.find<ChangeLogIdMap>(key))
+    {
+        mapping->local_id = local;
+        db.update(mapping);
+    }
+    else
+    {
+        ChangeLogIdMap created{key, local};
+        db.persist(created);
+    }
+}
+
+/**
+ * Translate the identifier of a related entity, which must already be known.
+ */
+unsigned long long related_id(odb::database &db, const std::string &source,
+                              const std::string &entity,
+                              unsigned long long remote_id)
+{
+    auto id = local_id(db, source, entity, remote_id);
+    if (!id)
+        throw LEOSACException(
+            BUILD_STR("Unknown " << entity << " " << remote_id << " from source."));
+    return id;
+}
+
+void apply_user(odb::database &db, const std::string &source,
+                const ChangeLogRow &entry, const json &payload)
+{
+    UserPtr user;
+    if (auto id = local_id(db, source, entry.entity, entry.entity_id))
+        user = db.find<User>(id);
+
+    if (entry.operation == "erase")
+    {
+        if (user)
+            db.erase(user);
+        unmap_id(db, source, entry.entity, entry.entity_id);
+        return;
+    }
+
+    // Adopt a user with the same (unique) username, like the default
+    // accounts that exist on both units.
+    auto username = payload.at("username").get<std::string>();
+    if (!user)
+        user = db.query_one<User>(odb::query<User>::username == username);
+
+    bool created = !user;
+    if (created)
+        user = std::make_shared<User>();
+    user->username(username);
+    UserJSONSerializer::unserialize(*user, payload,
+                                    SystemSecurityContext::instance());
+    if (created)
+        db.persist(user);
+    else
+        db.update(user);
+    map_id(db, source, entry.entity, entry.entity_id, user->id());
+}
+
+void apply_group(odb::database &db, const std::string &source,
+                 const ChangeLogRow &entry, const json &payload)
+{
+    GroupPtr group;
+    if (auto id = local_id(db, source, entry.entity, entry.entity_id))
+        group = db.find<Group>(id);
+
+    if (entry.operation == "erase")
+    {
+        if (group)
+            db.erase(group);
+        unmap_id(db, source, entry.entity, entry.entity_id);
+        return;
+    }
+
+    auto name = payload.at("name").get<std::string>();
+    if (!group)
+        group = db.query_one<Group>(odb::query<Group>::name == name);
+
+    bool created = !group;
+    if (created)
+        group = std::make_shared<Group>();
+    GroupJSONSerializer::unserialize(*group, payload,
+                                     SystemSecurityContext::instance());
+    if (created)
+        db.persist(group);
+    else
+        db.update(group);
+    map_id(db, source, entry.entity, entry.entity_id, group->id());
+}
+
+/**
+ * Memberships are identified by their user and group, so they don't
+ * need to be mapped.
+ */
+void apply_membership(odb::database &db, const std::string &source,
+                      const ChangeLogRow &entry, const json &payload)
+{
+    auto remote_user_id  = payload.at("user_id").get<unsigned long long>();
+    auto remote_group_id = payload.at("group_id").get<unsigned long long>();
+    // Erasing a membership of an unknown user or group (eg. a tombstone
+    // replayed by a new satellite) has nothing to do.
+    if (entry.operation == "erase" &&
+        (!local_id(db, source, "user", remote_user_id) ||
+         !local_id(db, source, "group", remote_group_id)))
+        return;
+
+    auto user_id  = related_id(db, source, "user", remote_user_id);
+    auto group_id = related_id(db, source, "group", remote_group_id);
+    auto group    = db.load<Group>(group_id);
+
+    UserGroupMembershipPtr membership;
+    for (const auto &m : group->user_memberships())
+    {
+        if (m->user_id() == user_id)
+            membership = m;
+    }
+
+    if (entry.operation == "erase")
+    {
+        if (membership)
+            db.erase(membership);
+        return;
+    }
+
+    auto rank = static_cast<GroupRank>(payload.at("rank").get<int>());
+    if (membership)
+    {
+        membership->rank(rank);
+        db.update(membership);
+    }
+    else
+    {
+        group->member_add(db.load<User>(user_id), rank);
+        db.update(group);
+    }
+}
+
+void apply_credential(odb::database &db, const std::string &source,
+                      const ChangeLogRow &entry, const json &payload)
+{
+    Cred::CredentialPtr cred;
+    if (auto id = local_id(db, source, entry.entity, entry.entity_id))
+        cred = db.find<Cred::Credential>(id);
+
+    if (entry.operation == "erase")
+    {
+        if (cred)
+            db.erase(cred);
+        unmap_id(db, source, entry.entity, entry.entity_id);
+        return;
+    }
+
+    bool created = !cred;
+    if (created)
+    {
+        auto type = payload.at("type").get<std::string>();
+        if (type == "rfid-card")
+            cred = std::make_shared<Cred::RFIDCard>();
+        else if (type == "pin-code")
+            cred = std::make_shared<Cred::PinCode>();
+        else
+            throw LEOSACException(
+                BUILD_STR("Credential {" << type << "} are not supported."));
+    }
+    PolymorphicCredentialJSONSerializer::unserialize(
+        *cred, payload, SystemSecurityContext::instance());
+
+    auto owner_id = payload.at("owner_id").get<unsigned long long>();
+    if (owner_id)
+        cred->owner(UserLPtr(db, related_id(db, source, "user", owner_id)));
+    else
+        cred->owner(UserLPtr());
+
+    if (created)
+        db.persist(cred);
+    else
+        db.update(cred);
+    map_id(db, source, entry.entity, entry.entity_id, cred->id());
+}
+
+void apply_schedule(odb::database &db, const std::string &source,
+                    const ChangeLogRow &entry, const json &payload)
+{
+    Tools::SchedulePtr schedule;
+    if (auto id = local_id(db, source, entry.entity, entry.entity_id))
+        schedule = db.find<Tools::Schedule>(id);
+
+    if (entry.operation == "erase")
+    {
+        if (schedule)
+        {
+            for (const auto &mapping : schedule->mapping())
+                db.erase(mapping);
+            db.erase(schedule);
+        }
+        unmap_id(db, source, entry.entity, entry.entity_id);
+        return;
+    }
+
+    auto name = payload.at("name").get<std::string>();
+    if (!schedule)
+        schedule =
+            db.query_one<Tools::Schedule>(odb::query<Tools::Schedule>::name == name);
+
+    bool created = !schedule;
+    if (created)
+        schedule = std::make_shared<Tools::Schedule>();
+    Tools::ScheduleJSONSerializer::unserialize(*schedule, payload,
+                                               SystemSecurityContext::instance());
+    if (created)
+        db.persist(schedule);
+    else
+        db.update(schedule);
+    map_id(db, source, entry.entity, entry.entity_id, schedule->id());
+}
+}
+
+void ChangeLog::ensure_table(odb::database &db)
+{
+    std::string seq_type = db.id() == odb::database_id::id_pgsql
+                               ? "BIGSERIAL PRIMARY KEY"
+                               : "INTEGER PRIMARY KEY AUTOINCREMENT";
+
+    db.execute("CREATE TABLE IF NOT EXISTS \"ChangeLog\" (\"seq\" " + seq_type +
+               ", "
+               "\"timestamp\" BIGINT NOT NULL, "
+               "\"entity\" TEXT NOT NULL, "
+               "\"entity_id\" BIGINT NOT NULL, "
+               "\"operation\" TEXT NOT NULL, "
+               "\"payload\" TEXT NOT NULL)");
+    db.execute("CREATE TABLE IF NOT EXISTS \"ChangeLogCursor\" ("
+               "\"source\" TEXT NOT NULL PRIMARY KEY, "
+               "\"seq\" BIGINT NOT NULL)");
+    db.execute("CREATE TABLE IF NOT EXISTS \"ChangeLogIdMap\" ("
+               "\"source\" TEXT NOT NULL, "
+               "\"entity\" TEXT NOT NULL, "
+               "\"remote_id\" BIGINT NOT NULL, "
+               "\"local_id\" BIGINT NOT NULL, "
+               "PRIMARY KEY (\"source\", \"entity\", \"remote_id\"))");
+}
+
+void ChangeLog::record(odb::database &db, const User &user, bool erased)
+{
+    record_entity(db, "user", user.id(), erased, [&]() {
+        auto attributes =
+            UserJSONSerializer::serialize(user, SystemSecurityContext::instance())
+                .at("attributes");
+        attributes.erase("version");
+        set_validity(attributes, user.validity());
+        return attributes;
+    });
+}
+
+void ChangeLog::record(odb::database &db, const Group &group, bool erased)
+{
+    record_entity(db, "group", group.id(), erased, [&]() {
+        auto attributes =
+            GroupJSONSerializer::serialize(group, SystemSecurityContext::instance())
+                .at("attributes");
+        return attributes;
+    });
+}
+
+void ChangeLog::record(odb::database &db, const UserGroupMembership &membership,
+                       bool erased)
+{
+    // The payload is needed to identify the membership, even when erased.
+    append(db, "membership", membership.id(), erased,
+           {{"user_id", membership.user_id()},
+            {"group_id", membership.group_id()},
+            {"rank", static_cast<int>(membership.rank())}});
+}
+
+void ChangeLog::record(odb::database &db, const Cred::Credential &cred,
+                       bool erased)
+{
+    record_entity(db, "credential", cred.id(), erased, [&]() {
+        auto serialized = PolymorphicCredentialJSONSerializer::serialize(
+            cred, SystemSecurityContext::instance());
+        auto attributes = serialized.at("attributes");
+        attributes.erase("version");
+        attributes["type"]     = serialized.at("type");
+        attributes["owner_id"] = cred.owner_id();
+        set_validity(attributes, cred.validity());
+        return attributes;
+    });
+}
+
+void ChangeLog::record(odb::database &db, const Tools::Schedule &schedule,
+                       bool erased)
+{
+    record_entity(db, "schedule", schedule.id(), erased, [&]() {
+        auto attributes = Tools::ScheduleJSONSerializer::serialize(
+                              schedule, SystemSecurityContext::instance())
+                              .at("attributes");
+        attributes.erase("version");
+        return attributes;
+    });
+}
+
+unsigned long long ChangeLog::head(odb::database &db)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    // PostgreSQL hands out sequence numbers at insert time, not at commit
+    // time: a reader could see an entry before an older one is committed,
+    // and skip the older one for good. This lock waits for the writers to
+    // commit, and holds new ones back until the end of our transaction.
+    if (db.id() == odb::database_id::id_pgsql)
+        db.execute("LOCK TABLE \"ChangeLog\" IN SHARE MODE");
+    return db.query_value<ChangeLogHead>().seq;
+}
+
+std::vector<ChangeLogRow> ChangeLog::fetch(odb::database &db,
+                                           unsigned long long after,
+                                           unsigned long long upto)
+{
+    using Query = odb::query<ChangeLogRow>;
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+
+    Query q("\"seq\" >" + Query::_val(after) + "AND \"seq\" <=" +
+            Query::_val(upto));
+
+    std::vector<ChangeLogRow> rows;
+    for (const auto &row : db.query<ChangeLogRow>(q))
+        rows.push_back(row);
+    return rows;
+}
+
+unsigned long long ChangeLog::cursor(odb::database &db, const std::string &source)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    auto cursor = db.find<ChangeLogCursor>(source);
+    return cursor ? cursor->seq : 0;
+}
+
+void ChangeLog::cursor(odb::database &db, const std::string &source,
+                       unsigned long long seq)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    if (auto cursor = db.find<ChangeLogCursor>(source))
+    {
+        cursor->seq = seq;
+        db.update(cursor);
+    }
+    else
+    {
+        ChangeLogCursor created{source, seq};
+        db.persist(created);
+    }
+}
+
+void ChangeLog::reset(odb::database &db, const std::string &source)
+{
+    using CursorQuery = odb::query<ChangeLogCursor>;
+    using IdMapQuery  = odb::query<ChangeLogIdMap>;
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    db.erase_query<ChangeLogCursor>(CursorQuery::source == source);
+    db.erase_query<ChangeLogIdMap>(IdMapQuery::key.source == source);
+}
+
+bool ChangeLog::apply(odb::database &db, const std::string &source,
+                      const ChangeLogRow &entry)
+{
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+    db::Savepoint savepoint(db);
+    try
+    {
+        auto payload = json::parse(entry.payload);
+        if (entry.entity == "user")
+            apply_user(db, source, entry, payload);
+        else if (entry.entity == "group")
+            apply_group(db, source, entry, payload);
+        else if (entry.entity == "membership")
+            apply_membership(db, source, entry, payload);
+        else if (entry.entity == "credential")
+            apply_credential(db, source, entry, payload);
+        else if (entry.entity == "schedule")
+            apply_schedule(db, source, entry, payload);
+        else
+            throw LEOSACException(
+                BUILD_STR("Unsupported entity type {" << entry.entity << "}"));
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        savepoint.rollback_to();
+        WARN("Skipping change log entry " << entry.seq << " (" << entry.operation
+                                          << " " << entry.entity << " "
+                                          << entry.entity_id << "): " << e.what());
+    }
+    return false;
+}
+
+unsigned long long ChangeLog::prune(odb::database &db,
+                                    const std::chrono::seconds &max_age)
+{
+    using Query = odb::query<ChangeLogEntry>;
+    ASSERT_LOG(odb::transaction::has_current(),
+               "Not currently in a database transaction.");
+
+    auto cutoff = static_cast<long long>(std::time(nullptr)) - max_age.count();
+    auto head   = db.query_value<ChangeLogHead>().seq;
+    auto old    = Query::timestamp < cutoff && Query::seq < head;
+
+    // Entries of entities whose last entry is an old "erase". The erase
+    // itself is kept as a tombstone: satellites whose cursor is older
+    // still have to remove the entity.
+    auto erased = db.erase_query<ChangeLogEntry>(
+        old && Query("EXISTS (SELECT 1 FROM \"ChangeLog\" AS \"e\" "
+                     "WHERE \"e\".\"entity\" = \"ChangeLog\".\"entity\" "
+                     "AND \"e\".\"entity_id\" = \"ChangeLog\".\"entity_id\" "
+                     "AND \"e\".\"seq\" > \"ChangeLog\".\"seq\" "
+                     "AND \"e\".\"operation\" = 'erase' "
+                     "AND \"e\".\"timestamp\" <" +
+                     Query::_val(cutoff) +
+                     "AND NOT EXISTS (SELECT 1 FROM \"ChangeLog\" AS \"n\" "
+                     "WHERE \"n\".\"entity\" = \"e\".\"entity\" "
+                     "AND \"n\".\"entity_id\" = \"e\".\"entity_id\" "
+                     "AND \"n\".\"seq\" > \"e\".\"seq\"))"));
+
+    // Entries superseded by a later one, except the first of each entity.
+    auto superseded = db.erase_query<ChangeLogEntry>(
+        old && Query("\"seq\" NOT IN (SELECT MIN(\"seq\") FROM \"ChangeLog\" "
+                     "GROUP BY \"entity\", \"entity_id\") "
+                     "AND \"seq\" NOT IN (SELECT MAX(\"seq\") FROM \"ChangeLog\" "
+                     "GROUP BY \"entity\", \"entity_id\")"));
+    return erased + superseded;
+}
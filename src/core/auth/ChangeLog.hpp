@@ -0,0 +1,242 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "core/auth/AuthFwd.hpp"
+#include "core/credentials/CredentialFwd.hpp"
+#include "tools/ToolsFwd.hpp"
+#include "tools/db/database.hpp"
+#include <chrono>
+#include <odb/core.hxx>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Leosac
+{
+namespace Auth
+{
+
+/**
+ * An entry of the `ChangeLog` table, as written by ChangeLog::record().
+ */
+#pragma db object table("ChangeLog")
+struct ChangeLogEntry
+{
+#pragma db id auto column("seq")
+    unsigned long long seq;
+
+    /**
+     * UNIX timestamp of the change.
+     */
+    long long timestamp;
+
+    std::string entity;
+
+    unsigned long long entity_id;
+
+    std::string operation;
+
+    std::string payload;
+};
+
+/**
+ * The sequence number of the last entry applied from a source.
+ */
+#pragma db object table("ChangeLogCursor")
+struct ChangeLogCursor
+{
+#pragma db id
+    std::string source;
+
+    unsigned long long seq;
+};
+
+#pragma db value
+struct ChangeLogIdKey
+{
+    std::string source;
+
+    std::string entity;
+
+    unsigned long long remote_id;
+
+    bool operator<(const ChangeLogIdKey &o) const
+    {
+        return std::tie(source, entity, remote_id) <
+               std::tie(o.source, o.entity, o.remote_id);
+    }
+};
+
+/**
+ * Map the identifier of an entity on a source to its local identifier.
+ */
+#pragma db object table("ChangeLogIdMap")
+struct ChangeLogIdMap
+{
+#pragma db id column("")
+    ChangeLogIdKey key;
+
+    unsigned long long local_id;
+};
+
+/**
+ * An entry of the `ChangeLog` table.
+ */
+#pragma db view query("SELECT \"seq\", \"entity\", \"entity_id\", " \
+                      "\"operation\", \"payload\" " \
+                      "FROM \"ChangeLog\" WHERE (?) ORDER BY \"seq\"")
+struct ChangeLogRow
+{
+    unsigned long long seq;
+
+    /**
+     * Type of the entity: "user", "group", "membership", "credential"
+     * or "schedule".
+     */
+    std::string entity;
+
+    unsigned long long entity_id;
+
+    /**
+     * Either "upsert" or "erase".
+     */
+    std::string operation;
+
+    /**
+     * JSON description of the entity. See ChangeLog.
+     */
+    std::string payload;
+};
+
+#pragma db view query("SELECT COALESCE(MAX(\"seq\"), 0) FROM \"ChangeLog\"")
+struct ChangeLogHead
+{
+    unsigned long long seq;
+};
+
+/**
+ * Change-data-capture log of the database-backed authentication data.
+ *
+ * Each time a user, group, group membership, credential or schedule is
+ * persisted, updated or erased, the entity's ODB callback appends an entry
+ * to the `ChangeLog` table, in the same transaction as the change itself.
+ * Entries are numbered by a monotonically increasing sequence number.
+ *
+ * A satellite unit pulls the entries it hasn't seen yet (`CHANGE_LOG` remote
+ * control command) and replays them with apply(). Identifiers differ between
+ * units, so the satellite maps the entity identifiers of its source to its
+ * own in the `ChangeLogIdMap` table, and remembers the sequence number of the
+ * last applied entry in `ChangeLogCursor`. A satellite therefore resumes where
+ * it left off after a disconnection or a restart.
+ *
+ * The payload of an "upsert" entry holds the attributes of the entity, in
+ * the format of the websocket API serializers. Relationships are limited
+ * to what is required to enforce access control: a credential's owner and
+ * a membership's user and group. Schedule mappings and password hashes
+ * are not part of the log.
+ *
+ * The tables belong to the "core" schema, but databases created before
+ * they were introduced gain them through ensure_table().
+ *
+ * Entries are kept for a limited time: see prune().
+ *
+ * All functions must be called from within a transaction.
+ */
+class ChangeLog
+{
+  public:
+    /**
+     * Create the `ChangeLog`, `ChangeLogCursor` and `ChangeLogIdMap`
+     * tables if they don't exist.
+     */
+    static void ensure_table(odb::database &db);
+
+    static void record(odb::database &db, const User &user, bool erased);
+
+    static void record(odb::database &db, const Group &group, bool erased);
+
+    static void record(odb::database &db, const UserGroupMembership &membership,
+                       bool erased);
+
+    static void record(odb::database &db, const Cred::Credential &cred,
+                       bool erased);
+
+    static void record(odb::database &db, const Tools::Schedule &schedule,
+                       bool erased);
+
+    /**
+     * Sequence number of the most recent entry, or 0 if the log is empty.
+     *
+     * Entries up to the returned sequence number are all committed: call
+     * this before fetch(), in the same transaction.
+     */
+    static unsigned long long head(odb::database &db);
+
+    /**
+     * Retrieve the entries whose sequence number is in (`after`, `upto`].
+     */
+    static std::vector<ChangeLogRow> fetch(odb::database &db,
+                                           unsigned long long after,
+                                           unsigned long long upto);
+
+    /**
+     * Sequence number of the last entry from `source` that was applied.
+     */
+    static unsigned long long cursor(odb::database &db, const std::string &source);
+
+    static void cursor(odb::database &db, const std::string &source,
+                       unsigned long long seq);
+
+    /**
+     * Forget everything about `source`: its cursor and its identifiers
+     * mapping.
+     */
+    static void reset(odb::database &db, const std::string &source);
+
+    /**
+     * Replay an entry from the change log of `source`.
+     *
+     * The entry is applied inside a savepoint. If it cannot be applied
+     * (eg. it references an entity we don't know about), a warning is
+     * logged and the entry is skipped.
+     *
+     * @return false if the entry was skipped.
+     */
+    static bool apply(odb::database &db, const std::string &source,
+                      const ChangeLogRow &entry);
+
+    /**
+     * Compact the entries older than `max_age`.
+     *
+     * For each entity, the first and the last entries are kept, so that
+     * replaying the log still creates entities before the entries that
+     * refer to them. For entities erased more than `max_age` ago, only
+     * the erase is kept: it is a tombstone for the satellites that
+     * replicated the entity but not its removal yet. The most recent entry
+     * is always kept.
+     *
+     * @return The number of removed entries.
+     */
+    static unsigned long long prune(odb::database &db,
+                                    const std::chrono::seconds &max_age);
+};
+}
+}
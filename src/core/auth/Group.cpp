@@ -17,6 +17,7 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "core/auth/ChangeLog.hpp"
 #include "core/auth/Group_odb.h"
 #include "core/auth/UserGroupMembership_odb.h"
 #include "tools/log.hpp"
@@ -115,6 +116,8 @@ void Group::odb_callback(odb::callback_event e, odb::database &db) const
     if (e == odb::callback_event::post_update ||
         e == odb::callback_event::post_persist)
     {
+        // Record the group first: entries for new memberships refer to it.
+        ChangeLog::record(db, *this, false);
         for (auto &membership : membership_)
         {
             if (membership->id() == 0)
@@ -123,6 +126,8 @@ void Group::odb_callback(odb::callback_event e, odb::database &db) const
                 db.update(membership);
         }
     }
+    else if (e == odb::callback_event::post_erase)
+        ChangeLog::record(db, *this, true);
 }
 
 const UserGroupMembershipSet &Group::user_memberships() const
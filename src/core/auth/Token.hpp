@@ -110,6 +110,8 @@ class Token
 #pragma db not_null
     boost::posix_time::ptime expiration_;
 
+#pragma db index("Token_owner_i") member(owner_)
+
   public:
 #pragma db version
     ssize_t version_;
@@ -17,6 +17,7 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "core/auth/ChangeLog.hpp"
 #include "core/auth/Group_odb.h"
 #include "core/auth/User_odb.h"
 #include "core/credentials/ICredential.hpp"
@@ -198,3 +199,12 @@ void User::add_credential(const Leosac::Cred::ICredentialPtr &cred)
     cred->owner(shared_from_this());
     credentials_.push_back(assert_cast<Cred::CredentialPtr>(cred));
 }
+
+void User::odb_callback(odb::callback_event e, odb::database &db) const
+{
+    if (e == odb::callback_event::post_persist ||
+        e == odb::callback_event::post_update)
+        ChangeLog::record(db, *this, false);
+    else if (e == odb::callback_event::post_erase)
+        ChangeLog::record(db, *this, true);
+}
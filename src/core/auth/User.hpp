@@ -28,6 +28,7 @@
 #include "tools/db/database.hpp"
 #include "tools/scrypt/Scrypt.hpp"
 #include <boost/optional.hpp>
+#include <odb/callback.hxx>
 #include <memory>
 
 namespace Leosac
@@ -38,7 +39,7 @@ namespace Auth
 /**
 * Represent a user
 */
-#pragma db object optimistic
+#pragma db object callback(odb_callback) optimistic
 class User : public std::enable_shared_from_this<User>
 {
   public:
@@ -197,6 +198,11 @@ class User : public std::enable_shared_from_this<User>
   private:
     friend class odb::access;
     friend class ::Leosac::TestAccess;
+
+    /**
+     * Record changes in the ChangeLog.
+     */
+    void odb_callback(odb::callback_event e, odb::database &) const;
 };
 }
 }
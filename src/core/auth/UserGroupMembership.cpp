@@ -18,6 +18,7 @@
 */
 
 #include "core/auth/UserGroupMembership.hpp"
+#include "core/auth/ChangeLog.hpp"
 #include "core/auth/Group_odb.h"
 #include "core/auth/User_odb.h"
 #include "tools/log.hpp"
@@ -28,6 +29,7 @@ using namespace Leosac::Auth;
 UserGroupMembership::UserGroupMembership()
     : id_(0)
     , version_(0)
+    , rank_changed_(false)
 {
     timestamp_ = boost::posix_time::second_clock::local_time();
     rank_      = GroupRank::MEMBER;
@@ -70,7 +72,8 @@ GroupRank UserGroupMembership::rank() const
 
 void UserGroupMembership::rank(const GroupRank &rank)
 {
-    rank_ = rank;
+    rank_changed_ = rank_changed_ || rank != rank_;
+    rank_         = rank;
 }
 
 UserId UserGroupMembership::user_id() const
@@ -93,3 +96,16 @@ operator()(const UserGroupMembershipPtr &m1, const UserGroupMembershipPtr &m2) c
     return std::make_pair(m1->user_id(), m1->group_id()) <
            std::make_pair(m2->user_id(), m2->group_id());
 }
+
+void UserGroupMembership::odb_callback(odb::callback_event e,
+                                       odb::database &db) const
+{
+    if (e == odb::callback_event::post_persist ||
+        (e == odb::callback_event::post_update && rank_changed_))
+        ChangeLog::record(db, *this, false);
+    else if (e == odb::callback_event::post_erase)
+        ChangeLog::record(db, *this, true);
+    if (e == odb::callback_event::post_persist ||
+        e == odb::callback_event::post_update)
+        rank_changed_ = false;
+}
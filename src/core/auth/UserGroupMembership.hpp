@@ -22,6 +22,7 @@
 #include "core/auth/AuthFwd.hpp"
 #include "tools/db/database.hpp"
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <odb/callback.hxx>
 #include <set>
 
 namespace Leosac
@@ -35,7 +36,7 @@ namespace Auth
  * @note A membership is deleted on cascade when either its Group or
  * its User is deleted.
  */
-#pragma db object optimistic
+#pragma db object callback(odb_callback) optimistic
 class UserGroupMembership
 {
   public:
@@ -77,7 +78,22 @@ class UserGroupMembership
 #pragma db version
     const size_t version_;
 
+    /**
+     * Was the rank changed since the membership was loaded or
+     * last stored ?
+     */
+#pragma db transient
+    mutable bool rank_changed_;
+
     friend class odb::access;
+
+    /**
+     * Record creation, rank changes and removal in the ChangeLog.
+     *
+     * Other updates are not recorded: the group updates all its memberships
+     * each time it is updated, even though they didn't change.
+     */
+    void odb_callback(odb::callback_event e, odb::database &) const;
 };
 
 /**
@@ -25,17 +25,20 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/property_tree/ptree_serialization.hpp>
+#include <sys/stat.h>
 
 using namespace Leosac;
 
 ConfigManager::ConfigManager(const boost::property_tree::ptree &cfg)
     : kernel_config_(cfg)
-    , version_(0)
 {
     Tools::PropertyTreeExtractor extractor(cfg, "General Config");
 
-    version_       = extractor.get<uint64_t>("version", 0);
-    instance_name_ = extractor.get<std::string>("instance_name");
+    auto versions     = std::make_shared<VersionVector>();
+    versions->version = extractor.get<uint64_t>("version", 0);
+    versions->general = versions->version;
+    versions_         = versions;
+    instance_name_    = extractor.get<std::string>("instance_name");
 }
 
 boost::property_tree::ptree ConfigManager::get_application_config()
@@ -125,10 +128,79 @@ bool ConfigManager::store_config(std::string const &module,
         ret = false;
 
     modules_configs_[module] = cfg;
+    module_hashes_.erase(module);
+    snapshots_.erase(module);
+    update_versions([&](VersionVector &v) { v.modules[module] = v.version; });
 
     return ret;
 }
 
+std::string ConfigManager::module_hash(const std::string &module) const
+{
+    auto itr = module_hashes_.find(module);
+    if (itr != module_hashes_.end())
+        return itr->second;
+    return "";
+}
+
+void ConfigManager::module_hash(const std::string &module, const std::string &hash)
+{
+    module_hashes_[module] = hash;
+}
+
+const ConfigManager::ModuleHashMap &ConfigManager::module_hashes() const
+{
+    return module_hashes_;
+}
+
+bool ConfigManager::snapshot(const std::string &module, const std::string &variant,
+                             SnapshotFrames &frames) const
+{
+    auto module_itr = snapshots_.find(module);
+    if (module_itr == snapshots_.end())
+        return false;
+
+    auto itr = module_itr->second.find(variant);
+    if (itr == module_itr->second.end() ||
+        itr->second.version != config_version())
+        return false;
+    for (const auto &stamp : itr->second.files)
+    {
+        if (!(FileStamp::of(stamp.path) == stamp))
+            return false;
+    }
+    frames = itr->second.frames;
+    return true;
+}
+
+void ConfigManager::snapshot(const std::string &module, const std::string &variant,
+                             const SnapshotFrames &frames,
+                             const std::vector<std::string> &files)
+{
+    Snapshot snap{config_version(), frames, {}};
+    for (const auto &path : files)
+        snap.files.push_back(FileStamp::of(path));
+    snapshots_[module][variant] = std::move(snap);
+}
+
+ConfigManager::FileStamp ConfigManager::FileStamp::of(const std::string &path)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+        return FileStamp{path, false, 0, 0, 0};
+    return FileStamp{path, true,
+                     static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                         st.st_mtim.tv_nsec,
+                     static_cast<int64_t>(st.st_size),
+                     static_cast<uint64_t>(st.st_ino)};
+}
+
+bool ConfigManager::FileStamp::operator==(const FileStamp &o) const
+{
+    return path == o.path && exists == o.exists && mtime_ns == o.mtime_ns &&
+           size == o.size && inode == o.inode;
+}
+
 const boost::property_tree::ptree &
 ConfigManager::load_config(const std::string &module) const
 {
@@ -170,6 +242,7 @@ const boost::property_tree::ptree &ConfigManager::kconfig() const
 
 boost::property_tree::ptree &ConfigManager::kconfig()
 {
+    snapshots_.erase("");
     return kernel_config_;
 }
 
@@ -178,6 +251,9 @@ bool ConfigManager::remove_config(const std::string &module)
     if (modules_configs_.find(module) != modules_configs_.end())
     {
         modules_configs_.erase(module);
+        module_hashes_.erase(module);
+        snapshots_.erase(module);
+        update_versions([&](VersionVector &v) { v.modules.erase(module); });
         return true;
     }
     return false;
@@ -186,6 +262,8 @@ bool ConfigManager::remove_config(const std::string &module)
 void ConfigManager::set_kconfig(boost::property_tree::ptree const &new_cfg)
 {
     INFO("Attempting to set kernel config. We need to somehow merge.");
+    snapshots_.erase("");
+    update_versions([](VersionVector &v) { v.general = v.version; });
     auto kernel_cfg_file = kernel_config_.get<std::string>("kernel-cfg");
 
     auto child_opt = kernel_config_.get_child_optional("sync_dest");
@@ -248,14 +326,19 @@ bool ConfigManager::is_module_importable(std::string const &module_name) const
     return std::find(lst.begin(), lst.end(), module_name) == lst.end();
 }
 
+ConfigManager::VersionVectorCPtr ConfigManager::version_vector() const
+{
+    return std::atomic_load(&versions_);
+}
+
 uint64_t ConfigManager::config_version() const
 {
-    return version_;
+    return version_vector()->version;
 }
 
 void ConfigManager::incr_version()
 {
-    ++version_;
+    update_versions([](VersionVector &v) { ++v.version; });
 }
 
 bool ConfigManager::has_config(const std::string &module) const
@@ -265,7 +348,7 @@ bool ConfigManager::has_config(const std::string &module) const
 
 void ConfigManager::config_version(uint64_t new_version)
 {
-    version_ = new_version;
+    update_versions([&](VersionVector &v) { v.version = new_version; });
 }
 
 const std::string &ConfigManager::instance_name() const
@@ -105,6 +105,65 @@ class ConfigManager
     */
     const boost::property_tree::ptree &load_config(const std::string &module) const;
 
+    /**
+     * Map module name to the content hash of its configuration,
+     * as computed by the remote we synchronized from.
+     */
+    using ModuleHashMap = std::map<std::string, std::string>;
+
+    /**
+     * Return the content hash of the configuration of `module`, as
+     * received during the last synchronization, or an empty string if unknown.
+     *
+     * This lets the replication process skip modules whose configuration
+     * didn't change on the master.
+     */
+    std::string module_hash(const std::string &module) const;
+
+    /**
+     * Remember the content hash of the configuration of `module`.
+     *
+     * @note store_config() forgets the hash, so this must be called
+     * after storing the config.
+     */
+    void module_hash(const std::string &module, const std::string &hash);
+
+    /**
+     * Returns all known module hashes.
+     */
+    const ModuleHashMap &module_hashes() const;
+
+    /**
+     * Frames of a serialized configuration, as sent by the remote control.
+     */
+    using SnapshotFrames = std::vector<std::string>;
+
+    /**
+     * Retrieve a serialized snapshot of the configuration of `module`
+     * (or of the general configuration if `module` is empty).
+     *
+     * `variant` distinguishes between serializations of the same
+     * configuration (eg. the format).
+     *
+     * Snapshots are only valid for the configuration version they were
+     * taken at, and as long as the additional files they were built from
+     * are left untouched on disk (same mtime, size and inode). Returns
+     * false if there is no valid snapshot.
+     */
+    bool snapshot(const std::string &module, const std::string &variant,
+                  SnapshotFrames &frames) const;
+
+    /**
+     * Store a serialized snapshot of the configuration of `module`,
+     * for the current configuration version.
+     *
+     * `files` are the paths of the additional configuration files the
+     * snapshot embeds: the snapshot is invalidated if any of them changes.
+     */
+    void snapshot(const std::string &module, const std::string &variant,
+                  const SnapshotFrames &frames,
+                  const std::vector<std::string> &files = {});
+
     /**
     * Remove the config entry for the module named module.
     *
@@ -119,6 +178,11 @@ class ConfigManager
     {
         BOOST_ARCHIVE = 0,
         XML           = 1,
+        /**
+         * Boost text archive, compressed with zlib. Additional files
+         * content is compressed too.
+         */
+        BOOST_ARCHIVE_ZLIB = 2,
     };
 
     /**
@@ -128,6 +192,9 @@ class ConfigManager
 
     /**
     * Returns non-const ref to general config tree.
+    *
+    * @note As the tree may be modified through the reference, this
+    * drops the snapshots of the general configuration.
     */
     boost::property_tree::ptree &kconfig();
 
@@ -150,11 +217,47 @@ class ConfigManager
     */
     bool is_module_importable(const std::string &) const;
 
+    /**
+     * Versions of the different parts of the configuration.
+     *
+     * The general configuration and each module's configuration are
+     * stamped with the configuration version in effect when they were
+     * last stored.
+     */
+    struct VersionVector
+    {
+        /**
+         * The configuration version. See config_version().
+         */
+        uint64_t version;
+
+        /**
+         * Version at which the general configuration was last set.
+         */
+        uint64_t general;
+
+        /**
+         * Version at which each module's configuration was last stored.
+         */
+        std::map<std::string, uint64_t> modules;
+    };
+    using VersionVectorCPtr = std::shared_ptr<const VersionVector>;
+
+    /**
+     * Return the current version vector.
+     *
+     * The vector is immutable: a new one is published on every
+     * change. This method is thread safe.
+     */
+    VersionVectorCPtr version_vector() const;
+
     /**
      * Return the current configuration version.
      * This is supposed to work similar to Bind9 serial.
      *
      * It should only ever increase.
+     *
+     * @note This method is thread safe.
      */
     uint64_t config_version() const;
 
@@ -184,7 +287,55 @@ class ConfigManager
     */
     boost::property_tree::ptree kernel_config_;
 
-    uint64_t version_;
+    ModuleHashMap module_hashes_;
+
+    /**
+     * State of an additional configuration file when a snapshot was taken.
+     */
+    struct FileStamp
+    {
+        std::string path;
+        bool exists;
+        int64_t mtime_ns;
+        int64_t size;
+        uint64_t inode;
+
+        static FileStamp of(const std::string &path);
+        bool operator==(const FileStamp &o) const;
+    };
+
+    struct Snapshot
+    {
+        uint64_t version;
+        SnapshotFrames frames;
+        std::vector<FileStamp> files;
+    };
+
+    /**
+     * Serialized configuration snapshots, indexed by module name
+     * then variant.
+     *
+     * Module snapshots are dropped when the module's configuration is stored
+     * or removed, general configuration snapshots when the general
+     * configuration is modified.
+     */
+    std::map<std::string, std::map<std::string, Snapshot>> snapshots_;
+
+    /**
+     * Publish a modified copy of the version vector.
+     *
+     * Only the thread owning the ConfigManager (the main thread) modifies
+     * the vector. Other threads only load it, atomically.
+     */
+    template <typename Modifier>
+    void update_versions(Modifier modifier)
+    {
+        auto versions = std::make_shared<VersionVector>(*version_vector());
+        modifier(*versions);
+        std::atomic_store(&versions_, VersionVectorCPtr(versions));
+    }
+
+    VersionVectorCPtr versions_;
 
     std::string instance_name_;
 };
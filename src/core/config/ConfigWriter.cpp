@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/config/ConfigWriter.hpp"
+#include "tools/XmlPropertyTree.hpp"
+#include "tools/log.hpp"
+#include "tools/unixfs.hpp"
+
+using namespace Leosac;
+
+ConfigWriter::ConfigWriter()
+    : busy_(false)
+    , stop_(false)
+{
+    thread_ = std::thread([this]() { run(); });
+}
+
+ConfigWriter::~ConfigWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void ConfigWriter::save(const std::string &path, boost::property_tree::ptree tree)
+{
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        pending_[path] = std::move(tree);
+    }
+    cond_.notify_all();
+}
+
+bool ConfigWriter::flush()
+{
+    std::unique_lock<std::mutex> ul(mutex_);
+    cond_.wait(ul, [this]() { return pending_.empty() && !busy_; });
+    return failed_.empty();
+}
+
+void ConfigWriter::run()
+{
+    std::unique_lock<std::mutex> ul(mutex_);
+    while (true)
+    {
+        cond_.wait(ul, [this]() { return stop_ || !pending_.empty(); });
+        if (pending_.empty())
+            return;
+
+        auto itr  = pending_.begin();
+        auto path = itr->first;
+        auto tree = std::move(itr->second);
+        pending_.erase(itr);
+        busy_ = true;
+
+        ul.unlock();
+        bool ok = write(path, tree);
+        ul.lock();
+
+        busy_ = false;
+        if (ok)
+            failed_.erase(path);
+        else
+            failed_.insert(path);
+        cond_.notify_all();
+    }
+}
+
+bool ConfigWriter::write(const std::string &path,
+                         const boost::property_tree::ptree &tree)
+{
+    try
+    {
+        auto content = Tools::propertyTreeToXml(tree);
+        auto itr     = written_.find(path);
+        if (itr != written_.end() && itr->second == content)
+        {
+            DEBUG("Configuration file " << path << " is up to date.");
+            return true;
+        }
+        Tools::UnixFs::writeAtomically(path, content);
+        INFO("Configuration saved to " << path);
+        written_[path] = std::move(content);
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        ERROR("Failed to save configuration to " << path << ": " << e.what());
+    }
+    return false;
+}
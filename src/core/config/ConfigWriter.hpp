@@ -0,0 +1,115 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/property_tree/ptree.hpp>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace Leosac
+{
+/**
+* Persist configuration files from a background thread.
+*
+* Saving a configuration tree only queues it: the XML serialization
+* and the write happen on the writer thread, so the caller (typically
+* the main thread) doesn't wait on the disk.
+*
+* Files are replaced atomically (see Tools::UnixFs::writeAtomically()):
+* a crash in the middle of a save leaves the previous configuration
+* intact.
+*
+* Rapid successive saves of the same file are coalesced: only the most
+* recent tree queued for a path is written. A tree whose serialization
+* is identical to what was last written to that path is not written
+* again.
+*
+* The object is thread-safe.
+*/
+class ConfigWriter
+{
+  public:
+    ConfigWriter();
+
+    /**
+    * Wait for pending writes, then stop the writer thread.
+    */
+    ~ConfigWriter();
+
+    ConfigWriter(const ConfigWriter &) = delete;
+    ConfigWriter(ConfigWriter &&)      = delete;
+    ConfigWriter &operator=(const ConfigWriter &) = delete;
+    ConfigWriter &operator=(ConfigWriter &&) = delete;
+
+    /**
+    * Queue `tree` to be written, as XML, to `path`.
+    *
+    * This replaces any tree queued for the same path and not yet written.
+    */
+    void save(const std::string &path, boost::property_tree::ptree tree);
+
+    /**
+    * Block until all queued trees are written.
+    *
+    * Returns false if the last write to any of the files failed. A file
+    * stops being reported once it is written successfully.
+    */
+    bool flush();
+
+  private:
+    void run();
+
+    /**
+    * Serialize and write one tree. Returns false on failure.
+    */
+    bool write(const std::string &path, const boost::property_tree::ptree &tree);
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    /**
+    * Trees waiting to be written, indexed by path.
+    */
+    std::map<std::string, boost::property_tree::ptree> pending_;
+
+    /**
+    * Content last written to each path.
+    * Only accessed by the writer thread.
+    */
+    std::map<std::string, std::string> written_;
+
+    /**
+    * Is the writer thread currently writing a file ?
+    */
+    bool busy_;
+
+    /**
+    * Paths whose last write failed.
+    */
+    std::set<std::string> failed_;
+
+    bool stop_;
+    std::thread thread_;
+};
+}
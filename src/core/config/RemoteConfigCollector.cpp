@@ -19,36 +19,28 @@
 
 #include "core/config/RemoteConfigCollector.hpp"
 #include "core/config/ConfigManager.hpp"
-#include "core/tasks/FetchRemoteConfig.hpp"
-#include "core/tasks/FetchRemoteConfig.hpp"
-#include "core/tasks/GetRemoteConfigVersion.hpp"
 #include "exception/ExceptionsTools.hpp"
 #include "tools/BuildString.hpp"
+#include "tools/Compression.hpp"
 #include "tools/XmlPropertyTree.hpp"
 #include "tools/log.hpp"
-#include <zmqpp/curve.hpp>
+#include <algorithm>
+#include <chrono>
 
 using namespace Leosac;
 
-RemoteConfigCollector::RemoteConfigCollector(zmqpp::context_t &ctx,
-                                             std::string const &remote_endpoint,
-                                             std::string const &remote_pk)
-    : remote_endpoint_(remote_endpoint)
-    , remote_pk_(remote_pk)
-    , sock_(ctx, zmqpp::socket_type::dealer)
+RemoteConfigCollector::RemoteConfigCollector(
+    RemoteConnectionPtr connection, const ConfigManager::ModuleHashMap &known_hashes)
+    : connection_(connection)
     , mstimeout_(5000)
+    , msdeadline_(30000)
+    , config_format_(ConfigManager::ConfigFormat::BOOST_ARCHIVE)
+    , known_hashes_(known_hashes)
     , first_call_(true)
     , succeed_(false)
 {
-    auto kp = zmqpp::curve::generate_keypair();
-    sock_.set(zmqpp::socket_option::curve_secret_key, kp.secret_key);
-    sock_.set(zmqpp::socket_option::curve_public_key, kp.public_key);
-    sock_.set(zmqpp::socket_option::curve_server_key, remote_pk);
-    sock_.set(zmqpp::socket_option::linger, 0);
-    poller_.add(sock_);
 }
 
-
 static bool warn_and_set_error(std::string *error_str, const std::string &msg)
 {
     WARN(msg);
@@ -62,31 +54,58 @@ bool RemoteConfigCollector::fetch_config(std::string *error_str) noexcept
     assert(first_call_);
     first_call_ = false;
 
+    bool ret = collect(error_str);
+    // If we stopped midway, replies may still be in flight: drop them
+    // with the socket before releasing the connection.
+    if (session_ && !ret)
+        session_->reset();
+    session_ = nullptr;
+    return ret;
+}
+
+bool RemoteConfigCollector::collect(std::string *error_str)
+{
+    const auto &remote_endpoint = connection_->endpoint();
     try
     {
-        sock_.connect(remote_endpoint_);
-        if (!fetch_remote_config_version(remote_version_))
+        session_ = std::make_unique<RemoteConnection::Session>(*connection_);
+        if (!session_->ok())
+            return warn_and_set_error(
+                error_str, build_str("Connection to remote Leosac (",
+                                     remote_endpoint, ") is backing off."));
+        bool has_versions;
+        if (!fetch_config_versions(has_versions))
+            return warn_and_set_error(error_str,
+                                      "Cannot retrieve remote config versions.");
+
+        if (!has_versions && !fetch_remote_config_version(remote_version_))
             return warn_and_set_error(error_str,
                                       "Cannot retrieve remote config version.");
 
+        if (!has_versions && !fetch_module_hashes())
+            return warn_and_set_error(
+                error_str,
+                build_str("Error fetching module hashes from remote Leosac (",
+                          remote_endpoint, ")"));
+
         if (!fetch_general_config())
             return warn_and_set_error(
                 error_str,
                 build_str("Error fetching general configuration of remote Leosac (",
-                          remote_endpoint_, ")"));
+                          remote_endpoint, ")"));
 
-        if (!fetch_module_list())
+        if (!has_versions && !fetch_module_list())
             return warn_and_set_error(
                 error_str,
                 build_str("Error fetching module list from remote Leosac (",
-                          remote_endpoint_, ")"));
+                          remote_endpoint, ")"));
 
         if (!fetch_modules_config())
             return warn_and_set_error(
                 error_str,
                 build_str(
                     "Error fetching modules configuration from remote Leosac (",
-                    remote_endpoint_, ")"));
+                    remote_endpoint, ")"));
         // fetch the version again, and compare
         uint64_t version2;
         if (!fetch_remote_config_version(version2))
@@ -108,24 +127,32 @@ bool RemoteConfigCollector::fetch_config(std::string *error_str) noexcept
     return false;
 }
 
+bool RemoteConfigCollector::request(zmqpp::message &req, zmqpp::message &rep)
+{
+    return session_->request(req, rep, mstimeout_);
+}
+
 bool RemoteConfigCollector::fetch_general_config()
 {
     zmqpp::message msg;
 
-    msg << "GENERAL_CONFIG" << ConfigManager::ConfigFormat::BOOST_ARCHIVE;
-    sock_.send(msg);
-    poller_.poll(mstimeout_);
+    zmqpp::message rep;
 
-    if (poller_.has_input(sock_))
+    msg << "GENERAL_CONFIG" << config_format_;
+    if (request(msg, rep))
     {
-        sock_.receive(msg);
-        if (msg.remaining() == 2)
+        if (rep.remaining() == 2)
         {
             std::string tmp;
-            msg >> tmp;
-            assert(tmp == "OK");
-            msg >> tmp;
-            if (Tools::boost_text_archive_to_ptree(tmp, general_config_))
+            rep >> tmp;
+            if (tmp != "OK")
+            {
+                rep >> tmp;
+                ERROR("Remote failed to send its general configuration: " << tmp);
+                return false;
+            }
+            rep >> tmp;
+            if (Tools::boost_text_archive_to_ptree(decode(tmp), general_config_))
                 return true;
         }
     }
@@ -134,14 +161,12 @@ bool RemoteConfigCollector::fetch_general_config()
 
 bool RemoteConfigCollector::fetch_module_list()
 {
-    sock_.send("MODULE_LIST");
+    zmqpp::message req;
+    zmqpp::message msg;
 
-    poller_.poll(mstimeout_);
-    if (poller_.has_input(sock_))
+    req << "MODULE_LIST";
+    if (request(req, msg))
     {
-        zmqpp::message msg;
-        sock_.receive(msg);
-
         while (msg.remaining())
         {
             std::string tmp;
@@ -153,30 +178,66 @@ bool RemoteConfigCollector::fetch_module_list()
     return false;
 }
 
-bool RemoteConfigCollector::fetch_module_config(const std::string &module_name)
+bool RemoteConfigCollector::fetch_config_versions(bool &supported)
 {
+    zmqpp::message req;
     zmqpp::message msg;
 
-    msg << "MODULE_CONFIG" << module_name
-        << ConfigManager::ConfigFormat::BOOST_ARCHIVE;
-    sock_.send(msg);
-    poller_.poll(mstimeout_);
+    supported = false;
+    req << "CONFIG_VERSIONS";
+    if (!request(req, msg))
+        return false;
 
-    if (poller_.has_input(sock_))
-    {
-        sock_.receive(msg);
-        if (msg.remaining() < 3)
-            return false;
+    std::string status;
+    msg >> status;
+    if (status != "OK")
+        return true;
 
-        std::string result;
-        std::string config_str;
-        std::string recv_module_name;
+    supported      = true;
+    config_format_ = ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB;
+    uint64_t general_version;
+    if (msg.remaining() < 2 || (msg.remaining() - 2) % 3 != 0)
+    {
+        ERROR("Msg has " << msg.remaining()
+                         << " remaining parts, but need 2 plus a multiple of 3.");
+        return false;
+    }
+    msg >> remote_version_ >> general_version;
+    while (msg.remaining())
+    {
+        std::string module_name;
+        uint64_t module_version;
+        std::string hash;
+
+        // The hash tells whether the content changed: we don't need the
+        // module version itself.
+        msg >> module_name >> module_version >> hash;
+        module_list_.push_back(module_name);
+        module_hashes_[module_name] = hash;
+    }
+    return true;
+}
 
-        msg >> result >> recv_module_name >> config_str;
-        assert(result == "OK");
-        assert(recv_module_name == module_name);
+bool RemoteConfigCollector::fetch_module_hashes()
+{
+    zmqpp::message req;
+    zmqpp::message msg;
 
-        // process additional file.
+    req << "MODULE_HASHES";
+    if (request(req, msg))
+    {
+        std::string status;
+        msg >> status;
+        if (status != "OK")
+        {
+            INFO("Remote Leosac (" << connection_->endpoint()
+                                   << ") doesn't provide module hashes. "
+                                      "Will fetch all modules configuration.");
+            return true;
+        }
+        // Remotes that know about MODULE_HASHES also support compressed
+        // configuration transfer.
+        config_format_ = ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB;
         if (msg.remaining() % 2 != 0)
         {
             ERROR("Msg has " << msg.remaining()
@@ -185,28 +246,111 @@ bool RemoteConfigCollector::fetch_module_config(const std::string &module_name)
         }
         while (msg.remaining())
         {
-            std::string file_name;
-            std::string file_content;
+            std::string module_name;
+            std::string hash;
 
-            msg >> file_name >> file_content;
-            additional_files_[module_name].push_back(
-                std::make_pair(file_name, file_content));
+            msg >> module_name >> hash;
+            module_hashes_[module_name] = hash;
         }
+        return true;
+    }
+    return false;
+}
 
-        // make sure the map is not empty event if there is no file.
-        additional_files_[module_name];
+bool RemoteConfigCollector::process_module_config(zmqpp::message &msg,
+                                                  std::set<std::string> &pending)
+{
+    std::string result;
+    std::string config_str;
+    std::string module_name;
+
+    if (!msg.remaining())
+        return false;
+    msg >> result;
+    if (result != "OK")
+    {
+        // The reply doesn't say which module it is about: give up on the batch.
+        std::string reason;
+        if (msg.remaining())
+            msg >> reason;
+        ERROR("Remote failed to send a module configuration: " << reason);
+        return false;
+    }
+    if (msg.remaining() < 2)
+    {
+        ERROR("Malformed module configuration reply.");
+        return false;
+    }
+    msg >> module_name >> config_str;
+    if (pending.erase(module_name) != 1)
+    {
+        ERROR("Received unexpected configuration for module " << module_name);
+        return false;
+    }
 
-        if (Tools::boost_text_archive_to_ptree(config_str, config_map_[module_name]))
-            return true;
+    // process additional file.
+    if (msg.remaining() % 2 != 0)
+    {
+        ERROR("Msg has " << msg.remaining()
+                         << " remaining parts, but need a multiple of 2.");
+        return false;
     }
-    return false;
+    while (msg.remaining())
+    {
+        std::string file_name;
+        std::string file_content;
+
+        msg >> file_name >> file_content;
+        additional_files_[module_name].push_back(
+            std::make_pair(file_name, decode(file_content)));
+    }
+
+    // make sure the map is not empty event if there is no file.
+    additional_files_[module_name];
+
+    return Tools::boost_text_archive_to_ptree(decode(config_str),
+                                              config_map_[module_name]);
 }
 
 bool RemoteConfigCollector::fetch_modules_config()
 {
+    using namespace std::chrono;
+    std::set<std::string> pending;
+
     for (const auto &mod_name : module_list_)
     {
-        if (!fetch_module_config(mod_name))
+        if (module_unchanged(mod_name))
+        {
+            DEBUG("Configuration of module {" << mod_name
+                                              << "} didn't change. Skipping.");
+            continue;
+        }
+        zmqpp::message msg;
+        msg << "MODULE_CONFIG" << mod_name << config_format_;
+        if (!session_->send(msg))
+            return false;
+        pending.insert(mod_name);
+    }
+
+    auto deadline = steady_clock::now() + milliseconds(msdeadline_);
+    while (!pending.empty())
+    {
+        auto left =
+            duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if (left <= 0)
+        {
+            WARN("Deadline exceeded while fetching modules configuration. "
+                 << pending.size() << " modules left.");
+            return false;
+        }
+        zmqpp::message msg;
+        if (!session_->receive(msg, std::min<long>(left, mstimeout_)))
+        {
+            WARN("Timeout while fetching modules configuration. "
+                 << pending.size() << " modules left.");
+            return false;
+        }
+        if (!process_module_config(msg, pending))
             return false;
     }
     return true;
@@ -251,14 +395,42 @@ RemoteConfigCollector::additional_files(const std::string module) const
     throw std::runtime_error("Module doesn't exist here.");
 }
 
+std::string RemoteConfigCollector::decode(const std::string &data) const
+{
+    if (config_format_ == ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB)
+        return Tools::zlib_decompress(data);
+    return data;
+}
+
+bool RemoteConfigCollector::module_unchanged(const std::string &name) const
+{
+    auto hash = module_hash(name);
+    if (hash.empty())
+        return false;
+
+    auto itr = known_hashes_.find(name);
+    return itr != known_hashes_.end() && itr->second == hash;
+}
+
+std::string RemoteConfigCollector::module_hash(const std::string &name) const
+{
+    auto itr = module_hashes_.find(name);
+    if (itr != module_hashes_.end())
+        return itr->second;
+    return "";
+}
+
 bool RemoteConfigCollector::fetch_remote_config_version(uint64_t &version)
 {
-    auto task = std::make_shared<Tasks::GetRemoteConfigVersion>(remote_endpoint_,
-                                                                remote_pk_);
-    task->run();
-    if (task->succeed())
+    // We hold the connection: send the request ourselves rather than
+    // through a GetRemoteConfigVersion task.
+    zmqpp::message req;
+    zmqpp::message rep;
+
+    req << "CONFIG_VERSION";
+    if (request(req, rep))
     {
-        version = task->config_version_;
+        rep >> version;
         return true;
     }
     return false;
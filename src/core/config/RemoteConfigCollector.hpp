@@ -19,9 +19,12 @@
 
 #pragma once
 
+#include "core/config/ConfigManager.hpp"
+#include "core/config/RemoteConnection.hpp"
 #include <boost/property_tree/ptree.hpp>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 #include <zmqpp/zmqpp.hpp>
@@ -47,6 +50,25 @@ namespace Leosac
 * Optimistic Concurrency Control: we fetch the configuration version once before
 * retrieving the configuration, then we fetch it again when we are done. If the
 * number is the same, it means that the configuration didn't change.
+*
+* #### Delta synchronization:
+*
+* The collector can be given the content hashes of the module configurations
+* received during a previous synchronization. Before fetching module
+* configurations, it retrieves the current hashes from the remote (MODULE_HASHES
+* command) and skips the modules whose hash didn't change. Those modules are
+* reported by module_unchanged().
+*
+* Remotes that support the CONFIG_VERSIONS command return the configuration
+* version, the module list and the hashes in a single response. Older remotes
+* are queried with CONFIG_VERSION, MODULE_HASHES and MODULE_LIST.
+*
+* #### Connection:
+*
+* The collector doesn't own its connection to the remote. It uses a
+* RemoteConnection, that can be kept around and shared with other requests
+* (version checks, later collections). The connection is locked for the whole
+* collection, so other requests don't interleave with ours.
 */
 class RemoteConfigCollector
 {
@@ -56,14 +78,11 @@ class RemoteConfigCollector
     * config
     * collection.
     *
-    * @param ctx the zeromq context to create a socket.
-    * @param remote_endpoint the endpoint (tcp://ip:port) of the unit we want to
-    * collect config.
-    * @param remote_pk the public key of the remote. Provide some security, and avoid
-    * connecting to a unwanted server.
-    */
-    RemoteConfigCollector(zmqpp::context_t &ctx, const std::string &remote_endpoint,
-                          const std::string &remote_pk);
+    * @param connection connection to the unit we want to collect config.
+    * @param known_hashes the hashes of module configurations we already have.
+    */
+    RemoteConfigCollector(RemoteConnectionPtr connection,
+                          const ConfigManager::ModuleHashMap &known_hashes = {});
     virtual ~RemoteConfigCollector() = default;
 
     RemoteConfigCollector(const RemoteConfigCollector &) = delete;
@@ -114,9 +133,28 @@ class RemoteConfigCollector
 
     const FileNameContentList &additional_files(const std::string module) const;
 
+    /**
+    * Returns true if the configuration of the module didn't change since
+    * the synchronization its known hash comes from. The configuration of
+    * such a module has not been fetched.
+    */
+    bool module_unchanged(const std::string &name) const;
+
+    /**
+    * Returns the hash of the configuration of the module, as reported
+    * by the remote, or an empty string if the remote doesn't provide hashes.
+    */
+    std::string module_hash(const std::string &name) const;
+
     uint64_t remote_version() const;
 
   private:
+    /**
+    * Perform the collection for fetch_config(), while holding
+    * the connection.
+    */
+    bool collect(std::string *error_str);
+
     /**
     * Send the GENERAL_CONFIG command to the remote, and wait for response.
     */
@@ -128,12 +166,46 @@ class RemoteConfigCollector
     bool fetch_module_list();
 
     /**
-    * Sends the MODULE_CONFIG command for the module whose name is `module_name`.
+    * Sends the CONFIG_VERSIONS command.
+    *
+    * On success, this sets `remote_version_`, `module_list_` and
+    * `module_hashes_`. `supported` is set to false if the remote
+    * doesn't know the command.
     */
-    bool fetch_module_config(const std::string &module_name);
+    bool fetch_config_versions(bool &supported);
 
     /**
-    * Fetch the conf for all modules (relying on fetch_module_config()).
+    * Sends the MODULE_HASHES command.
+    *
+    * A remote that doesn't support the command is not an error: we
+    * simply don't know any hash and will fetch every module.
+    */
+    bool fetch_module_hashes();
+
+    /**
+    * Decode a configuration frame received from the remote, according
+    * to `config_format_`.
+    */
+    std::string decode(const std::string &data) const;
+
+    /**
+    * Process the response to a MODULE_CONFIG command.
+    *
+    * The module the response is about is identified by the
+    * module name embedded in the response. It must be part of `pending`,
+    * and is removed from it.
+    *
+    * A KO response carries no module name: it is logged, and fails the
+    * whole collection.
+    */
+    bool process_module_config(zmqpp::message &msg, std::set<std::string> &pending);
+
+    /**
+    * Fetch the conf for all modules.
+    *
+    * All MODULE_CONFIG commands are sent upfront, and the responses are matched
+    * as they arrive. The whole collection must complete within `msdeadline_`, and
+    * the remote must not stay silent for more than `mstimeout_`.
     */
     bool fetch_modules_config();
 
@@ -143,28 +215,54 @@ class RemoteConfigCollector
      */
     bool fetch_remote_config_version(uint64_t &version);
 
-    std::string remote_endpoint_;
-    std::string remote_pk_;
+    /**
+    * Send `req` over the session and wait for the response.
+    */
+    bool request(zmqpp::message &req, zmqpp::message &rep);
+
+    RemoteConnectionPtr connection_;
 
     /**
-    * Poll on the socket.
+    * Exclusive access to the connection, held while fetch_config() runs.
     */
-    zmqpp::poller_t poller_;
-    zmqpp::socket_t sock_;
+    std::unique_ptr<RemoteConnection::Session> session_;
 
     long mstimeout_;
 
+    /**
+    * Overall deadline for fetching all modules configuration.
+    */
+    long msdeadline_;
+
+    /**
+    * Format used to request configuration from the remote.
+    *
+    * We use compressed archive if the remote supports it, which is
+    * detected by fetch_config_versions() or fetch_module_hashes().
+    */
+    ConfigManager::ConfigFormat config_format_;
+
     uint64_t remote_version_;
 
     /**
     * Map module name to their config tree.
-    * The maps start empty and is filled by fetch_module_config();
+    * The maps start empty and is filled by process_module_config();
     */
     ModuleConfigMap config_map_;
     boost::property_tree::ptree general_config_;
     std::list<std::string> module_list_;
     ModuleAdditionalFiles additional_files_;
 
+    /**
+    * Hashes of the module configurations we already have.
+    */
+    ConfigManager::ModuleHashMap known_hashes_;
+
+    /**
+    * Hashes of the module configurations, as reported by the remote.
+    */
+    ConfigManager::ModuleHashMap module_hashes_;
+
     // those 2 boolean are here to enforce the correct use of the object.
     // Call fetch_config() then access various config item.
 
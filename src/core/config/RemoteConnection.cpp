@@ -0,0 +1,140 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/config/RemoteConnection.hpp"
+#include "tools/log.hpp"
+#include <algorithm>
+
+using namespace Leosac;
+
+constexpr const long RemoteConnection::min_backoff_ms;
+constexpr const long RemoteConnection::max_backoff_ms;
+
+RemoteConnection::RemoteConnection(const std::string &endpoint,
+                                   const std::string &server_pk)
+    : endpoint_(endpoint)
+    , server_pk_(server_pk)
+    , keypair_(zmqpp::curve::generate_keypair())
+    , backoff_ms_(min_backoff_ms)
+    , retry_after_(Clock::time_point::min())
+{
+}
+
+RemoteConnection::~RemoteConnection()
+{
+    close();
+}
+
+const std::string &RemoteConnection::endpoint() const
+{
+    return endpoint_;
+}
+
+const std::string &RemoteConnection::server_pk() const
+{
+    return server_pk_;
+}
+
+bool RemoteConnection::ensure_connected()
+{
+    if (sock_)
+        return true;
+    if (Clock::now() < retry_after_)
+        return false;
+
+    sock_ = std::make_unique<zmqpp::socket>(ctx_, zmqpp::socket_type::dealer);
+    sock_->set(zmqpp::socket_option::curve_secret_key, keypair_.secret_key);
+    sock_->set(zmqpp::socket_option::curve_public_key, keypair_.public_key);
+    sock_->set(zmqpp::socket_option::curve_server_key, server_pk_);
+    sock_->set(zmqpp::socket_option::linger, 0);
+    sock_->set(zmqpp::socket_option::reconnect_interval, 100);
+    sock_->set(zmqpp::socket_option::reconnect_interval_max,
+               static_cast<int>(max_backoff_ms));
+    sock_->connect(endpoint_);
+
+    poller_ = std::make_unique<zmqpp::poller>();
+    poller_->add(*sock_);
+    return true;
+}
+
+void RemoteConnection::failed()
+{
+    close();
+    retry_after_ = Clock::now() + std::chrono::milliseconds(backoff_ms_);
+    WARN("Connection to " << endpoint_ << " failed. Backing off for "
+                          << backoff_ms_ << "ms.");
+    backoff_ms_ = std::min(backoff_ms_ * 2, max_backoff_ms);
+}
+
+void RemoteConnection::succeeded()
+{
+    backoff_ms_ = min_backoff_ms;
+}
+
+void RemoteConnection::close()
+{
+    poller_ = nullptr;
+    sock_   = nullptr;
+}
+
+RemoteConnection::Session::Session(RemoteConnection &conn)
+    : conn_(conn)
+    , lock_(conn.mutex_)
+{
+    conn_.ensure_connected();
+}
+
+bool RemoteConnection::Session::ok() const
+{
+    return conn_.sock_ != nullptr;
+}
+
+bool RemoteConnection::Session::send(zmqpp::message &msg)
+{
+    if (!ok())
+        return false;
+    return conn_.sock_->send(msg);
+}
+
+bool RemoteConnection::Session::receive(zmqpp::message &msg, long timeout)
+{
+    if (!ok())
+        return false;
+
+    conn_.poller_->poll(timeout);
+    if (conn_.poller_->has_input(*conn_.sock_))
+    {
+        conn_.sock_->receive(msg);
+        conn_.succeeded();
+        return true;
+    }
+    conn_.failed();
+    return false;
+}
+
+bool RemoteConnection::Session::request(zmqpp::message &req, zmqpp::message &rep,
+                                        long timeout)
+{
+    return send(req) && receive(rep, timeout);
+}
+
+void RemoteConnection::Session::reset()
+{
+    conn_.close();
+}
@@ -0,0 +1,148 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "LeosacFwd.hpp"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <zmqpp/curve.hpp>
+#include <zmqpp/zmqpp.hpp>
+
+namespace Leosac
+{
+/**
+* A long-lived, authenticated connection to the remote control
+* interface of a Leosac unit.
+*
+* The curve keypair is generated once, and the DEALER socket is kept
+* connected between requests, so that version checks and configuration
+* fetches don't each pay for a new context, keypair and handshake.
+*
+* The connection is used through a Session, which grants exclusive access
+* to the socket for a sequence of requests. When a reply doesn't arrive in
+* time, the socket is dropped (along with any late reply still in flight)
+* and recreated on next use. Consecutive failures are spaced by an
+* exponential backoff: while backing off, sessions fail immediately
+* instead of waiting for a timeout again.
+*
+* The object is thread-safe.
+*/
+class RemoteConnection
+{
+  public:
+    /**
+    * @param endpoint the endpoint (tcp://ip:port) of the remote unit.
+    * @param server_pk the public key of the remote.
+    */
+    RemoteConnection(const std::string &endpoint, const std::string &server_pk);
+    ~RemoteConnection();
+
+    RemoteConnection(const RemoteConnection &) = delete;
+    RemoteConnection(RemoteConnection &&)      = delete;
+    RemoteConnection &operator=(const RemoteConnection &) = delete;
+    RemoteConnection &operator=(RemoteConnection &&) = delete;
+
+    const std::string &endpoint() const;
+    const std::string &server_pk() const;
+
+    /**
+    * Exclusive access to the connection.
+    *
+    * The connection is locked for the lifetime of the session.
+    */
+    class Session
+    {
+      public:
+        explicit Session(RemoteConnection &conn);
+
+        /**
+        * Returns false if the connection is backing off after a failure.
+        * Sending and receiving will fail in this case.
+        */
+        bool ok() const;
+
+        /**
+        * Send a message to the remote.
+        */
+        bool send(zmqpp::message &msg);
+
+        /**
+        * Wait at most `timeout` ms for a message from the remote.
+        *
+        * On timeout, the connection is reset.
+        */
+        bool receive(zmqpp::message &msg, long timeout);
+
+        /**
+        * Send `req` and wait at most `timeout` ms for the reply.
+        */
+        bool request(zmqpp::message &req, zmqpp::message &rep, long timeout);
+
+        /**
+        * Discard the socket, and any reply that may still be in flight.
+        *
+        * Call this when the request/reply sequence was abandoned
+        * midway, so that a late reply doesn't get mistaken for the
+        * response to a future request.
+        */
+        void reset();
+
+      private:
+        RemoteConnection &conn_;
+        std::unique_lock<std::mutex> lock_;
+    };
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+    * Create and connect the socket if needed.
+    * Returns false if we are backing off.
+    */
+    bool ensure_connected();
+
+    /**
+    * Drop the socket and back off.
+    */
+    void failed();
+
+    void succeeded();
+
+    void close();
+
+    static constexpr const long min_backoff_ms = 500;
+    static constexpr const long max_backoff_ms = 30000;
+
+    std::mutex mutex_;
+
+    std::string endpoint_;
+    std::string server_pk_;
+    zmqpp::curve::keypair keypair_;
+
+    zmqpp::context ctx_;
+    std::unique_ptr<zmqpp::socket> sock_;
+    std::unique_ptr<zmqpp::poller> poller_;
+
+    long backoff_ms_;
+    Clock::time_point retry_after_;
+};
+}
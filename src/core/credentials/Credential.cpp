@@ -18,6 +18,7 @@
 */
 
 #include "core/credentials/Credential.hpp"
+#include "core/auth/ChangeLog.hpp"
 #include "core/auth/User_odb.h"
 #include "core/credentials/CredentialValidator.hpp"
 
@@ -103,3 +104,12 @@ void Credential::schedule_mapping_added(
 {
     schedules_mapping_.push_back(sched_mapping);
 }
+
+void Credential::odb_callback(odb::callback_event e, odb::database &db) const
+{
+    if (e == odb::callback_event::post_persist ||
+        e == odb::callback_event::post_update)
+        Auth::ChangeLog::record(db, *this, false);
+    else if (e == odb::callback_event::post_erase)
+        Auth::ChangeLog::record(db, *this, true);
+}
@@ -25,6 +25,7 @@
 #include "core/credentials/ICredential.hpp"
 #include "tools/ToolsFwd.hpp"
 #include <cstddef>
+#include <odb/callback.hxx>
 
 namespace Leosac
 {
@@ -33,7 +34,7 @@ namespace Cred
 /**
  * An ODB enabled credential object.
  */
-#pragma db object polymorphic optimistic
+#pragma db object polymorphic callback(odb_callback) optimistic
 class Credential : public virtual ICredential
 {
   public:
@@ -89,9 +90,18 @@ class Credential : public virtual ICredential
 #pragma db version
     size_t odb_version_;
 
+// Credentials are looked up by alias and loaded through their owner.
+#pragma db index("Credential_alias_i") member(alias_)
+#pragma db index("Credential_owner_i") member(owner_)
+
   private:
     friend class odb::access;
     friend class ::Leosac::TestAccess;
+
+    /**
+     * Record changes in the ChangeLog.
+     */
+    void odb_callback(odb::callback_event e, odb::database &) const;
 };
 }
 }
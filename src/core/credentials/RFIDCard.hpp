@@ -61,6 +61,8 @@ class RFIDCard : public virtual IRFIDCard, public Credential
     int nb_bits_;
     std::string card_id_;
 
+#pragma db index("RFIDCard_card_id_i") member(card_id_)
+
   private:
     /**
      * Extract the card ID, assuming the format to be Wiegand26.
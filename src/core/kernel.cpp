@@ -18,7 +18,9 @@
 */
 
 #include "kernel.hpp"
+#include "core/audit/StatsRollup.hpp"
 #include "core/audit/serializers/JSONService.hpp"
+#include "core/auth/ChangeLog.hpp"
 #include "core/auth/AccessPointService.hpp"
 #include "core/auth/Group.hpp"
 #include "core/auth/User.hpp"
@@ -26,6 +28,7 @@
 #include "core/auth/serializers/AccessPointSerializer.hpp"
 #include "core/credentials/RFIDCard.hpp"
 #include "core/credentials/RFIDCard_odb.h"
+#include "core/tasks/GenericTask.hpp"
 #include "core/update/UpdateService.hpp"
 #include "core/update/serializers/AccessPointUpdateSerializer.hpp"
 #include "exception/ExceptionsTools.hpp"
@@ -39,6 +42,7 @@
 #include "tools/Schedule_odb.h"
 #include "tools/XmlPropertyTree.hpp"
 #include "tools/db/PGSQLTracer.hpp"
+#include "tools/db/SchemaIndexes.hpp"
 #include "tools/db/database.hpp"
 #include "tools/log.hpp"
 #include "tools/registry/GlobalRegistry.hpp"
@@ -46,13 +50,11 @@
 #include "tools/service/ServiceRegistry.hpp"
 #include "tools/signalhandler.hpp"
 #include "tools/unixfs.hpp"
-#include "tools/unixshellscript.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/property_tree/ptree_serialization.hpp>
-#include <fstream>
 #include <odb/pgsql/database.hxx>
 #include <odb/sqlite/database.hxx>
 
@@ -79,6 +81,8 @@ Kernel::Kernel(const boost::property_tree::ptree &config, bool strict)
     , send_sighup_(false)
     , autosave_(false)
     , start_time_(std::chrono::steady_clock::now())
+    , change_log_retention_(std::chrono::hours(24 * 30))
+    , last_change_log_prune_(start_time_ - std::chrono::hours(1))
     , xmlnne_(config_file_path())
 {
     configure_database();
@@ -89,12 +93,12 @@ Kernel::Kernel(const boost::property_tree::ptree &config, bool strict)
     if (config.get_child_optional("network"))
     {
         network_config_ = std::unique_ptr<NetworkConfig>(
-            new NetworkConfig(*this, config.get_child("network")));
+            new NetworkConfig(config.get_child("network")));
     }
     else
     {
         network_config_ = std::unique_ptr<NetworkConfig>(
-            new NetworkConfig(*this, boost::property_tree::ptree()));
+            new NetworkConfig(boost::property_tree::ptree()));
     }
 
     if (config.get_child_optional("remote"))
@@ -167,6 +171,9 @@ bool Kernel::run()
     {
         reactor_.poll(25); // this is good enough. May be improved later tho.
         utils_->scheduler().update(TargetThread::MAIN);
+        prune_change_log();
+        if (remote_controller_)
+            remote_controller_->update();
         if (send_sighup_)
         {
             bus_push_.send(zmqpp::message() << "KERNEL"
@@ -180,6 +187,8 @@ bool Kernel::run()
 
     if (autosave_)
         save_config();
+    if (!flush_config())
+        ERROR("Failed to save configuration to disk.");
     return want_restart_;
 }
 
@@ -278,17 +287,21 @@ void Kernel::handle_control_request()
 void Kernel::factory_reset()
 {
     // we need to restore factory config file.
-    UnixShellScript script("cp -f");
-
     std::string kernel_config_file =
         config_manager_.kconfig().get_child("kernel-cfg").data();
     INFO("Kernel config file path = " << kernel_config_file);
     INFO("RESTORING FACTORY CONFIG");
 
-    if (script.run(UnixShellScript::toCmdLine(
-            factory_config_directory() + "/kernel.xml", kernel_config_file)) != 0)
+    // Make sure a pending save won't overwrite the factory configuration.
+    config_writer_.flush();
+    try
     {
-        ERROR("Error restoring factory configuration...");
+        Tools::UnixFs::copyFile(factory_config_directory() + "/kernel.xml",
+                                kernel_config_file);
+    }
+    catch (const FsException &e)
+    {
+        ERROR("Error restoring factory configuration: " << e.what());
     }
 }
 
@@ -325,8 +338,8 @@ void Kernel::set_netconfig(zmqpp::message *msg)
     to_save.get_child("kernel").erase("kernel-cfg");
     try
     {
-        Leosac::Tools::propertyTreeToXmlFile(
-            to_save, config_manager_.kconfig().get_child("kernel-cfg").data());
+        config_writer_.save(config_manager_.kconfig().get_child("kernel-cfg").data(),
+                            std::move(to_save));
     }
     catch (std::exception &e)
     {
@@ -334,7 +347,7 @@ void Kernel::set_netconfig(zmqpp::message *msg)
         control_.send("KO");
         return;
     }
-    control_.send("OK");
+    control_.send(config_writer_.flush() ? "OK" : "KO");
 }
 
 void Kernel::extract_environ()
@@ -415,17 +428,25 @@ ModuleManager &Kernel::module_manager()
 bool Kernel::save_config()
 {
     INFO("Saving current configuration to disk.");
-    std::string full_config =
-        Tools::propertyTreeToXml(config_manager_.get_application_config());
-    std::string cfg_file_path =
-        config_manager_.kconfig().get<std::string>("kernel-cfg");
+    std::string cfg_file_path;
+    try
+    {
+        cfg_file_path = config_manager_.kconfig().get<std::string>("kernel-cfg");
+    }
+    catch (const ptree_error &e)
+    {
+        ERROR("Cannot save configuration: " << e.what());
+        return false;
+    }
 
     DEBUG("Will overwrite " << cfg_file_path << " in order to save configuration.");
-    std::ofstream cfg_file(cfg_file_path);
+    config_writer_.save(cfg_file_path, config_manager_.get_application_config());
+    return true;
+}
 
-    if (cfg_file << full_config)
-        return true;
-    return false;
+bool Kernel::flush_config()
+{
+    return config_writer_.flush();
 }
 
 zmqpp::context &Kernel::zmqpp_context()
@@ -478,6 +499,12 @@ void Kernel::configure_database()
     auto db_cfg_node = config_manager_.kconfig().get_child_optional("database");
     if (db_cfg_node)
     {
+        auto retention = db_cfg_node->get<long>("change_log_retention", 30);
+        if (retention < 1)
+            throw ConfigException(config_file_path(),
+                                  "change_log_retention must be positive.");
+        change_log_retention_ = std::chrono::hours(24 * retention);
+
         ElapsedTimeCounter etc;
         int wait_time = 1;
         while (etc.elapsed() <
@@ -763,12 +790,9 @@ void Kernel::create_update_schema()
     DEBUG("Database schema version: " << v);
     if (v == 0)
     {
-        {
-            odb::transaction t(database_->begin());
-            odb::schema_catalog::create_schema(*database_, "core");
-            t.commit();
-        }
-        populate_default_db();
+        odb::transaction t(database_->begin());
+        odb::schema_catalog::create_schema(*database_, "core");
+        t.commit();
     }
     else if (v < cv)
     {
@@ -778,4 +802,43 @@ void Kernel::create_update_schema()
         odb::schema_catalog::migrate(*database_, cv, "core");
         t.commit();
     }
+
+    odb::transaction t(database_->begin());
+    db::ensure_core_indexes(*database_);
+    Audit::StatsRollup::ensure_table(*database_);
+    Auth::ChangeLog::ensure_table(*database_);
+    t.commit();
+
+    // Populate once the ChangeLog exists, as the default objects are
+    // recorded in it.
+    if (v == 0)
+        populate_default_db();
+}
+
+void Kernel::prune_change_log()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!database_ || now - last_change_log_prune_ < std::chrono::hours(1))
+        return;
+    last_change_log_prune_ = now;
+
+    auto db        = database_;
+    auto retention = change_log_retention_;
+    auto task      = Tasks::GenericTask::build([db, retention]() {
+        try
+        {
+            odb::transaction t(db->begin());
+            auto removed = Auth::ChangeLog::prune(*db, retention);
+            t.commit();
+            if (removed)
+                INFO("Removed " << removed << " entries from the change log.");
+            return true;
+        }
+        catch (const odb::exception &e)
+        {
+            WARN("Failed to prune the change log: " << e.what());
+            return false;
+        }
+    });
+    utils_->scheduler().enqueue(task, TargetThread::POOL);
 }
@@ -25,6 +25,7 @@
 #include "Scheduler.hpp"
 #include "core/config/ConfigChecker.hpp"
 #include "core/config/ConfigManager.hpp"
+#include "core/config/ConfigWriter.hpp"
 #include "core/netconfig/networkconfig.hpp"
 #include "module_manager.hpp"
 #include "tools/ToolsFwd.hpp"
@@ -173,9 +174,20 @@ class Kernel
     * Save the current configuration to its original file if `autosave` is enabled.
     * This means that configuration change made when Leosac was running will be
     * persisted.
+    *
+    * The configuration is captured immediately but written by the
+    * ConfigWriter thread: this returns once the save is queued.
+    * Use flush_config() to wait for the write to complete.
     */
     bool save_config();
 
+    /**
+    * Wait for queued configuration saves to be written to disk.
+    *
+    * Returns false if a save failed.
+    */
+    bool flush_config();
+
     /**
     * Set the running_ and want_restart flag so that
     * leosac will restart in the next main loop iteration.
@@ -222,6 +234,8 @@ class Kernel
     /**
     * Handle SET_NETCONFIG command and update the configuration file directly.
     * The configuration update will take effect on the next restart.
+    * The file is written by the ConfigWriter thread. The reply (OK or KO)
+    * is sent once the write is done.
     * @param msg ZMQ message that holds config
     */
     void set_netconfig(zmqpp::message *msg);
@@ -233,12 +247,18 @@ class Kernel
     void populate_default_db();
 
     /**
-     * Create and/or update the database schema.
+     * Create and/or update the database schema, and make sure
+     * secondary indexes and the statistics rollup table exist.
      */
     void create_update_schema();
 
     void connect_to_db(const boost::property_tree::ptree &db_cfg_node);
 
+    /**
+     * Schedule the compaction of the ChangeLog, at most once an hour.
+     */
+    void prune_change_log();
+
     void configure_logger();
 
     /**
@@ -269,6 +289,11 @@ class Kernel
 
     ConfigManager config_manager_;
 
+    /**
+    * Writes configuration files off the main thread.
+    */
+    ConfigWriter config_writer_;
+
     /**
     * The application ZMQ context.
     */
@@ -348,6 +373,13 @@ class Kernel
      */
     DBPtr database_;
 
+    /**
+     * How long ChangeLog entries are kept before being compacted.
+     */
+    std::chrono::seconds change_log_retention_;
+
+    std::chrono::steady_clock::time_point last_change_log_prune_;
+
     Tools::XmlNodeNameEnforcer xmlnne_;
 
     ServiceRegistryUPtr service_registry_;
@@ -24,19 +24,21 @@
  */
 
 #include "networkconfig.hpp"
-#include "core/kernel.hpp"
 #include "tools/log.hpp"
+#include "tools/unixfs.hpp"
 #include "tools/unixshellscript.hpp"
 #include <boost/property_tree/ptree_fwd.hpp>
+#include <chrono>
+#include <sstream>
+#include <thread>
 
 using namespace Leosac::Tools;
 using namespace Leosac;
 
-NetworkConfig::NetworkConfig(const Kernel &k, const boost::property_tree::ptree &cfg)
+NetworkConfig::NetworkConfig(const boost::property_tree::ptree &cfg)
     : config_(cfg)
     , _enabled(false)
     , _dhcpEnabled(false)
-    , kernel_(k)
 {
     _enabled = cfg.get<bool>("enabled", false);
 
@@ -48,6 +50,7 @@ NetworkConfig::NetworkConfig(const Kernel &k, const boost::property_tree::ptree
         _defaultIp   = cfg.get<std::string>("default_ip");
         _ip          = cfg.get<std::string>("ip", _defaultIp);
         _gateway     = cfg.get<std::string>("gateway");
+        _cfgFile     = cfg.get<std::string>("interfaces_file", NetCfgFile);
 
         INFO("Network settings:" << std::endl
                                  << '\t' << "enabled=" << _enabled << std::endl
@@ -63,23 +66,45 @@ NetworkConfig::NetworkConfig(const Kernel &k, const boost::property_tree::ptree
 
 void NetworkConfig::reload()
 {
-    UnixShellScript builder(kernel_.script_directory() + "build_ipconfig.sh");
-    UnixShellScript apply(kernel_.script_directory() + "load_ipconfig.sh");
-
     if (!_enabled)
         return;
 
-    builder.run(UnixShellScript::toCmdLine(_dhcpEnabled, NetCfgFile, _interface, _ip,
-                                           _netmask, _gateway, "1&>/dev/null"));
-    if (!builder.getOutput().empty())
-        throw(ScriptException(builder.getOutput()));
+    UnixFs::writeAtomically(_cfgFile, interfaces());
 
-    apply.run(UnixShellScript::toCmdLine(NetCfgFile, _interface, "1&>/dev/null"));
-    if (!apply.getOutput().empty())
-        INFO("ScriptOutput:\n" << apply.getOutput() << "\n");
+    int ret;
+    if ((ret = UnixShellScript::exec({IfDown, "-i", _cfgFile, _interface})))
+        WARN(IfDown << " " << _interface << " exited with status " << ret);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if ((ret = UnixShellScript::exec({IfUp, "-i", _cfgFile, _interface})))
+    {
+        ERROR(IfUp << " " << _interface << " exited with status " << ret);
+        return;
+    }
     INFO("JUST LOADED IFCONFIG CONFIGURATION");
 }
 
+std::string NetworkConfig::interfaces() const
+{
+    std::ostringstream oss;
+
+    oss << "# This file was auto-generated" << std::endl
+        << "auto lo" << std::endl
+        << "iface lo inet loopback" << std::endl
+        << std::endl
+        << "auto " << _interface << std::endl
+        << "allow-hotplug " << _interface << std::endl;
+    if (_dhcpEnabled)
+        oss << "iface " << _interface << " inet dhcp" << std::endl;
+    else
+    {
+        oss << "iface " << _interface << " inet static" << std::endl
+            << "    address " << _ip << std::endl
+            << "    netmask " << _netmask << std::endl
+            << "    gateway " << _gateway << std::endl;
+    }
+    return oss.str();
+}
+
 void NetworkConfig::setEnabled(bool state)
 {
     _enabled = state;
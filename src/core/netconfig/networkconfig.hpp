@@ -24,25 +24,30 @@
 */
 
 #include <boost/property_tree/ptree.hpp>
+#include <string>
 
 #ifndef NETWORKCONFIG_HPP
 #define NETWORKCONFIG_HPP
 
 namespace Leosac
 {
-class Kernel;
-
 /**
 * Class that helps configuring the network.
 *
+* The interface configuration file is generated in-process and
+* written atomically. The interface is then restarted by running
+* `ifdown` and `ifup` directly, without going through a shell.
+*
 * @see @ref general_config_network for end-user documentation.
 */
 class NetworkConfig
 {
     static constexpr const char *NetCfgFile = "interfaces";
+    static constexpr const char *IfDown     = "/sbin/ifdown";
+    static constexpr const char *IfUp       = "/sbin/ifup";
 
   public:
-    explicit NetworkConfig(const Kernel &k, const boost::property_tree::ptree &cfg);
+    explicit NetworkConfig(const boost::property_tree::ptree &cfg);
 
     ~NetworkConfig() = default;
 
@@ -51,8 +56,19 @@ class NetworkConfig
     NetworkConfig &operator=(const NetworkConfig &other) = delete;
 
   public:
+    /**
+    * Write the interface configuration file and restart the interface.
+    *
+    * Does nothing if network management is disabled.
+    */
     void reload();
 
+    /**
+    * Build the content of the interface configuration file
+    * (ifupdown's `interfaces(5)` format).
+    */
+    std::string interfaces() const;
+
     void setEnabled(bool state);
 
     void setDHCP(bool enabled);
@@ -73,7 +89,11 @@ class NetworkConfig
     std::string _defaultIp;
     std::string _gateway;
 
-    const Kernel &kernel_;
+    /**
+    * Path to the generated interface configuration file.
+    * Defaults to NetCfgFile, in the working directory.
+    */
+    std::string _cfgFile;
 };
 }
 
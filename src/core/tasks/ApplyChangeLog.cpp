@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ApplyChangeLog.hpp"
+#include "core/auth/ChangeLog.hpp"
+#include "core/config/RemoteConnection.hpp"
+#include "tools/log.hpp"
+#include <odb/transaction.hxx>
+
+using namespace Leosac;
+using namespace Leosac::Tasks;
+
+constexpr const int ApplyChangeLog::timeout;
+constexpr const uint32_t ApplyChangeLog::batch_size;
+
+ApplyChangeLog::ApplyChangeLog(RemoteConnectionPtr connection, DBPtr db,
+                               const std::string &source)
+    : applied_(0)
+    , connection_(connection)
+    , db_(db)
+    , source_(source)
+{
+    INFO("Creating ApplyChangeLog task. Guid = " << get_guid());
+}
+
+bool ApplyChangeLog::do_run()
+{
+    bool done = false;
+    while (!done)
+    {
+        if (!apply_batch(done))
+            return false;
+    }
+    if (applied_)
+        INFO("Applied " << applied_ << " change log entries from remote.");
+    return true;
+}
+
+bool ApplyChangeLog::apply_batch(bool &done)
+{
+    uint64_t cursor;
+    {
+        odb::transaction t(db_->begin());
+        cursor = Auth::ChangeLog::cursor(*db_, source_);
+        t.commit();
+    }
+
+    zmqpp::message req;
+    zmqpp::message rep;
+    req << "CHANGE_LOG" << cursor << batch_size;
+    {
+        RemoteConnection::Session session(*connection_);
+        if (!session.request(req, rep, timeout))
+        {
+            ERROR("Failed to receive change log from remote server in due time");
+            return false;
+        }
+    }
+
+    std::string status;
+    rep >> status;
+    if (status != "OK")
+    {
+        std::string reason;
+        if (rep.remaining())
+            rep >> reason;
+        ERROR("Remote refused to send its change log: " << reason);
+        return false;
+    }
+
+    uint64_t upto;
+    uint64_t head;
+    rep >> upto >> head;
+    if (rep.remaining() % 5 != 0)
+    {
+        ERROR("Msg has " << rep.remaining()
+                         << " remaining parts, but need a multiple of 5.");
+        return false;
+    }
+
+    odb::transaction t(db_->begin());
+    if (upto < cursor)
+    {
+        // The remote's log restarted (eg. new database). Replay it entirely.
+        WARN("Remote change log is behind us (" << upto << " < " << cursor
+                                                << "). Replaying it.");
+        Auth::ChangeLog::reset(*db_, source_);
+        t.commit();
+        return true;
+    }
+    while (rep.remaining())
+    {
+        Auth::ChangeLogRow entry;
+        uint64_t seq;
+        uint64_t entity_id;
+
+        rep >> seq >> entry.entity >> entity_id >> entry.operation >> entry.payload;
+        entry.seq       = seq;
+        entry.entity_id = entity_id;
+        if (Auth::ChangeLog::apply(*db_, source_, entry))
+            ++applied_;
+    }
+    Auth::ChangeLog::cursor(*db_, source_, upto);
+    t.commit();
+
+    done = upto >= head;
+    return true;
+}
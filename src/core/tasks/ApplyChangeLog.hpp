@@ -0,0 +1,78 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "LeosacFwd.hpp"
+#include "Task.hpp"
+#include "tools/db/db_fwd.hpp"
+#include <string>
+
+namespace Leosac
+{
+namespace Tasks
+{
+/**
+ * Pull the authentication data ChangeLog of a remote unit, and apply
+ * its entries to the local database.
+ *
+ * Entries are requested in batches (CHANGE_LOG command), starting after the
+ * last entry applied from this source. Each batch is applied in a single
+ * transaction that also moves the source's cursor forward, so an interrupted
+ * synchronization resumes where it left off.
+ *
+ * This tasks should be scheduled in a pool thread.
+ *
+ * @see Auth::ChangeLog
+ */
+class ApplyChangeLog : public Task
+{
+  public:
+    /**
+     * @param source Stable identifier of the remote (eg. its public key). Used
+     * to track what was already applied.
+     */
+    ApplyChangeLog(RemoteConnectionPtr connection, DBPtr db,
+                   const std::string &source);
+
+    /**
+     * Number of entries applied by this task.
+     */
+    uint64_t applied_;
+
+    static constexpr const int timeout = 5000;
+
+    static constexpr const uint32_t batch_size = 500;
+
+  private:
+    virtual bool do_run() override;
+
+    /**
+     * Request and apply one batch.
+     *
+     * @param done set to true once the local database caught up.
+     */
+    bool apply_batch(bool &done);
+
+    RemoteConnectionPtr connection_;
+    DBPtr db_;
+    std::string source_;
+};
+}
+}
@@ -0,0 +1,301 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ExportHistory.hpp"
+#include "core/SecurityContext.hpp"
+#include "core/audit/AuditEntry.hpp"
+#include "core/audit/AuditEntry_odb.h"
+#include "core/audit/serializers/PolymorphicAuditSerializer.hpp"
+#include "exception/leosacexception.hpp"
+#include "tools/LogEntry.hpp"
+#include "tools/LogEntry_odb.h"
+#include "tools/db/database.hpp"
+#include "tools/log.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <cstdio>
+#include <zlib.h>
+
+using namespace Leosac;
+using namespace Leosac::Tasks;
+
+/**
+ * Thin wrapper over either a plain or a gzip'd file.
+ */
+class ExportHistory::OutputFile
+{
+  public:
+    OutputFile(const std::string &path, bool compress)
+        : path_(path)
+        , file_(nullptr)
+        , gz_(nullptr)
+    {
+        if (compress)
+            gz_ = gzopen(path.c_str(), "wb");
+        else
+            file_ = std::fopen(path.c_str(), "wb");
+
+        if (!file_ && !gz_)
+            throw FsException(BUILD_STR("Cannot open " << path << " for writing."));
+    }
+
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+    ~OutputFile()
+    {
+        if (file_)
+            std::fclose(file_);
+        if (gz_)
+            gzclose(gz_);
+    }
+
+    void write(const std::string &data)
+    {
+        if (data.empty())
+            return;
+
+        bool ok;
+        if (gz_)
+            ok = gzwrite(gz_, data.data(), static_cast<unsigned>(data.size())) ==
+                 static_cast<int>(data.size());
+        else
+            ok = std::fwrite(data.data(), 1, data.size(), file_) == data.size();
+        if (!ok)
+            throw FsException(BUILD_STR("Failed to write to " << path_));
+    }
+
+    /**
+     * Flush and close the file, throwing if anything fails.
+     */
+    void close()
+    {
+        int ret = 0;
+        if (file_)
+            ret = std::fclose(file_);
+        if (gz_)
+            ret = gzclose(gz_) == Z_OK ? 0 : -1;
+        file_ = nullptr;
+        gz_   = nullptr;
+        if (ret != 0)
+            throw FsException(BUILD_STR("Failed to close " << path_));
+    }
+
+  private:
+    std::string path_;
+    FILE *file_;
+    gzFile gz_;
+};
+
+namespace
+{
+/**
+ * Quote a CSV field if needed, as described by RFC 4180.
+ */
+std::string csv_field(const std::string &in)
+{
+    if (in.find_first_of(",\"\r\n") == std::string::npos)
+        return in;
+
+    std::string out;
+    out.reserve(in.size() + 2);
+    out += '"';
+    for (const auto &c : in)
+    {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    out += '"';
+    return out;
+}
+}
+
+ExportHistory::ExportHistory(DBPtr db, Source source, Format format, bool compress,
+                             const std::string &path)
+    : db_(db)
+    , source_(source)
+    , format_(format)
+    , compress_(compress)
+    , path_(path)
+    , exported_(0)
+    , total_(0)
+{
+    INFO("Creating ExportHistory task. Guid = " << get_guid());
+}
+
+size_t ExportHistory::exported() const
+{
+    return exported_;
+}
+
+size_t ExportHistory::total() const
+{
+    return total_;
+}
+
+const std::string &ExportHistory::path() const
+{
+    return path_;
+}
+
+ExportHistory::Source ExportHistory::source() const
+{
+    return source_;
+}
+
+bool ExportHistory::do_run()
+{
+    ASSERT_LOG(db_, "Database cannot be null.");
+    std::string tmp_path = path_ + ".part";
+
+    try
+    {
+        OutputFile out(tmp_path, compress_);
+        if (source_ == Source::AUDIT)
+            export_audit(out);
+        else
+            export_log(out);
+        out.close();
+    }
+    catch (...)
+    {
+        // Don't leave a partial export behind.
+        std::remove(tmp_path.c_str());
+        throw;
+    }
+
+    if (std::rename(tmp_path.c_str(), path_.c_str()) != 0)
+    {
+        ERROR("Failed to rename " << tmp_path << " to " << path_);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    INFO("Exported " << exported_ << " rows to " << path_);
+    return true;
+}
+
+void ExportHistory::export_audit(OutputFile &out)
+{
+    using Query = odb::query<Audit::AuditEntry>;
+    {
+        odb::transaction t(db_->begin());
+        total_ = db_->query_value<Audit::AuditEntryCount>().count;
+        t.commit();
+    }
+
+    if (format_ == Format::CSV)
+        out.write("id,timestamp,type,author_id,description\n");
+
+    Audit::AuditEntryId last_id = 0;
+    bool more                   = true;
+    while (more)
+    {
+        size_t count = 0;
+        std::string buffer;
+
+        odb::transaction t(db_->begin());
+        auto entries = db_->query<Audit::AuditEntry>(
+            (Query::id > last_id) + "ORDER BY" + Query::id + "LIMIT" +
+            std::to_string(batch_size));
+        for (const auto &entry : entries)
+        {
+            json serialized = Audit::Serializer::PolymorphicAuditJSON::serialize(
+                entry, SystemSecurityContext::instance());
+            if (format_ == Format::NDJSON)
+            {
+                buffer += serialized.dump();
+            }
+            else
+            {
+                auto type = serialized.at("type").get<std::string>();
+                buffer += std::to_string(entry.id()) + ',' +
+                          boost::posix_time::to_iso_extended_string(
+                              entry.timestamp()) +
+                          ',' + csv_field(type) + ',' +
+                          std::to_string(entry.author_id()) + ',' +
+                          csv_field(entry.generate_description());
+            }
+            buffer += '\n';
+            last_id = entry.id();
+            ++count;
+        }
+        t.commit();
+
+        out.write(buffer);
+        exported_ += count;
+        more = count == batch_size;
+    }
+}
+
+void ExportHistory::export_log(OutputFile &out)
+{
+    using Query = odb::query<Tools::LogEntry>;
+    {
+        odb::transaction t(db_->begin());
+        total_ = db_->query_value<Tools::LogView>().count;
+        t.commit();
+    }
+
+    if (format_ == Format::CSV)
+        out.write("id,timestamp,level,run_id,thread_id,message\n");
+
+    unsigned long last_id = 0;
+    bool more             = true;
+    while (more)
+    {
+        size_t count = 0;
+        std::string buffer;
+
+        odb::transaction t(db_->begin());
+        auto entries = db_->query<Tools::LogEntry>(
+            (Query::id > last_id) + "ORDER BY" + Query::id + "LIMIT" +
+            std::to_string(batch_size));
+        for (const auto &entry : entries)
+        {
+            auto timestamp =
+                boost::posix_time::to_iso_extended_string(entry.timestamp_);
+            if (format_ == Format::NDJSON)
+            {
+                json serialized = {{"id", entry.id_},
+                                   {"timestamp", timestamp},
+                                   {"level", entry.level_},
+                                   {"run_id", entry.run_id_},
+                                   {"thread_id", entry.thread_id_},
+                                   {"message", entry.msg_}};
+                buffer += serialized.dump();
+            }
+            else
+            {
+                buffer += std::to_string(entry.id_) + ',' + timestamp + ',' +
+                          std::to_string(entry.level_) + ',' +
+                          csv_field(entry.run_id_) + ',' +
+                          std::to_string(entry.thread_id_) + ',' +
+                          csv_field(entry.msg_);
+            }
+            buffer += '\n';
+            last_id = entry.id_;
+            ++count;
+        }
+        t.commit();
+
+        out.write(buffer);
+        exported_ += count;
+        more = count == batch_size;
+    }
+}
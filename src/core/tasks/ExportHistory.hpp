@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "LeosacFwd.hpp"
+#include "Task.hpp"
+#include "tools/db/db_fwd.hpp"
+#include <atomic>
+#include <string>
+
+namespace Leosac
+{
+namespace Tasks
+{
+/**
+ * Export the audit trail or the log history to a file.
+ *
+ * Rows are fetched by batch of `batch_size`, in increasing id order,
+ * each batch in its own transaction. Each row is written to the output
+ * file before the next batch is fetched: the memory footprint of the task
+ * does not depend on the size of the table.
+ *
+ * The file is written as `path + ".part"` and renamed to `path` once the
+ * export completes successfully. It is removed if the export fails.
+ *
+ * This task should be scheduled in a pool thread. Progress can be
+ * monitored from any thread through `exported()` and `total()`.
+ */
+class ExportHistory : public Task
+{
+  public:
+    enum class Source
+    {
+        AUDIT,
+        LOG,
+    };
+
+    enum class Format
+    {
+        /**
+         * One JSON object per line. Audit entries use the same
+         * representation as the `audit.get` websocket call.
+         */
+        NDJSON,
+        CSV,
+    };
+
+    ExportHistory(DBPtr db, Source source, Format format, bool compress,
+                  const std::string &path);
+
+    static constexpr const size_t batch_size = 500;
+
+    /**
+     * Number of rows exported so far.
+     */
+    size_t exported() const;
+
+    /**
+     * Number of rows to export. This is computed when the task starts
+     * and is 0 until then.
+     */
+    size_t total() const;
+
+    const std::string &path() const;
+
+    Source source() const;
+
+  private:
+    virtual bool do_run() override;
+
+    class OutputFile;
+
+    void export_audit(OutputFile &out);
+
+    void export_log(OutputFile &out);
+
+    DBPtr db_;
+    Source source_;
+    Format format_;
+    bool compress_;
+    std::string path_;
+
+    std::atomic<size_t> exported_;
+    std::atomic<size_t> total_;
+};
+}
+}
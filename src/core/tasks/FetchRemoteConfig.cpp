@@ -23,10 +23,18 @@
 using namespace Leosac;
 using namespace Leosac::Tasks;
 
-FetchRemoteConfig::FetchRemoteConfig(const std::string &endpoint,
-                                     const std::string &pubkey)
-    : ctx_()
-    , collector_(ctx_, endpoint, pubkey)
+FetchRemoteConfig::FetchRemoteConfig(
+    const std::string &endpoint, const std::string &pubkey,
+    const ConfigManager::ModuleHashMap &known_hashes)
+    : FetchRemoteConfig(std::make_shared<RemoteConnection>(endpoint, pubkey),
+                        known_hashes)
+{
+}
+
+FetchRemoteConfig::FetchRemoteConfig(
+    RemoteConnectionPtr connection,
+    const ConfigManager::ModuleHashMap &known_hashes)
+    : collector_(connection, known_hashes)
 {
     INFO("Creating FetchRemoteConfig task. Guid = " << get_guid());
 }
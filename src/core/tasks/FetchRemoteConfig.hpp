@@ -35,7 +35,18 @@ namespace Tasks
 class FetchRemoteConfig : public Task
 {
   public:
-    FetchRemoteConfig(const std::string &endpoint, const std::string &pubkey);
+    /**
+     * @param known_hashes Hashes of the module configurations received during
+     * the previous synchronization. Unchanged modules are not fetched.
+     */
+    FetchRemoteConfig(const std::string &endpoint, const std::string &pubkey,
+                      const ConfigManager::ModuleHashMap &known_hashes = {});
+
+    /**
+     * Fetch the configuration over an existing connection to the remote.
+     */
+    FetchRemoteConfig(RemoteConnectionPtr connection,
+                      const ConfigManager::ModuleHashMap &known_hashes = {});
 
     static constexpr const int timeout = 2000;
 
@@ -44,7 +55,6 @@ class FetchRemoteConfig : public Task
   private:
     virtual bool do_run() override;
 
-    zmqpp::context ctx_;
     RemoteConfigCollector collector_;
 };
 }
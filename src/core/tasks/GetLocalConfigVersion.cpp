@@ -31,5 +31,6 @@ Leosac::Tasks::GetLocalConfigVersion::GetLocalConfigVersion(Kernel &k)
 bool Leosac::Tasks::GetLocalConfigVersion::do_run()
 {
     config_version_ = kernel_.config_manager().config_version();
+    module_hashes_  = kernel_.config_manager().module_hashes();
     return true;
 }
@@ -21,21 +21,27 @@
 
 #include "LeosacFwd.hpp"
 #include "Task.hpp"
+#include "core/config/ConfigManager.hpp"
 
 namespace Leosac
 {
 namespace Tasks
 {
 /**
- * Run in the main thread and retrieve the current configuration version.
+ * Run in the main thread and retrieve the current configuration version,
+ * as well as the known hashes of modules configuration.
  *
  * This is done by querying the kernel's configuration manager.
+ *
+ * @note The configuration version alone can be read from any thread,
+ * see ConfigManager::version_vector().
  */
 class GetLocalConfigVersion : public Task
 {
   public:
     GetLocalConfigVersion(Kernel &k);
     uint64_t config_version_;
+    ConfigManager::ModuleHashMap module_hashes_;
 
   private:
     virtual bool do_run() override;
@@ -18,43 +18,35 @@
 */
 
 #include "GetRemoteConfigVersion.hpp"
+#include "core/config/RemoteConnection.hpp"
 #include "core/kernel.hpp"
 #include "tools/log.hpp"
-#include <zmqpp/curve.hpp>
 
 using namespace Leosac;
 
 Tasks::GetRemoteConfigVersion::GetRemoteConfigVersion(const std::string &endpoint,
                                                       const std::string &pubkey)
+    : GetRemoteConfigVersion(std::make_shared<RemoteConnection>(endpoint, pubkey))
+{
+}
+
+Tasks::GetRemoteConfigVersion::GetRemoteConfigVersion(
+    RemoteConnectionPtr connection)
     : config_version_(0)
-    , endpoint_(endpoint)
-    , pubkey_(pubkey)
+    , connection_(connection)
 {
     INFO("Creating GetRemoteConfigVersion task. Guid = " << get_guid());
 }
 
 bool Tasks::GetRemoteConfigVersion::do_run()
 {
-    zmqpp::context ctx;
-    zmqpp::socket sock(ctx, zmqpp::socket_type::dealer);
-    auto kp = zmqpp::curve::generate_keypair();
-
-    sock.set(zmqpp::socket_option::curve_secret_key, kp.secret_key);
-    sock.set(zmqpp::socket_option::curve_public_key, kp.public_key);
-    sock.set(zmqpp::socket_option::curve_server_key, pubkey_);
-    sock.set(zmqpp::socket_option::linger, 0);
-    sock.connect(endpoint_);
-
-    sock.send("CONFIG_VERSION");
-
+    RemoteConnection::Session session(*connection_);
+    zmqpp::message request;
     zmqpp::message response;
-    zmqpp::poller p;
-    p.add(sock);
 
-    p.poll(timeout);
-    if (p.has_input(sock))
+    request << "CONFIG_VERSION";
+    if (session.request(request, response, timeout))
     {
-        sock.receive(response);
         response >> config_version_;
         INFO("Remote configuration version = " << config_version_);
         return true;
@@ -36,6 +36,11 @@ class GetRemoteConfigVersion : public Task
   public:
     GetRemoteConfigVersion(const std::string &endpoint, const std::string &pubkey);
 
+    /**
+     * Send the request over an existing connection to the remote.
+     */
+    explicit GetRemoteConfigVersion(RemoteConnectionPtr connection);
+
     uint64_t config_version_;
 
     static constexpr const int timeout = 5000;
@@ -43,8 +48,7 @@ class GetRemoteConfigVersion : public Task
   private:
     virtual bool do_run() override;
 
-    std::string endpoint_;
-    std::string pubkey_;
+    RemoteConnectionPtr connection_;
 };
 }
 }
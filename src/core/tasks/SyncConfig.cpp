@@ -47,6 +47,7 @@ bool SyncConfig::do_run()
         return false;
     }
 
+    auto version = kernel_.config_manager().config_version();
     try
     {
         kernel_.core_utils()->config_checker().clear();
@@ -55,6 +56,9 @@ bool SyncConfig::do_run()
     catch (const std::exception &e)
     {
         ERROR("SyncConfig task had a problem " << e.what());
+        // Don't claim the remote version: the next notification has to
+        // trigger a synchronization again.
+        kernel_.config_manager().config_version(version);
         return false;
     }
 
@@ -66,6 +70,10 @@ void SyncConfig::sync_config()
     const RemoteConfigCollector &collector = fetch_task_->collector();
     ConfigManager backup                   = kernel_.config_manager();
 
+    // Adopt the remote version first: store_config() and set_kconfig()
+    // stamp what they store with the current version.
+    kernel_.config_manager().config_version(collector.remote_version());
+
     if (sync_general_config_)
     {
         INFO("Also syncing general configuration.");
@@ -78,7 +86,14 @@ void SyncConfig::sync_config()
     for (const auto &name : collector.modules_list())
     {
         DEBUG("Handling module {" << name << "}");
-        if (kernel_.config_manager().is_module_importable(name))
+        if (kernel_.config_manager().is_module_importable(name) &&
+            collector.module_unchanged(name) && backup.has_config(name))
+        {
+            // Keep the current config and additional files.
+            DEBUG("Config for {" << name << "} is unchanged.");
+            kernel_.config_manager().store_config(name, backup.load_config(name));
+        }
+        else if (kernel_.config_manager().is_module_importable(name))
         {
             INFO("Updating config for {" << name << "}");
             kernel_.config_manager().store_config(name,
@@ -136,7 +151,17 @@ void SyncConfig::sync_config()
             assert(ret);
         }
     }
-    kernel_.config_manager().config_version(collector.remote_version());
+    // Remember the hashes of what we imported, so that the next
+    // synchronization can skip the unchanged modules.
+    for (const auto &name : collector.modules_list())
+    {
+        auto hash = collector.module_hash(name);
+        if (!hash.empty() && kernel_.config_manager().is_module_importable(name) &&
+            kernel_.config_manager().has_config(name))
+        {
+            kernel_.config_manager().module_hash(name, hash);
+        }
+    }
     kernel_.module_manager().initModules();
     if (autocommit_)
     {
@@ -20,6 +20,7 @@
 #include "BaseModule.hpp"
 #include "core/CoreUtils.hpp"
 #include "core/config/ConfigManager.hpp"
+#include "tools/Compression.hpp"
 #include "tools/XmlPropertyTree.hpp"
 #include "tools/log.hpp"
 #include <boost/archive/text_oarchive.hpp>
@@ -77,12 +78,13 @@ void BaseModule::dump_config(ConfigManager::ConfigFormat fmt,
                              zmqpp::message *out_msg) const
 {
     assert(out_msg);
-    if (fmt == ConfigManager::ConfigFormat::BOOST_ARCHIVE)
+    bool compressed = fmt == ConfigManager::ConfigFormat::BOOST_ARCHIVE_ZLIB;
+    if (fmt == ConfigManager::ConfigFormat::BOOST_ARCHIVE || compressed)
     {
         std::ostringstream oss;
         boost::archive::text_oarchive archive(oss);
         boost::property_tree::save(archive, config_, 1);
-        out_msg->add(oss.str());
+        out_msg->add(compressed ? zlib_compress(oss.str()) : oss.str());
     }
     else
     {
@@ -90,7 +92,22 @@ void BaseModule::dump_config(ConfigManager::ConfigFormat fmt,
     }
     try
     {
-        dump_additional_config(out_msg);
+        if (!compressed)
+        {
+            dump_additional_config(out_msg);
+            return;
+        }
+        // Additional files come as (file_name, file_content) pairs.
+        zmqpp::message files;
+        dump_additional_config(&files);
+        while (files.remaining() >= 2)
+        {
+            std::string file_name;
+            std::string file_content;
+            files >> file_name >> file_content;
+            out_msg->add(file_name);
+            out_msg->add(zlib_compress(file_content));
+        }
     }
     catch (std::exception &e)
     {
@@ -22,12 +22,15 @@
 #include "core/CoreUtils.hpp"
 #include "core/Scheduler.hpp"
 #include "core/SecurityContext.hpp"
+#include "core/audit/StatsRollup.hpp"
 #include "core/auth/Auth.hpp"
 #include "core/auth/AuthSourceBuilder.hpp"
 #include "core/auth/User.hpp"
 #include "core/credentials/serializers/PolymorphicCredentialSerializer.hpp"
 #include "exception/ExceptionsTools.hpp"
 #include "tools/Colorize.hpp"
+#include "tools/db/MultiplexedTransaction.hpp"
+#include "tools/db/database.hpp"
 #include "tools/log.hpp"
 #include <boost/algorithm/string/join.hpp>
 
@@ -99,6 +102,8 @@ void AuthFileInstance::handle_bus_msg()
              << Colorize::underline(target_name_) << " for " << log_user);
     }
     bus_push_.send(auth_result_msg);
+    record_access_stats(auth_result.user ? auth_result.user->username() : "",
+                        auth_result.success);
 }
 
 zmqpp::socket &AuthFileInstance::bus_sub()
@@ -198,6 +203,42 @@ void AuthFileInstance::reload_auth_config()
     core_utils_->scheduler().enqueue(task, TargetThread::POOL);
 }
 
+void AuthFileInstance::record_access_stats(const std::string &username,
+                                           bool granted)
+{
+    if (!core_utils_->database())
+        return;
+
+    auto door = target_name_.empty() ? name_ : target_name_;
+    stats_.record_access(boost::posix_time::second_clock::universal_time(), door,
+                         username, granted);
+}
+
+void AuthFileInstance::flush_access_stats()
+{
+    auto db = core_utils_->database();
+    if (!db || stats_.empty())
+        return;
+
+    auto stats = std::make_shared<Audit::StatsBatch>();
+    std::swap(*stats, stats_);
+    auto task = Tasks::GenericTask::build([db, stats]() {
+        try
+        {
+            db::MultiplexedTransaction t(db->begin());
+            stats->write(*db);
+            t.commit();
+            return true;
+        }
+        catch (const odb::exception &e)
+        {
+            WARN("Failed to update access statistics: " << e.what());
+            return false;
+        }
+    });
+    core_utils_->scheduler().enqueue(task, TargetThread::POOL);
+}
+
 bool AuthFileInstance::handle_kernel_message(const zmqpp::message &msg)
 {
     auto cp = msg.copy();
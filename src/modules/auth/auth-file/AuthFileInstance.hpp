@@ -21,6 +21,7 @@
 
 #include "FileAuthSourceMapper.hpp"
 #include "LeosacFwd.hpp"
+#include "core/audit/StatsRollup.hpp"
 #include "core/auth/AuthFwd.hpp"
 #include "core/tasks/Task.hpp"
 #include <fstream>
@@ -113,6 +114,14 @@ class AuthFileInstance : public std::enable_shared_from_this<AuthFileInstance>
     */
     std::string auth_file_content() const;
 
+    /**
+     * Schedule the write of the access statistics recorded since the
+     * last flush, in a single transaction.
+     *
+     * This does nothing if no access was recorded.
+     */
+    void flush_access_stats();
+
   private:
     /**
      * Handle the message if its from Leosac's kernel, or
@@ -127,6 +136,14 @@ class AuthFileInstance : public std::enable_shared_from_this<AuthFileInstance>
      */
     void reload_auth_config();
 
+    /**
+     * Record an access decision in the statistics rollups, at the next
+     * call to flush_access_stats().
+     *
+     * This does nothing if Leosac runs without a database.
+     */
+    void record_access_stats(const std::string &username, bool granted);
+
     /**
     * Prepare auth source object, map them to profile and check if access is granted.
     *
@@ -177,6 +194,11 @@ class AuthFileInstance : public std::enable_shared_from_this<AuthFileInstance>
     */
     std::string file_path_;
 
+    /**
+     * Access statistics not yet written to the database.
+     */
+    Audit::StatsBatch stats_;
+
     CoreUtilsPtr core_utils_;
 };
 }
@@ -20,6 +20,8 @@
 #include "AuthFileModule.hpp"
 #include "core/CoreUtils.hpp"
 #include "core/kernel.hpp"
+#include <algorithm>
+#include <chrono>
 
 using namespace Leosac;
 using namespace Leosac::Module::Auth;
@@ -42,6 +44,27 @@ AuthFileModule::~AuthFileModule()
 {
 }
 
+void AuthFileModule::run()
+{
+    // Access statistics are written in batches, at most every
+    // `stats_flush_interval`, and when the module stops.
+    using namespace std::chrono;
+    const auto stats_flush_interval = seconds(5);
+    auto next_flush                 = steady_clock::now() + stats_flush_interval;
+    while (is_running_)
+    {
+        auto timeout = duration_cast<milliseconds>(next_flush - steady_clock::now());
+        reactor_.poll(std::max(timeout, milliseconds(0)).count());
+        if (steady_clock::now() < next_flush)
+            continue;
+        for (auto &authenticator : authenticators_)
+            authenticator->flush_access_stats();
+        next_flush = steady_clock::now() + stats_flush_interval;
+    }
+    for (auto &authenticator : authenticators_)
+        authenticator->flush_access_stats();
+}
+
 void AuthFileModule::process_config()
 {
     boost::property_tree::ptree module_config = config_.get_child("module_config");
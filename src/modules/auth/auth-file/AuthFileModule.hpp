@@ -49,6 +49,11 @@ class AuthFileModule : public BaseModule
 
     ~AuthFileModule();
 
+    /**
+     * Run the reactor, and periodically write the access statistics.
+     */
+    virtual void run() override;
+
   protected:
     /**
     * We have one config file per authenticator object.
@@ -18,77 +18,211 @@
 */
 
 #include "EventPublish.h"
+#include "exception/configexception.hpp"
 #include <core/auth/Auth.hpp>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cstring>
 
 using namespace Leosac::Module::EventPublish;
 
+namespace
+{
+/**
+ * Write `value` in big endian.
+ */
+void put_be64(char *out, uint64_t value)
+{
+    for (int i = 7; i >= 0; --i)
+    {
+        out[i] = static_cast<char>(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+/**
+ * Write the decimal representation of `value`, returns its size.
+ */
+size_t to_decimal(uint64_t value, char *out)
+{
+    char tmp[20];
+    size_t size = 0;
+    do
+    {
+        tmp[size++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (size_t i = 0; i < size; ++i)
+        out[i] = tmp[size - 1 - i];
+    return size;
+}
+
+uint64_t now_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+}
+
 EventPublish::EventPublish(zmqpp::context &ctx, zmqpp::socket *pipe,
                            const boost::property_tree::ptree &cfg,
                            CoreUtilsPtr utils)
     : BaseModule(ctx, pipe, cfg, utils)
     , bus_sub_(ctx, zmqpp::socket_type::sub)
     , network_pub_(ctx, zmqpp::socket_type::pub)
+    , conflate_interval_(0)
 {
     bus_sub_.connect("inproc://zmq-bus-pub");
     process_config();
     reactor_.add(bus_sub_, std::bind(&EventPublish::handle_msg_bus, this));
 }
 
+void EventPublish::run()
+{
+    while (is_running_)
+    {
+        reactor_.poll(conflate_timeout());
+        if (conflated_pub_)
+            publish_conflated();
+    }
+}
+
+bool EventPublish::decode(const std::vector<WiegandFormat> &formats,
+                          const char *card, size_t size, int bits,
+                          uint64_t &number)
+{
+    auto format = std::find_if(
+        formats.begin(), formats.end(),
+        [&](const WiegandFormat &f) { return f.bits_ == bits; });
+    if (format == formats.end())
+        return false;
+
+    // The frame is left-aligned in the hexadecimal digits.
+    uint64_t raw = 0;
+    int digits   = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        char c = card[i];
+        if (c == ':')
+            continue;
+        if (!std::isxdigit(static_cast<unsigned char>(c)) || digits == 16)
+            return false;
+        raw = (raw << 4) |
+              static_cast<uint64_t>(std::isdigit(static_cast<unsigned char>(c))
+                                        ? c - '0'
+                                        : std::tolower(c) - 'a' + 10);
+        ++digits;
+    }
+    int padding = digits * 4 - bits;
+    if (padding < 0)
+        return false;
+
+    raw >>= padding + format->skip_;
+    if (format->width_ < 64)
+        raw &= (uint64_t(1) << format->width_) - 1;
+    number = raw;
+    return true;
+}
+
 void EventPublish::handle_msg_bus()
 {
+    // zmq hands over each part whole; small parts are stored inline in the
+    // message, so the event path stays cheap.
     zmqpp::message msg;
-    std::string src;
-    Leosac::Auth::SourceType type;
-    std::string card;
-    int bits;
-
     bus_sub_.receive(msg);
+    uint8_t type;
+    int32_t bits;
+    if (msg.parts() < 4 || msg.size(1) != sizeof(type) ||
+        msg.size(3) != sizeof(bits))
+        return;
+    std::memcpy(&type, msg.raw_data(1), sizeof(type));
+    std::memcpy(&bits, msg.raw_data(3), sizeof(bits));
+    if (static_cast<Leosac::Auth::SourceType>(type) !=
+        Leosac::Auth::SourceType::SIMPLE_WIEGAND)
+        return;
 
-    if (msg.parts() < 4)
+    auto source = std::find_if(sources_.begin(), sources_.end(),
+                               [&](const Source &s) {
+                                   return s.topic_.size() == msg.size(0) &&
+                                          !std::memcmp(s.topic_.data(),
+                                                       msg.raw_data(0),
+                                                       msg.size(0));
+                               });
+    uint64_t number;
+    if (source == sources_.end() ||
+        !decode(formats_, static_cast<const char *>(msg.raw_data(2)),
+                msg.size(2), static_cast<int>(ntohl(bits)), number))
         return;
-    msg >> src >> type >> card >> bits;
-    INFO("Will publish card id {" << card << "}");
 
-    if (type != Leosac::Auth::SourceType::SIMPLE_WIEGAND)
+    auto timestamp = now_ms();
+    publish(network_pub_, *source, number, timestamp);
+    if (conflated_pub_)
+    {
+        source->card_      = number;
+        source->timestamp_ = timestamp;
+        source->dirty_     = true;
+        publish_conflated();
+    }
+}
+
+void EventPublish::publish(zmqpp::socket &socket, const Source &source,
+                           uint64_t card, uint64_t timestamp)
+{
+    if (binary_)
     {
-        INFO("EventPublish cannot handle this type of credential yet.");
+        char payload[16];
+        put_be64(payload, card);
+        put_be64(payload + 8, timestamp);
+        socket.send_raw(source.name_.data(), source.name_.size(),
+                        zmqpp::socket::send_more);
+        socket.send_raw(payload, sizeof(payload));
         return;
     }
 
-    // Hack Alert! Hack Alert!
-    // For this use case, we read 35bits wiegand frame CP1000 encoded.
-    // We want to extract the identifier: the 20 second-to-last bits (14 first bit
-    // ignored).
-    // In case this is not a 35 bits tram, do nothing
-    if (bits == 35)
+    char text[20];
+    auto size = to_decimal(card, text);
+    if (publish_source_)
+    {
+        socket.send_raw(text, size, zmqpp::socket::send_more);
+        socket.send_raw(source.topic_.data(), source.topic_.size());
+    }
+    else
+        socket.send_raw(text, size);
+}
+
+void EventPublish::publish_conflated()
+{
+    auto now = Clock::now();
+    for (auto &source : sources_)
     {
-        std::stringstream ss;
-        ss << std::hex << "0x";
-        for (auto c : card)
+        if (source.dirty_ && now - source.last_sent_ >= conflate_interval_)
         {
-            if (c == ':')
-                continue;
-            ss << std::hex << c;
+            publish(*conflated_pub_, source, source.card_, source.timestamp_);
+            source.dirty_     = false;
+            source.last_sent_ = now;
         }
-        INFO("Bla: {" << ss.str() << "}");
-        // n has 40 "meaningful" bits because the hex string was 5 bytes.
-        uint64_t n;
-        ss >> n;
-        INFO(" n = " << n);
-        n = (n >> 6); // remove last 6bits. parity bit + 5bits;
-        n &= 0xFFFFF; // keep 20 bits.
-        INFO(" n2 = " << n);
-        std::stringstream ss2;
-        ss2 << n;
-        ss2 >> card;
     }
-    else
-        return;
+}
 
-    if (publish_source_)
-        network_pub_.send(zmqpp::message() << card << src);
-    else
-        network_pub_.send(card);
+long EventPublish::conflate_timeout() const
+{
+    using namespace std::chrono;
+    auto now     = Clock::now();
+    long timeout = -1;
+
+    for (const auto &source : sources_)
+    {
+        if (!source.dirty_)
+            continue;
+        auto left = duration_cast<milliseconds>(source.last_sent_ +
+                                                conflate_interval_ - now)
+                        .count();
+        left    = std::max<long>(left, 0);
+        timeout = timeout < 0 ? left : std::min(timeout, left);
+    }
+    return timeout;
 }
 
 void EventPublish::process_config()
@@ -97,9 +231,47 @@ void EventPublish::process_config()
     network_pub_.bind("tcp://*:" + std::to_string(port));
     publish_source_ = config_.get<bool>("module_config.publish_source", false);
 
+    auto payload = config_.get<std::string>("module_config.payload", "text");
+    if (payload != "text" && payload != "binary")
+        throw ConfigException("main", "EventPublish: invalid payload: " + payload);
+    binary_ = payload == "binary";
+
     for (auto &&itr : config_.get_child("module_config.sources"))
     {
         auto name = itr.second.get<std::string>("");
         bus_sub_.subscribe("S_" + name);
+        sources_.push_back({"S_" + name, name, 0, 0, false, Clock::time_point()});
+    }
+
+    if (auto formats = config_.get_child_optional("module_config.formats"))
+    {
+        for (auto &&itr : *formats)
+        {
+            WiegandFormat format;
+            format.bits_  = itr.second.get<int>("bits");
+            format.skip_  = itr.second.get<int>("skip", 1);
+            format.width_ = itr.second.get<int>("width");
+            if (format.bits_ < 1 || format.bits_ > 64 || format.skip_ < 0 ||
+                format.width_ < 1 || format.skip_ + format.width_ > format.bits_)
+                throw ConfigException("main",
+                                      "EventPublish: invalid Wiegand format.");
+            formats_.push_back(format);
+        }
+    }
+    else
+    {
+        // Compatibility: 35 bits CP1000 frames, whose identifier is
+        // made of the 20 bits before the trailing parity bit.
+        formats_.push_back({35, 1, 20});
+    }
+
+    if (auto conflate = config_.get_child_optional("module_config.conflate"))
+    {
+        conflated_pub_ = std::make_unique<zmqpp::socket>(
+            ctx_, zmqpp::socket_type::pub);
+        conflated_pub_->bind("tcp://*:" +
+                             std::to_string(conflate->get<int>("port")));
+        conflate_interval_ =
+            std::chrono::milliseconds(conflate->get<int>("interval", 100));
     }
 }
@@ -21,6 +21,7 @@
 
 #include <zmqpp/zmqpp.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <chrono>
 #include <vector>
 #include <memory>
 #include "modules/BaseModule.hpp"
@@ -59,7 +60,51 @@ namespace Leosac
 
                 ~EventPublish() = default;
 
+                /**
+                * Main loop: poll the reactor, and publish conflated events
+                * when they are due.
+                */
+                virtual void run() override;
+
+                /**
+                * How to extract the card number from a Wiegand frame.
+                *
+                * The `skip_` last bits of the frame (parity bits) are dropped,
+                * and the card number is made of the `width_` bits before them.
+                */
+                struct WiegandFormat
+                {
+                    int bits_;
+                    int skip_;
+                    int width_;
+                };
+
+                /**
+                * Extract the card number from the hexadecimal representation
+                * of a `bits` bits frame ("aa:bb:cc:dd"), without allocating.
+                *
+                * Returns false if the frame doesn't match a format.
+                */
+                static bool decode(const std::vector<WiegandFormat> &formats,
+                        const char *card, size_t size, int bits, uint64_t &number);
+
             private:
+                using Clock = std::chrono::steady_clock;
+
+                /**
+                * A source we watch, and its latest event for the conflated
+                * publisher.
+                */
+                struct Source
+                {
+                    std::string topic_;
+                    std::string name_;
+                    uint64_t card_;
+                    uint64_t timestamp_;
+                    bool dirty_;
+                    Clock::time_point last_sent_;
+                };
+
                 void handle_msg_bus();
 
                 /**
@@ -68,6 +113,24 @@ namespace Leosac
                 */
                 void process_config();
 
+                /**
+                * Publish an event on `socket`, in the configured encoding.
+                */
+                void publish(zmqpp::socket &socket, const Source &source,
+                        uint64_t card, uint64_t timestamp);
+
+                /**
+                * Publish the latest event of the sources whose conflation
+                * delay expired.
+                */
+                void publish_conflated();
+
+                /**
+                * How long (in milliseconds) before some conflated event
+                * is due, or -1.
+                */
+                long conflate_timeout() const;
+
                 /**
                  * Read internal message bus.
                  */
@@ -79,6 +142,23 @@ namespace Leosac
                 zmqpp::socket network_pub_;
 
                 bool publish_source_;
+
+                /**
+                * Publish a compact binary payload instead of text.
+                */
+                bool binary_;
+
+                std::vector<WiegandFormat> formats_;
+
+                std::vector<Source> sources_;
+
+                /**
+                * Publisher that only sends the latest event per source, at
+                * most once per `conflate_interval_`. Optional.
+                */
+                std::unique_ptr<zmqpp::socket> conflated_pub_;
+
+                std::chrono::milliseconds conflate_interval_;
             };
 
         }
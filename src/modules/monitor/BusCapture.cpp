@@ -0,0 +1,239 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BusCapture.hpp"
+#include "exception/leosacexception.hpp"
+#include "tools/log.hpp"
+#include "tools/unixfs.hpp"
+#include "tools/unixsyscall.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Leosac;
+using namespace Leosac::Module::Monitor;
+using namespace Leosac::Tools;
+
+namespace
+{
+/**
+ * The worker writes as soon as this many bytes are waiting.
+ */
+constexpr size_t batch_size = 64 * 1024;
+
+constexpr char magic[] = "LEOSACBC";
+constexpr uint32_t format_version = 1;
+
+template <typename T>
+void put_le(char *out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+void write_all(int fd, const char *data, size_t size)
+{
+    while (size)
+    {
+        auto ret = ::write(fd, data, size);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+            throw FsException(UnixSyscall::getErrorString("write", errno));
+        data += ret;
+        size -= ret;
+    }
+}
+}
+
+BusCapture::BusCapture(const Options &options)
+    : options_(options)
+    , dropped_(0)
+    , stop_(false)
+    , fd_(-1)
+    , segment_bytes_(0)
+    , next_index_(0)
+{
+    if (::mkdir(options_.directory_.c_str(), 0750) == -1 && errno != EEXIST)
+        throw FsException(UnixSyscall::getErrorString("mkdir", errno) + ": " +
+                          options_.directory_);
+
+    // Resume after the segments of a previous run.
+    auto files = UnixFs::listFiles(options_.directory_, ".cap");
+    files.sort();
+    for (const auto &path : files)
+    {
+        try
+        {
+            next_index_ = std::max<uint64_t>(
+                next_index_, std::stoull(UnixFs::stripPath(path)) + 1);
+            segments_.push_back(path);
+        }
+        catch (const std::logic_error &)
+        {
+            WARN("Ignoring unexpected file " << path << " in bus capture.");
+        }
+    }
+
+    pending_.reserve(batch_size);
+    writing_.reserve(batch_size);
+    thread_ = std::thread([this]() { run(); });
+}
+
+BusCapture::~BusCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void BusCapture::capture(const zmqpp::message &msg)
+{
+    using namespace std::chrono;
+    constexpr size_t header_size  = sizeof(uint32_t) + sizeof(uint64_t) + 2;
+    constexpr size_t frame_header = sizeof(uint32_t);
+
+    uint16_t parts = std::min<size_t>(msg.parts(), UINT16_MAX);
+    size_t size    = header_size;
+    for (uint16_t i = 0; i < parts; ++i)
+        size += frame_header + msg.size(i);
+    uint64_t timestamp =
+        duration_cast<microseconds>(system_clock::now().time_since_epoch())
+            .count();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_.size() + size > options_.buffer_size_)
+    {
+        ++dropped_;
+        return;
+    }
+
+    auto offset = pending_.size();
+    pending_.resize(offset + size);
+    char *out = &pending_[offset];
+    put_le<uint32_t>(out, size - sizeof(uint32_t));
+    put_le<uint64_t>(out + 4, timestamp);
+    put_le<uint16_t>(out + 12, parts);
+    out += header_size;
+    for (uint16_t i = 0; i < parts; ++i)
+    {
+        auto frame_size = msg.size(i);
+        put_le<uint32_t>(out, frame_size);
+        std::memcpy(out + frame_header, msg.raw_data(i), frame_size);
+        out += frame_header + frame_size;
+    }
+
+    // Only wake the worker once a batch is ready.
+    bool full = offset < batch_size && pending_.size() >= batch_size;
+    lock.unlock();
+    if (full)
+        cv_.notify_one();
+}
+
+void BusCapture::run()
+{
+    bool stop = false;
+    while (!stop)
+    {
+        size_t dropped;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, options_.flush_interval_, [this]() {
+                return stop_ || pending_.size() >= batch_size;
+            });
+            stop = stop_;
+            // Swap the buffers: both keep their capacity.
+            writing_.swap(pending_);
+            pending_.clear();
+            dropped  = dropped_;
+            dropped_ = 0;
+        }
+
+        if (dropped)
+            WARN("Bus capture is falling behind: dropped " << dropped
+                                                           << " messages.");
+        if (writing_.empty())
+            continue;
+        try
+        {
+            write(writing_);
+        }
+        catch (const std::exception &e)
+        {
+            ERROR("Failed to write bus capture: " << e.what());
+            close_segment();
+        }
+    }
+    close_segment();
+}
+
+void BusCapture::write(const std::vector<char> &data)
+{
+    if (fd_ != -1 && segment_bytes_ >= options_.segment_size_)
+        close_segment();
+    if (fd_ == -1)
+        open_segment();
+
+    write_all(fd_, data.data(), data.size());
+    segment_bytes_ += data.size();
+}
+
+void BusCapture::open_segment()
+{
+    std::ostringstream name;
+    name << options_.directory_ << '/' << std::setw(20) << std::setfill('0')
+         << next_index_ << ".cap";
+
+    fd_ = ::open(name.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0640);
+    if (fd_ == -1)
+        throw FsException(UnixSyscall::getErrorString("open", errno) + ": " +
+                          name.str());
+    next_index_++;
+    segments_.push_back(name.str());
+    while (segments_.size() > std::max<size_t>(options_.segments_, 1))
+    {
+        if (::unlink(segments_.front().c_str()) == -1 && errno != ENOENT)
+            WARN(UnixSyscall::getErrorString("unlink", errno) << ": "
+                                                              << segments_.front());
+        segments_.pop_front();
+    }
+
+    char header[sizeof(magic) - 1 + sizeof(format_version)];
+    std::memcpy(header, magic, sizeof(magic) - 1);
+    put_le<uint32_t>(header + sizeof(magic) - 1, format_version);
+    write_all(fd_, header, sizeof(header));
+    segment_bytes_ = sizeof(header);
+}
+
+void BusCapture::close_segment()
+{
+    if (fd_ != -1)
+        ::close(fd_);
+    fd_            = -1;
+    segment_bytes_ = 0;
+}
@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zmqpp/message.hpp>
+
+namespace Leosac
+{
+namespace Module
+{
+namespace Monitor
+{
+/**
+ * Write raw application bus messages to rotating segment files.
+ *
+ * capture() only appends the message to an in-memory batch: no
+ * formatting and no system call happens on the caller's thread. A
+ * worker thread writes the batch to the current segment once it grows
+ * past 64KB, or every `flush_interval_`. When more than `buffer_size_`
+ * bytes are waiting, new messages are dropped (and counted) rather
+ * than slowing the caller down.
+ *
+ * Segments are named after a growing index (00000000000000000042.cap),
+ * and only the `segments_` most recent ones are kept. A segment starts
+ * with the 8 bytes magic "LEOSACBC" and a 32 bits format version. Then
+ * come the records:
+ *     - 32 bits: size of the rest of the record.
+ *     - 64 bits: timestamp, in microseconds since the epoch.
+ *     - 16 bits: number of frames.
+ *     - for each frame, its 32 bits size followed by its content.
+ * Integers are little endian. scripts/decode_bus_capture.py prints
+ * the messages in a capture.
+ */
+class BusCapture
+{
+  public:
+    struct Options
+    {
+        std::string directory_;
+        /**
+         * A new segment is started once the current one reaches this size.
+         */
+        size_t segment_size_;
+        /**
+         * Number of segments kept, including the current one.
+         */
+        size_t segments_;
+        std::chrono::milliseconds flush_interval_;
+        /**
+         * Maximum number of bytes waiting to be written.
+         */
+        size_t buffer_size_;
+    };
+
+    explicit BusCapture(const Options &options);
+
+    /**
+     * Write the messages captured so far and stop the worker.
+     */
+    ~BusCapture();
+
+    BusCapture(const BusCapture &) = delete;
+    BusCapture(BusCapture &&)      = delete;
+    BusCapture &operator=(const BusCapture &) = delete;
+    BusCapture &operator=(BusCapture &&) = delete;
+
+    /**
+     * Queue `msg` to be written. This is thread safe.
+     */
+    void capture(const zmqpp::message &msg);
+
+  private:
+    void run();
+
+    /**
+     * Append `data` to the current segment, starting a new one if needed.
+     */
+    void write(const std::vector<char> &data);
+
+    void open_segment();
+
+    void close_segment();
+
+    const Options options_;
+
+    /**
+     * Protects the members below, which are shared with capture().
+     */
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<char> pending_;
+    size_t dropped_;
+    bool stop_;
+
+    /**
+     * The members below are only used by the worker thread.
+     */
+    std::vector<char> writing_;
+    int fd_;
+    size_t segment_bytes_;
+    uint64_t next_index_;
+    /**
+     * Paths of the segments on disk, oldest first.
+     */
+    std::deque<std::string> segments_;
+
+    std::thread thread_;
+};
+}
+}
+}
@@ -18,8 +18,10 @@
 */
 
 #include "MonitorModule.hpp"
+#include "exception/configexception.hpp"
 #include "tools/log.hpp"
 #include "tools/unixshellscript.hpp"
+#include <cstring>
 #include <zmqpp/z85.hpp>
 
 using namespace Leosac::Module::Monitor;
@@ -33,12 +35,23 @@ static std::string z85_pad(const std::string &in, char pad_char)
     return out;
 }
 
+/**
+* Does the frame `part` of `msg` hold `value` ?
+*/
+static bool frame_equals(const zmqpp::message &msg, size_t part,
+                         const std::string &value)
+{
+    return msg.parts() > part && msg.size(part) == value.size() &&
+           std::memcmp(msg.raw_data(part), value.data(), value.size()) == 0;
+}
+
 MonitorModule::MonitorModule(zmqpp::context &ctx, zmqpp::socket *pipe,
                              const boost::property_tree::ptree &cfg,
                              CoreUtilsPtr utils)
     : BaseModule(ctx, pipe, cfg, utils)
     , bus_(ctx, zmqpp::socket_type::sub)
     , verbose_(false)
+    , log_bus_text_(false)
     , last_ping_(TimePoint::max())
     , kernel_(ctx, zmqpp::socket_type::req)
 {
@@ -66,23 +79,39 @@ void MonitorModule::run()
 }
 
 void MonitorModule::log_system_bus()
+{
+    zmqpp::message msg;
+    bus_.receive(msg);
+
+    if (capture_)
+        capture_->capture(msg);
+    if (log_bus_text_)
+        log_system_bus_text(msg);
+
+    // reader activity check
+    if (reader_led_ && frame_equals(msg, 0, "S_" + reader_to_watch_))
+    {
+        reader_led_->turnOn(500);
+    }
+
+    // system readiness check
+    if (system_led_ && frame_equals(msg, 0, "KERNEL"))
+    {
+        system_led_->turnOn();
+    }
+}
+
+void MonitorModule::log_system_bus_text(zmqpp::message &msg)
 {
     auto system_bus_logger = spdlog::get("system_bus_event");
     assert(system_bus_logger);
 
-    std::string src;
     std::stringstream full_msg;
-    zmqpp::message msg;
-    bus_.receive(msg);
 
     for (size_t i = 0; i < msg.parts(); ++i)
     {
         std::string buf;
         msg >> buf;
-        if (i == 0)
-        {
-            src = buf;
-        }
         if (std::find_if(buf.begin(), buf.end(),
                          [](char c) { return !isprint(c); }) != buf.end())
         {
@@ -102,18 +131,6 @@ void MonitorModule::log_system_bus()
         assert(monitor_stdout);
         monitor_stdout->info(full_msg.str());
     }
-
-    // reader activity check
-    if (src == ("S_" + reader_to_watch_) && reader_led_)
-    {
-        reader_led_->turnOn(500);
-    }
-
-    // system readiness check
-    if (src == "KERNEL" && system_led_)
-    {
-        system_led_->turnOn();
-    }
 }
 
 void MonitorModule::test_ping()
@@ -158,6 +175,7 @@ void MonitorModule::process_config()
         config_.get_child("module_config").get<std::string>("file-bus", "");
     if (!system_bus_log_file.empty())
     {
+        log_bus_text_ = true;
         bus_.subscribe("");
         spdlog::rotating_logger_mt("system_bus_event", system_bus_log_file,
                                    1024 * 1024 * 3, 2);
@@ -178,6 +196,7 @@ void MonitorModule::process_config()
 
     process_network_config();
     process_reader_config();
+    process_capture_config();
 }
 
 void MonitorModule::process_network_config()
@@ -205,3 +224,27 @@ void MonitorModule::process_reader_config()
             std::make_unique<Leosac::Hardware::FLED>(ctx_, reader_led_name);
     }
 }
+
+void MonitorModule::process_capture_config()
+{
+    auto capture_node =
+        config_.get_child("module_config").get_child_optional("capture");
+    if (!capture_node)
+        return;
+
+    BusCapture::Options options;
+    options.directory_    = capture_node->get<std::string>("directory");
+    options.segment_size_ =
+        capture_node->get<size_t>("segment_size", 16 * 1024 * 1024);
+    options.segments_       = capture_node->get<size_t>("segments", 8);
+    options.flush_interval_ = std::chrono::milliseconds(
+        capture_node->get<int>("flush_interval", 1000));
+    options.buffer_size_ =
+        capture_node->get<size_t>("buffer_size", 4 * 1024 * 1024);
+    if (options.segments_ == 0 || options.flush_interval_.count() <= 0)
+        throw ConfigException("main", "Monitor: invalid bus capture settings.");
+
+    INFO("Monitor module capturing the system bus to " << options.directory_);
+    capture_ = std::make_unique<BusCapture>(options);
+    bus_.subscribe("");
+}
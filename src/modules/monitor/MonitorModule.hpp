@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "BusCapture.hpp"
 #include "hardware/facades/FLED.hpp"
 #include "modules/BaseModule.hpp"
 
@@ -67,6 +68,11 @@ class MonitorModule : public BaseModule
     */
     void process_reader_config();
 
+    /**
+    * Load config related to the binary capture of the system bus.
+    */
+    void process_capture_config();
+
     /**
     * Get scripts directory from kernel.
     */
@@ -78,12 +84,27 @@ class MonitorModule : public BaseModule
     */
     void log_system_bus();
 
+    /**
+    * Write `msg` to the text log of the system bus.
+    */
+    void log_system_bus_text(zmqpp::message &msg);
+
     void test_ping();
 
     zmqpp::socket bus_;
 
     bool verbose_;
 
+    /**
+    * Do we write bus messages to the text log ?
+    */
+    bool log_bus_text_;
+
+    /**
+    * Binary capture of the system bus, if enabled.
+    */
+    std::unique_ptr<BusCapture> capture_;
+
     std::string addr_to_ping_;
 
     std::string reader_to_watch_;
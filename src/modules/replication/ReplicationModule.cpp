@@ -20,11 +20,14 @@
 #include "ReplicationModule.hpp"
 #include "core/CoreUtils.hpp"
 #include "core/Scheduler.hpp"
+#include "core/config/RemoteConnection.hpp"
+#include "core/tasks/ApplyChangeLog.hpp"
 #include "core/tasks/FetchRemoteConfig.hpp"
 #include "core/tasks/GetLocalConfigVersion.hpp"
 #include "core/tasks/GetRemoteConfigVersion.hpp"
 #include "core/tasks/SyncConfig.hpp"
 #include "tools/log.hpp"
+#include <zmqpp/curve.hpp>
 
 using namespace Leosac::Module::Replication;
 
@@ -32,7 +35,9 @@ ReplicationModule::ReplicationModule(zmqpp::context &ctx, zmqpp::socket *pipe,
                                      const boost::property_tree::ptree &cfg,
                                      CoreUtilsPtr utils)
     : BaseModule(ctx, pipe, cfg, utils)
+    , notified_version_(std::make_shared<std::atomic<uint64_t>>(0))
     , last_sync_(TimePoint::max())
+    , last_change_log_sync_(TimePoint::max())
 {
     process_config();
 }
@@ -49,37 +54,111 @@ void ReplicationModule::run()
             replicate();
             last_sync_ = std::chrono::system_clock::now();
         }
+        elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::system_clock::now() - last_change_log_sync_)
+                      .count();
+        if (change_log_ && (last_change_log_sync_ == TimePoint::max() ||
+                            elapsed > change_log_delay_))
+        {
+            replicate_change_log();
+            last_change_log_sync_ = std::chrono::system_clock::now();
+        }
         reactor_.poll(25);
     }
 }
 
 void ReplicationModule::process_config()
 {
-    delay_    = config_.get_child("module_config").get<int>("delay", 120);
-    endpoint_ = config_.get_child("module_config").get<std::string>("endpoint");
-    pubkey_   = config_.get_child("module_config").get<std::string>("pubkey");
+    const auto &module_config = config_.get_child("module_config");
+
+    endpoint_         = module_config.get<std::string>("endpoint");
+    pubkey_           = module_config.get<std::string>("pubkey");
+    publish_endpoint_ = module_config.get<std::string>("publish_endpoint", "");
+    // When notified of changes, polling is only a fallback.
+    delay_ = module_config.get<int>("delay", publish_endpoint_.empty() ? 120 : 900);
+
+    change_log_       = module_config.get<bool>("change_log", false);
+    change_log_delay_ = module_config.get<int>("change_log_delay", 10);
+
+    // Version checks and fetches all go through this connection.
+    master_ = std::make_shared<RemoteConnection>(endpoint_, pubkey_);
+
+    if (!publish_endpoint_.empty())
+    {
+        auto kp = zmqpp::curve::generate_keypair();
+        notification_sub_ =
+            std::make_unique<zmqpp::socket>(ctx_, zmqpp::socket_type::subscribe);
+        notification_sub_->set(zmqpp::socket_option::curve_secret_key,
+                               kp.secret_key);
+        notification_sub_->set(zmqpp::socket_option::curve_public_key,
+                               kp.public_key);
+        notification_sub_->set(zmqpp::socket_option::curve_server_key, pubkey_);
+        notification_sub_->set(zmqpp::socket_option::linger, 0);
+        notification_sub_->connect(publish_endpoint_);
+        notification_sub_->subscribe("CONFIG_VERSION");
+        reactor_.add(*notification_sub_,
+                     std::bind(&ReplicationModule::handle_notification, this));
+    }
+}
+
+void ReplicationModule::handle_notification()
+{
+    zmqpp::message msg;
+    std::string topic;
+    uint64_t remote;
+
+    notification_sub_->receive(msg);
+    if (msg.parts() != 2)
+    {
+        WARN("Invalid configuration version notification.");
+        return;
+    }
+    msg >> topic >> remote;
+    uint64_t previous = *notified_version_;
+    if (remote <= previous ||
+        !notified_version_->compare_exchange_strong(previous, remote))
+        return;
+
+    INFO("Master notified configuration version " << remote);
+    auto notified = notified_version_;
+    sync_if_newer(remote, [notified, remote, previous]() {
+        // Unless a newer version was notified in the meantime.
+        auto expected = remote;
+        notified->compare_exchange_strong(expected, previous);
+    });
+    last_sync_ = std::chrono::system_clock::now();
 }
 
 void ReplicationModule::replicate()
 {
-    uint64_t local;
     uint64_t remote;
-    bool ok = true;
 
-    ok &= fetch_local_version(local);
-    ok &= fetch_remote_version(remote);
+    if (!fetch_remote_version(remote))
+    {
+        ERROR("Failed to retrieve config version");
+        return;
+    }
+    sync_if_newer(remote);
+}
 
-    if (ok)
-        INFO("Current cfg version = " << local << ". Remote = " << remote);
-    else
+void ReplicationModule::sync_if_newer(uint64_t remote,
+                                      std::function<void()> on_failure)
+{
+    uint64_t local;
+
+    if (!on_failure)
+        on_failure = []() {};
+    if (!fetch_local_version(local))
     {
         ERROR("Failed to retrieve config version");
+        on_failure();
         return;
     }
+    INFO("Current cfg version = " << local << ". Remote = " << remote);
 
     if (remote > local)
     {
-        start_sync();
+        start_sync(on_failure);
     }
     else
     {
@@ -90,19 +169,24 @@ void ReplicationModule::replicate()
 }
 
 bool ReplicationModule::fetch_local_version(uint64_t &local)
+{
+    local = utils_->kernel().config_manager().config_version();
+    return true;
+}
+
+void ReplicationModule::fetch_module_hashes()
 {
     auto task = std::make_shared<Tasks::GetLocalConfigVersion>(utils_->kernel());
     utils_->scheduler().enqueue(task, TargetThread::MAIN);
     task->wait();
     assert(task->succeed());
 
-    local = task->config_version_;
-    return true;
+    module_hashes_ = task->module_hashes_;
 }
 
 bool ReplicationModule::fetch_remote_version(uint64_t &remote)
 {
-    auto task = std::make_shared<Tasks::GetRemoteConfigVersion>(endpoint_, pubkey_);
+    auto task = std::make_shared<Tasks::GetRemoteConfigVersion>(master_);
     utils_->scheduler().enqueue(task, TargetThread::POOL);
     task->wait();
 
@@ -126,16 +210,48 @@ bool ReplicationModule::fetch_remote_version(uint64_t &remote)
     return true;
 }
 
-void ReplicationModule::start_sync()
+void ReplicationModule::replicate_change_log()
+{
+    auto db = utils_->database();
+    if (!db)
+    {
+        WARN("Cannot replicate the change log without a database. Disabling.");
+        change_log_ = false;
+        return;
+    }
+
+    // The master's public key identifies it, even if its endpoint changes.
+    auto task = std::make_shared<Tasks::ApplyChangeLog>(master_, db, pubkey_);
+    utils_->scheduler().enqueue(task, TargetThread::POOL);
+    task->wait();
+
+    if (!task->succeed() && task->get_exception())
+    {
+        try
+        {
+            std::rethrow_exception(task->get_exception());
+        }
+        catch (const std::exception &e)
+        {
+            ERROR("Replicating change log failed: " << e.what());
+        }
+    }
+}
+
+void ReplicationModule::start_sync(std::function<void()> on_failure)
 {
     INFO("Starting the synchronization process...");
+    fetch_module_hashes();
     // two tasks queued. Fetch and Sync.
 
-    auto fetch_task = std::make_shared<Tasks::FetchRemoteConfig>(endpoint_, pubkey_);
+    auto fetch_task =
+        std::make_shared<Tasks::FetchRemoteConfig>(master_, module_hashes_);
 
     auto sync_task = std::make_shared<Tasks::SyncConfig>(utils_->kernel(),
                                                          fetch_task, true, true);
     sync_task->set_on_success([]() { INFO("Synchronization complete."); });
+    sync_task->set_on_failure(on_failure);
+    fetch_task->set_on_failure(on_failure);
 
     auto *sched = &utils_->scheduler();
     fetch_task->set_on_success(
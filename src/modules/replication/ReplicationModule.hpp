@@ -21,6 +21,8 @@
 
 #include "core/CoreUtils.hpp"
 #include "modules/BaseModule.hpp"
+#include <atomic>
+#include <functional>
 
 namespace Leosac
 {
@@ -62,17 +64,47 @@ class ReplicationModule : public BaseModule
      */
     void replicate();
 
+    /**
+     * Start the synchronization if `remote` is greater than the
+     * local configuration version.
+     *
+     * `on_failure` is invoked, from any thread, if the synchronization
+     * fails.
+     */
+    void sync_if_newer(uint64_t remote, std::function<void()> on_failure = nullptr);
+
+    /**
+     * Handle a configuration version notification from the master.
+     */
+    void handle_notification();
+
+    /**
+     * Pull and apply the master's ChangeLog, by running a task
+     * in a pool.
+     */
+    void replicate_change_log();
+
     /**
      * Launch the tasks so that the synchronisation may take place.
+     *
+     * `on_failure` is invoked, from the thread running the failed task,
+     * if either fetching or applying the configuration fails.
      */
-    void start_sync();
+    void start_sync(std::function<void()> on_failure);
 
     /**
-     * Fetch the local configuration version by running
-     * a task in the main thread.
+     * Fetch the local configuration version.
+     *
+     * The version is read directly from the ConfigManager's version
+     * vector: this doesn't involve the main thread.
      */
     bool fetch_local_version(uint64_t &local);
 
+    /**
+     * Refresh `module_hashes_` by running a task in the main thread.
+     */
+    void fetch_module_hashes();
+
     /**
      * Fetch the remote configuration version by running a task
      * in a pool, and sending the CONFIG_VERSION message.
@@ -94,7 +126,53 @@ class ReplicationModule : public BaseModule
      */
     std::string pubkey_;
 
+    /**
+     * Persistent connection to the master server, shared by
+     * the replication tasks.
+     */
+    RemoteConnectionPtr master_;
+
+    /**
+     * Endpoint the master publishes configuration version changes on.
+     * May be empty.
+     */
+    std::string publish_endpoint_;
+
+    /**
+     * Subscriber to the master's configuration version changes.
+     */
+    std::unique_ptr<zmqpp::socket> notification_sub_;
+
+    /**
+     * Highest version received through a notification.
+     * Used to avoid starting a synchronization for each repeated notification.
+     *
+     * It is reverted if the synchronization fails, so that the next
+     * notification triggers a new attempt. It is shared with the failure
+     * callback of the synchronization tasks, which may outlive the module.
+     */
+    std::shared_ptr<std::atomic<uint64_t>> notified_version_;
+
+    /**
+     * Hashes of the module configurations received during the
+     * last synchronization.
+     */
+    ConfigManager::ModuleHashMap module_hashes_;
+
     TimePoint last_sync_;
+
+    /**
+     * Replicate the database-backed authentication data through
+     * the master's ChangeLog.
+     */
+    bool change_log_;
+
+    /**
+     * Delay between 2 ChangeLog pulls.
+     */
+    int change_log_delay_;
+
+    TimePoint last_change_log_sync_;
 };
 }
 }
@@ -0,0 +1,138 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CardSet.hpp"
+#include <algorithm>
+#include <iterator>
+
+using namespace Leosac::Module::Rpleth;
+
+bool CardSet::pack(const char *text, size_t len, CardKey &key)
+{
+    key.value_  = 0;
+    key.digits_ = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = text[i];
+        uint8_t nibble;
+
+        if (c >= '0' && c <= '9')
+            nibble = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            nibble = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            nibble = c - 'A' + 10;
+        else if (c == ':')
+            continue;
+        else
+            return false;
+        if (key.digits_ == 16)
+            return false;
+        key.value_ = (key.value_ << 4) | nibble;
+        ++key.digits_;
+    }
+    return key.digits_ != 0;
+}
+
+bool CardSet::pack(const std::string &text, CardKey &key)
+{
+    return pack(text.data(), text.size(), key);
+}
+
+void CardSet::append_text(const std::string &text, std::vector<Byte> &out)
+{
+    std::remove_copy(text.begin(), text.end(), std::back_inserter(out), ':');
+}
+
+bool CardSet::insert(const CardKey &key, const std::string &text)
+{
+    if (!index_.emplace(key, cards_.size()).second)
+        return false;
+    cards_.push_back(key);
+    texts_.push_back(text);
+    return true;
+}
+
+bool CardSet::contains(const CardKey &key) const
+{
+    return index_.count(key) != 0;
+}
+
+const std::string *CardSet::text(const CardKey &key) const
+{
+    auto itr = index_.find(key);
+    if (itr == index_.end())
+        return nullptr;
+    return &texts_[itr->second];
+}
+
+size_t CardSet::assign(const Byte *begin, const Byte *end)
+{
+    auto count     = std::count(begin, end, '|') + 1;
+    size_t invalid = 0;
+
+    clear();
+    index_.reserve(count);
+    cards_.reserve(count);
+    texts_.reserve(count);
+
+    auto start = begin;
+    while (start != end)
+    {
+        auto sep = std::find(start, end, '|');
+        std::string text(start, sep);
+        CardKey key;
+        if (pack(text, key))
+        {
+            insert(key, text);
+        }
+        else if (!text.empty())
+        {
+            cards_.push_back(CardKey{0, 0});
+            texts_.push_back(std::move(text));
+            ++invalid;
+        }
+        if (sep == end)
+            break;
+        start = sep + 1;
+    }
+    return invalid;
+}
+
+void CardSet::clear()
+{
+    index_.clear();
+    cards_.clear();
+    texts_.clear();
+}
+
+size_t CardSet::size() const
+{
+    return cards_.size();
+}
+
+const std::vector<CardKey> &CardSet::cards() const
+{
+    return cards_;
+}
+
+const std::vector<std::string> &CardSet::texts() const
+{
+    return texts_;
+}
@@ -0,0 +1,134 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "tools/bufferutils.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Leosac
+{
+namespace Module
+{
+namespace Rpleth
+{
+/**
+ * A card number, as exchanged with Rpleth clients, packed into an integer.
+ *
+ * Cards are hexadecimal text (bytes may be separated by colons, as in
+ * "ff:ae:32:00"). The key stores the value and the number of digits, so
+ * that the text can be rebuilt with its leading zeros.
+ */
+struct CardKey
+{
+    uint64_t value_;
+    uint8_t digits_;
+
+    bool operator==(const CardKey &o) const
+    {
+        return value_ == o.value_ && digits_ == o.digits_;
+    }
+};
+
+struct CardKeyHash
+{
+    size_t operator()(const CardKey &key) const
+    {
+        // Mix the bits: card numbers are often sequential.
+        uint64_t h = (key.value_ ^ (uint64_t(key.digits_) << 59)) *
+                     0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+/**
+ * A set of cards that remembers the order of insertion, and the text
+ * each card was given as.
+ *
+ * Lookups are hashed, and bulk operations are linear in the number of
+ * cards.
+ */
+class CardSet
+{
+  public:
+    /**
+     * Pack a card number. Colons are ignored.
+     *
+     * Returns false if `text` is empty, isn't hexadecimal, or has more
+     * than 16 digits.
+     */
+    static bool pack(const char *text, size_t len, CardKey &key);
+    static bool pack(const std::string &text, CardKey &key);
+
+    /**
+     * Append `text`, without its colons, to `out`.
+     */
+    static void append_text(const std::string &text, std::vector<Byte> &out);
+
+    /**
+     * Add a card, given as `text`. Returns false if it was already present.
+     */
+    bool insert(const CardKey &key, const std::string &text);
+
+    bool contains(const CardKey &key) const;
+
+    /**
+     * The text `key` was inserted with, or nullptr if it isn't present.
+     */
+    const std::string *text(const CardKey &key) const;
+
+    /**
+     * Replace the content of the set with the pipe separated list of
+     * cards in [begin, end).
+     *
+     * Empty entries are skipped. Invalid entries are kept, so that they
+     * are listed with the other cards, but they match no card: their key
+     * is zero digits long. Returns the number of invalid entries.
+     */
+    size_t assign(const Byte *begin, const Byte *end);
+
+    void clear();
+
+    size_t size() const;
+
+    /**
+     * Cards, in the order they were inserted.
+     */
+    const std::vector<CardKey> &cards() const;
+
+    /**
+     * Text of the cards, in the same order as cards().
+     */
+    const std::vector<std::string> &texts() const;
+
+  private:
+    /**
+     * Position of each valid card in cards_ and texts_.
+     */
+    std::unordered_map<CardKey, size_t, CardKeyHash> index_;
+    std::vector<CardKey> cards_;
+    std::vector<std::string> texts_;
+};
+}
+}
+}
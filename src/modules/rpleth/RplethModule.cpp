@@ -73,12 +73,13 @@ void RplethModule::handle_socket()
 {
     zmqpp::message msg;
     std::string identity;
-    std::string content;
 
     server_.receive(msg);
-    msg >> identity >> content;
+    msg >> identity;
+    // The content is written to the client's buffer straight from the message.
+    auto content_size = msg.size(1);
 
-    if (content.size() == 0)
+    if (content_size == 0)
     {
         // handle special 0 length message that indicates connection / disconnection.
         if (client_connected(
@@ -101,8 +102,8 @@ void RplethModule::handle_socket()
     if (client_failed(identity))
         return;
     assert(clients_.count(identity) && !client_failed(identity));
-    clients_[identity].write(reinterpret_cast<const uint8_t *>(content.c_str()),
-                             content.size());
+    clients_[identity].write(static_cast<const uint8_t *>(msg.raw_data(1)),
+                             content_size);
     if (handle_client_msg(identity, clients_[identity]) == false)
         failed_clients_.push_back(identity);
 }
@@ -212,48 +213,28 @@ void RplethModule::handle_wiegand_event()
     if (stream_mode_)
         cards_read_stream_.push_back(std::make_pair(card_id, nb_bit_read));
 
-    card_id.erase(std::remove(card_id.begin(), card_id.end(), ':'), card_id.end());
-    if (std::find(cards_pushed_.begin(), cards_pushed_.end(), card_id) !=
-        cards_pushed_.end())
+    // The present list echoes the card as it was pushed.
+    CardKey key;
+    if (CardSet::pack(card_id, key))
     {
-        cards_read_.push_back(card_id);
+        if (auto text = cards_pushed_.text(key))
+            cards_read_.insert(key, *text);
     }
-    cards_read_.unique();
     rpleth_publish_card();
 }
 
 void RplethModule::rpleth_send_cards(const RplethPacket &packet)
 {
-    auto itr_start                             = packet.data.begin();
-    std::vector<Byte>::const_iterator my_start = itr_start;
-    std::vector<Byte>::const_iterator it;
-
     WARN("Should not be here");
-    cards_pushed_.clear();
     cards_read_.clear();
-
-    while (my_start != packet.data.end())
-    {
-        it = std::find(itr_start, packet.data.end(), '|');
-        std::string card;
-        while (my_start != packet.data.end() && my_start != it)
-        {
-            card += *my_start;
-            my_start++;
-        }
-        cards_pushed_.push_back(card);
-        if (my_start == packet.data.end())
-            break;
-        else
-            my_start++;
-        itr_start = ++it;
-    }
-    cards_pushed_.unique();
+    auto invalid = cards_pushed_.assign(packet.data.begin(), packet.data.end());
+    if (invalid)
+        WARN("SendCards packet has " << invalid
+                                     << " invalid card(s): they can't be read.");
 }
 
 RplethPacket RplethModule::rpleth_receive_cards(const RplethPacket &packet)
 {
-    std::list<std::string> to_send;
     RplethPacket response = packet;
     WARN("Should not be here");
     DEBUG("Packet size = " << packet.data.size());
@@ -262,40 +243,28 @@ RplethPacket RplethModule::rpleth_receive_cards(const RplethPacket &packet)
         WARN("Invalid Packet");
         return response;
     }
-    if (packet.data[0] == 0x01)
-    {
-        DEBUG("Present list");
-        // send present list
-        to_send = cards_read_;
-    }
-    else
-    {
-        DEBUG("Absent list");
-        // send absent list
-        to_send     = cards_pushed_;
-        auto lambda = [this](const std::string &str) -> bool {
-            // if entry is not in cards_read_ means user was absent, do not remove
-            // him
-            bool found = std::find(cards_read_.begin(), cards_read_.end(), str) !=
-                         cards_read_.end();
-            return found;
-        };
-        to_send.erase(std::remove_if(to_send.begin(), to_send.end(), lambda),
-                      to_send.end());
-    }
+
+    bool present     = packet.data[0] == 0x01;
+    const auto &list = present ? cards_read_ : cards_pushed_;
+    DEBUG((present ? "Present list" : "Absent list"));
+
     // we reserve approximately what we need, just to avoid useless memory
     // allocations.
     std::vector<Byte> data;
-    data.reserve(to_send.size() * 8);
-    for (auto &card : to_send)
+    data.reserve(list.size() * 9);
+    for (size_t i = 0; i < list.size(); ++i)
     {
-        // we need to convert the card (ff:ae:32:00) to something like "ffae3200"
-        card.erase(std::remove(card.begin(), card.end(), ':'), card.end());
-        data.insert(data.end(), card.begin(), card.end());
+        // if a pushed card was read, the user is present: it's not part of the
+        // absent list.
+        if (!present && cards_read_.contains(list.cards()[i]))
+            continue;
+        // we need to convert the card (ff:ae:32:00) to something like
+        // "ffae3200"
+        CardSet::append_text(list.texts()[i], data);
         data.push_back('|');
     }
-    response.data    = data;
     response.dataLen = data.size();
+    response.data    = std::move(data);
     return response;
 }
 
@@ -344,22 +313,25 @@ void RplethModule::rpleth_publish_card()
 {
     for (auto const &card_pair : cards_read_stream_)
     {
+        RplethPacket packet(RplethPacket::Sender::Server);
+
+        packet.data    = card_convert_from_text(card_pair);
+        packet.status  = RplethProtocol::Success;
+        packet.type    = RplethProtocol::HID;
+        packet.command = RplethProtocol::Badge;
+        packet.dataLen = packet.data.size();
+
+        // The packet is the same for every client: encode it once.
+        std::array<uint8_t, 64> buf;
+        std::size_t size;
+        size = RplethProtocol::encodeCommand(packet, &buf[0], buf.size());
         for (auto &client : clients_)
         {
+            if (client_failed(client.first))
+                continue;
             zmqpp::message msg;
-            RplethPacket packet(RplethPacket::Sender::Server);
-
             msg << client.first;
-            packet.data    = card_convert_from_text(card_pair);
-            packet.status  = RplethProtocol::Success;
-            packet.type    = RplethProtocol::HID;
-            packet.command = RplethProtocol::Badge;
-            packet.dataLen = packet.data.size();
-
-            std::array<uint8_t, 64> buf;
-            std::size_t size;
-            size = RplethProtocol::encodeCommand(packet, &buf[0], buf.size());
-            msg.add_raw(&buf, size);
+            msg.add_raw(&buf[0], size);
             if (!server_.send(msg, true))
                 failed_clients_.push_back(client.first);
         }
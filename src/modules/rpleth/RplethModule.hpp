@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "CardSet.hpp"
 #include "hardware/facades/FWiegandReader.hpp"
 #include "modules/BaseModule.hpp"
 #include "modules/rpleth/network/circularbuffer.hpp"
@@ -182,15 +183,15 @@ class RplethModule : public BaseModule
     void handle_wiegand_event();
 
     /**
-    * List of cards pushed by SendCards Rpleth command.
+    * Cards pushed by SendCards Rpleth command.
     */
-    std::list<std::string> cards_pushed_;
+    CardSet cards_pushed_;
 
     /**
     * Valid cards our Wiegand reader read: cards that were not pushed are not stored
     * here.
     */
-    std::list<std::string> cards_read_;
+    CardSet cards_read_;
 
     /**
     * If stream mode is on, all cards read are stored here.
@@ -26,6 +26,7 @@
 #include "circularbuffer.hpp"
 
 #include <algorithm>
+#include <cstring>
 
 using namespace Leosac::Module::Rpleth;
 
@@ -62,8 +63,10 @@ std::size_t CircularBuffer::write(const Byte *data, std::size_t size)
 {
     if (!size || size > _size)
         return (0);
-    for (std::size_t i                 = 0; i < size; ++i)
-        _buffer[((_wIdx + i) % _size)] = data[i];
+    // At most two copies: up to the end of the buffer, then from its start.
+    std::size_t first = std::min(size, _size - _wIdx);
+    std::memcpy(&_buffer[_wIdx], data, first);
+    std::memcpy(&_buffer[0], data + first, size - first);
     _wIdx += size;
     _wIdx %= _size;
     if (_rIdx == _wIdx)
@@ -78,6 +81,22 @@ Byte CircularBuffer::operator[](int idx) const
     return (_buffer[(_rIdx + idx) % _size]);
 }
 
+const Byte *CircularBuffer::contiguous(std::size_t offset, std::size_t size) const
+{
+    std::size_t start = (_rIdx + offset) % _size;
+    if (start + size > _size)
+        return (nullptr);
+    return (&_buffer[start]);
+}
+
+void CircularBuffer::peek(std::size_t offset, Byte *data, std::size_t size) const
+{
+    std::size_t start = (_rIdx + offset) % _size;
+    std::size_t first = std::min(size, _size - start);
+    std::memcpy(data, &_buffer[start], first);
+    std::memcpy(data + first, &_buffer[0], size - first);
+}
+
 void CircularBuffer::fastForward(std::size_t offset)
 {
     if (offset > _toRead)
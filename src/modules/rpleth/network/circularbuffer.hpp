@@ -56,6 +56,20 @@ class CircularBuffer
 
     Byte operator[](int idx) const;
 
+    /**
+    * Returns a pointer to the `size` bytes located `offset` bytes after the
+    * read index, or nullptr if they wrap around the end of the buffer.
+    *
+    * The pointer is valid until the next write().
+    */
+    const Byte *contiguous(std::size_t offset, std::size_t size) const;
+
+    /**
+    * Copy the `size` bytes located `offset` bytes after the read index
+    * to `data`, without moving the read index.
+    */
+    void peek(std::size_t offset, Byte *data, std::size_t size) const;
+
     void fastForward(std::size_t offset);
 
     void reset();
@@ -25,8 +25,104 @@
 
 #include "rplethpacket.hpp"
 
+#include <algorithm>
+
 using namespace Leosac::Module::Rpleth;
 
+PacketData::PacketData()
+    : data_(nullptr)
+    , size_(0)
+{
+}
+
+PacketData::PacketData(const PacketData &other)
+    : storage_(other.storage_)
+    , data_(other.owning() ? storage_.data() : other.data_)
+    , size_(other.size_)
+{
+}
+
+PacketData &PacketData::operator=(const PacketData &other)
+{
+    if (this != &other)
+    {
+        storage_ = other.storage_;
+        data_    = other.owning() ? storage_.data() : other.data_;
+        size_    = other.size_;
+    }
+    return (*this);
+}
+
+PacketData &PacketData::operator=(std::vector<Byte> data)
+{
+    storage_ = std::move(data);
+    data_    = storage_.data();
+    size_    = storage_.size();
+    return (*this);
+}
+
+void PacketData::view(const Byte *data, std::size_t size)
+{
+    storage_.clear();
+    data_ = data;
+    size_ = size;
+}
+
+const Byte *PacketData::data() const
+{
+    return (data_);
+}
+
+std::size_t PacketData::size() const
+{
+    return (size_);
+}
+
+bool PacketData::empty() const
+{
+    return (size_ == 0);
+}
+
+Byte PacketData::operator[](std::size_t idx) const
+{
+    return (data_[idx]);
+}
+
+PacketData::const_iterator PacketData::begin() const
+{
+    return (data_);
+}
+
+PacketData::const_iterator PacketData::end() const
+{
+    return (data_ + size_);
+}
+
+bool PacketData::owning() const
+{
+    return (!storage_.empty() && data_ == storage_.data());
+}
+
+bool Leosac::Module::Rpleth::operator==(const PacketData &lhs,
+                                        const PacketData &rhs)
+{
+    return (lhs.size() == rhs.size() &&
+            std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+}
+
+bool Leosac::Module::Rpleth::operator==(const std::vector<Byte> &lhs,
+                                        const PacketData &rhs)
+{
+    return (lhs.size() == rhs.size() &&
+            std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+}
+
+bool Leosac::Module::Rpleth::operator==(const PacketData &lhs,
+                                        const std::vector<Byte> &rhs)
+{
+    return (rhs == lhs);
+}
+
 RplethPacket::RplethPacket(Sender packetSender)
     : status(0)
     , type(0)
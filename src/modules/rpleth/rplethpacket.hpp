@@ -28,6 +28,7 @@
 
 #include "tools/bufferutils.hpp"
 
+#include <cstddef>
 #include <vector>
 
 namespace Leosac
@@ -36,6 +37,65 @@ namespace Module
 {
 namespace Rpleth
 {
+/**
+* Payload of a Rpleth packet.
+*
+* The payload either owns its bytes, or refers to memory owned by someone
+* else (typically the CircularBuffer a packet was decoded from). In the latter
+* case, it is only valid until that memory is modified.
+*/
+class PacketData
+{
+  public:
+    using iterator       = const Byte *;
+    using const_iterator = const Byte *;
+
+    PacketData();
+
+    PacketData(const PacketData &other);
+
+    PacketData(PacketData &&other) = default;
+
+    PacketData &operator=(const PacketData &other);
+
+    PacketData &operator=(PacketData &&other) = default;
+
+    /**
+    * Take ownership of `data`.
+    */
+    PacketData &operator=(std::vector<Byte> data);
+
+    /**
+    * Refer to `size` bytes at `data`, without copying them.
+    */
+    void view(const Byte *data, std::size_t size);
+
+    const Byte *data() const;
+
+    std::size_t size() const;
+
+    bool empty() const;
+
+    Byte operator[](std::size_t idx) const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+  private:
+    bool owning() const;
+
+    std::vector<Byte> storage_;
+    const Byte *data_;
+    std::size_t size_;
+};
+
+bool operator==(const PacketData &lhs, const PacketData &rhs);
+
+bool operator==(const std::vector<Byte> &lhs, const PacketData &rhs);
+
+bool operator==(const PacketData &lhs, const std::vector<Byte> &rhs);
+
 class RplethPacket
 {
   public:
@@ -62,7 +122,7 @@ class RplethPacket
     Byte type;
     Byte command;
     Byte dataLen;
-    std::vector<Byte> data;
+    PacketData data;
     Byte sum;
     bool isGood;
     Sender sender;
@@ -24,6 +24,7 @@
 */
 
 #include "rplethprotocol.hpp"
+#include <cstring>
 #include <tools/log.hpp>
 #include <vector>
 
@@ -51,9 +52,17 @@ RplethPacket RplethProtocol::decodeCommand(CircularBuffer &buffer,
         return (packet);
     if (packet.dataLen)
     {
-        packet.data = std::vector<Byte>(packet.dataLen);
-        for (unsigned int i = 0; i < packet.dataLen; ++i)
-            packet.data[i]  = buffer[SizeByteIdx + 1 + i];
+        // Refer to the payload in place, unless it wraps around the end of
+        // the buffer.
+        const Byte *payload = buffer.contiguous(SizeByteIdx + 1, packet.dataLen);
+        if (payload)
+            packet.data.view(payload, packet.dataLen);
+        else
+        {
+            std::vector<Byte> copy(packet.dataLen);
+            buffer.peek(SizeByteIdx + 1, &copy[0], packet.dataLen);
+            packet.data = std::move(copy);
+        }
     }
     packet.type    = buffer[TypeByteIdx];
     packet.command = buffer[CommandByteIdx];
@@ -82,8 +91,8 @@ std::size_t RplethProtocol::encodeCommand(const RplethPacket &packet, Byte *buff
     buffer[TypeByteIdx]    = packet.type;
     buffer[CommandByteIdx] = packet.command;
     buffer[SizeByteIdx]    = packet.dataLen;
-    for (int i                               = 0; i < packet.dataLen; ++i)
-        buffer[SizeByteIdx + i + 1]          = packet.data[i];
+    if (packet.dataLen)
+        std::memcpy(&buffer[SizeByteIdx + 1], packet.data.data(), packet.dataLen);
     buffer[SizeByteIdx + packet.dataLen + 1] = packet.checksum();
 
     if (packet.sender == RplethPacket::Sender::Server)
@@ -104,6 +104,9 @@ class RplethProtocol
     * Decode a packet from a circular buffer object.
     * If `from_server` is true that means the packet comes from a Rpleth server: this
     * is used by unit testing code.
+    *
+    * The payload of the packet refers to the buffer's memory when it is contiguous
+    * there: it is valid until the next write to the buffer.
     */
     static RplethPacket decodeCommand(CircularBuffer &buffer,
                                       bool from_server = false);
@@ -0,0 +1,518 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MailQueue.hpp"
+#include "tools/Colorize.hpp"
+#include "tools/MyTime.hpp"
+#include "tools/log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace Leosac;
+using namespace Leosac::Module;
+using namespace Leosac::Module::SMTP;
+
+namespace
+{
+/**
+ * How long the worker waits on curl before looking at newly
+ * queued mails.
+ */
+constexpr long max_wait_ms = 100;
+
+/**
+ * Return a string representation of what the whole mail would look like.
+ */
+std::string build_mail_str(const MailInfo &mail)
+{
+    std::stringstream ss;
+
+    ASSERT_LOG(mail.to.size(), "No recipients for mail.");
+    ss << "Date: " << to_local_rfc2822(std::chrono::system_clock::now()) << "\r\n";
+    ss << "To: " << mail.to.at(0) << "\r\n";
+
+    ss << "Subject: " << mail.title << "\r\n";
+    ss << "\r\n"; // empty line to divide headers from body, see RFC5322
+    ss << mail.body << "\r\n\r\n";
+
+    return ss.str();
+}
+
+/**
+ * Merge mails to the same recipients into a single one.
+ */
+MailInfo build_digest(const std::vector<MailInfo> &mails)
+{
+    MailInfo digest;
+    std::stringstream ss;
+
+    digest.to    = mails.front().to;
+    digest.title = mails.front().title + " (and " +
+                   std::to_string(mails.size() - 1) + " more)";
+    ss << mails.size() << " notifications were sent in a short time. "
+       << "They were merged into this mail.\r\n\r\n";
+    for (const auto &mail : mails)
+    {
+        ss << "== " << mail.title << " ==\r\n";
+        ss << mail.body << "\r\n\r\n";
+    }
+    digest.body = ss.str();
+    return digest;
+}
+}
+
+/**
+ * An enabled server, with its reusable easy handle and the mail it's
+ * currently sending.
+ */
+struct MailQueue::Server
+{
+    SMTPServerInfo info_;
+    CURL *easy_;
+    curl_slist *recipients_;
+    std::unique_ptr<Pending> current_;
+    std::string payload_;
+    size_t offset_;
+};
+
+MailQueue::MailQueue(const Options &options,
+                     const std::vector<SMTPServerInfo> &servers)
+    : options_(options)
+    , size_(0)
+    , dropped_(0)
+    , stop_(false)
+    , multi_(curl_multi_init())
+    , next_seq_(0)
+    , in_flight_(0)
+{
+    if (!multi_)
+        throw std::runtime_error("Cannot initialize curl_multi.");
+    apply(servers);
+    thread_ = std::thread([this]() { run(); });
+}
+
+MailQueue::~MailQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    apply({});
+    curl_multi_cleanup(multi_);
+}
+
+bool MailQueue::push(const MailInfo &mail, Callback done)
+{
+    if (mail.to.empty())
+    {
+        WARN("No recipient for mail titled " << Colorize::cyan(mail.title) << '.');
+        if (done)
+            done(false);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_ < options_.queue_size_)
+        {
+            ++size_;
+            incoming_.push_back(Pending{mail, std::move(done), 1, 0, 0});
+            cv_.notify_one();
+            return true;
+        }
+        if (dropped_++ == 0)
+            WARN("Mail queue is full (" << size_ << " mails). New mails are "
+                                        << "dropped until it drains.");
+    }
+    if (done)
+        done(false);
+    return false;
+}
+
+void MailQueue::servers(const std::vector<SMTPServerInfo> &servers)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    new_servers_ = std::make_unique<std::vector<SMTPServerInfo>>(servers);
+    cv_.notify_one();
+}
+
+void MailQueue::run()
+{
+    std::deque<Pending> incoming;
+    while (true)
+    {
+        bool reconfiguring;
+        std::unique_ptr<std::vector<SMTPServerInfo>> new_servers;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto wake = [&]() {
+                return stop_ || !incoming_.empty() || new_servers_;
+            };
+            if (!in_flight_ && ready_.empty())
+            {
+                auto deadline = next_deadline();
+                if (deadline == Clock::time_point::max())
+                    cv_.wait(lock, wake);
+                else
+                    cv_.wait_until(lock, deadline, wake);
+            }
+            if (stop_)
+                break;
+            incoming.swap(incoming_);
+            // Servers are only replaced once their handles are free.
+            if (new_servers_ && !in_flight_)
+                new_servers = std::move(new_servers_);
+            reconfiguring = new_servers_ != nullptr;
+        }
+
+        if (new_servers)
+            apply(*new_servers);
+
+        auto now = Clock::now();
+        for (auto &pending : incoming)
+            admit(std::move(pending), now);
+        incoming.clear();
+        flush_digests(now);
+
+        if (!reconfiguring)
+            start_transfers();
+        if (in_flight_)
+        {
+            int running;
+            curl_multi_perform(multi_, &running);
+            process_completed();
+        }
+        if (in_flight_)
+        {
+            long timeout = max_wait_ms;
+            auto deadline = next_deadline();
+            if (deadline != Clock::time_point::max())
+            {
+                auto until = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - Clock::now());
+                timeout = std::max(0L, std::min(timeout, long(until.count())));
+            }
+            curl_multi_wait(multi_, nullptr, 0, timeout, nullptr);
+        }
+    }
+    abandon();
+}
+
+void MailQueue::apply(const std::vector<SMTPServerInfo> &infos)
+{
+    for (auto &server : servers_)
+    {
+        curl_easy_cleanup(server->easy_);
+        curl_slist_free_all(server->recipients_);
+    }
+    servers_.clear();
+
+    for (const auto &info : infos)
+    {
+        if (!info.enabled)
+            continue;
+        ASSERT_LOG(info.url.size(), "No mail server url.");
+
+        auto curl = curl_easy_init();
+        if (!curl)
+        {
+            ERROR("Cannot initialize curl_easy.");
+            continue;
+        }
+        auto server = std::make_unique<Server>();
+        server->info_       = info;
+        server->easy_       = curl;
+        server->recipients_ = nullptr;
+        server->offset_     = 0;
+
+        if (!info.CA_info_file_.empty())
+            curl_easy_setopt(curl, CURLOPT_CAINFO, info.CA_info_file_.c_str());
+        if (!info.verify_host)
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        if (!info.verify_peer)
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        if (info.username.size())
+            curl_easy_setopt(curl, CURLOPT_USERNAME, info.username.c_str());
+        if (info.password.size())
+            curl_easy_setopt(curl, CURLOPT_PASSWORD, info.password.c_str());
+        if (info.from.size())
+            curl_easy_setopt(curl, CURLOPT_MAIL_FROM, info.from.c_str());
+        curl_easy_setopt(curl, CURLOPT_URL, info.url.c_str());
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, long(info.ms_timeout));
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, &MailQueue::read_payload);
+        curl_easy_setopt(curl, CURLOPT_READDATA, server.get());
+        curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, &MailQueue::seek_payload);
+        curl_easy_setopt(curl, CURLOPT_SEEKDATA, server.get());
+        curl_easy_setopt(curl, CURLOPT_PRIVATE, server.get());
+        servers_.push_back(std::move(server));
+    }
+}
+
+void MailQueue::admit(Pending &&pending, Clock::time_point now)
+{
+    if (pending.done_)
+    {
+        // Mails whose sender waits for the outcome skip digests and the queue.
+        ready_.push_front(std::move(pending));
+        return;
+    }
+    if (options_.digest_delay_.count() == 0)
+    {
+        ready(std::move(pending));
+        return;
+    }
+
+    auto &digest = digests_[pending.mail_.to];
+    if (digest.mails_.empty() && now >= digest.last_sent_ + options_.digest_delay_)
+    {
+        digest.last_sent_ = now;
+        ready(std::move(pending));
+        return;
+    }
+    digest.mails_.push_back(std::move(pending.mail_));
+    if (digest.mails_.size() >= options_.digest_size_)
+        flush(digest, now);
+}
+
+void MailQueue::ready(Pending &&pending)
+{
+    pending.seq_ = next_seq_++;
+    ready_.push_back(std::move(pending));
+}
+
+void MailQueue::flush(Digest &digest, Clock::time_point now)
+{
+    Pending pending{{}, nullptr, digest.mails_.size(), 0, 0};
+    if (digest.mails_.size() == 1)
+        pending.mail_ = std::move(digest.mails_.front());
+    else
+        pending.mail_ = build_digest(digest.mails_);
+    ready(std::move(pending));
+
+    digest.mails_.clear();
+    digest.last_sent_ = now;
+}
+
+void MailQueue::flush_digests(Clock::time_point now)
+{
+    for (auto itr = digests_.begin(); itr != digests_.end();)
+    {
+        auto &digest = itr->second;
+        if (now < digest.last_sent_ + options_.digest_delay_)
+        {
+            ++itr;
+        }
+        else if (digest.mails_.size())
+        {
+            flush(digest, now);
+            ++itr;
+        }
+        else
+        {
+            // Nothing was held back: forget about these recipients.
+            itr = digests_.erase(itr);
+        }
+    }
+}
+
+MailQueue::Clock::time_point MailQueue::next_deadline() const
+{
+    auto deadline = Clock::time_point::max();
+    for (const auto &entry : digests_)
+    {
+        if (entry.second.mails_.size())
+            deadline = std::min(deadline,
+                                entry.second.last_sent_ + options_.digest_delay_);
+    }
+    return deadline;
+}
+
+void MailQueue::start_transfers()
+{
+    for (auto itr = ready_.begin();
+         itr != ready_.end() && in_flight_ < servers_.size();)
+    {
+        if (itr->server_ >= servers_.size())
+        {
+            if (servers_.empty())
+                WARN("Cannot send mail titled " << Colorize::cyan(itr->mail_.title)
+                                                << ". No SMTP server configured.");
+            else
+                WARN("Giving up on mail titled "
+                     << Colorize::cyan(itr->mail_.title)
+                     << ". No SMTP server accepted it.");
+            finish(*itr, false);
+            itr = ready_.erase(itr);
+            continue;
+        }
+
+        auto &server = *servers_[itr->server_];
+        if (server.current_)
+        {
+            ++itr;
+            continue;
+        }
+
+        const auto &mail = itr->mail_;
+        server.payload_  = build_mail_str(mail);
+        server.offset_   = 0;
+        curl_slist_free_all(server.recipients_);
+        server.recipients_ = nullptr;
+        for (const auto &recipient : mail.to)
+            server.recipients_ =
+                curl_slist_append(server.recipients_, recipient.c_str());
+        curl_easy_setopt(server.easy_, CURLOPT_MAIL_RCPT, server.recipients_);
+        curl_easy_setopt(server.easy_, CURLOPT_INFILESIZE_LARGE,
+                         curl_off_t(server.payload_.size()));
+
+        auto ret = curl_multi_add_handle(multi_, server.easy_);
+        if (ret != CURLM_OK)
+        {
+            // Keep the mail at its place, and try it on the next server.
+            WARN("Cannot send mail titled "
+                 << Colorize::cyan(mail.title) << " through " << server.info_.url
+                 << ": " << curl_multi_strerror(ret));
+            itr->server_++;
+            continue;
+        }
+        server.current_ = std::make_unique<Pending>(std::move(*itr));
+        itr             = ready_.erase(itr);
+        ++in_flight_;
+    }
+}
+
+void MailQueue::process_completed()
+{
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(multi_, &left)))
+    {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        Server *server = nullptr;
+        auto result    = msg->data.result;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &server);
+        curl_multi_remove_handle(multi_, msg->easy_handle);
+        --in_flight_;
+        ASSERT_LOG(server && server->current_, "Completed transfer without mail.");
+
+        auto pending = std::move(server->current_);
+        if (result == CURLE_OK)
+        {
+            INFO("Mail titled " << Colorize::cyan(pending->mail_.title)
+                                << " has been sent.");
+            finish(*pending, true);
+        }
+        else
+        {
+            WARN("Failed to send mail titled "
+                 << Colorize::cyan(pending->mail_.title) << " through "
+                 << server->info_.url << ": " << curl_easy_strerror(result));
+            // Try the next server before the mails queued after this one.
+            pending->server_++;
+            auto pos = std::find_if(ready_.begin(), ready_.end(),
+                                    [&](const Pending &other) {
+                                        return other.seq_ > pending->seq_;
+                                    });
+            ready_.insert(pos, std::move(*pending));
+        }
+    }
+}
+
+void MailQueue::finish(Pending &pending, bool success)
+{
+    if (pending.done_)
+        pending.done_(success);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_ -= pending.count_;
+    if (dropped_ && size_ < options_.queue_size_)
+    {
+        WARN("Mail queue drained. " << dropped_ << " mails were dropped.");
+        dropped_ = 0;
+    }
+}
+
+void MailQueue::abandon()
+{
+    for (auto &server : servers_)
+    {
+        if (server->current_)
+        {
+            curl_multi_remove_handle(multi_, server->easy_);
+            ready_.push_back(std::move(*server->current_));
+            server->current_ = nullptr;
+        }
+    }
+    in_flight_ = 0;
+
+    size_t count = 0;
+    for (auto &pending : ready_)
+    {
+        count += pending.count_;
+        if (pending.done_)
+            pending.done_(false);
+    }
+    for (const auto &entry : digests_)
+        count += entry.second.mails_.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &pending : incoming_)
+        {
+            count += pending.count_;
+            if (pending.done_)
+                pending.done_(false);
+        }
+    }
+    if (count)
+        WARN("Shutting down with " << count << " mails not sent.");
+}
+
+size_t MailQueue::read_payload(char *ptr, size_t size, size_t nmemb, void *userp)
+{
+    auto server = static_cast<Server *>(userp);
+    ASSERT_LOG(server, "Server is null.");
+
+    auto to_transfer =
+        std::min(size * nmemb, server->payload_.size() - server->offset_);
+    std::memcpy(ptr, server->payload_.data() + server->offset_, to_transfer);
+    server->offset_ += to_transfer;
+    return to_transfer;
+}
+
+int MailQueue::seek_payload(void *userp, curl_off_t offset, int origin)
+{
+    auto server = static_cast<Server *>(userp);
+    ASSERT_LOG(server, "Server is null.");
+
+    // Curl rewinds the upload when it resends it over a new connection.
+    if (origin != SEEK_SET || offset < 0 ||
+        static_cast<size_t>(offset) > server->payload_.size())
+        return CURL_SEEKFUNC_CANTSEEK;
+    server->offset_ = static_cast<size_t>(offset);
+    return CURL_SEEKFUNC_OK;
+}
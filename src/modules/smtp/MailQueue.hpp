@@ -0,0 +1,237 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "modules/smtp/SMTPConfig.hpp"
+#include "tools/Mail.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Leosac
+{
+namespace Module
+{
+namespace SMTP
+{
+/**
+ * A bounded mail queue, delivered by a worker thread.
+ *
+ * push() only stores the mail and returns: it is safe to call from
+ * any thread, and never waits for the network. The worker drives a
+ * curl multi handle and owns one easy handle per enabled server.
+ * Handles are reused from one mail to the next, so that curl keeps
+ * the SMTP connection (and the TLS session) open across messages.
+ * Servers are tried in order: a mail that fails on one server is
+ * retried on the next one.
+ *
+ * Bursts are merged into digests. The first mail to a list of
+ * recipients is sent right away. Mails to the same recipients that
+ * follow within `digest_delay_` are held back, and sent as a single
+ * mail once the delay expires, or once `digest_size_` of them are
+ * waiting.
+ *
+ * When `queue_size_` mails are waiting, new mails are dropped: an
+ * alert storm, or an unreachable server, can't make the module grow
+ * without bound.
+ */
+class MailQueue
+{
+  public:
+    struct Options
+    {
+        /**
+         * Maximum number of mails waiting to be sent.
+         */
+        size_t queue_size_;
+        /**
+         * How long mails to the same recipients are accumulated into
+         * a digest. 0 disables digests.
+         */
+        std::chrono::milliseconds digest_delay_;
+        /**
+         * Maximum number of mails merged into a digest.
+         */
+        size_t digest_size_;
+    };
+
+    /**
+     * Invoked, from the worker thread, once a mail was sent or given up on.
+     */
+    using Callback = std::function<void(bool)>;
+
+    MailQueue(const Options &options, const std::vector<SMTPServerInfo> &servers);
+    ~MailQueue();
+
+    MailQueue(const MailQueue &) = delete;
+    MailQueue(MailQueue &&)      = delete;
+    MailQueue &operator=(const MailQueue &) = delete;
+    MailQueue &operator=(MailQueue &&) = delete;
+
+    /**
+     * Queue a mail. Returns false if the mail was dropped.
+     *
+     * If `done` is set, the mail is sent on its own, ahead of the other
+     * queued mails, and `done` is invoked with the outcome.
+     */
+    bool push(const MailInfo &mail, Callback done = nullptr);
+
+    /**
+     * Replace the list of servers.
+     *
+     * The new list is used once the mails being sent are done.
+     */
+    void servers(const std::vector<SMTPServerInfo> &servers);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * A mail waiting to be sent.
+     */
+    struct Pending
+    {
+        MailInfo mail_;
+        Callback done_;
+        /**
+         * Number of queued mails this one stands for (more than one
+         * for a digest).
+         */
+        size_t count_;
+        /**
+         * Index of the next server to try.
+         */
+        size_t server_;
+        /**
+         * Position in the ready queue, so that retried mails keep
+         * their order.
+         */
+        uint64_t seq_;
+    };
+
+    /**
+     * Mails to a list of recipients, held back to be sent as a digest.
+     */
+    struct Digest
+    {
+        std::vector<MailInfo> mails_;
+        Clock::time_point last_sent_ = Clock::time_point::min();
+    };
+
+    struct Server;
+
+    void run();
+
+    /**
+     * Release the servers' handles and create new ones from `infos`.
+     */
+    void apply(const std::vector<SMTPServerInfo> &infos);
+
+    /**
+     * Route a newly queued mail, either to the ready queue or to the
+     * digest for its recipients.
+     */
+    void admit(Pending &&pending, Clock::time_point now);
+
+    /**
+     * Append a mail to the ready queue.
+     */
+    void ready(Pending &&pending);
+
+    /**
+     * Turn the mails held by `digest` into a single ready mail.
+     */
+    void flush(Digest &digest, Clock::time_point now);
+
+    /**
+     * Flush the digests whose delay expired.
+     */
+    void flush_digests(Clock::time_point now);
+
+    /**
+     * When the next digest is due, or Clock::time_point::max().
+     */
+    Clock::time_point next_deadline() const;
+
+    /**
+     * Start sending ready mails on the servers that are free.
+     */
+    void start_transfers();
+
+    /**
+     * Process the transfers curl reports as complete.
+     */
+    void process_completed();
+
+    /**
+     * Report the outcome of a mail, and release its room in the queue.
+     */
+    void finish(Pending &pending, bool success);
+
+    /**
+     * Give up on every mail that wasn't sent yet.
+     */
+    void abandon();
+
+    static size_t read_payload(char *ptr, size_t size, size_t nmemb, void *userp);
+    static int seek_payload(void *userp, curl_off_t offset, int origin);
+
+    const Options options_;
+    std::thread thread_;
+
+    /**
+     * Protects the members below, which are shared with callers of
+     * push() and servers().
+     */
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending> incoming_;
+    std::unique_ptr<std::vector<SMTPServerInfo>> new_servers_;
+    /**
+     * Number of mails accepted and not sent yet.
+     */
+    size_t size_;
+    /**
+     * Number of mails dropped since the queue became full.
+     */
+    size_t dropped_;
+    bool stop_;
+
+    /**
+     * The members below are only used by the worker thread.
+     */
+    CURLM *multi_;
+    std::vector<std::unique_ptr<Server>> servers_;
+    std::deque<Pending> ready_;
+    std::map<std::vector<std::string>, Digest> digests_;
+    uint64_t next_seq_;
+    size_t in_flight_;
+};
+}
+}
+}
@@ -28,6 +28,7 @@ namespace Module
 namespace SMTP
 {
 class SMTPModule;
+class MailQueue;
 
 class SMTPConfig;
 using SMTPConfigPtr  = std::shared_ptr<SMTPConfig>;
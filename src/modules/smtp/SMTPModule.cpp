@@ -18,6 +18,7 @@
 */
 
 #include "SMTPModule.hpp"
+#include "MailQueue.hpp"
 #include "SMTPAuditSerializer.hpp"
 #include "SMTPServerInfoSerializer.hpp"
 #include "SMTPServiceImpl.hpp"
@@ -27,14 +28,16 @@
 #include "core/audit/IWSAPICall.hpp"
 #include "core/audit/serializers/JSONService.hpp"
 #include "core/auth/Auth.hpp"
+#include "exception/configexception.hpp"
 #include "modules/smtp/SMTPAudit_odb.h"
 #include "modules/smtp/SMTPConfig_odb.h"
 #include "modules/websock-api/ExceptionConverter.hpp"
 #include "modules/websock-api/Exceptions.hpp"
 #include "modules/websock-api/Service.hpp"
-#include "tools/MyTime.hpp"
 #include "tools/registry/GlobalRegistry.hpp"
 #include <boost/asio.hpp>
+#include <curl/curl.h>
+#include <future>
 
 using namespace Leosac;
 using namespace Leosac::Module;
@@ -73,6 +76,8 @@ SMTPModule::SMTPModule(zmqpp::context &ctx, zmqpp::socket *pipe,
 
 SMTPModule::~SMTPModule()
 {
+    // The queue's worker uses curl until it is stopped.
+    queue_ = nullptr;
     curl_global_cleanup();
     auto audit_serializer_service =
         utils_->service_registry().get_service<Audit::Serializer::JSONService>();
@@ -135,136 +140,24 @@ void SMTPModule::process_config()
         }
     }
 
+    MailQueue::Options options;
+    options.queue_size_   = config_.get<size_t>("module_config.queue_size", 256);
+    options.digest_delay_ = std::chrono::milliseconds(
+        config_.get<int>("module_config.digest_delay", 10000));
+    options.digest_size_ = config_.get<size_t>("module_config.digest_size", 50);
+    if (options.queue_size_ == 0 || options.digest_size_ == 0 ||
+        options.digest_delay_.count() < 0)
+        throw ConfigException("main", "SMTP: invalid mail queue settings.");
+    INFO("SMTP module mail queue: size: "
+         << Colorize::green(options.queue_size_)
+         << ", digest_delay: " << Colorize::green(options.digest_delay_.count())
+         << "ms, digest_size: " << Colorize::green(options.digest_size_));
+    queue_ = std::make_unique<MailQueue>(options, smtp_config_->servers());
+
     if (use_database_)
         register_ws_handlers();
 }
 
-bool SMTPModule::prepare_curl(const MailInfo &mail)
-{
-    if (smtp_config_->servers().size() == 0)
-        WARN("Cannot send mail titled " << Colorize::cyan(mail.title)
-                                        << ". No SMTP server configured.");
-    if (mail.to.size() == 0)
-    {
-        WARN("No recipient for mail titled " << Colorize::cyan(mail.title) << '.');
-        return false;
-    }
-
-    for (const auto &target : smtp_config_->servers())
-    {
-        if (!target.enabled)
-            continue;
-
-        auto curl = curl_easy_init();
-        if (curl)
-        {
-            if (!target.CA_info_file_.empty())
-                curl_easy_setopt(curl, CURLOPT_CAINFO, target.CA_info_file_.c_str());
-            if (!target.verify_host)
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-            if (!target.verify_peer)
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            if (target.username.size())
-                curl_easy_setopt(curl, CURLOPT_USERNAME, target.username.c_str());
-            if (target.password.size())
-                curl_easy_setopt(curl, CURLOPT_PASSWORD, target.password.c_str());
-            if (target.from.size())
-                curl_easy_setopt(curl, CURLOPT_MAIL_FROM, target.from.c_str());
-
-            ASSERT_LOG(target.url.size(), "No mail server url.");
-            curl_easy_setopt(curl, CURLOPT_URL, target.url.c_str());
-
-            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, target.ms_timeout);
-
-            bool sent = send_mail(curl, mail);
-            curl_easy_cleanup(curl);
-            if (sent)
-                return true;
-        }
-        else
-        {
-            ERROR("Cannot initialize curl_easy.");
-        }
-    }
-    return false;
-}
-
-struct UploadStatus
-{
-    const MailInfo &mail;
-    int counter;
-};
-
-/**
- * Return a string representation of what the whole mail would look like.
- */
-static std::string build_mail_str(const MailInfo &mail)
-{
-    std::stringstream ss;
-
-    ASSERT_LOG(mail.to.size(), "No recipients for mail.");
-    ss << "Date: " << to_local_rfc2822(std::chrono::system_clock::now()) << "\r\n";
-    ss << "To: " << mail.to.at(0) << "\r\n";
-
-    ss << "Subject: " << mail.title << "\r\n";
-    ss << "\r\n"; // empty line to divide headers from body, see RFC5322
-    ss << mail.body << "\r\n\r\n";
-
-    return ss.str();
-}
-
-/**
- * Callback for libcurl.
- *
- * CURL invokes this to get the data it should send to the server.
- */
-static size_t read_callback(void *ptr, size_t size, size_t nmemb, void *userp)
-{
-    UploadStatus *st = static_cast<UploadStatus *>(userp);
-    ASSERT_LOG(st, "UploadStatus is null.");
-
-    std::string content = build_mail_str(st->mail);
-    auto wanted         = size * nmemb;
-    auto available      = content.size() - st->counter;
-    auto to_transfer    = std::min(available, wanted);
-
-    std::memset(ptr, 0, wanted);
-    std::memcpy(ptr, &content[0] + st->counter, to_transfer);
-    st->counter += to_transfer;
-
-    return to_transfer;
-}
-
-bool SMTPModule::send_mail(CURL *curl, const MailInfo &mail)
-{
-    ASSERT_LOG(curl, "CURL pointer is null.");
-
-    struct curl_slist *recipients = NULL;
-    for (const auto &recipient : mail.to)
-        recipients = curl_slist_append(recipients, recipient.c_str());
-    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, recipients);
-
-    UploadStatus status{.mail = mail, .counter = 0};
-
-    curl_easy_setopt(curl, CURLOPT_READFUNCTION, &read_callback);
-    curl_easy_setopt(curl, CURLOPT_READDATA, &status);
-    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-    auto res = curl_easy_perform(curl);
-    curl_slist_free_all(recipients);
-    if (res != CURLE_OK)
-    {
-        WARN("curl_easy_perform() failed: " << curl_easy_strerror(res));
-        return false;
-    }
-    else
-    {
-        INFO("Mail titled " << Colorize::cyan(mail.title) << " has been sent.");
-        return true;
-    }
-}
-
 void SMTPModule::setup_database()
 {
     using namespace odb;
@@ -334,6 +227,7 @@ json SMTPModule::handle_ws_smtp_setconfig(const WebSockAPI::RequestContext &req_
         t.commit();
         smtp_config_ = std::move(cfg);
     }
+    queue_->servers(smtp_config_->servers());
 
     return {};
 }
@@ -348,7 +242,12 @@ json SMTPModule::handle_ws_smtp_sendmail(const WebSockAPI::RequestContext &,
     for (const auto &recipient : req.at("to"))
         mail.to.push_back(recipient);
 
-    return {{"sent", (prepare_curl(mail))}};
+    // The caller wants to know whether the mail was sent, so this one
+    // doesn't wait for a digest.
+    auto sent   = std::make_shared<std::promise<bool>>();
+    auto result = sent->get_future();
+    queue_->push(mail, [sent](bool success) { sent->set_value(success); });
+    return {{"sent", result.get()}};
 }
 
 void SMTPModule::on_service_event(const service_event::Event &e)
@@ -424,5 +323,5 @@ void SMTPModule::register_ws_handlers()
 
 void SMTPModule::async_send_mail(const MailInfo &mail)
 {
-    io_service_.post([this, mail]() { prepare_curl(mail); });
+    queue_->push(mail);
 }
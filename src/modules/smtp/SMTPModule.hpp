@@ -29,7 +29,6 @@
 #include "tools/service/ServiceRegistry.hpp"
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/steady_timer.hpp>
-#include <curl/curl.h>
 #include <json.hpp>
 
 namespace Leosac
@@ -51,8 +50,9 @@ class SMTPModule : public AsioModule
     /**
      * Asynchronously and thread-safely send an email.
      *
-     * This method doesn't provide a way to inform the caller of
-     * completion of his operation.
+     * The mail is queued, and may be merged into a digest with other
+     * mails to the same recipients. This method doesn't provide a way
+     * to inform the caller of completion of his operation.
      */
     void async_send_mail(const MailInfo &mail);
 
@@ -86,9 +86,11 @@ class SMTPModule : public AsioModule
 
     void setup_database();
 
-    bool prepare_curl(const MailInfo &mail);
+    /**
+     * Mails waiting to be sent, and the thread sending them.
+     */
+    std::unique_ptr<MailQueue> queue_;
 
-    bool send_mail(CURL *curl, const MailInfo &mail);
     static constexpr const char *wshandler_getconfig = "module.smtp.getconfig";
     static constexpr const char *wshandler_setconfig = "module.smtp.setconfig";
     static constexpr const char *wshandler_sendmail  = "module.smtp.sendmail";
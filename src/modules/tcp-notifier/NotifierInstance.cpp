@@ -22,27 +22,44 @@
 #include "core/credentials/RFIDCard.hpp"
 #include "tools/Colorize.hpp"
 #include "tools/log.hpp"
+#include <algorithm>
 #include <zmqpp/message.hpp>
 
 using namespace Leosac;
 using namespace Leosac::Module;
 using namespace Leosac::Module::TCPNotifier;
 
+namespace
+{
+/**
+ * How often the outbox is flushed to disk.
+ */
+constexpr std::chrono::seconds sync_interval(1);
+}
+
 NotifierInstance::NotifierInstance(zmqpp::context &ctx, zmqpp::reactor &reactor,
                                    std::vector<std::string> auth_sources,
                                    std::vector<std::string> connect_to,
                                    std::vector<std::string> bind_to,
-                                   ProtocolHandlerUPtr protocol_handler)
+                                   ProtocolHandlerUPtr protocol_handler,
+                                   size_t queue_size, OverflowPolicy overflow,
+                                   Tools::OutboxPtr outbox)
     : bus_sub_(ctx, zmqpp::socket_type::sub)
     , tcp_(ctx, zmqpp::socket_type::stream)
+    , queue_size_(queue_size)
+    , overflow_(overflow)
     , protocol_(std::move(protocol_handler))
+    , outbox_(outbox)
+    , unsynced_(false)
 {
     ASSERT_LOG(connect_to.empty() || bind_to.empty(),
                "Cannot bind and connect at the same time.");
     ASSERT_LOG(!connect_to.empty() || !bind_to.empty(), "Cannot do nothing");
     ASSERT_LOG(protocol_, "No protocol handler");
+    ASSERT_LOG(queue_size_ > 0, "Queue size must be positive");
 
     act_as_server_ = !bind_to.empty();
+    ASSERT_LOG(!act_as_server_ || !outbox_, "Outbox requires a client instance.");
 
     bus_sub_.connect("inproc://zmq-bus-pub");
     for (const auto &src : auth_sources)
@@ -55,32 +72,159 @@ NotifierInstance::NotifierInstance(zmqpp::context &ctx, zmqpp::reactor &reactor,
     reactor.add(tcp_, std::bind(&NotifierInstance::handle_tcp_msg, this));
 }
 
-void NotifierInstance::handle_credential(Leosac::Cred::RFIDCard &card)
+NotifierInstance::~NotifierInstance()
 {
     for (const auto &target : targets_)
+        log_stats(target.second);
+    if (outbox_)
+        sync_outbox(true);
+}
+
+void NotifierInstance::handle_event(const ProtocolHandler::Event &event)
+{
+    std::vector<ByteVector> messages;
+    try
     {
-        // Skip disconnected client.
-        if (!target.status_)
-            continue;
-        zmqpp::message msg;
+        messages = protocol_->handle_event(event);
+    }
+    catch (const ProtocolException &e)
+    {
+        WARN("TCPNotifier: Protocol error: " << e.what());
+        return;
+    }
+    for (const auto &message : messages)
+        dispatch(message);
+}
+
+void NotifierInstance::dispatch(const ByteVector &message)
+{
+    std::string data(message.begin(), message.end());
 
-        msg << target.zmq_identity_;
+    if (outbox_)
+    {
         try
         {
-            auto data = protocol_->build_cred_msg(card);
-            msg.add_raw(&data[0], data.size());
+            outbox_->append(data);
+            unsynced_ = true;
         }
-        catch (const ProtocolException &e)
+        catch (const std::exception &e)
         {
-            WARN("TCPNotifier: Protocol error: " << e.what());
-            continue;
+            ERROR("TCPNotifier: Cannot store message in outbox: " << e.what());
         }
-        auto ret = tcp_.send(msg, true);
-        if (ret == false) // would block. woops
+        // flush() sends the backlog once the bus message is processed.
+        return;
+    }
+
+    for (auto &target : targets_)
+    {
+        // Skip disconnected client.
+        if (!target.second.status_)
+            continue;
+        enqueue(target.second, data);
+    }
+}
+
+void NotifierInstance::enqueue(TargetInfo &target, std::string data)
+{
+    if (target.queue_.empty() && send_one(target, data))
+        return;
+
+    if (target.queue_.full())
+    {
+        if (overflow_ == OverflowPolicy::DISCONNECT)
         {
-            ERROR("Sending to client would block.");
+            WARN("TCP-Notifier: Client cannot keep up. Disconnecting it, "
+                 "and dropping "
+                 << target.queue_.size() + 1 << " messages.");
+            target.dropped_ += target.queue_.size() + 1;
+            target.queue_.clear();
+            // An empty message closes the connection.
+            zmqpp::message msg;
+            msg << target.zmq_identity_ << "";
+            tcp_.send(msg, true);
+            return;
         }
+        if (target.dropped_++ % 100 == 0)
+            WARN("TCP-Notifier: Queue for client is full. Dropped "
+                 << target.dropped_ << " messages so far.");
+        if (overflow_ == OverflowPolicy::DROP_NEWEST)
+            return;
     }
+    // When full, the circular buffer overwrites the oldest message.
+    target.queue_.push_back(std::move(data));
+    target.max_queued_ = std::max(target.max_queued_, target.queue_.size());
+}
+
+bool NotifierInstance::send_one(TargetInfo &target, const std::string &data)
+{
+    zmqpp::message msg;
+
+    msg << target.zmq_identity_;
+    msg.add_raw(data.data(), data.size());
+    if (!tcp_.send(msg, true))
+        return false;
+    target.sent_++;
+    return true;
+}
+
+void NotifierInstance::send_queue(TargetInfo &target)
+{
+    while (!target.queue_.empty() && send_one(target, target.queue_.front()))
+        target.queue_.pop_front();
+}
+
+void NotifierInstance::flush()
+{
+    for (const auto &message : protocol_->flush(ProtocolHandler::Clock::now()))
+        dispatch(message);
+
+    for (auto &target : targets_)
+    {
+        if (!target.second.status_)
+            continue;
+        if (outbox_)
+            send_backlog(target.second);
+        else
+            send_queue(target.second);
+    }
+    if (outbox_)
+        sync_outbox(false);
+}
+
+long NotifierInstance::poll_timeout() const
+{
+    // STREAM sockets are always reported as writable, even when
+    // a peer can't accept more data: retry periodically instead.
+    static constexpr long retry_interval = 10;
+
+    for (const auto &target : targets_)
+    {
+        if (!target.second.status_)
+            continue;
+        if (!target.second.queue_.empty())
+            return retry_interval;
+        if (outbox_ && outbox_->offset(target.second.consumer_) < outbox_->end())
+            return retry_interval;
+    }
+    auto timeout = protocol_->flush_timeout(ProtocolHandler::Clock::now());
+    if (unsynced_)
+    {
+        using namespace std::chrono;
+        auto sync_in = duration_cast<milliseconds>(last_sync_ + sync_interval -
+                                                   steady_clock::now());
+        long t  = static_cast<long>(std::max(sync_in, milliseconds(0)).count());
+        timeout = timeout < 0 ? t : std::min(timeout, t);
+    }
+    return timeout;
+}
+
+void NotifierInstance::log_stats(const TargetInfo &target)
+{
+    INFO("TCP-Notifier: Client " << (target.url_.empty() ? "(incoming)"
+                                                        : target.url_)
+                                 << ": sent " << target.sent_ << ", dropped "
+                                 << target.dropped_ << ", max queued "
+                                 << target.max_queued_ << " messages.");
 }
 
 void NotifierInstance::handle_one(zmqpp::message &msg)
@@ -103,18 +247,15 @@ void NotifierInstance::handle_one(zmqpp::message &msg)
                 TargetInfo ti;
                 ti.status_       = true;
                 ti.zmq_identity_ = routing_id;
+                ti.queue_.set_capacity(queue_size_);
 
-                targets_.push_back(std::move(ti));
+                targets_.emplace(routing_id, std::move(ti));
                 INFO("TCP-Notifier: New client connected.");
             }
             else
             {
-                targets_.erase(std::remove_if(targets_.begin(), targets_.end(),
-                                              [&](const TargetInfo &info) {
-                                                  return info.zmq_identity_ ==
-                                                         routing_id;
-                                              }),
-                               targets_.end());
+                log_stats(*target);
+                targets_.erase(routing_id);
                 INFO("TCP-Notifier: Client disconnected.");
             }
             return;
@@ -126,10 +267,76 @@ void NotifierInstance::handle_one(zmqpp::message &msg)
         else
             INFO("Successfully connected to client.");
 
+        // Queued messages are kept until the client is back.
         target->status_ = !target->status_;
+        if (outbox_ && !target->status_)
+        {
+            // Nothing tells what the server received: send everything
+            // again from the start of the connection.
+            commit(*target, target->resend_from_);
+        }
+        if (target->status_)
+        {
+            target->resend_from_ = target->committed_;
+            flush();
+        }
+    }
+}
+
+void NotifierInstance::send_backlog(TargetInfo &target)
+{
+    std::vector<Tools::Outbox::Record> records;
+    try
+    {
+        auto offset = outbox_->offset(target.consumer_);
+        while (outbox_->read(offset, 64, records))
+        {
+            for (const auto &record : records)
+            {
+                if (!send_one(target, record.payload_))
+                {
+                    // flush() will try again.
+                    commit(target, offset);
+                    return;
+                }
+                offset = record.seq_ + 1;
+            }
+            records.clear();
+        }
+        commit(target, offset);
+    }
+    catch (const std::exception &e)
+    {
+        ERROR("TCPNotifier: Outbox error: " << e.what());
     }
 }
 
+void NotifierInstance::commit(TargetInfo &target, uint64_t offset)
+{
+    if (offset == target.committed_)
+        return;
+    outbox_->commit(target.consumer_, offset);
+    target.committed_ = offset;
+    unsynced_         = true;
+}
+
+void NotifierInstance::sync_outbox(bool force)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!unsynced_ || (!force && now - last_sync_ < sync_interval))
+        return;
+    try
+    {
+        outbox_->sync();
+    }
+    catch (const std::exception &e)
+    {
+        WARN("TCPNotifier: Failed to sync outbox: " << e.what());
+    }
+    unsynced_  = false;
+    last_sync_ = now;
+}
+
 void NotifierInstance::handle_tcp_msg()
 {
     zmqpp::message msg;
@@ -143,12 +350,9 @@ void NotifierInstance::handle_tcp_msg()
 NotifierInstance::TargetInfo *
 NotifierInstance::find_target(const std::string &routing_id)
 {
-    auto itr = std::find_if(targets_.begin(), targets_.end(),
-                            [&](const TargetInfo &target) {
-                                return target.zmq_identity_ == routing_id;
-                            });
+    auto itr = targets_.find(routing_id);
     if (itr != targets_.end())
-        return &(*itr);
+        return &itr->second;
     return nullptr;
 }
 
@@ -160,7 +364,21 @@ void NotifierInstance::handle_msg_bus()
     std::string card;
     int bits;
 
+    ProtocolHandler::Event event;
+    event.timestamp_ = ProtocolHandler::Clock::now();
+    event.status_    = 0;
+
     bus_sub_.receive(msg);
+    if (msg.parts() == 2)
+    {
+        // A decision from an authentication source.
+        Leosac::Auth::AccessStatus status;
+        msg >> src >> status;
+        event.source_ = src.substr(2);
+        event.status_ = static_cast<uint8_t>(status);
+        handle_event(event);
+        return;
+    }
     if (msg.parts() < 4)
     {
         WARN("Unexpected message content.");
@@ -176,7 +394,9 @@ void NotifierInstance::handle_msg_bus()
     wiegand_card->card_id(card);
     wiegand_card->nb_bits(bits);
 
-    handle_credential(*wiegand_card);
+    event.card_   = wiegand_card;
+    event.source_ = src.substr(2);
+    handle_event(event);
 }
 
 void NotifierInstance::configure_tcp_socket(
@@ -196,12 +416,17 @@ void NotifierInstance::configure_tcp_socket(
         for (auto &endpoint : endpoints)
         {
             TargetInfo target;
-            target.url_    = "tcp://" + endpoint;
-            target.status_ = false;
+            target.url_      = "tcp://" + endpoint;
+            target.status_   = false;
+            target.consumer_ = "tcp-" + endpoint;
+            target.queue_.set_capacity(queue_size_);
             tcp_.connect(target.url_);
             INFO("TCP-Notifier remote target: " << Colorize::green(target.url_));
             tcp_.get(zmqpp::socket_option::identity, target.zmq_identity_);
-            targets_.push_back(std::move(target));
+            if (outbox_)
+                target.committed_ = outbox_->offset(target.consumer_);
+            auto routing_id = target.zmq_identity_;
+            targets_.emplace(routing_id, std::move(target));
         }
     }
 }
@@ -23,6 +23,10 @@
 #include "ProtocolHandler.hpp"
 #include "core/auth/AuthFwd.hpp"
 #include "core/credentials/CredentialFwd.hpp"
+#include "tools/Outbox.hpp"
+#include <boost/circular_buffer.hpp>
+#include <chrono>
+#include <unordered_map>
 #include <zmqpp/reactor.hpp>
 #include <zmqpp/socket.hpp>
 
@@ -35,6 +39,26 @@ namespace TCPNotifier
 class NotifierInstance;
 using NotifierInstanceUPtr = std::unique_ptr<NotifierInstance>;
 
+/**
+ * What to do when a message is queued for a client whose queue
+ * is full.
+ */
+enum class OverflowPolicy
+{
+    /**
+     * Drop the oldest queued message.
+     */
+    DROP_OLDEST,
+    /**
+     * Drop the new message.
+     */
+    DROP_NEWEST,
+    /**
+     * Drop the client's queue, and close the connection.
+     */
+    DISCONNECT,
+};
+
 /**
  * This is an instance of the Notifier. The module can have
  * many NotifierInstance running concurrently.
@@ -54,6 +78,19 @@ using NotifierInstanceUPtr = std::unique_ptr<NotifierInstance>;
  * When acting as a client, we always keep the list of server we connect
  * to,
  * and manage the state (connected or not).
+ * Targets are indexed by their routing id.
+ *
+ * @note Each target has a bounded queue. Messages a target can't
+ * accept right away (because it reads too slowly) wait in its queue,
+ * and are sent by flush(). What happens when the queue is full
+ * depends on the OverflowPolicy.
+ *
+ * @note When acting as a client, the instance may store its messages
+ * in an outbox. Each server is then a consumer of the outbox: dispatch()
+ * only appends messages to the outbox, and flush() sends each connected
+ * server the messages it didn't receive yet. Messages stored while the
+ * server was unreachable, and those sent on a connection that dropped,
+ * are sent again once the connection is back.
  */
 class NotifierInstance
 {
@@ -73,25 +110,47 @@ class NotifierInstance
      * register callback
      * on socket.
      * @param auth_source The list of authentication source to listen to.
+     * @param queue_size Maximum number of messages queued per target.
+     * @param overflow What to do when a target's queue is full.
+     * @param outbox Optional outbox, used when connecting to servers.
      */
     NotifierInstance(zmqpp::context &ctx, zmqpp::reactor &reactor,
                      std::vector<std::string> auth_sources,
                      std::vector<std::string> connect_to,
                      std::vector<std::string> bind_to,
-                     ProtocolHandlerUPtr protocol_handler);
+                     ProtocolHandlerUPtr protocol_handler, size_t queue_size,
+                     OverflowPolicy overflow, Tools::OutboxPtr outbox = nullptr);
 
-    ~NotifierInstance() = default;
+    ~NotifierInstance();
 
     NotifierInstance(const NotifierInstance &) = delete;
     NotifierInstance &operator=(const NotifierInstance &) = delete;
     NotifierInstance(NotifierInstance &&o)                = delete;
     NotifierInstance &operator=(NotifierInstance &&o) = delete;
 
+    /**
+     * Send the messages the protocol handler accumulated, if they're
+     * due, and as many pending messages as the connected targets accept.
+     */
+    void flush();
+
+    /**
+     * How long (in milliseconds) the module may wait before calling
+     * flush(). Returns -1 if nothing is pending.
+     */
+    long poll_timeout() const;
+
   private:
     /**
-     * Notify the peers of the `card` credential.
+     * Notify the peers of `event`, through the protocol handler.
+     */
+    void handle_event(const ProtocolHandler::Event &event);
+
+    /**
+     * Send (or queue) a message to every connected target. With an
+     * outbox, the message is only stored: flush() sends it.
      */
-    void handle_credential(Cred::RFIDCard &card);
+    void dispatch(const ByteVector &message);
 
     void handle_one(zmqpp::message &msg);
 
@@ -104,6 +163,46 @@ class NotifierInstance
 
     void configure_tcp_socket(const std::vector<std::string> &endpoints);
 
+    struct TargetInfo;
+
+    /**
+     * Send the messages `target` didn't receive yet from the outbox,
+     * until the socket would block.
+     */
+    void send_backlog(TargetInfo &target);
+
+    /**
+     * Flush the outbox to disk, if something changed and the last
+     * sync is older than a second, or if `force` is true.
+     */
+    void sync_outbox(bool force);
+
+    /**
+     * Commit the outbox offset of `target`.
+     */
+    void commit(TargetInfo &target, uint64_t offset);
+
+    /**
+     * Send `data` to `target` without blocking, or queue it.
+     */
+    void enqueue(TargetInfo &target, std::string data);
+
+    /**
+     * Send the queued messages of `target` until the socket would block.
+     */
+    void send_queue(TargetInfo &target);
+
+    /**
+     * Try to send one message to `target`. Returns false if
+     * it would block.
+     */
+    bool send_one(TargetInfo &target, const std::string &data);
+
+    /**
+     * Log the counters of `target`.
+     */
+    static void log_stats(const TargetInfo &target);
+
     /**
      * Some information for each tcp server target.
      */
@@ -111,6 +210,11 @@ class NotifierInstance
     {
         TargetInfo()
             : status_(false)
+            , committed_(0)
+            , resend_from_(0)
+            , sent_(0)
+            , dropped_(0)
+            , max_queued_(0)
         {
         }
         TargetInfo(const TargetInfo &) = default;
@@ -128,6 +232,24 @@ class NotifierInstance
         // ZMQ provide auto reconnection
         // This tracks the status.
         bool status_;
+
+        // Name of the target as an outbox consumer.
+        std::string consumer_;
+
+        // Outbox offset last committed for this target.
+        uint64_t committed_;
+
+        // Outbox offset of the first message sent on the current
+        // connection. Messages may still sit in the socket's buffer when
+        // the connection drops, so the offset is rewound there.
+        uint64_t resend_from_;
+
+        // Messages waiting for the target to catch up.
+        boost::circular_buffer<std::string> queue_;
+
+        size_t sent_;
+        size_t dropped_;
+        size_t max_queued_;
     };
 
     /**
@@ -141,7 +263,14 @@ class NotifierInstance
      */
     zmqpp::socket tcp_;
 
-    std::list<TargetInfo> targets_;
+    /**
+     * Targets, indexed by routing id.
+     */
+    std::unordered_map<std::string, TargetInfo> targets_;
+
+    size_t queue_size_;
+
+    OverflowPolicy overflow_;
 
     ProtocolHandlerUPtr protocol_;
 
@@ -150,6 +279,15 @@ class NotifierInstance
      */
     bool act_as_server_;
 
+    Tools::OutboxPtr outbox_;
+
+    /**
+     * Were offsets committed to the outbox since the last sync ?
+     */
+    bool unsynced_;
+
+    std::chrono::steady_clock::time_point last_sync_;
+
     /**
      * Attempt to find a target from its routing_id.
      *
@@ -18,18 +18,42 @@
 */
 
 #include "ProtocolHandler.hpp"
+#include "protocols/PushFramedEvents.hpp"
 #include "protocols/PushSimpleCardNumber.hpp"
+#include <boost/property_tree/ptree.hpp>
 
 using namespace Leosac;
 using namespace Leosac::Module;
 using namespace Leosac::Module::TCPNotifier;
 
-ProtocolHandlerUPtr ProtocolHandler::create(int protocol_id)
+std::vector<ByteVector> ProtocolHandler::handle_event(const Event &event)
+{
+    if (!event.card_)
+        return {};
+    return {build_cred_msg(*event.card_)};
+}
+
+std::vector<ByteVector> ProtocolHandler::flush(Clock::time_point)
+{
+    return {};
+}
+
+long ProtocolHandler::flush_timeout(Clock::time_point) const
+{
+    return -1;
+}
+
+ProtocolHandlerUPtr ProtocolHandler::create(int protocol_id,
+                                            const boost::property_tree::ptree &cfg)
 {
     switch (protocol_id)
     {
     case SIMPLE_CARD_NUMBER:
         return std::make_unique<PushSimpleCardNumber>();
+    case FRAMED_EVENTS:
+        return std::make_unique<PushFramedEvents>(
+            cfg.get<size_t>("frame_size", 4096),
+            std::chrono::milliseconds(cfg.get<long>("frame_delay", 50)));
     default:
         return nullptr;
     }
@@ -21,7 +21,10 @@
 
 #include "LeosacFwd.hpp"
 #include "core/credentials/CredentialFwd.hpp"
+#include <boost/property_tree/ptree_fwd.hpp>
+#include <chrono>
 #include <stdexcept>
+#include <vector>
 
 namespace Leosac
 {
@@ -32,6 +35,7 @@ namespace TCPNotifier
 enum Protocol
 {
     SIMPLE_CARD_NUMBER,
+    FRAMED_EVENTS,
 };
 
 class ProtocolHandler;
@@ -61,9 +65,37 @@ class ProtocolException : public ::std::runtime_error
  * a credential read.
  *
  * One instance of protocol handler is created by client.
+ *
+ * A protocol handler may also accumulate events, and turn them into
+ * messages later: handle_event() and flush() return the messages
+ * that are ready to be sent.
  */
 class ProtocolHandler
 {
+  public:
+    using Clock = std::chrono::system_clock;
+
+    /**
+     * Something the clients may be notified of: either a credential
+     * was read, or an authentication source took a decision.
+     */
+    struct Event
+    {
+        /**
+         * The credential that was read, or null for a decision.
+         */
+        std::shared_ptr<Cred::RFIDCard> card_;
+        /**
+         * Name of the source that published the event.
+         */
+        std::string source_;
+        Clock::time_point timestamp_;
+        /**
+         * The value of the Auth::AccessStatus of a decision, or 0.
+         */
+        uint8_t status_;
+    };
+
   protected:
     /**
      * ProtocolHandler shall not be created directly.
@@ -79,11 +111,36 @@ class ProtocolHandler
      */
     virtual ByteVector build_cred_msg(const Cred::RFIDCard &card) = 0;
 
+    /**
+     * Returns the messages to send after `event` happened.
+     *
+     * The default implementation sends one message per credential,
+     * built by build_cred_msg(), and ignores decisions.
+     */
+    virtual std::vector<ByteVector> handle_event(const Event &event);
+
+    /**
+     * Returns the accumulated messages that are due at `now`.
+     */
+    virtual std::vector<ByteVector> flush(Clock::time_point now);
+
+    /**
+     * How long (in milliseconds) until flush() has something to
+     * return, or -1 if it won't.
+     */
+    virtual long flush_timeout(Clock::time_point now) const;
+
+    virtual ~ProtocolHandler() = default;
+
     /**
      * Create an instance of a protocol handler depending
      * on the requested protocol id.
+     *
+     * @param cfg The configuration of the notifier instance, for
+     * protocol-specific options.
      */
-    static ProtocolHandlerUPtr create(int protocol_id);
+    static ProtocolHandlerUPtr create(int protocol_id,
+                                      const boost::property_tree::ptree &cfg);
 };
 }
 }
@@ -19,6 +19,7 @@
 
 #include "TcpNotifier.hpp"
 #include "core/auth/Auth.hpp"
+#include <algorithm>
 #include <tools/PropertyTreeExtractor.hpp>
 
 using namespace Leosac;
@@ -39,6 +40,23 @@ TCPNotifierModule::~TCPNotifierModule()
 {
 }
 
+void TCPNotifierModule::run()
+{
+    while (is_running_)
+    {
+        long timeout = -1;
+        for (const auto &ni : instances_)
+        {
+            auto t = ni->poll_timeout();
+            if (t >= 0)
+                timeout = timeout < 0 ? t : std::min(timeout, t);
+        }
+        reactor_.poll(timeout);
+        for (auto &ni : instances_)
+            ni->flush();
+    }
+}
+
 void TCPNotifierModule::process_config()
 {
     for (auto &&itr : config_.get_child("module_config"))
@@ -83,15 +101,60 @@ void TCPNotifierModule::process_config()
 
         Tools::PropertyTreeExtractor extractor(itr.second, "TCP-Notifier");
         int protocol_id = extractor.get<int>("protocol");
-        auto protocol   = ProtocolHandler::create(protocol_id);
+        auto protocol   = ProtocolHandler::create(protocol_id, itr.second);
 
         if (!protocol)
         {
             ERROR("Cannot instanciate a protocol number " << protocol_id);
             continue;
         }
+        auto queue_size = itr.second.get<size_t>("queue_size", 1024);
+        auto overflow_name =
+            itr.second.get<std::string>("overflow", "drop_oldest");
+        OverflowPolicy overflow;
+        if (overflow_name == "drop_oldest")
+            overflow = OverflowPolicy::DROP_OLDEST;
+        else if (overflow_name == "drop_newest")
+            overflow = OverflowPolicy::DROP_NEWEST;
+        else if (overflow_name == "disconnect")
+            overflow = OverflowPolicy::DISCONNECT;
+        else
+        {
+            ERROR("Invalid overflow policy: " << overflow_name);
+            continue;
+        }
+        if (queue_size < 1)
+        {
+            ERROR("queue_size must be positive.");
+            continue;
+        }
+
+        Tools::OutboxPtr outbox;
+        if (auto outbox_cfg = itr.second.get_child_optional("outbox"))
+        {
+            if (connects.empty())
+            {
+                ERROR("An outbox can only be used when connecting to servers.");
+                continue;
+            }
+            Tools::Outbox::Options options;
+            options.max_size_ =
+                outbox_cfg->get<size_t>("max_size", 16 * 1024 * 1024);
+            options.max_age_ = std::chrono::seconds(
+                outbox_cfg->get<long>("max_age", 7 * 24 * 3600));
+            options.segment_size_ =
+                outbox_cfg->get<size_t>("segment_size", 1024 * 1024);
+            if (options.max_size_ < 1 || options.max_age_.count() < 1)
+            {
+                ERROR("Outbox limits must be positive.");
+                continue;
+            }
+            outbox = std::make_shared<Tools::Outbox>(
+                outbox_cfg->get<std::string>("directory"), options);
+        }
         auto ni = std::make_unique<NotifierInstance>(
-            ctx_, reactor_, auth_sources, connects, binds, std::move(protocol));
+            ctx_, reactor_, auth_sources, connects, binds, std::move(protocol),
+            queue_size, overflow, outbox);
         instances_.push_back(std::move(ni));
     }
 }
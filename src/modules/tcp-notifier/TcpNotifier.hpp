@@ -42,6 +42,12 @@ class TCPNotifierModule : public BaseModule
 
     ~TCPNotifierModule();
 
+    /**
+     * Main loop: poll the reactor, and let the instances send their
+     * pending messages.
+     */
+    virtual void run() override;
+
   private:
     /**
      * Process the configuration file.
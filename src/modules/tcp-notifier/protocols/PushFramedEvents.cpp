@@ -0,0 +1,151 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PushFramedEvents.hpp"
+#include "core/credentials/RFIDCard.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace Leosac;
+using namespace Leosac::Module::TCPNotifier;
+
+constexpr uint16_t PushFramedEvents::version;
+constexpr size_t PushFramedEvents::header_size;
+constexpr size_t PushFramedEvents::record_header_size;
+
+namespace
+{
+/**
+ * Write the `size` low-order bytes of `value` at `pos`, big endian.
+ */
+void put(ByteVector &data, size_t pos, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        data[pos + i] = static_cast<uint8_t>(value >> (8 * (size - 1 - i)));
+}
+
+size_t source_size(const ProtocolHandler::Event &event)
+{
+    return std::min<size_t>(event.source_.size(), 255);
+}
+
+size_t record_size(const ProtocolHandler::Event &event)
+{
+    return PushFramedEvents::record_header_size + (source_size(event) + 7) / 8 * 8;
+}
+}
+
+PushFramedEvents::PushFramedEvents(size_t max_frame_size,
+                                   std::chrono::milliseconds max_delay)
+    : max_frame_size_(std::min<size_t>(max_frame_size,
+                                       std::numeric_limits<uint32_t>::max()))
+    , max_delay_(max_delay)
+    , count_(0)
+{
+}
+
+ByteVector PushFramedEvents::build_cred_msg(const Cred::RFIDCard &card)
+{
+    ByteVector frame(header_size + record_header_size, 0);
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         Clock::now().time_since_epoch())
+                         .count();
+
+    put(frame, 0, frame.size(), 4);
+    put(frame, 4, version, 2);
+    put(frame, 6, 1, 2);
+    put(frame, header_size, record_header_size, 2);
+    put(frame, header_size + 4, card.nb_bits(), 2);
+    put(frame, header_size + 8, card.to_int(), 8);
+    put(frame, header_size + 16, timestamp, 8);
+    return frame;
+}
+
+std::vector<ByteVector> PushFramedEvents::handle_event(const Event &event)
+{
+    std::vector<ByteVector> frames;
+
+    if (count_ && (frame_.size() + record_size(event) > max_frame_size_ ||
+                   count_ == std::numeric_limits<uint16_t>::max()))
+        frames.push_back(take_frame());
+    append_record(event);
+    if (frame_.size() >= max_frame_size_ || max_delay_.count() <= 0)
+        frames.push_back(take_frame());
+    return frames;
+}
+
+std::vector<ByteVector> PushFramedEvents::flush(Clock::time_point now)
+{
+    // If the clock went backward, don't hold the frame for as long.
+    if (count_ && (now - first_ >= max_delay_ || now < first_))
+        return {take_frame()};
+    return {};
+}
+
+long PushFramedEvents::flush_timeout(Clock::time_point now) const
+{
+    using namespace std::chrono;
+    if (!count_)
+        return -1;
+    if (now < first_)
+        return 0;
+    auto left = duration_cast<milliseconds>(first_ + max_delay_ - now);
+    return std::max<long>(0, left.count());
+}
+
+void PushFramedEvents::append_record(const Event &event)
+{
+    using namespace std::chrono;
+    if (!count_)
+    {
+        frame_.assign(header_size, 0);
+        first_ = event.timestamp_;
+    }
+
+    auto pos       = frame_.size();
+    auto size      = record_size(event);
+    auto timestamp =
+        duration_cast<milliseconds>(event.timestamp_.time_since_epoch()).count();
+
+    frame_.resize(pos + size, 0);
+    put(frame_, pos, size, 2);
+    put(frame_, pos + 2, event.status_, 1);
+    put(frame_, pos + 3, source_size(event), 1);
+    if (event.card_)
+    {
+        put(frame_, pos + 4, event.card_->nb_bits(), 2);
+        put(frame_, pos + 8, event.card_->to_int(), 8);
+    }
+    put(frame_, pos + 16, timestamp, 8);
+    std::copy_n(event.source_.begin(), source_size(event),
+                frame_.begin() + pos + record_header_size);
+    ++count_;
+}
+
+ByteVector PushFramedEvents::take_frame()
+{
+    ByteVector frame = std::move(frame_);
+
+    put(frame, 0, frame.size(), 4);
+    put(frame, 4, version, 2);
+    put(frame, 6, count_, 2);
+    frame_.clear();
+    count_ = 0;
+    return frame;
+}
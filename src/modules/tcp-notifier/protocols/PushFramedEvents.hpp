@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "modules/tcp-notifier/ProtocolHandler.hpp"
+
+namespace Leosac
+{
+namespace Module
+{
+namespace TCPNotifier
+{
+/**
+ * Protocol that packs events into frames.
+ *
+ * Events are accumulated, and sent as a frame once the frame is
+ * `max_frame_size` bytes big, or once its first event has waited
+ * `max_delay`. The delay is measured from the timestamp of that event
+ * to the `now` given to flush().
+ *
+ * All integers are big endian. A frame is an 8 bytes header followed
+ * by the records:
+ *     + u32: size of the frame, header included.
+ *     + u16: version of the format (1).
+ *     + u16: number of records.
+ *
+ * A record is a 24 bytes header followed by the source name, padded
+ * with zeros to a multiple of 8 bytes. All fields are therefore
+ * naturally aligned relative to the start of the frame.
+ *     + u16: size of the record, padding included.
+ *     + u8: access status (0 for a credential, see Auth::AccessStatus
+ *       for a decision).
+ *     + u8: size of the source name.
+ *     + u16: number of bits of the card (0 for a decision).
+ *     + u16: reserved (0).
+ *     + u64: card number, formatted like in protocol 0 (0 for a decision).
+ *     + u64: timestamp, in milliseconds since the UNIX epoch.
+ *     + the source name.
+ */
+class PushFramedEvents : public ProtocolHandler
+{
+  public:
+    PushFramedEvents(size_t max_frame_size, std::chrono::milliseconds max_delay);
+
+    /**
+     * Returns a frame holding a single event for `card`.
+     */
+    virtual ByteVector build_cred_msg(const Cred::RFIDCard &card) override;
+
+    virtual std::vector<ByteVector> handle_event(const Event &event) override;
+
+    virtual std::vector<ByteVector> flush(Clock::time_point now) override;
+
+    virtual long flush_timeout(Clock::time_point now) const override;
+
+    static constexpr uint16_t version          = 1;
+    static constexpr size_t header_size        = 8;
+    static constexpr size_t record_header_size = 24;
+
+  private:
+    /**
+     * Append the record for `event` to the current frame.
+     */
+    void append_record(const Event &event);
+
+    /**
+     * Finalize the current frame and return it.
+     */
+    ByteVector take_frame();
+
+    size_t max_frame_size_;
+    std::chrono::milliseconds max_delay_;
+
+    ByteVector frame_;
+    uint16_t count_;
+    /**
+     * Timestamp of the first event of the current frame.
+     */
+    Clock::time_point first_;
+};
+}
+}
+}
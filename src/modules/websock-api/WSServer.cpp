@@ -28,11 +28,13 @@
 #include "api/CredentialCRUD.hpp"
 #include "api/DoorCRUD.hpp"
 #include "api/GroupCRUD.hpp"
+#include "api/HistoryExport.hpp"
 #include "api/LogGet.hpp"
 #include "api/MembershipCRUD.hpp"
 #include "api/PasswordChange.hpp"
 #include "api/Restart.hpp"
 #include "api/ScheduleCRUD.hpp"
+#include "api/StatsGet.hpp"
 #include "api/UserCRUD.hpp"
 #include "api/ZoneCRUD.hpp"
 #include "api/search/AccessPointSearch.hpp"
@@ -56,6 +58,7 @@
 #include "core/audit/WSAPICall.hpp"
 #include "core/auth/Token_odb.h"
 #include "core/auth/User.hpp"
+#include "core/tasks/ExportHistory.hpp"
 #include "exception/EntityNotFound.hpp"
 #include "exception/ExceptionsTools.hpp"
 #include "exception/ModelException.hpp"
@@ -122,6 +125,9 @@ WSServer::WSServer(WebSockAPIModule &module, DBPtr database)
     individual_handlers_["get_pending_update"]        = &PendingUpdateGet::create;
     individual_handlers_["get_update"]                = &UpdateGet::create;
     individual_handlers_["restart"]                   = &Restart::create;
+    individual_handlers_["history.export"]            = &HistoryExport::create;
+    individual_handlers_["history.export_status"]     = &HistoryExportStatus::create;
+    individual_handlers_["stats.get"]                 = &StatsGet::create;
 
     register_crud_handler("group", &WebSockAPI::GroupCRUD::instanciate);
     register_crud_handler("user", &WebSockAPI::UserCRUD::instanciate);
@@ -344,6 +350,48 @@ CoreUtilsPtr WSServer::core_utils()
     return module_.core_utils();
 }
 
+const std::string &WSServer::export_directory() const
+{
+    return module_.export_directory();
+}
+
+constexpr const std::chrono::hours WSServer::history_export_ttl;
+
+void WSServer::track_history_export(Tasks::ExportHistoryPtr task)
+{
+    ASSERT_LOG(task, "Export task cannot be null.");
+    expire_history_exports();
+    history_exports_[task->get_guid()] = {
+        task, std::chrono::steady_clock::time_point::max()};
+}
+
+Tasks::ExportHistoryPtr WSServer::find_history_export(const std::string &guid)
+{
+    expire_history_exports();
+    auto itr = history_exports_.find(guid);
+    if (itr != history_exports_.end())
+        return itr->second.task_;
+    return nullptr;
+}
+
+void WSServer::expire_history_exports()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto itr = history_exports_.begin(); itr != history_exports_.end();)
+    {
+        auto &entry = itr->second;
+        if (entry.completed_ == std::chrono::steady_clock::time_point::max() &&
+            entry.task_->is_complete())
+            entry.completed_ = now;
+
+        if (entry.completed_ != std::chrono::steady_clock::time_point::max() &&
+            now - entry.completed_ > history_export_ttl)
+            itr = history_exports_.erase(itr);
+        else
+            ++itr;
+    }
+}
+
 void WSServer::send_message(websocketpp::connection_hdl hdl,
                             const ServerMessage &msg)
 {
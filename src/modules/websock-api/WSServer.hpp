@@ -31,6 +31,7 @@
 #include "core/audit/AuditFwd.hpp"
 #include "tools/db/db_fwd.hpp"
 #include <boost/optional.hpp>
+#include <chrono>
 #include <set>
 #include <type_traits>
 #include <websocketpp/config/asio_no_tls.hpp>
@@ -141,6 +142,32 @@ class WSServer
      */
     void clear_user_sessions(Auth::UserPtr user, APIPtr exception);
 
+    /**
+     * The directory where history export files are written.
+     * May be empty, in which case exports are disabled.
+     */
+    const std::string &export_directory() const;
+
+    /**
+     * Keep track of an history export task, so that its progress
+     * can be queried later on.
+     *
+     * Tasks are forgotten `history_export_ttl` after they complete.
+     */
+    void track_history_export(Tasks::ExportHistoryPtr task);
+
+    /**
+     * Retrieve a tracked history export task by its GUID.
+     *
+     * @return The task, or nullptr.
+     */
+    Tasks::ExportHistoryPtr find_history_export(const std::string &guid);
+
+    /**
+     * How long a completed history export remains queryable.
+     */
+    static constexpr const std::chrono::hours history_export_ttl{1};
+
   private:
     void on_open(websocketpp::connection_hdl hdl);
 
@@ -250,6 +277,27 @@ class WSServer
      */
     DBServicePtr dbsrv_;
 
+    /**
+     * Forget about the history exports that completed more than
+     * `history_export_ttl` ago.
+     */
+    void expire_history_exports();
+
+    struct HistoryExportEntry
+    {
+        Tasks::ExportHistoryPtr task_;
+
+        /**
+         * When the task was first seen complete, or time_point::max().
+         */
+        std::chrono::steady_clock::time_point completed_;
+    };
+
+    /**
+     * History export tasks, indexed by their GUID.
+     */
+    std::map<std::string, HistoryExportEntry> history_exports_;
+
     /**
      * A reference to the module.
      *
@@ -34,8 +34,9 @@ WebSockAPIModule::WebSockAPIModule(zmqpp::context &ctx, zmqpp::socket *pipe,
                                    CoreUtilsPtr utils)
     : BaseModule(ctx, pipe, cfg, utils)
 {
-    port_      = cfg.get<uint16_t>("module_config.port", 8976);
-    interface_ = cfg.get<std::string>("module_config.interface", "127.0.0.1");
+    port_       = cfg.get<uint16_t>("module_config.port", 8976);
+    interface_  = cfg.get<std::string>("module_config.interface", "127.0.0.1");
+    export_dir_ = cfg.get<std::string>("module_config.export_dir", "");
 
     auto endpoint_colorized = Colorize::green(
         Colorize::underline(fmt::format("{}:{}", interface_, port_)));
@@ -61,3 +62,8 @@ CoreUtilsPtr WebSockAPIModule::core_utils()
 {
     return utils_;
 }
+
+const std::string &WebSockAPIModule::export_directory() const
+{
+    return export_dir_;
+}
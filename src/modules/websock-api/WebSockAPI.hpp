@@ -59,6 +59,11 @@ class WebSockAPIModule : public BaseModule
      */
     CoreUtilsPtr core_utils();
 
+    /**
+     * The directory where history export files are written.
+     */
+    const std::string &export_directory() const;
+
   private:
     /**
      * Port to bind the websocket endpoint.
@@ -70,6 +75,12 @@ class WebSockAPIModule : public BaseModule
      */
     std::string interface_;
 
+    /**
+     * Directory where history export files are written.
+     * Exports are disabled if this is empty.
+     */
+    std::string export_dir_;
+
     /**
      * Our websocket server object.
      */
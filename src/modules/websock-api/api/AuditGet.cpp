@@ -24,7 +24,10 @@
 #include "core/CoreUtils.hpp"
 #include "core/audit/AuditEntry.hpp"
 #include "core/audit/AuditEntry_odb.h"
+#include "core/audit/WSAPICall.hpp"
+#include "core/audit/WSAPICall_odb.h"
 #include "core/audit/serializers/PolymorphicAuditSerializer.hpp"
+#include "core/audit/serializers/WSAPICallSerializer.hpp"
 #include "exception/InvalidArgument.hpp"
 #include "tools/JSONUtils.hpp"
 #include "tools/LogEntry_odb.h"
@@ -75,14 +78,30 @@ json AuditGet::process_impl(const json &req)
         else
             rep["meta"]["total_page"] = 0;
 
-        auto query  = Query(build_request_string(req, page, page_size));
-        auto ret    = db->query<Audit::AuditEntry>(query);
         rep["data"] = json::array();
-        for (const auto &audit : ret)
+        if (is_wsapicall_only(req))
         {
-            json audit_json = Audit::Serializer::PolymorphicAuditJSON::serialize(
-                audit, security_context());
-            rep["data"].push_back(audit_json);
+            // Fast path: fetch the page from the flat view, in a single
+            // statement and without polymorphic loading.
+            using RowQuery = odb::query<Audit::WSAPICallRow>;
+            auto rows      = db->query<Audit::WSAPICallRow>(RowQuery(
+                build_page_clause("\"AuditEntry\".\"id\"", page, page_size)));
+            for (const auto &row : rows)
+            {
+                rep["data"].push_back(Audit::Serializer::WSAPICallJSON::serialize(
+                    row, security_context()));
+            }
+        }
+        else
+        {
+            auto query = Query(build_request_string(req, page, page_size));
+            auto ret   = db->query<Audit::AuditEntry>(query);
+            for (const auto &audit : ret)
+            {
+                json audit_json = Audit::Serializer::PolymorphicAuditJSON::serialize(
+                    audit, security_context());
+                rep["data"].push_back(audit_json);
+            }
         }
     }
     else
@@ -107,13 +126,31 @@ std::string AuditGet::build_request_string(const json &req, int page,
     std::stringstream request_builder;
 
     request_builder << build_in_clause(req);
-    request_builder << " ORDER BY id DESC";
+    request_builder << " " << build_page_clause("id", page, page_size);
+    DEBUG("QUERY: " << request_builder.str());
+    return request_builder.str();
+}
+
+std::string AuditGet::build_page_clause(const std::string &id_column, int page,
+                                        int page_size) const
+{
+    std::stringstream request_builder;
+
+    request_builder << "ORDER BY " << id_column << " DESC";
     request_builder << " LIMIT " << page_size;
     request_builder << " OFFSET " << page_size * (page - 1);
-    DEBUG("QUERY: " << request_builder.str());
     return request_builder.str();
 }
 
+bool AuditGet::is_wsapicall_only(const json &req) const
+{
+    auto itr = req.find("enabled_type");
+    if (itr == req.end() || !itr->is_array() || itr->size() != 1)
+        return false;
+    return itr->at(0).is_string() &&
+           itr->at(0).get<std::string>() == "Leosac::Audit::WSAPICall";
+}
+
 bool AuditGet::is_stringtype_sane(const std::string &str) const
 {
     for (const auto &c : str)
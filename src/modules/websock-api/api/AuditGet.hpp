@@ -65,6 +65,20 @@ class AuditGet : public MethodHandler
     virtual json process_impl(const json &req) override;
     std::string build_request_string(const json &req, int page, int page_size) const;
 
+    /**
+     * Build the "ORDER BY ... LIMIT ... OFFSET ..." string for a given page.
+     */
+    std::string build_page_clause(const std::string &id_column, int page,
+                                  int page_size) const;
+
+    /**
+     * Are we only retrieving WSAPICall entries?
+     *
+     * In that case we page through the flat Audit::WSAPICallRow view
+     * instead of loading polymorphic AuditEntry objects.
+     */
+    bool is_wsapicall_only(const json &req) const;
+
     /**
      * Build the "WHERE typeid IN (...)" string based on the enabled types.
      */
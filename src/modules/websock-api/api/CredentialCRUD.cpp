@@ -197,7 +197,7 @@ boost::optional<json> CredentialCRUD::delete_impl(const json &req)
             *cred, SystemSecurityContext::instance()));
 
         audit->finalize();
-        db->erase<Cred::Credential>(cred->id());
+        db->erase(assert_cast<Cred::CredentialPtr>(cred));
         t.commit();
     }
     return json{};
@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HistoryExport.hpp"
+#include "core/CoreUtils.hpp"
+#include "core/Scheduler.hpp"
+#include "core/tasks/ExportHistory.hpp"
+#include "exception/EntityNotFound.hpp"
+#include "exception/InvalidArgument.hpp"
+#include "modules/websock-api/WSServer.hpp"
+#include "tools/GenGuid.h"
+#include "tools/JSONUtils.hpp"
+#include "tools/enforce.hpp"
+#include <boost/filesystem.hpp>
+#include <spdlog/fmt/fmt.h>
+
+namespace Leosac
+{
+namespace Module
+{
+namespace WebSockAPI
+{
+HistoryExport::HistoryExport(RequestContext ctx)
+    : MethodHandler(ctx)
+{
+}
+
+MethodHandlerUPtr HistoryExport::create(RequestContext ctx)
+{
+    return std::make_unique<HistoryExport>(ctx);
+}
+
+std::vector<ActionActionParam>
+HistoryExport::required_permission(const json &req) const
+{
+    std::vector<ActionActionParam> perm_;
+    SecurityContext::ActionParam ap;
+
+    if (JSONUtil::extract_with_default(req, "source", "audit") == "log")
+        perm_.push_back({SecurityContext::Action::LOG_READ, ap});
+    else
+        perm_.push_back({SecurityContext::Action::AUDIT_READ, ap});
+    return perm_;
+}
+
+json HistoryExport::process_impl(const json &req)
+{
+    using namespace JSONUtil;
+    using Tasks::ExportHistory;
+
+    const auto &export_dir = ctx_.server.export_directory();
+    if (export_dir.empty())
+        throw LEOSACException("History export is disabled: no export_dir.");
+
+    std::string source = extract_with_default(req, "source", "audit");
+    std::string format = extract_with_default(req, "format", "ndjson");
+    bool gzip          = extract_with_default(req, "gzip", false);
+
+    LEOSAC_ENFORCE_ARGUMENT(source == "audit" || source == "log", source,
+                            "Source must be either audit or log");
+    LEOSAC_ENFORCE_ARGUMENT(format == "ndjson" || format == "csv", format,
+                            "Format must be either ndjson or csv");
+
+    auto filename = fmt::format("{}-{}.{}{}", source, gen_uuid(), format,
+                                gzip ? ".gz" : "");
+    auto path = (boost::filesystem::path(export_dir) / filename).string();
+
+    auto task = std::make_shared<ExportHistory>(
+        ctx_.dbsrv->db(),
+        source == "audit" ? ExportHistory::Source::AUDIT
+                          : ExportHistory::Source::LOG,
+        format == "csv" ? ExportHistory::Format::CSV : ExportHistory::Format::NDJSON,
+        gzip, path);
+    ctx_.server.track_history_export(task);
+    ctx_.server.core_utils()->scheduler().enqueue(task, TargetThread::POOL);
+
+    json rep;
+    rep["task_id"]  = task->get_guid();
+    rep["filename"] = filename;
+    return rep;
+}
+
+HistoryExportStatus::HistoryExportStatus(RequestContext ctx)
+    : MethodHandler(ctx)
+{
+}
+
+MethodHandlerUPtr HistoryExportStatus::create(RequestContext ctx)
+{
+    return std::make_unique<HistoryExportStatus>(ctx);
+}
+
+std::vector<ActionActionParam>
+HistoryExportStatus::required_permission(const json &req) const
+{
+    std::vector<ActionActionParam> perm_;
+    SecurityContext::ActionParam ap;
+
+    // Require the same permission as the one needed to start the export.
+    auto task = ctx_.server.find_history_export(
+        JSONUtil::extract_with_default(req, "task_id", ""));
+    if (task && task->source() == Tasks::ExportHistory::Source::LOG)
+        perm_.push_back({SecurityContext::Action::LOG_READ, ap});
+    else
+        perm_.push_back({SecurityContext::Action::AUDIT_READ, ap});
+    return perm_;
+}
+
+json HistoryExportStatus::process_impl(const json &req)
+{
+    std::string task_id = req.at("task_id");
+    auto task           = ctx_.server.find_history_export(task_id);
+    if (!task)
+        throw EntityNotFound(task_id, "history-export");
+
+    json rep;
+    rep["complete"] = task->is_complete();
+    rep["success"]  = task->is_complete() && task->succeed();
+    rep["exported"] = task->exported();
+    rep["total"]    = task->total();
+    return rep;
+}
+}
+}
+}
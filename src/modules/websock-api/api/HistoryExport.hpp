@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "modules/websock-api/api/MethodHandler.hpp"
+
+namespace Leosac
+{
+namespace Module
+{
+namespace WebSockAPI
+{
+using json = nlohmann::json;
+
+/**
+ * Export the audit trail or the log history to a file, in
+ * the background.
+ *
+ * The file is written in the directory configured by the `export_dir`
+ * module option. The call fails if this option is not set.
+ *
+ * Request:
+ *     + source: "audit" or "log".
+ *     + format: "ndjson" (default) or "csv".
+ *     + gzip: Compress the file. Defaults to false.
+ *
+ * Response:
+ *     + task_id: Identifier of the export, to be used with
+ *       `history.export_status`.
+ *     + filename: Name of the file in the export directory.
+ */
+class HistoryExport : public MethodHandler
+{
+  public:
+    HistoryExport(RequestContext ctx);
+
+    static MethodHandlerUPtr create(RequestContext);
+
+  protected:
+    std::vector<ActionActionParam>
+    required_permission(const json &req) const override;
+
+  private:
+    virtual json process_impl(const json &req) override;
+};
+
+/**
+ * Retrieve the progress of an history export.
+ *
+ * An export can be queried until an hour after it completed.
+ *
+ * Request:
+ *     + task_id: Identifier returned by `history.export`.
+ *
+ * Response:
+ *     + complete: Whether the export is over.
+ *     + success: Whether the export succeeded.
+ *     + exported: Number of rows written so far.
+ *     + total: Number of rows to export.
+ */
+class HistoryExportStatus : public MethodHandler
+{
+  public:
+    HistoryExportStatus(RequestContext ctx);
+
+    static MethodHandlerUPtr create(RequestContext);
+
+  protected:
+    std::vector<ActionActionParam>
+    required_permission(const json &req) const override;
+
+  private:
+    virtual json process_impl(const json &req) override;
+};
+}
+}
+}
@@ -236,7 +236,7 @@ boost::optional<json> ScheduleCRUD::delete_impl(const json &req)
         }
 
         audit->finalize();
-        db->erase<Tools::Schedule>(schedule->id());
+        db->erase(assert_cast<Tools::SchedulePtr>(schedule));
         t.commit();
     }
     return json{};
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StatsGet.hpp"
+#include "core/audit/StatsRollup.hpp"
+#include "exception/InvalidArgument.hpp"
+#include "tools/JSONUtils.hpp"
+#include "tools/db/DBService.hpp"
+#include "tools/enforce.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+
+using namespace Leosac;
+using namespace Leosac::Module;
+using namespace Leosac::Module::WebSockAPI;
+
+namespace
+{
+/**
+ * Maximum number of hourly buckets a request may span: roughly a year.
+ */
+constexpr long long max_bucket_count = 24 * 366;
+
+bool is_access_metric(const std::string &metric)
+{
+    return boost::starts_with(metric, "access.");
+}
+}
+
+StatsGet::StatsGet(RequestContext ctx)
+    : MethodHandler(ctx)
+{
+}
+
+MethodHandlerUPtr StatsGet::create(RequestContext ctx)
+{
+    return std::make_unique<StatsGet>(ctx);
+}
+
+std::vector<ActionActionParam> StatsGet::required_permission(const json &req) const
+{
+    std::vector<ActionActionParam> perm_;
+    SecurityContext::ActionParam ap;
+
+    // Access decisions are otherwise only available through the logs.
+    if (is_access_metric(JSONUtil::extract_with_default(req, "metric", "")))
+        perm_.push_back({SecurityContext::Action::LOG_READ, ap});
+    else
+        perm_.push_back({SecurityContext::Action::AUDIT_READ, ap});
+    return perm_;
+}
+
+json StatsGet::process_impl(const json &req)
+{
+    using namespace JSONUtil;
+    using Audit::StatsRollup;
+
+    json rep;
+    DBPtr db = ctx_.dbsrv->db();
+    if (!db)
+    {
+        rep["status"] = -1;
+        return rep;
+    }
+
+    std::string metric    = req.at("metric");
+    std::string dimension = req.at("dimension");
+    long long to          = extract_with_default(
+        req, "to", static_cast<long long>(std::time(nullptr)));
+    long long from = extract_with_default(req, "from", to - 7 * 24 * 3600);
+    long long resolution =
+        extract_with_default(req, "resolution", StatsRollup::bucket_duration);
+
+    if (is_access_metric(metric))
+    {
+        LEOSAC_ENFORCE_ARGUMENT(metric == "access.granted" ||
+                                    metric == "access.denied",
+                                metric, "Unknown metric");
+        LEOSAC_ENFORCE_ARGUMENT(dimension == "door" || dimension == "user",
+                                dimension, "Dimension must be door or user");
+    }
+    else
+    {
+        LEOSAC_ENFORCE_ARGUMENT(metric == "audit", metric, "Unknown metric");
+        LEOSAC_ENFORCE_ARGUMENT(dimension == "type" || dimension == "user",
+                                dimension, "Dimension must be type or user");
+    }
+    LEOSAC_ENFORCE_ARGUMENT(resolution > 0 &&
+                                resolution % StatsRollup::bucket_duration == 0,
+                            resolution, "Resolution must be a multiple of 3600");
+    LEOSAC_ENFORCE_ARGUMENT(from < to, from, "from must be lower than to");
+    LEOSAC_ENFORCE_ARGUMENT((to - from) / StatsRollup::bucket_duration <=
+                                max_bucket_count,
+                            to, "Time range is too large");
+
+    std::vector<Audit::StatsRollupRow> rows;
+    {
+        odb::transaction t(db->begin());
+        rows = StatsRollup::aggregate(*db, metric, dimension, from, to, resolution);
+        t.commit();
+    }
+
+    rep["resolution"] = resolution;
+    rep["data"]       = json::array();
+    for (const auto &row : rows)
+    {
+        rep["data"].push_back(
+            {{"bucket", row.bucket}, {"key", row.key}, {"count", row.count}});
+    }
+    return rep;
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MethodHandler.hpp"
+
+namespace Leosac
+{
+namespace Module
+{
+namespace WebSockAPI
+{
+using json = nlohmann::json;
+
+/**
+ * Retrieve pre-aggregated statistics about access decisions
+ * or audit entries. See Audit::StatsRollup.
+ *
+ * The cost of this call depends on the requested time range and
+ * resolution, not on the amount of raw history stored in the database.
+ *
+ * Request:
+ *     + `metric`: One of `access.granted`, `access.denied` or `audit`.
+ *     + `dimension`: `door` or `user` for access metrics, `type` or `user`
+ *       for the `audit` metric.
+ *     + `from`: UNIX timestamp. Defaults to one week before `to`.
+ *     + `to`: UNIX timestamp (exclusive). Defaults to now.
+ *     + `resolution`: Size of the returned buckets, in seconds. Must be
+ *       a multiple of 3600. Defaults to 3600.
+ *
+ * Response:
+ *     + `resolution`: Size of the returned buckets.
+ *     + `data`: Array of `{bucket, key, count}` objects, ordered by bucket.
+ */
+class StatsGet : public MethodHandler
+{
+  public:
+    StatsGet(RequestContext ctx);
+
+    static MethodHandlerUPtr create(RequestContext);
+
+  protected:
+    std::vector<ActionActionParam>
+    required_permission(const json &req) const override;
+
+  private:
+    virtual json process_impl(const json &req) override;
+};
+}
+}
+}
@@ -0,0 +1,543 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HttpEngine.hpp"
+#include "tools/log.hpp"
+#include <algorithm>
+#include <cassert>
+#include <curl/curl.h>
+#include <stdexcept>
+
+using namespace Leosac;
+using namespace Leosac::Module::WSNotifier;
+
+namespace
+{
+/**
+ * How often the outbox is flushed to disk.
+ */
+constexpr std::chrono::seconds sync_interval(1);
+
+/**
+ * Bounds of the delay before retrying a target.
+ */
+constexpr std::chrono::seconds min_backoff(1);
+constexpr std::chrono::seconds max_backoff(60);
+
+/**
+ * Notifications are stored in the outbox as the form and the JSON
+ * encodings, separated by a NUL byte.
+ */
+std::string encode(const Notification &notification)
+{
+    return notification.form_ + '\0' + notification.json_;
+}
+
+Notification decode(const std::string &payload)
+{
+    auto pos = payload.find('\0');
+    if (pos == std::string::npos)
+        return {payload, ""};
+    return {payload.substr(0, pos), payload.substr(pos + 1)};
+}
+}
+
+/**
+ * A notification waiting to be sent.
+ */
+struct HttpEngine::Entry
+{
+    /**
+     * The notification, in the encoding the target expects.
+     */
+    std::string body_;
+    Clock::time_point queued_at_;
+    /**
+     * Sequence number in the outbox, if any.
+     */
+    uint64_t seq_;
+};
+
+/**
+ * A reusable easy handle, and the request it's currently performing.
+ */
+struct HttpEngine::Transfer
+{
+    CURL *easy_;
+    std::string body_;
+    bool busy_;
+    Target *target_;
+    /**
+     * Range of outbox sequence numbers sent by this request, and the
+     * target's generation when it started.
+     */
+    uint64_t first_;
+    uint64_t end_;
+    unsigned generation_;
+};
+
+struct HttpEngine::Target
+{
+    TargetInfo info_;
+    std::vector<std::unique_ptr<Transfer>> transfers_;
+    std::deque<Entry> queue_;
+    size_t dropped_;
+    /**
+     * Extra HTTP headers, for batching targets.
+     */
+    curl_slist *headers_;
+
+    /**
+     * Name of the target as an outbox consumer.
+     */
+    std::string consumer_;
+    /**
+     * Next outbox record to read into the queue.
+     */
+    uint64_t cursor_;
+    /**
+     * Every outbox record before this one was delivered.
+     */
+    uint64_t committed_;
+    /**
+     * Ranges of outbox records sent by the requests started since the
+     * last commit, in order, and whether they completed.
+     */
+    std::deque<std::pair<std::pair<uint64_t, uint64_t>, bool>> sent_;
+    /**
+     * Bumped when the target rewinds to its committed offset, so that
+     * the requests started before are ignored.
+     */
+    unsigned generation_;
+    std::chrono::milliseconds backoff_;
+    Clock::time_point retry_at_;
+};
+
+/**
+ * We don't care about getting the resulting page from the webservice.
+ *
+ * We use this function as a callback for CURL.
+ */
+static size_t write_callback(char * /*ptr*/, size_t size, size_t nmemb,
+                             void * /*userdata*/)
+{
+    return size * nmemb;
+}
+
+HttpEngine::HttpEngine(const std::vector<TargetInfo> &targets,
+                       Tools::OutboxPtr outbox)
+    : multi_(curl_multi_init())
+    , outbox_(outbox)
+    , unsynced_(false)
+    , last_sync_(Clock::now())
+{
+    if (!multi_)
+        throw std::runtime_error("Cannot initialize curl_multi.");
+
+    for (const auto &info : targets)
+    {
+        auto target      = std::make_unique<Target>();
+        target->info_    = info;
+        target->dropped_ = 0;
+        target->headers_ = nullptr;
+        if (info.batch_delay_ > 0)
+            target->headers_ = curl_slist_append(
+                nullptr, "Content-Type: application/json");
+        target->consumer_   = "ws-" + info.url_;
+        target->committed_  = outbox_ ? outbox_->offset(target->consumer_) : 0;
+        target->cursor_     = target->committed_;
+        target->generation_ = 0;
+        target->backoff_    = std::chrono::milliseconds(0);
+        targets_.push_back(std::move(target));
+    }
+}
+
+HttpEngine::~HttpEngine()
+{
+    for (auto &target : targets_)
+    {
+        if (!outbox_ && !target->queue_.empty())
+            WARN("Dropping " << target->queue_.size()
+                             << " pending notifications for "
+                             << target->info_.url_);
+        for (auto &transfer : target->transfers_)
+        {
+            if (transfer->busy_)
+                curl_multi_remove_handle(multi_, transfer->easy_);
+            curl_easy_cleanup(transfer->easy_);
+        }
+        curl_slist_free_all(target->headers_);
+    }
+    curl_multi_cleanup(multi_);
+}
+
+void HttpEngine::post(const Notification &notification)
+{
+    if (outbox_)
+    {
+        try
+        {
+            outbox_->append(encode(notification));
+            unsynced_ = true;
+        }
+        catch (const std::exception &e)
+        {
+            ERROR("Cannot store notification in outbox: " << e.what());
+        }
+        return;
+    }
+
+    auto now = Clock::now();
+    for (auto &target : targets_)
+    {
+        if (target->queue_.size() >= target->info_.queue_size_)
+        {
+            if (target->dropped_++ % 100 == 0)
+                WARN("Notification queue for " << target->info_.url_
+                                               << " is full. Dropped "
+                                               << target->dropped_
+                                               << " notifications so far.");
+            target->queue_.pop_front();
+        }
+        if (target->info_.batch_delay_ > 0)
+            target->queue_.push_back({notification.json_, now, 0});
+        else
+            target->queue_.push_back({notification.form_, now, 0});
+    }
+}
+
+void HttpEngine::update()
+{
+    int running;
+
+    for (auto &target : targets_)
+    {
+        fill(*target);
+        start_transfers(*target);
+    }
+    curl_multi_perform(multi_, &running);
+    process_completed();
+    // Completed transfers freed some handles.
+    for (auto &target : targets_)
+    {
+        fill(*target);
+        start_transfers(*target);
+    }
+
+    if (unsynced_ && Clock::now() - last_sync_ >= sync_interval)
+    {
+        try
+        {
+            outbox_->sync();
+        }
+        catch (const std::exception &e)
+        {
+            WARN("Failed to sync outbox: " << e.what());
+        }
+        unsynced_  = false;
+        last_sync_ = Clock::now();
+    }
+}
+
+bool HttpEngine::idle() const
+{
+    for (const auto &target : targets_)
+    {
+        if (!target->queue_.empty() || has_backlog(*target))
+            return false;
+        for (const auto &transfer : target->transfers_)
+        {
+            if (transfer->busy_)
+                return false;
+        }
+    }
+    return true;
+}
+
+long HttpEngine::poll_timeout() const
+{
+    // We don't watch curl's sockets: while requests are in flight,
+    // come back often enough to pick up their progress.
+    static constexpr long max_timeout = 10;
+    auto now     = Clock::now();
+    long timeout = -1;
+    bool busy    = false;
+    auto wake_in = [&](Clock::duration delay) {
+        long ms = std::max<long>(
+            0, std::chrono::duration_cast<std::chrono::milliseconds>(delay).count());
+        timeout = timeout < 0 ? ms : std::min(timeout, ms);
+    };
+
+    if (unsynced_)
+        wake_in(last_sync_ + sync_interval - now);
+    for (const auto &target : targets_)
+    {
+        for (const auto &transfer : target->transfers_)
+            busy |= transfer->busy_;
+        if (backing_off(*target, now))
+            wake_in(target->retry_at_ - now);
+        else if (!target->queue_.empty() || has_backlog(*target))
+            wake_in(std::chrono::milliseconds(max_timeout));
+    }
+    if (busy)
+    {
+        long curl_timeout;
+        wake_in(std::chrono::milliseconds(max_timeout));
+        if (curl_multi_timeout(multi_, &curl_timeout) == CURLM_OK &&
+            curl_timeout >= 0)
+            wake_in(std::chrono::milliseconds(curl_timeout));
+    }
+    return timeout;
+}
+
+bool HttpEngine::backing_off(const Target &target, Clock::time_point now)
+{
+    return target.backoff_.count() && now < target.retry_at_;
+}
+
+bool HttpEngine::ready(const Target &target, Clock::time_point now)
+{
+    if (target.queue_.empty() || backing_off(target, now))
+        return false;
+    if (target.info_.batch_delay_ <= 0 ||
+        target.queue_.size() >= target.info_.batch_size_)
+        return true;
+    return now - target.queue_.front().queued_at_ >=
+           std::chrono::milliseconds(target.info_.batch_delay_);
+}
+
+std::string HttpEngine::next_body(const Target &target, size_t &count,
+                                  uint64_t &end)
+{
+    end   = target.queue_.front().seq_ + 1;
+    count = 1;
+    if (target.info_.batch_delay_ <= 0)
+        return target.queue_.front().body_;
+
+    std::string body = "[";
+    count = std::min(target.info_.batch_size_, target.queue_.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            body += ",";
+        body += target.queue_[i].body_;
+        end = target.queue_[i].seq_ + 1;
+    }
+    body += "]";
+    return body;
+}
+
+bool HttpEngine::has_backlog(const Target &target) const
+{
+    return outbox_ && target.cursor_ < outbox_->end();
+}
+
+void HttpEngine::fill(Target &target)
+{
+    auto now = Clock::now();
+    std::vector<Tools::Outbox::Record> records;
+
+    if (!has_backlog(target) || backing_off(target, now) ||
+        target.queue_.size() >= target.info_.queue_size_)
+        return;
+    try
+    {
+        outbox_->read(target.cursor_,
+                      target.info_.queue_size_ - target.queue_.size(), records);
+    }
+    catch (const std::exception &e)
+    {
+        WARN("Cannot read from outbox: " << e.what());
+        return;
+    }
+    if (records.empty())
+        return;
+
+    if (records.front().seq_ > target.cursor_)
+    {
+        WARN("Notifications " << target.cursor_ << " to "
+                              << records.front().seq_ - 1 << " for "
+                              << target.info_.url_
+                              << " were removed from the outbox.");
+        if (target.sent_.empty())
+            target.committed_ = records.front().seq_;
+    }
+    for (auto &record : records)
+    {
+        auto notification = decode(record.payload_);
+        if (target.info_.batch_delay_ > 0)
+            target.queue_.push_back({notification.json_, now, record.seq_});
+        else
+            target.queue_.push_back({notification.form_, now, record.seq_});
+    }
+    target.cursor_ = records.back().seq_ + 1;
+}
+
+void HttpEngine::start_transfers(Target &target)
+{
+    auto now = Clock::now();
+    while (ready(target, now))
+    {
+        auto itr = std::find_if(
+            target.transfers_.begin(), target.transfers_.end(),
+            [](const std::unique_ptr<Transfer> &t) { return !t->busy_; });
+        Transfer *transfer;
+        if (itr != target.transfers_.end())
+            transfer = itr->get();
+        else if (target.transfers_.size() <
+                 static_cast<size_t>(target.info_.max_in_flight_))
+        {
+            auto easy = curl_easy_init();
+            if (!easy)
+            {
+                ERROR("Cannot initialize curl_easy.");
+                return;
+            }
+            const auto &info = target.info_;
+            curl_easy_setopt(easy, CURLOPT_URL, info.url_.c_str());
+            if (!info.CA_info_file_.empty())
+                curl_easy_setopt(easy, CURLOPT_CAINFO, info.CA_info_file_.c_str());
+            if (!info.verify_host_)
+                curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 0L);
+            if (!info.verify_peer_)
+                curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 0L);
+
+            // timeouts
+            curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                             static_cast<long>(info.connect_timeout_));
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS,
+                             static_cast<long>(info.request_timeout_));
+            curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, nullptr);
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &write_callback);
+            if (target.headers_)
+                curl_easy_setopt(easy, CURLOPT_HTTPHEADER, target.headers_);
+
+            target.transfers_.push_back(std::unique_ptr<Transfer>(
+                new Transfer{easy, "", false, &target, 0, 0, 0}));
+            transfer = target.transfers_.back().get();
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+        }
+        else
+            return;
+
+        size_t count;
+        transfer->first_      = target.queue_.front().seq_;
+        transfer->body_       = next_body(target, count, transfer->end_);
+        transfer->generation_ = target.generation_;
+        curl_easy_setopt(transfer->easy_, CURLOPT_POSTFIELDS,
+                         transfer->body_.c_str());
+        curl_easy_setopt(transfer->easy_, CURLOPT_POSTFIELDSIZE,
+                         static_cast<long>(transfer->body_.size()));
+        auto ret = curl_multi_add_handle(multi_, transfer->easy_);
+        if (ret != CURLM_OK)
+        {
+            // The notifications stay queued: the next perform() retries.
+            WARN("curl_multi_add_handle() failed: " << curl_multi_strerror(ret));
+            transfer->body_.clear();
+            return;
+        }
+        target.queue_.erase(target.queue_.begin(),
+                            target.queue_.begin() + count);
+        transfer->busy_ = true;
+        if (outbox_)
+            target.sent_.push_back({{transfer->first_, transfer->end_}, false});
+    }
+}
+
+void HttpEngine::process_completed()
+{
+    CURLMsg *msg;
+    int left;
+
+    while ((msg = curl_multi_info_read(multi_, &left)))
+    {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        Transfer *transfer = nullptr;
+        char *url          = nullptr;
+        long status        = 0;
+        bool success       = true;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_EFFECTIVE_URL, &url);
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+        if (msg->data.result != CURLE_OK)
+        {
+            WARN("Notification to " << (url ? url : "?") << " failed: "
+                                    << curl_easy_strerror(msg->data.result));
+            success = false;
+        }
+        else if (status >= 500)
+        {
+            WARN("Notification to " << (url ? url : "?")
+                                    << " failed: HTTP status " << status);
+            success = false;
+        }
+
+        curl_multi_remove_handle(multi_, msg->easy_handle);
+        assert(transfer);
+        transfer->busy_ = false;
+        transfer->body_.clear();
+        if (outbox_)
+            delivered(*transfer, success);
+    }
+}
+
+void HttpEngine::delivered(Transfer &transfer, bool success)
+{
+    auto &target = *transfer.target_;
+
+    // The target rewound since this request started.
+    if (transfer.generation_ != target.generation_)
+        return;
+
+    if (!success)
+    {
+        target.backoff_ = std::min<std::chrono::milliseconds>(
+            std::max<std::chrono::milliseconds>(2 * target.backoff_, min_backoff),
+            max_backoff);
+        target.retry_at_ = Clock::now() + target.backoff_;
+        target.generation_++;
+        target.sent_.clear();
+        target.queue_.clear();
+        target.cursor_ = target.committed_;
+        WARN("Will retry " << target.info_.url_ << " in "
+                           << target.backoff_.count() << "ms, starting from "
+                           << "notification " << target.committed_);
+        return;
+    }
+
+    target.backoff_ = std::chrono::milliseconds(0);
+    for (auto &sent : target.sent_)
+    {
+        if (sent.first.first == transfer.first_)
+            sent.second = true;
+    }
+    // Commit up to the first request that hasn't completed yet.
+    while (!target.sent_.empty() && target.sent_.front().second)
+    {
+        target.committed_ = target.sent_.front().first.second;
+        target.sent_.pop_front();
+    }
+    outbox_->commit(target.consumer_, target.committed_);
+    unsynced_ = true;
+}
@@ -0,0 +1,217 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "tools/Outbox.hpp"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Leosac
+{
+namespace Module
+{
+namespace WSNotifier
+{
+/**
+ * Some information for each webservice target.
+ */
+struct TargetInfo
+{
+    std::string url_;
+    int connect_timeout_;
+    int request_timeout_;
+    /**
+     * If SSL is enabled, do we perform certificate hostname validation ?
+     */
+    bool verify_host_;
+    /**
+     * If SSL is enabled, do we perform certificate validation ?
+     */
+    bool verify_peer_;
+    /**
+     * Path to a CA bundle file.
+     */
+    std::string CA_info_file_;
+    /**
+     * Maximum number of concurrent requests to this target.
+     */
+    int max_in_flight_;
+    /**
+     * Maximum number of notifications waiting to be sent to this target.
+     */
+    size_t queue_size_;
+    /**
+     * How long (in milliseconds) notifications are accumulated before
+     * being sent as a single JSON array. 0 disables batching.
+     */
+    int batch_delay_;
+    /**
+     * Maximum number of notifications per batch.
+     */
+    size_t batch_size_;
+};
+
+/**
+ * A notification, in the encodings the engine may need.
+ */
+struct Notification
+{
+    /**
+     * Url-encoded form fields, sent as is to non-batching targets.
+     */
+    std::string form_;
+    /**
+     * A JSON object, that becomes an element of the array sent to
+     * batching targets.
+     */
+    std::string json_;
+};
+
+/**
+ * Deliver HTTP POST requests to webservice targets, without blocking.
+ *
+ * The engine is driven by a curl multi handle: requests are performed
+ * concurrently, and update() only does the work that can be done
+ * without waiting. It is meant to be called from the module's main loop.
+ *
+ * Each target owns up to `max_in_flight_` easy handles. Handles are
+ * reused from one request to the next, so that curl keeps the connection
+ * (and the TLS session) alive. Requests that can't be started right
+ * away wait in a per-target queue. When the queue is full, the oldest
+ * request is dropped: one unreachable target doesn't hold the others
+ * back, and can't make the module grow without bound.
+ *
+ * Targets with a `batch_delay_` receive notifications in batches: a
+ * request is sent once `batch_size_` notifications are queued, or once
+ * the oldest one has waited `batch_delay_` milliseconds. The body is a
+ * JSON array of the notifications.
+ *
+ * When an outbox is given, notifications are appended to it instead of
+ * being queued in memory, and each target reads them back as a consumer
+ * of the outbox. A target commits its offset once a notification is
+ * delivered. When a request fails, the target backs off (exponentially,
+ * up to a minute) and then replays everything that wasn't delivered.
+ * Notifications are delivered at least once: a replay may repeat
+ * notifications whose request was in flight when another one failed.
+ */
+class HttpEngine
+{
+  public:
+    explicit HttpEngine(const std::vector<TargetInfo> &targets,
+                        Tools::OutboxPtr outbox = nullptr);
+    ~HttpEngine();
+
+    HttpEngine(const HttpEngine &) = delete;
+    HttpEngine(HttpEngine &&)      = delete;
+    HttpEngine &operator=(const HttpEngine &) = delete;
+    HttpEngine &operator=(HttpEngine &&) = delete;
+
+    /**
+     * Queue a notification for every target.
+     */
+    void post(const Notification &notification);
+
+    /**
+     * Start queued requests and make progress on in-flight ones.
+     */
+    void update();
+
+    /**
+     * Returns true if no request is queued, in-flight or waiting
+     * in the outbox.
+     */
+    bool idle() const;
+
+    /**
+     * How long (in milliseconds) the caller may wait before calling
+     * update() again. Returns -1 when the engine is idle.
+     */
+    long poll_timeout() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct Entry;
+    struct Transfer;
+    struct Target;
+
+    /**
+     * Returns true if `target` is waiting before retrying.
+     */
+    static bool backing_off(const Target &target, Clock::time_point now);
+
+    /**
+     * Returns true if `target` should send a request now.
+     */
+    static bool ready(const Target &target, Clock::time_point now);
+
+    /**
+     * Build the body of the next request from the front of `target`'s
+     * queue.
+     *
+     * `count` is set to the number of notifications in the request, which
+     * the caller pops once the request started. `end` is set to the outbox
+     * sequence number following the last notification of the request.
+     */
+    static std::string next_body(const Target &target, size_t &count,
+                                 uint64_t &end);
+
+    /**
+     * Returns true if the outbox has notifications `target` didn't
+     * read yet.
+     */
+    bool has_backlog(const Target &target) const;
+
+    /**
+     * Read notifications from the outbox into `target`'s queue.
+     */
+    void fill(Target &target);
+
+    /**
+     * Start as many queued requests as `target` allows.
+     */
+    void start_transfers(Target &target);
+
+    /**
+     * Process the transfers curl reports as complete.
+     */
+    void process_completed();
+
+    /**
+     * Record the outcome of a request performed by an outbox consumer.
+     */
+    void delivered(Transfer &transfer, bool success);
+
+    void *multi_;
+    std::vector<std::unique_ptr<Target>> targets_;
+
+    Tools::OutboxPtr outbox_;
+    /**
+     * Whether the outbox changed since it was last synced.
+     */
+    bool unsynced_;
+    Clock::time_point last_sync_;
+};
+}
+}
+}
@@ -20,7 +20,13 @@
 #include "WebServiceNotifier.hpp"
 #include "core/auth/Auth.hpp"
 #include "core/credentials/RFIDCard.hpp"
+#include "exception/configexception.hpp"
+#include <chrono>
+#include <ctime>
 #include <curl/curl.h>
+#include <iomanip>
+#include <json.hpp>
+#include <sstream>
 
 using namespace Leosac;
 using namespace Leosac::Module;
@@ -44,14 +50,27 @@ WebServiceNotifier::WebServiceNotifier(zmqpp::context &ctx, zmqpp::socket *pipe,
     }
     bus_sub_.connect("inproc://zmq-bus-pub");
     process_config();
+    engine_ = std::make_unique<HttpEngine>(targets_, outbox_);
     reactor_.add(bus_sub_, std::bind(&WebServiceNotifier::handle_msg_bus, this));
 }
 
 WebServiceNotifier::~WebServiceNotifier()
 {
+    // The engine's handles must go before curl's global state.
+    engine_ = nullptr;
+    outbox_ = nullptr;
     curl_global_cleanup();
 }
 
+void WebServiceNotifier::run()
+{
+    while (is_running_)
+    {
+        reactor_.poll(engine_->poll_timeout());
+        engine_->update();
+    }
+}
+
 void WebServiceNotifier::handle_msg_bus()
 {
     zmqpp::message msg;
@@ -93,6 +112,15 @@ void WebServiceNotifier::process_config()
         target.verify_host_     = itr.second.get<bool>("verify_host", true);
         target.verify_peer_     = itr.second.get<bool>("verify_peer", true);
         target.CA_info_file_    = itr.second.get<std::string>("ca_file", "");
+        target.max_in_flight_   = itr.second.get<int>("max_in_flight", 4);
+        target.queue_size_      = itr.second.get<size_t>("queue_size", 256);
+        target.batch_delay_     = itr.second.get<int>("batch_delay", 0);
+        target.batch_size_      = itr.second.get<size_t>("batch_size", 50);
+        if (target.max_in_flight_ < 1 || target.queue_size_ < 1 ||
+            target.batch_size_ < 1)
+            throw ConfigException(
+                "main",
+                "max_in_flight, queue_size and batch_size must be positive.");
 
         INFO("WS-Notifier remote target: "
              << Colorize::green(target.url_)
@@ -100,9 +128,32 @@ void WebServiceNotifier::process_config()
              << ", request_timeout: " << Colorize::green(target.request_timeout_)
              << ", verify_host: " << Colorize::green(target.verify_host_)
              << ", verify_peer: " << Colorize::green(target.verify_peer_)
-             << ", ca_info: " << Colorize::green(target.CA_info_file_) << ")");
+             << ", ca_info: " << Colorize::green(target.CA_info_file_)
+             << ", max_in_flight: " << Colorize::green(target.max_in_flight_)
+             << ", queue_size: " << Colorize::green(target.queue_size_)
+             << ", batch_delay: " << Colorize::green(target.batch_delay_)
+             << ", batch_size: " << Colorize::green(target.batch_size_) << ")");
         targets_.push_back(std::move(target));
     }
+
+    if (auto outbox_cfg = config_.get_child_optional("module_config.outbox"))
+    {
+        auto directory = outbox_cfg->get<std::string>("directory");
+        Tools::Outbox::Options options;
+        options.max_size_ = outbox_cfg->get<size_t>("max_size", 16 * 1024 * 1024);
+        options.max_age_ =
+            std::chrono::seconds(outbox_cfg->get<long>("max_age", 7 * 24 * 3600));
+        options.segment_size_ = outbox_cfg->get<size_t>("segment_size", 1024 * 1024);
+        if (options.max_size_ < 1 || options.max_age_.count() < 1)
+            throw ConfigException("main", "Outbox limits must be positive.");
+
+        INFO("WS-Notifier outbox: " << Colorize::green(directory) << " (max_size: "
+                                    << Colorize::green(options.max_size_)
+                                    << ", max_age: "
+                                    << Colorize::green(options.max_age_.count())
+                                    << ")");
+        outbox_ = std::make_shared<Tools::Outbox>(directory, options);
+    }
 }
 
 void WebServiceNotifier::send_card_info_to_remote(const std::string &auth_source,
@@ -113,61 +164,24 @@ void WebServiceNotifier::send_card_info_to_remote(const std::string &auth_source
     card.card_id(card_hex);
     card.nb_bits(nb_bits);
 
-    for (const auto &target : targets_)
-    {
-        auto curl = curl_easy_init();
-        if (curl)
-        {
-            if (!target.CA_info_file_.empty())
-                curl_easy_setopt(curl, CURLOPT_CAINFO, target.CA_info_file_.c_str());
-            if (!target.verify_host_)
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-            if (!target.verify_peer_)
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            send_to_target(curl, auth_source, card, target);
-            curl_easy_cleanup(curl);
-        }
-        else
-        {
-            ERROR("Cannot initialize curl_easy.");
-        }
-    }
-}
-
-/**
- * We don't care about getting the resulting page from the webservice.
- *
- * We use this function as a callback for CURL.
- */
-static size_t write_callback(char * /*ptr*/, size_t size, size_t nmemb,
-                             void * /*userdata*/)
-{
-    return size * nmemb;
-}
-
-void WebServiceNotifier::send_to_target(
-    void *curl, const std::string &auth_source, const Cred::RFIDCard &card,
-    const WebServiceNotifier::TargetInfo &target) noexcept
-{
-    assert(curl);
-
-    std::string post_fields =
-        fmt::format("card_id={}&auth_source={}&card_id_raw={}", card.to_int(),
-                    auth_source, card.to_raw_int());
-
-    curl_easy_setopt(curl, CURLOPT_URL, target.url_.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_fields.c_str());
-
-    // timeouts
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, target.connect_timeout_);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, target.request_timeout_);
-
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &write_callback);
-
-    auto res = curl_easy_perform(curl);
-    if (res != CURLE_OK)
-    {
-        WARN("curl_easy_perform() failed: " << curl_easy_strerror(res));
-    }
+    // Timestamp the event now: batching may delay its delivery.
+    using namespace std::chrono;
+    auto now      = system_clock::now();
+    auto now_time = system_clock::to_time_t(now);
+    auto ms = duration_cast<milliseconds>(now.time_since_epoch()).count() % 1000;
+    std::tm tm;
+    gmtime_r(&now_time, &tm);
+    std::ostringstream timestamp;
+    timestamp << std::put_time(&tm, "%FT%T") << '.' << std::setfill('0')
+              << std::setw(3) << ms << 'Z';
+
+    Notification notification;
+    notification.form_ = fmt::format("card_id={}&auth_source={}&card_id_raw={}",
+                                     card.to_int(), auth_source, card.to_raw_int());
+    notification.json_ = nlohmann::json{{"card_id", card.to_int()},
+                                        {"card_id_raw", card.to_raw_int()},
+                                        {"auth_source", auth_source},
+                                        {"timestamp", timestamp.str()}}
+                             .dump();
+    engine_->post(notification);
 }
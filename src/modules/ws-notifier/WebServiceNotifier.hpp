@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "HttpEngine.hpp"
 #include "core/auth/AuthFwd.hpp"
 #include "modules/BaseModule.hpp"
 #include <core/credentials/RFIDCard.hpp>
@@ -37,6 +38,12 @@ class WebServiceNotifier : public BaseModule
 
     ~WebServiceNotifier();
 
+    /**
+     * Main loop: poll the reactor, and let the HTTP engine
+     * make progress between events.
+     */
+    virtual void run() override;
+
   private:
     /**
      * Process a message that was read on the bus.
@@ -49,8 +56,8 @@ class WebServiceNotifier : public BaseModule
     void process_config();
 
     /**
-     * Send an HTTP request to the remote webservice
-     * to let it know a card was read.
+     * Queue an HTTP request to the remote webservices
+     * to let them know a card was read.
      */
     void send_card_info_to_remote(const std::string &auth_source,
                                   const std::string &card, int nb_bits);
@@ -61,33 +68,17 @@ class WebServiceNotifier : public BaseModule
      */
     zmqpp::socket bus_sub_;
 
+    std::vector<TargetInfo> targets_;
+
     /**
-     * Some information for each webservice target.
+     * Persistent queue of notifications, if configured.
      */
-    struct TargetInfo
-    {
-        std::string url_;
-        int connect_timeout_;
-        int request_timeout_;
-        /**
-         * If SSL is enabled, do we perform certificate hostname validation ?
-         */
-        bool verify_host_;
-        /**
-         * If SSL is enabled, do we perform certificate validation ?
-         */
-        bool verify_peer_;
-        /**
-         * Path to a CA bundle file.
-         */
-        std::string CA_info_file_;
-    };
+    Tools::OutboxPtr outbox_;
 
-    std::vector<TargetInfo> targets_;
-
-    void send_to_target(void *curl, const std::string &auth_source,
-                        const Cred::RFIDCard &card,
-                        const TargetInfo &target) noexcept;
+    /**
+     * Performs the requests. Created once the configuration is processed.
+     */
+    std::unique_ptr<HttpEngine> engine_;
 };
 }
 }
@@ -0,0 +1,67 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tools/Compression.hpp"
+#include "exception/leosacexception.hpp"
+#include <array>
+#include <zlib.h>
+
+std::string Leosac::Tools::zlib_compress(const std::string &data)
+{
+    uLongf compressed_size = compressBound(data.size());
+    std::string compressed(compressed_size, '\0');
+
+    if (compress2(reinterpret_cast<Bytef *>(&compressed[0]), &compressed_size,
+                  reinterpret_cast<const Bytef *>(data.data()), data.size(),
+                  Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw LEOSACException("Failed to compress data.");
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+std::string Leosac::Tools::zlib_decompress(const std::string &data)
+{
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK)
+        throw LEOSACException("Failed to initialize zlib stream.");
+
+    stream.next_in  = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.size();
+
+    std::string out;
+    std::array<char, 16384> buffer;
+    int ret;
+    do
+    {
+        stream.next_out  = reinterpret_cast<Bytef *>(buffer.data());
+        stream.avail_out = buffer.size();
+        ret              = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+        {
+            inflateEnd(&stream);
+            throw LEOSACException("Failed to decompress data: invalid zlib stream.");
+        }
+        out.append(buffer.data(), buffer.size() - stream.avail_out);
+    } while (ret != Z_STREAM_END && (stream.avail_in || !stream.avail_out));
+    inflateEnd(&stream);
+
+    if (ret != Z_STREAM_END)
+        throw LEOSACException("Failed to decompress data: truncated zlib stream.");
+    return out;
+}
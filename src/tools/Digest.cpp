@@ -0,0 +1,39 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tools/Digest.hpp"
+#include "exception/leosacexception.hpp"
+#include <iomanip>
+#include <openssl/evp.h>
+#include <sstream>
+
+std::string Leosac::Tools::sha256_hex(const std::string &data)
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int md_len = 0;
+
+    if (!EVP_Digest(data.data(), data.size(), md, &md_len, EVP_sha256(), nullptr))
+        throw LEOSACException("Failed to compute SHA-256 digest.");
+
+    std::ostringstream oss;
+    oss << std::hex << std::setfill('0');
+    for (unsigned int i = 0; i < md_len; ++i)
+        oss << std::setw(2) << static_cast<int>(md[i]);
+    return oss.str();
+}
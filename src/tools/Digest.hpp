@@ -0,0 +1,37 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace Leosac
+{
+namespace Tools
+{
+/**
+ * Compute the SHA-256 digest of `data` and return it as
+ * a lowercase hexadecimal string.
+ *
+ * This is used to detect content changes, and is stable across
+ * platforms and Leosac versions.
+ */
+std::string sha256_hex(const std::string &data);
+}
+}
@@ -0,0 +1,483 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tools/Outbox.hpp"
+#include "tools/log.hpp"
+#include "tools/unixfs.hpp"
+#include "tools/unixsyscall.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Leosac;
+using namespace Leosac::Tools;
+
+namespace
+{
+/**
+ * A record is a header followed by the payload.
+ * The header holds the size of the payload and its checksum, in host
+ * byte order.
+ */
+constexpr size_t header_size = 2 * sizeof(uint32_t);
+
+uint32_t checksum(const char *data, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void pread_all(int fd, char *data, size_t size, off_t pos)
+{
+    while (size)
+    {
+        auto ret = ::pread(fd, data, size, pos);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+            throw FsException(UnixSyscall::getErrorString("pread", errno));
+        if (ret == 0)
+            throw FsException("unexpected end of outbox segment");
+        data += ret;
+        size -= ret;
+        pos += ret;
+    }
+}
+
+void sync_directory(const std::string &directory)
+{
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        throw FsException(UnixSyscall::getErrorString("open", errno) + ": " +
+                          directory);
+    auto ret = ::fsync(fd);
+    ::close(fd);
+    if (ret == -1)
+        throw FsException(UnixSyscall::getErrorString("fsync", errno));
+}
+
+/**
+ * Build a file name from a consumer name.
+ *
+ * When characters have to be replaced, a hash of the original name is
+ * appended so that different consumers keep different files. The hash
+ * (FNV-1a) must not change across builds.
+ */
+std::string sanitize(const std::string &consumer)
+{
+    std::string name = consumer;
+    std::replace_if(name.begin(), name.end(),
+                    [](char c) {
+                        return !std::isalnum(static_cast<unsigned char>(c)) &&
+                               c != '-' && c != '.';
+                    },
+                    '_');
+    if (name == consumer)
+        return name;
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : consumer)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream oss;
+    oss << name << '-' << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return oss.str();
+}
+}
+
+Outbox::Outbox(const std::string &directory, const Options &options)
+    : directory_(directory)
+    , options_(options)
+    , end_(0)
+    , total_size_(0)
+    , fd_(-1)
+    , unsynced_(false)
+{
+    // Leave room for at least one closed segment.
+    options_.segment_size_ = std::max<size_t>(
+        1, std::min(options_.segment_size_, options_.max_size_ / 2));
+    if (::mkdir(directory_.c_str(), 0750) == -1 && errno != EEXIST)
+        throw FsException(UnixSyscall::getErrorString("mkdir", errno) + ": " +
+                          directory_);
+    load();
+}
+
+Outbox::~Outbox()
+{
+    try
+    {
+        sync();
+    }
+    catch (const std::exception &e)
+    {
+        ERROR("Failed to sync outbox " << directory_ << ": " << e.what());
+    }
+    if (fd_ != -1)
+        ::close(fd_);
+}
+
+void Outbox::load()
+{
+    for (const auto &path : UnixFs::listFiles(directory_, ".offset"))
+    {
+        auto name = UnixFs::stripPath(path);
+        name.resize(name.size() - std::strlen(".offset"));
+        try
+        {
+            consumers_[name] = {std::stoull(UnixFs::readAll(path)), false};
+        }
+        catch (const std::logic_error &)
+        {
+            WARN("Ignoring invalid outbox offset file " << path);
+        }
+    }
+
+    for (const auto &path : UnixFs::listFiles(directory_, ".seg"))
+    {
+        struct stat st;
+        uint64_t first;
+        try
+        {
+            first = std::stoull(UnixFs::stripPath(path));
+        }
+        catch (const std::logic_error &)
+        {
+            WARN("Ignoring unexpected file " << path << " in outbox.");
+            continue;
+        }
+        if (::stat(path.c_str(), &st) == -1)
+            throw FsException(UnixSyscall::getErrorString("stat", errno) + ": " +
+                              path);
+        auto mtime = Clock::from_time_t(st.st_mtime);
+        segments_[first] = {path, 0, static_cast<size_t>(st.st_size), mtime, mtime,
+                            {}};
+        total_size_ += st.st_size;
+    }
+
+    // Only the last segment may have been interrupted while being written.
+    for (auto itr = segments_.begin(); itr != segments_.end(); ++itr)
+    {
+        auto next = std::next(itr);
+        if (next != segments_.end())
+            itr->second.count_ = next->first - itr->first;
+        else
+            recover(itr->second);
+    }
+    if (!segments_.empty())
+    {
+        auto last = std::prev(segments_.end());
+        end_      = last->first + last->second.count_;
+        if (!last->second.count_)
+        {
+            ::unlink(last->second.path_.c_str());
+            total_size_ -= last->second.size_;
+            segments_.erase(last);
+        }
+    }
+    // If every segment is gone, don't reuse the sequence numbers
+    // the consumers already went through.
+    for (const auto &consumer : consumers_)
+        end_ = std::max(end_, consumer.second.offset_);
+}
+
+void Outbox::recover(Segment &segment)
+{
+    auto data  = UnixFs::readAll(segment.path_);
+    size_t pos = 0;
+
+    segment.count_ = 0;
+    while (pos + header_size <= data.size())
+    {
+        uint32_t size;
+        uint32_t sum;
+        std::memcpy(&size, &data[pos], sizeof(size));
+        std::memcpy(&sum, &data[pos + sizeof(size)], sizeof(sum));
+        if (size > data.size() - pos - header_size ||
+            checksum(&data[pos + header_size], size) != sum)
+            break;
+        pos += header_size + size;
+        segment.count_++;
+    }
+    if (pos != data.size())
+    {
+        WARN("Discarding " << data.size() - pos << " trailing bytes from "
+                           << segment.path_);
+        if (::truncate(segment.path_.c_str(), pos) == -1)
+            throw FsException(UnixSyscall::getErrorString("truncate", errno) +
+                              ": " + segment.path_);
+        total_size_ -= data.size() - pos;
+        segment.size_ = pos;
+    }
+}
+
+void Outbox::open_segment()
+{
+    std::ostringstream name;
+    name << directory_ << '/' << std::setw(20) << std::setfill('0') << end_
+         << ".seg";
+
+    fd_ = ::open(name.str().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                 0640);
+    if (fd_ == -1)
+        throw FsException(UnixSyscall::getErrorString("open", errno) + ": " +
+                          name.str());
+    auto now        = Clock::now();
+    segments_[end_] = {name.str(), 0, 0, now, now, {}};
+    // Make the new file itself durable.
+    sync_directory(directory_);
+}
+
+void Outbox::close_segment()
+{
+    if (unsynced_ && ::fdatasync(fd_) == -1)
+        WARN(UnixSyscall::getErrorString("fdatasync", errno));
+    ::close(fd_);
+    fd_       = -1;
+    unsynced_ = false;
+}
+
+uint64_t Outbox::append(const std::string &payload)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (fd_ != -1 &&
+        segments_.rbegin()->second.size_ >= options_.segment_size_)
+        close_segment();
+    if (fd_ == -1)
+    {
+        open_segment();
+        enforce_retention();
+    }
+
+    auto &segment = segments_.rbegin()->second;
+    uint32_t size = payload.size();
+    uint32_t sum  = checksum(payload.data(), payload.size());
+    std::string record(header_size, '\0');
+    std::memcpy(&record[0], &size, sizeof(size));
+    std::memcpy(&record[sizeof(size)], &sum, sizeof(sum));
+    record += payload;
+
+    const char *data = record.data();
+    size_t left      = record.size();
+    while (left)
+    {
+        auto ret = ::write(fd_, data, left);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+        {
+            auto err = errno;
+            // Don't leave half a record behind.
+            if (::ftruncate(fd_, segment.size_) == -1)
+                WARN(UnixSyscall::getErrorString("ftruncate", errno));
+            throw FsException(UnixSyscall::getErrorString("write", err) + ": " +
+                              segment.path_);
+        }
+        data += ret;
+        left -= ret;
+    }
+
+    segment.size_ += record.size();
+    segment.count_++;
+    segment.modified_ = Clock::now();
+    total_size_ += record.size();
+    unsynced_ = true;
+    return end_++;
+}
+
+size_t Outbox::read(uint64_t from, size_t max, std::vector<Record> &out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+
+    if (segments_.empty())
+        return 0;
+    from     = std::max(from, segments_.begin()->first);
+    auto itr = segments_.upper_bound(from);
+    if (itr == segments_.begin())
+        return 0;
+    for (--itr; itr != segments_.end() && count < max; ++itr)
+    {
+        auto &segment = itr->second;
+        if (from >= itr->first + segment.count_)
+            continue;
+
+        int fd = ::open(segment.path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            throw FsException(UnixSyscall::getErrorString("open", errno) + ": " +
+                              segment.path_);
+        uint64_t seq = itr->first;
+        off_t pos    = 0;
+        auto hint    = segment.hints_.upper_bound(from);
+        if (hint != segment.hints_.begin())
+        {
+            --hint;
+            seq = hint->first;
+            pos = hint->second;
+        }
+        try
+        {
+            while (static_cast<size_t>(pos) < segment.size_ && count < max)
+            {
+                uint32_t size;
+                pread_all(fd, reinterpret_cast<char *>(&size), sizeof(size), pos);
+                if (seq >= from)
+                {
+                    Record record{seq, std::string(size, '\0')};
+                    if (size)
+                        pread_all(fd, &record.payload_[0], size, pos + header_size);
+                    out.push_back(std::move(record));
+                    ++count;
+                }
+                pos += header_size + size;
+                ++seq;
+            }
+        }
+        catch (const FsException &)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+
+        // Consumers read forward: remember where the next read starts,
+        // and forget the oldest positions.
+        segment.hints_[seq] = pos;
+        if (segment.hints_.size() > 16)
+            segment.hints_.erase(segment.hints_.begin());
+        from = seq;
+    }
+    return count;
+}
+
+uint64_t Outbox::offset(const std::string &consumer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto name = sanitize(consumer);
+    auto itr  = consumers_.find(name);
+
+    if (itr != consumers_.end())
+        return itr->second.offset_;
+    UnixFs::writeAtomically(consumer_path(name), std::to_string(end_));
+    consumers_[name] = {end_, false};
+    return end_;
+}
+
+void Outbox::commit(const std::string &consumer, uint64_t offset)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &c = consumers_[sanitize(consumer)];
+
+    if (c.offset_ != offset)
+    {
+        c.offset_ = offset;
+        c.dirty_  = true;
+    }
+}
+
+uint64_t Outbox::end() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return end_;
+}
+
+void Outbox::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (fd_ != -1 && unsynced_)
+    {
+        if (::fdatasync(fd_) == -1)
+            throw FsException(UnixSyscall::getErrorString("fdatasync", errno));
+        unsynced_ = false;
+    }
+    for (auto &consumer : consumers_)
+    {
+        if (!consumer.second.dirty_)
+            continue;
+        UnixFs::writeAtomically(consumer_path(consumer.first),
+                                std::to_string(consumer.second.offset_));
+        consumer.second.dirty_ = false;
+    }
+
+    // Records in the current segment can only expire once it's closed.
+    if (fd_ != -1)
+    {
+        const auto &current = segments_.rbegin()->second;
+        if (current.count_ &&
+            Clock::now() - current.created_ >= options_.max_age_ / 4)
+            close_segment();
+    }
+    enforce_retention();
+}
+
+void Outbox::enforce_retention()
+{
+    auto now            = Clock::now();
+    uint64_t min_offset = std::numeric_limits<uint64_t>::max();
+
+    for (const auto &consumer : consumers_)
+        min_offset = std::min(min_offset, consumer.second.offset_);
+    while (!segments_.empty())
+    {
+        auto itr = segments_.begin();
+        if (fd_ != -1 && std::next(itr) == segments_.end())
+            break;
+
+        const auto &segment = itr->second;
+        uint64_t last       = itr->first + segment.count_;
+        bool consumed       = !consumers_.empty() && last <= min_offset;
+        bool expired        = now - segment.modified_ > options_.max_age_;
+        if (!consumed && !expired && total_size_ <= options_.max_size_)
+            break;
+
+        auto lost = last - std::max(itr->first, std::min(min_offset, last));
+        if (!consumed && lost)
+        {
+            WARN("Outbox " << directory_ << ": dropping " << lost
+                           << " undelivered records ("
+                           << (expired ? "too old" : "outbox full") << ").");
+        }
+        if (::unlink(segment.path_.c_str()) == -1)
+            WARN(UnixSyscall::getErrorString("unlink", errno) << ": "
+                                                              << segment.path_);
+        total_size_ -= segment.size_;
+        segments_.erase(itr);
+    }
+}
+
+std::string Outbox::consumer_path(const std::string &consumer) const
+{
+    return directory_ + "/" + consumer + ".offset";
+}
@@ -0,0 +1,209 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace Leosac
+{
+namespace Tools
+{
+class Outbox;
+using OutboxPtr = std::shared_ptr<Outbox>;
+
+/**
+ * A persistent, append-only queue of opaque records.
+ *
+ * Records are appended to segment files in a directory. Each record
+ * is identified by a sequence number, which grows forever. Consumers
+ * are identified by name and own an offset: the sequence number of the
+ * first record they haven't processed yet. Reading doesn't consume
+ * anything: a consumer that fails to deliver a record reads it again
+ * later, and only commits its offset once it's done.
+ *
+ * append() writes to the page cache and never waits for the disk.
+ * sync() makes the appended records and the committed offsets durable,
+ * and enforces the retention limits. The owner is expected to call it
+ * periodically.
+ *
+ * The outbox is bounded. Closed segments are removed once every consumer
+ * is done with them, once they're older than `max_age_`, or (oldest
+ * first) when the outbox grows past `max_size_`. Consumers that lagged
+ * behind silently skip the records lost this way: read() starts at the
+ * first record still available.
+ *
+ * This class is thread safe.
+ */
+class Outbox
+{
+  public:
+    struct Options
+    {
+        /**
+         * Maximum size of the closed segments, in bytes. The current
+         * segment comes on top of that.
+         */
+        size_t max_size_;
+        /**
+         * Maximum age of a record.
+         */
+        std::chrono::seconds max_age_;
+        /**
+         * A new segment is started once the current one reaches this size.
+         */
+        size_t segment_size_;
+    };
+
+    struct Record
+    {
+        uint64_t seq_;
+        std::string payload_;
+    };
+
+    /**
+     * Open (or create) the outbox stored in `directory`.
+     *
+     * A record that was being written when the previous owner crashed
+     * is discarded.
+     */
+    Outbox(const std::string &directory, const Options &options);
+
+    /**
+     * Sync the outbox before closing it.
+     */
+    ~Outbox();
+
+    Outbox(const Outbox &) = delete;
+    Outbox &operator=(const Outbox &) = delete;
+
+    /**
+     * Append a record and return its sequence number.
+     */
+    uint64_t append(const std::string &payload);
+
+    /**
+     * Read up to `max` records, starting at sequence number `from`,
+     * into `out`.
+     *
+     * If the record `from` is no longer available, reading starts at the
+     * first available record. Returns the number of records read.
+     */
+    size_t read(uint64_t from, size_t max, std::vector<Record> &out);
+
+    /**
+     * Returns the committed offset of `consumer`.
+     *
+     * A consumer that's unknown to the outbox is registered, and starts
+     * at the end of the outbox: it only sees records appended later.
+     * The name is used to build a file name.
+     */
+    uint64_t offset(const std::string &consumer);
+
+    /**
+     * Set the offset of `consumer`: all the records before `offset`
+     * have been processed.
+     */
+    void commit(const std::string &consumer, uint64_t offset);
+
+    /**
+     * The sequence number the next appended record will have.
+     */
+    uint64_t end() const;
+
+    /**
+     * Flush the current segment and the committed offsets to disk,
+     * then enforce the retention limits.
+     */
+    void sync();
+
+  private:
+    using Clock = std::chrono::system_clock;
+
+    struct Segment
+    {
+        std::string path_;
+        uint64_t count_;
+        size_t size_;
+        Clock::time_point created_;
+        Clock::time_point modified_;
+        /**
+         * File position of some records, to avoid scanning the
+         * segment from the start on each read.
+         */
+        std::map<uint64_t, off_t> hints_;
+    };
+
+    struct Consumer
+    {
+        uint64_t offset_;
+        bool dirty_;
+    };
+
+    /**
+     * Open the segment files found in the directory, and load
+     * the consumers' offsets.
+     */
+    void load();
+
+    /**
+     * Count the valid records of a segment, truncating it
+     * after the last one.
+     */
+    void recover(Segment &segment);
+
+    /**
+     * Start a new segment, that becomes the current one.
+     */
+    void open_segment();
+
+    /**
+     * Stop appending to the current segment.
+     */
+    void close_segment();
+
+    void enforce_retention();
+
+    std::string consumer_path(const std::string &consumer) const;
+
+    mutable std::mutex mutex_;
+    std::string directory_;
+    Options options_;
+    /**
+     * Segments, indexed by the sequence number of their first record.
+     */
+    std::map<uint64_t, Segment> segments_;
+    std::map<std::string, Consumer> consumers_;
+    uint64_t end_;
+    size_t total_size_;
+    /**
+     * The current segment, or -1 if none.
+     */
+    int fd_;
+    bool unsynced_;
+};
+}
+}
@@ -19,6 +19,7 @@
 
 #include "tools/Schedule.hpp"
 #include "AssertCast.hpp"
+#include "core/auth/ChangeLog.hpp"
 #include "exception/ModelException.hpp"
 #include "tools/log.hpp"
 
@@ -124,3 +125,12 @@ void ScheduleValidator::validate_name(const std::string &name)
         }
     }
 }
+
+void Schedule::odb_callback(odb::callback_event e, odb::database &db) const
+{
+    if (e == odb::callback_event::post_persist ||
+        e == odb::callback_event::post_update)
+        Auth::ChangeLog::record(db, *this, false);
+    else if (e == odb::callback_event::post_erase)
+        Auth::ChangeLog::record(db, *this, true);
+}
@@ -26,6 +26,7 @@
 #include "tools/ToolsFwd.hpp"
 #include "tools/db/database.hpp"
 #include <chrono>
+#include <odb/callback.hxx>
 #include <string>
 #include <vector>
 
@@ -37,7 +38,7 @@ namespace Tools
 * A schedule is simply a list of time frame (SingleTimeFrame) with
 * a name.
 */
-#pragma db object optimistic
+#pragma db object callback(odb_callback) optimistic
 class Schedule : public virtual ISchedule
 {
   public:
@@ -76,6 +77,11 @@ class Schedule : public virtual ISchedule
     friend class odb::access;
     friend class ::Leosac::TestAccess;
 
+    /**
+     * Record changes in the ChangeLog.
+     */
+    void odb_callback(odb::callback_event e, odb::database &) const;
+
 #pragma db id auto
     ScheduleId id_;
 
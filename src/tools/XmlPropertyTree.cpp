@@ -20,6 +20,7 @@
 #include "XmlPropertyTree.hpp"
 #include "exception/configexception.hpp"
 #include "log.hpp"
+#include "unixfs.hpp"
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/property_tree/ptree_serialization.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -58,10 +59,7 @@ Leosac::Tools::propertyTreeFromXmlFile(const std::string &path)
 void Leosac::Tools::propertyTreeToXmlFile(const boost::property_tree::ptree &tree,
                                           const std::string &path)
 {
-    std::string filename(path);
-    std::ofstream cfg_stream(filename);
-
-    cfg_stream << propertyTreeToXml(tree);
+    UnixFs::writeAtomically(path, propertyTreeToXml(tree));
 }
 
 std::string Leosac::Tools::propertyTreeToXml(const boost::property_tree::ptree &tree)
@@ -32,7 +32,7 @@ namespace Tools
 boost::property_tree::ptree propertyTreeFromXmlFile(const std::string &path);
 
 /**
-* Write a property tree to an xml file.
+* Write a property tree to an xml file. The file is replaced atomically.
 */
 void propertyTreeToXmlFile(const boost::property_tree::ptree &tree,
                            const std::string &path);
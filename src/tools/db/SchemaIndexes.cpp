@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tools/db/SchemaIndexes.hpp"
+#include "tools/log.hpp"
+#include <spdlog/fmt/fmt.h>
+
+namespace Leosac
+{
+namespace db
+{
+
+namespace
+{
+struct IndexDescriptor
+{
+    const char *name;
+    const char *table;
+    const char *columns;
+};
+
+/**
+ * Secondary indexes required by hot lookups.
+ *
+ * Names must match the one used in the `#pragma db index`
+ * declarations, if any.
+ */
+const IndexDescriptor core_indexes[] = {
+    // AuditGet filters by event type and pages by id.
+    {"AuditEntry_typeid_id_i", "AuditEntry", "\"typeid\", \"id\""},
+    {"AuditEntry_timestamp_i", "AuditEntry", "\"timestamp\""},
+    {"Credential_alias_i", "Credential", "\"alias\""},
+    {"Credential_owner_i", "Credential", "\"owner\""},
+    {"RFIDCard_card_id_i", "RFIDCard", "\"card_id\""},
+    {"Token_owner_i", "Token", "\"owner\""}};
+
+std::string create_index_sqlite(const IndexDescriptor &idx)
+{
+    return fmt::format("CREATE INDEX IF NOT EXISTS \"{}\" ON \"{}\" ({})",
+                       idx.name, idx.table, idx.columns);
+}
+
+/**
+ * PostgreSQL only supports "CREATE INDEX IF NOT EXISTS" starting
+ * with version 9.5, so we check the catalog ourselves.
+ */
+std::string create_index_pgsql(const IndexDescriptor &idx)
+{
+    return fmt::format("DO $$ BEGIN IF NOT EXISTS (SELECT 1 FROM pg_class WHERE "
+                       "relname = '{0}' AND relkind = 'i') THEN "
+                       "CREATE INDEX \"{0}\" ON \"{1}\" ({2}); END IF; END $$",
+                       idx.name, idx.table, idx.columns);
+}
+}
+
+void ensure_core_indexes(odb::database &db)
+{
+    for (const auto &idx : core_indexes)
+    {
+        if (db.id() == odb::database_id::id_sqlite)
+            db.execute(create_index_sqlite(idx));
+        else if (db.id() == odb::database_id::id_pgsql)
+            db.execute(create_index_pgsql(idx));
+        else
+        {
+            WARN("Unsupported database type. Cannot create index " << idx.name);
+            return;
+        }
+    }
+}
+}
+}
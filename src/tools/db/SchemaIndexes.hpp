@@ -0,0 +1,44 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <odb/database.hxx>
+
+namespace Leosac
+{
+namespace db
+{
+
+/**
+ * Create the secondary indexes of the "core" schema that are
+ * missing from the database.
+ *
+ * Most of those indexes are declared through `#pragma db index`
+ * and are therefore part of a freshly created schema. However, databases
+ * created by a previous version of Leosac lack them, and some
+ * columns (such as the `typeid` discriminator of polymorphic
+ * hierarchies) cannot be indexed through ODB pragmas.
+ *
+ * This function is idempotent and must be called from within
+ * a transaction.
+ */
+void ensure_core_indexes(odb::database &db);
+}
+}
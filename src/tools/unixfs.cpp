@@ -27,11 +27,17 @@
 
 extern "C" {
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <unistd.h>
 }
 
 #include <algorithm>
 #include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
 
 #include "unixsyscall.hpp"
 
@@ -117,3 +123,139 @@ bool UnixFs::fileExists(const std::string &path)
     else
         return (true);
 }
+
+namespace
+{
+/**
+ * Replace the file at `path` with a temporary file, filled by `fill`.
+ *
+ * The temporary file is created in the same directory, flushed to disk
+ * and renamed over `path`.
+ */
+void replace_file(const std::string &path, const std::function<void(int)> &fill)
+{
+    std::string tmp_path = path + ".XXXXXX";
+    std::size_t pos      = path.find_last_of('/');
+    std::string dir_path = ".";
+    struct stat st;
+    int fd;
+
+    if (pos != std::string::npos)
+        dir_path = path.substr(0, pos + 1);
+
+    if ((fd = mkstemp(&tmp_path[0])) == -1)
+        throw(FsException(UnixSyscall::getErrorString("mkstemp", errno)));
+    // mkstemp() creates the file 0600: keep the mode of the file we replace.
+    mode_t mode = (stat(path.c_str(), &st) == 0) ? (st.st_mode & 07777) : 0644;
+    try
+    {
+        if (fchmod(fd, mode) == -1)
+            throw(FsException(UnixSyscall::getErrorString("fchmod", errno)));
+        fill(fd);
+        if (fsync(fd) == -1)
+            throw(FsException(UnixSyscall::getErrorString("fsync", errno)));
+        if (close(fd) == -1)
+        {
+            fd = -1;
+            throw(FsException(UnixSyscall::getErrorString("close", errno)));
+        }
+        fd = -1;
+        if (rename(tmp_path.c_str(), path.c_str()) == -1)
+            throw(FsException(UnixSyscall::getErrorString("rename", errno)));
+    }
+    catch (const FsException &)
+    {
+        if (fd != -1)
+            close(fd);
+        unlink(tmp_path.c_str());
+        throw;
+    }
+    // Persist the rename itself. Failing here does not leave a corrupt file.
+    if ((fd = open(dir_path.c_str(), O_RDONLY | O_DIRECTORY)) != -1)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+void write_all(int fd, const char *data, std::size_t left)
+{
+    while (left)
+    {
+        ssize_t ret = write(fd, data, left);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+            throw(FsException(UnixSyscall::getErrorString("write", errno)));
+        data += ret;
+        left -= static_cast<std::size_t>(ret);
+    }
+}
+
+/**
+ * Copy `size` bytes from `in_fd` to `out_fd`.
+ *
+ * Let the kernel copy the data without a round-trip through userspace,
+ * falling back to read()/write() if it can't.
+ */
+void copy_fd(int in_fd, int out_fd, off_t size)
+{
+    off_t offset = 0;
+    char buffer[4096];
+    ssize_t ret;
+
+    while (offset < size)
+    {
+        auto count = static_cast<std::size_t>(size - offset);
+        ret        = sendfile(out_fd, in_fd, &offset, count);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1 && (errno == EINVAL || errno == ENOSYS))
+            break;
+        if (ret == -1)
+            throw(FsException(UnixSyscall::getErrorString("sendfile", errno)));
+        if (ret == 0)
+            return;
+    }
+    if (offset >= size)
+        return;
+    if (lseek(in_fd, offset, SEEK_SET) == -1)
+        throw(FsException(UnixSyscall::getErrorString("lseek", errno)));
+    while ((ret = read(in_fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+            throw(FsException(UnixSyscall::getErrorString("read", errno)));
+        write_all(out_fd, buffer, static_cast<std::size_t>(ret));
+    }
+}
+}
+
+void UnixFs::writeAtomically(const std::string &path, const std::string &content)
+{
+    replace_file(path,
+                 [&](int fd) { write_all(fd, content.data(), content.size()); });
+}
+
+void UnixFs::copyFile(const std::string &source, const std::string &dest)
+{
+    int in_fd;
+    struct stat st;
+
+    if ((in_fd = open(source.c_str(), O_RDONLY)) == -1)
+        throw(FsException(UnixSyscall::getErrorString("open", errno) + ": " +
+                          source));
+    try
+    {
+        if (fstat(in_fd, &st) == -1)
+            throw(FsException(UnixSyscall::getErrorString("fstat", errno)));
+        replace_file(dest, [&](int out_fd) { copy_fd(in_fd, out_fd, st.st_size); });
+    }
+    catch (const FsException &)
+    {
+        close(in_fd);
+        throw;
+    }
+    close(in_fd);
+}
@@ -79,6 +79,26 @@ class UnixFs
     */
     static bool fileExists(const std::string &path);
 
+    /**
+    * replace the content of a file atomically
+    *
+    * The content is written to a temporary file in the same directory,
+    * flushed to disk and renamed over `path`. Readers (and a crash) see
+    * either the old or the new content, never a truncated file.
+    * @param path Path of the file
+    * @param content New file contents
+    */
+    static void writeAtomically(const std::string &path, const std::string &content);
+
+    /**
+    * copy a file, replacing the destination atomically
+    *
+    * The copy is done in-kernel (sendfile()) when possible.
+    * @param source Path of the file to copy
+    * @param dest Path of the copy
+    */
+    static void copyFile(const std::string &source, const std::string &dest);
+
     /**
     * read value from a sysfs file
     * @param path Path of the sysfs target
@@ -26,7 +26,10 @@
 #include "unixshellscript.hpp"
 
 extern "C" {
+#include <spawn.h>
 #include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
 }
 
 #include <sstream>
@@ -67,3 +70,30 @@ const std::string &UnixShellScript::getOutput() const
 {
     return (_output);
 }
+
+int UnixShellScript::exec(const std::vector<std::string> &argv)
+{
+    std::vector<char *> args;
+    pid_t pid;
+    int status;
+    int ret;
+
+    if (argv.empty())
+        throw(ScriptException("exec: no program"));
+    for (const auto &arg : argv)
+        args.push_back(const_cast<char *>(arg.c_str()));
+    args.push_back(nullptr);
+
+    INFO("Exec: " << argv[0]);
+    if ((ret = posix_spawn(&pid, args[0], nullptr, nullptr, args.data(), environ)))
+        throw(ScriptException(UnixSyscall::getErrorString("posix_spawn", ret) +
+                              " command: '" + argv[0] + '\''));
+    while (waitpid(pid, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+            throw(ScriptException(UnixSyscall::getErrorString("waitpid", errno)));
+    }
+    if (WIFSIGNALED(status))
+        return (128 + WTERMSIG(status));
+    return (WEXITSTATUS(status));
+}
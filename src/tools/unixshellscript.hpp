@@ -28,6 +28,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 namespace Leosac
 {
@@ -51,6 +52,16 @@ class UnixShellScript
 
     const std::string &getOutput() const;
 
+    /**
+    * Run a program directly, without going through a shell, and wait
+    * for it to exit.
+    *
+    * @param argv Path to the program, followed by its arguments.
+    * @return The exit status of the program (128 + signal number if it
+    * was killed by a signal).
+    */
+    static int exec(const std::vector<std::string> &argv);
+
     template <typename T>
     static std::string toCmdLine(T value)
     {
@@ -0,0 +1,115 @@
+/*
+    Copyright (C) 2014-2017 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/audit/Snapshot.hpp"
+#include "tools/Compression.hpp"
+#include "gtest/gtest.h"
+#include <json.hpp>
+#include <zmqpp/z85.hpp>
+
+using namespace Leosac::Audit;
+
+namespace Leosac
+{
+namespace Test
+{
+TEST(TestAuditSnapshot, round_trip_small)
+{
+    Snapshot s;
+    s.before(R"({"id":1,"username":"toto"})");
+    s.after(R"({"id":1,"username":"titi"})");
+
+    ASSERT_EQ(R"({"id":1,"username":"toto"})", s.before());
+    ASSERT_EQ(R"({"id":1,"username":"titi"})", s.after());
+}
+
+TEST(TestAuditSnapshot, after_only)
+{
+    Snapshot s;
+    s.after(R"({"id":1})");
+
+    ASSERT_EQ("", s.before());
+    ASSERT_EQ(R"({"id":1})", s.after());
+}
+
+TEST(TestAuditSnapshot, after_then_before)
+{
+    nlohmann::json big;
+    for (int i = 0; i < 100; ++i)
+        big["field" + std::to_string(i)] = "some value " + std::to_string(i);
+    nlohmann::json big_modified = big;
+    big_modified["field0"] = "modified";
+
+    // Serializers store snapshots as `dump(4)`: make sure the formatting
+    // survives the round trip through a JSON Patch.
+    Snapshot s;
+    s.after(big_modified.dump(4));
+    s.before(big.dump(4));
+
+    ASSERT_EQ(big.dump(4), s.before());
+    ASSERT_EQ(big_modified.dump(4), s.after());
+}
+
+TEST(TestAuditSnapshot, not_json)
+{
+    Snapshot s;
+    s.before("not json");
+    s.after("not json either");
+
+    ASSERT_EQ("not json", s.before());
+    ASSERT_EQ("not json either", s.after());
+}
+
+TEST(TestAuditSnapshot, compress)
+{
+    std::string small = "abcd";
+    ASSERT_EQ(small, Snapshot::compress(small));
+    ASSERT_EQ(small, Snapshot::decompress(small));
+
+    std::string large(4096, 'a');
+    auto compressed = Snapshot::compress(large);
+    ASSERT_LT(compressed.size(), large.size());
+    ASSERT_EQ(large, Snapshot::decompress(compressed));
+}
+
+TEST(TestAuditSnapshot, compress_format)
+{
+    std::string large(4096, 'a');
+    auto compressed = Snapshot::compress(large);
+
+    // "Z:<raw_size>:<compressed_size>:<z85 data>"
+    auto sep1 = compressed.find(':', 2);
+    auto sep2 = compressed.find(':', sep1 + 1);
+    ASSERT_EQ("Z:4096:", compressed.substr(0, sep1 + 1));
+
+    auto size    = std::stoul(compressed.substr(sep1 + 1, sep2 - sep1 - 1));
+    auto decoded = zmqpp::z85::decode(compressed.substr(sep2 + 1));
+    ASSERT_GE(decoded.size(), size);
+    ASSERT_EQ(large, Tools::zlib_decompress(
+                         std::string(decoded.begin(), decoded.begin() + size)));
+
+    // Data compressed elsewhere with Tools::zlib_compress() decodes as well.
+    auto stream = Tools::zlib_compress(large);
+    std::string padded = stream;
+    padded.resize((padded.size() + 3) / 4 * 4, '\0');
+    ASSERT_EQ(large, Snapshot::decompress("Z:4096:" + std::to_string(stream.size()) +
+                                          ":" + zmqpp::z85::encode(padded)));
+}
+}
+}
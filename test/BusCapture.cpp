@@ -0,0 +1,252 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "helper/ScratchDirectory.hpp"
+#include "modules/monitor/BusCapture.hpp"
+#include "tools/unixfs.hpp"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <fstream>
+
+using namespace Leosac::Module::Monitor;
+using namespace Leosac::Tools;
+
+namespace Leosac
+{
+namespace Test
+{
+class BusCaptureTest : public ::testing::Test
+{
+  public:
+    BusCaptureTest()
+        : directory_("buscapture")
+    {
+        options_.directory_      = directory_.path();
+        options_.segment_size_   = 1024 * 1024;
+        options_.segments_       = 4;
+        options_.flush_interval_ = std::chrono::milliseconds(10);
+        options_.buffer_size_    = 1024 * 1024;
+    }
+
+  protected:
+    struct Record
+    {
+        uint64_t timestamp_;
+        std::vector<std::string> frames_;
+    };
+
+    std::string path(const std::string &name) const
+    {
+        return directory_.path(name);
+    }
+
+    /**
+     * Segments in the capture directory, oldest first.
+     */
+    std::vector<std::string> segments() const
+    {
+        auto files = UnixFs::listFiles(directory_.path(), ".cap");
+        files.sort();
+        return std::vector<std::string>(files.begin(), files.end());
+    }
+
+    template <typename T>
+    static T get_le(const std::string &data, size_t &offset)
+    {
+        if (offset + sizeof(T) > data.size())
+            throw std::out_of_range("truncated segment");
+        T value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            value |= static_cast<T>(static_cast<uint8_t>(data[offset + i]))
+                     << (8 * i);
+        offset += sizeof(T);
+        return value;
+    }
+
+    /**
+     * Decode a segment, following the format documented in BusCapture.hpp.
+     */
+    static std::vector<Record> read_segment(const std::string &path)
+    {
+        auto data = UnixFs::readAll(path);
+        if (data.compare(0, 8, "LEOSACBC") != 0)
+            throw std::runtime_error("bad magic");
+        size_t offset = 8;
+        if (get_le<uint32_t>(data, offset) != 1)
+            throw std::runtime_error("bad format version");
+
+        std::vector<Record> records;
+        while (offset < data.size())
+        {
+            auto size = get_le<uint32_t>(data, offset);
+            auto end  = offset + size;
+            Record record;
+            record.timestamp_ = get_le<uint64_t>(data, offset);
+            auto parts        = get_le<uint16_t>(data, offset);
+            for (uint16_t i = 0; i < parts; ++i)
+            {
+                auto frame_size = get_le<uint32_t>(data, offset);
+                if (offset + frame_size > end)
+                    throw std::out_of_range("frame overflows its record");
+                record.frames_.push_back(data.substr(offset, frame_size));
+                offset += frame_size;
+            }
+            if (offset != end)
+                throw std::runtime_error("record size mismatch");
+            records.push_back(std::move(record));
+        }
+        return records;
+    }
+
+    static uint64_t now_us()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    Helper::ScratchDirectory directory_;
+    BusCapture::Options options_;
+};
+
+TEST_F(BusCaptureTest, roundTrip)
+{
+    std::string binary("\x00\x01\xFF\x00", 4);
+    auto before = now_us();
+    {
+        BusCapture capture(options_);
+        zmqpp::message first;
+        first << "S_WIEGAND1" << binary << "";
+        capture.capture(first);
+        zmqpp::message second;
+        second << "KERNEL";
+        capture.capture(second);
+    }
+    auto after = now_us();
+
+    auto files = segments();
+    ASSERT_EQ(1, files.size());
+    ASSERT_EQ(path("00000000000000000000.cap"), files[0]);
+
+    auto records = read_segment(files[0]);
+    ASSERT_EQ(2, records.size());
+    ASSERT_EQ(std::vector<std::string>({"S_WIEGAND1", binary, ""}),
+              records[0].frames_);
+    ASSERT_EQ(std::vector<std::string>({"KERNEL"}), records[1].frames_);
+    ASSERT_LE(before, records[0].timestamp_);
+    ASSERT_LE(records[0].timestamp_, records[1].timestamp_);
+    ASSERT_LE(records[1].timestamp_, after);
+}
+
+TEST_F(BusCaptureTest, rotation)
+{
+    // Every batch goes to a new segment.
+    options_.segment_size_ = 1;
+    options_.segments_     = 2;
+    {
+        BusCapture capture(options_);
+        for (int i = 0; i < 4; ++i)
+        {
+            zmqpp::message msg;
+            msg << std::to_string(i);
+            capture.capture(msg);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    auto files = segments();
+    ASSERT_EQ(2, files.size());
+    ASSERT_EQ(path("00000000000000000002.cap"), files[0]);
+    ASSERT_EQ(path("00000000000000000003.cap"), files[1]);
+    ASSERT_EQ(std::vector<std::string>({"2"}), read_segment(files[0])[0].frames_);
+    ASSERT_EQ(std::vector<std::string>({"3"}), read_segment(files[1])[0].frames_);
+}
+
+TEST_F(BusCaptureTest, resumeFromExistingSegments)
+{
+    options_.segments_ = 2;
+    for (int run = 0; run < 2; ++run)
+    {
+        BusCapture capture(options_);
+        zmqpp::message msg;
+        msg << "run " + std::to_string(run);
+        capture.capture(msg);
+    }
+    std::ofstream(path("unexpected.cap")) << "not a segment";
+
+    auto files = segments();
+    ASSERT_EQ(3, files.size());
+    ASSERT_EQ(path("00000000000000000000.cap"), files[0]);
+    ASSERT_EQ(path("00000000000000000001.cap"), files[1]);
+    auto first_run  = UnixFs::readAll(files[0]);
+    auto second_run = UnixFs::readAll(files[1]);
+
+    {
+        BusCapture capture(options_);
+        zmqpp::message msg;
+        msg << "run 2";
+        capture.capture(msg);
+    }
+
+    // The new run starts after the existing segments, without touching
+    // them, and the retention accounts for them. Unknown files are left
+    // alone.
+    files = segments();
+    ASSERT_EQ(3, files.size());
+    ASSERT_EQ(path("00000000000000000001.cap"), files[0]);
+    ASSERT_EQ(path("00000000000000000002.cap"), files[1]);
+    ASSERT_EQ(path("unexpected.cap"), files[2]);
+    ASSERT_EQ(second_run, UnixFs::readAll(files[0]));
+    ASSERT_NE(first_run, second_run);
+
+    ASSERT_EQ(std::vector<std::string>({"run 1"}),
+              read_segment(files[0])[0].frames_);
+    auto records = read_segment(files[1]);
+    ASSERT_EQ(1, records.size());
+    ASSERT_EQ(std::vector<std::string>({"run 2"}), records[0].frames_);
+}
+
+TEST_F(BusCaptureTest, dropsWhenBufferFull)
+{
+    // The worker only wakes up on a full batch or at the flush interval,
+    // so nothing is written before the capture stops.
+    options_.flush_interval_ = std::chrono::hours(1);
+    // Each record is 14 bytes of header, 4 bytes of frame size and 10
+    // bytes of content.
+    options_.buffer_size_ = 3 * 28 + 10;
+    {
+        BusCapture capture(options_);
+        for (int i = 0; i < 10; ++i)
+        {
+            zmqpp::message msg;
+            msg << "message " + std::to_string(i);
+            capture.capture(msg);
+        }
+    }
+
+    auto files = segments();
+    ASSERT_EQ(1, files.size());
+    auto records = read_segment(files[0]);
+    ASSERT_EQ(3, records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+        ASSERT_EQ(std::vector<std::string>({"message " + std::to_string(i)}),
+                  records[i].frames_);
+}
+}
+}
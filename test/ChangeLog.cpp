@@ -0,0 +1,296 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/auth/ChangeLog.hpp"
+#include "core/auth/ChangeLog_odb.h"
+#include "core/auth/Group.hpp"
+#include "core/auth/Group_odb.h"
+#include "core/auth/User.hpp"
+#include "core/auth/UserGroupMembership_odb.h"
+#include "core/auth/User_odb.h"
+#include "gtest/gtest.h"
+#include "helper/ScratchDirectory.hpp"
+#include "tools/JSONUtils.hpp"
+#include <odb/schema-catalog.hxx>
+#include <odb/sqlite/database.hxx>
+#include <odb/transaction.hxx>
+
+using namespace Leosac::Auth;
+
+namespace Leosac
+{
+namespace Test
+{
+class ChangeLogTest : public ::testing::Test
+{
+  public:
+    ChangeLogTest()
+        : directory_("changelog")
+    {
+        master_    = open("master.db");
+        satellite_ = open("satellite.db");
+    }
+
+  protected:
+    DBPtr open(const std::string &name)
+    {
+        DBPtr db = std::make_shared<odb::sqlite::database>(
+            directory_.path(name), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        odb::transaction t(db->begin());
+        odb::schema_catalog::create_schema(*db, "core");
+        ChangeLog::ensure_table(*db);
+        t.commit();
+        return db;
+    }
+
+    /**
+     * Apply the master's new entries to the satellite.
+     */
+    void replicate()
+    {
+        std::vector<ChangeLogRow> entries;
+        {
+            odb::transaction t(master_->begin());
+            entries = ChangeLog::fetch(*master_, 0, ChangeLog::head(*master_));
+            t.commit();
+        }
+        odb::transaction t(satellite_->begin());
+        auto cursor = ChangeLog::cursor(*satellite_, "master");
+        for (const auto &entry : entries)
+        {
+            if (entry.seq <= cursor)
+                continue;
+            ASSERT_TRUE(ChangeLog::apply(*satellite_, "master", entry));
+            ChangeLog::cursor(*satellite_, "master", entry.seq);
+        }
+        t.commit();
+    }
+
+    std::vector<ChangeLogRow> entries(odb::database &db)
+    {
+        odb::transaction t(db.begin());
+        auto rows = ChangeLog::fetch(db, 0, ChangeLog::head(db));
+        t.commit();
+        return rows;
+    }
+
+    Helper::ScratchDirectory directory_;
+    DBPtr master_;
+    DBPtr satellite_;
+};
+
+TEST_F(ChangeLogTest, changesAreRecorded)
+{
+    {
+        odb::transaction t(master_->begin());
+        auto user = std::make_shared<User>();
+        user->username("toto");
+        master_->persist(user);
+
+        auto group = std::make_shared<Group>();
+        group->name("group");
+        group->member_add(user, GroupRank::ADMIN);
+        master_->persist(group);
+
+        master_->erase(user);
+        t.commit();
+    }
+
+    auto rows = entries(*master_);
+    ASSERT_EQ(4, rows.size());
+    ASSERT_EQ("user", rows[0].entity);
+    ASSERT_EQ("upsert", rows[0].operation);
+    ASSERT_EQ("toto", json::parse(rows[0].payload).at("username"));
+    ASSERT_EQ("group", rows[1].entity);
+    ASSERT_EQ("membership", rows[2].entity);
+    ASSERT_EQ(static_cast<int>(GroupRank::ADMIN),
+              json::parse(rows[2].payload).at("rank"));
+    // The membership is erased on cascade: the satellite does the same.
+    ASSERT_EQ("user", rows[3].entity);
+    ASSERT_EQ("erase", rows[3].operation);
+    for (size_t i = 1; i < rows.size(); ++i)
+        ASSERT_LT(rows[i - 1].seq, rows[i].seq);
+}
+
+TEST_F(ChangeLogTest, changesAreApplied)
+{
+    UserPtr user;
+    GroupPtr group;
+    {
+        odb::transaction t(master_->begin());
+        user = std::make_shared<User>();
+        user->username("toto");
+        user->firstname("Toto");
+        master_->persist(user);
+
+        group = std::make_shared<Group>();
+        group->name("group");
+        group->member_add(user, GroupRank::MEMBER);
+        master_->persist(group);
+        t.commit();
+    }
+    replicate();
+    {
+        odb::transaction t(satellite_->begin());
+        auto copy =
+            satellite_->query_one<User>(odb::query<User>::username == "toto");
+        ASSERT_TRUE(copy);
+        ASSERT_EQ("Toto", copy->firstname());
+        auto group_copy =
+            satellite_->query_one<Group>(odb::query<Group>::name == "group");
+        ASSERT_TRUE(group_copy);
+        ASSERT_EQ(1, group_copy->user_memberships().size());
+        ASSERT_EQ(copy->id(), (*group_copy->user_memberships().begin())->user_id());
+        t.commit();
+    }
+
+    // Updates, including a membership's rank, and removals.
+    {
+        odb::transaction t(master_->begin());
+        user->firstname("Titi");
+        master_->update(user);
+        (*group->user_memberships().begin())->rank(GroupRank::OPERATOR);
+        master_->update(group);
+        t.commit();
+    }
+    replicate();
+    {
+        odb::transaction t(satellite_->begin());
+        auto copy =
+            satellite_->query_one<User>(odb::query<User>::username == "toto");
+        ASSERT_EQ("Titi", copy->firstname());
+        auto group_copy =
+            satellite_->query_one<Group>(odb::query<Group>::name == "group");
+        ASSERT_EQ(GroupRank::OPERATOR,
+                  (*group_copy->user_memberships().begin())->rank());
+        t.commit();
+    }
+
+    {
+        odb::transaction t(master_->begin());
+        master_->erase(group);
+        t.commit();
+    }
+    replicate();
+    {
+        odb::transaction t(satellite_->begin());
+        ASSERT_FALSE(
+            satellite_->query_one<Group>(odb::query<Group>::name == "group"));
+        ASSERT_TRUE(
+            satellite_->query_one<User>(odb::query<User>::username == "toto"));
+        t.commit();
+    }
+}
+
+TEST_F(ChangeLogTest, pruneKeepsWhatReplicationNeeds)
+{
+    {
+        odb::transaction t(master_->begin());
+        auto user = std::make_shared<User>();
+        user->username("toto");
+        master_->persist(user);
+        user->firstname("A");
+        master_->update(user);
+        user->firstname("B");
+        master_->update(user);
+
+        auto gone = std::make_shared<User>();
+        gone->username("gone");
+        master_->persist(gone);
+        master_->erase(gone);
+
+        auto last = std::make_shared<User>();
+        last->username("last");
+        master_->persist(last);
+        t.commit();
+    }
+    ASSERT_EQ(6, entries(*master_).size());
+
+    {
+        odb::transaction t(master_->begin());
+        // A negative age makes every entry old enough.
+        ASSERT_EQ(2, ChangeLog::prune(*master_, std::chrono::seconds(-10)));
+        t.commit();
+    }
+    auto rows = entries(*master_);
+    ASSERT_EQ(4, rows.size());
+    ASSERT_EQ("toto", json::parse(rows[0].payload).at("username"));
+    ASSERT_EQ("B", json::parse(rows[1].payload).at("firstname"));
+    // The removal of "gone" stays as a tombstone.
+    ASSERT_EQ("erase", rows[2].operation);
+    ASSERT_EQ("user", rows[2].entity);
+    ASSERT_EQ("last", json::parse(rows[3].payload).at("username"));
+
+    // A new satellite still converges.
+    replicate();
+    odb::transaction t(satellite_->begin());
+    auto copy = satellite_->query_one<User>(odb::query<User>::username == "toto");
+    ASSERT_TRUE(copy);
+    ASSERT_EQ("B", copy->firstname());
+    ASSERT_FALSE(satellite_->query_one<User>(odb::query<User>::username == "gone"));
+    t.commit();
+}
+TEST_F(ChangeLogTest, pruneKeepsRemovalsForLateSatellites)
+{
+    UserPtr gone;
+    GroupPtr group;
+    {
+        odb::transaction t(master_->begin());
+        auto user = std::make_shared<User>();
+        user->username("toto");
+        master_->persist(user);
+
+        gone = std::make_shared<User>();
+        gone->username("gone");
+        master_->persist(gone);
+
+        group = std::make_shared<Group>();
+        group->name("group");
+        group->member_add(user, GroupRank::MEMBER);
+        master_->persist(group);
+        t.commit();
+    }
+    replicate();
+
+    // Revoke a user and a membership, then prune while the satellite's
+    // cursor is still before the removals.
+    {
+        odb::transaction t(master_->begin());
+        master_->erase(gone);
+        master_->erase(*group->user_memberships().begin());
+
+        auto last = std::make_shared<User>();
+        last->username("last");
+        master_->persist(last);
+        ASSERT_LT(0, ChangeLog::prune(*master_, std::chrono::seconds(-10)));
+        t.commit();
+    }
+    replicate();
+
+    odb::transaction t(satellite_->begin());
+    ASSERT_FALSE(satellite_->query_one<User>(odb::query<User>::username == "gone"));
+    ASSERT_TRUE(satellite_->query_one<User>(odb::query<User>::username == "last"));
+    auto group_copy =
+        satellite_->query_one<Group>(odb::query<Group>::name == "group");
+    ASSERT_TRUE(group_copy);
+    ASSERT_EQ(0, group_copy->user_memberships().size());
+    t.commit();
+}
+}
+}
@@ -100,6 +100,57 @@ TEST_F(ConfigManagerTest, store_load)
     ASSERT_EQ(my_module_cfg, cfg);
 }
 
+/**
+* Storing a new config for a module must invalidate the hash
+* of its previous config.
+*/
+TEST_F(ConfigManagerTest, module_hash)
+{
+    boost::property_tree::ptree my_module_cfg;
+
+    ASSERT_EQ("", cfg0->module_hash("my"));
+    cfg0->store_config("my", my_module_cfg);
+    cfg0->module_hash("my", "abcd");
+    ASSERT_EQ("abcd", cfg0->module_hash("my"));
+    ASSERT_EQ(1, cfg0->module_hashes().size());
+
+    cfg0->store_config("my", my_module_cfg);
+    ASSERT_EQ("", cfg0->module_hash("my"));
+
+    cfg0->module_hash("my", "abcd");
+    cfg0->remove_config("my");
+    ASSERT_EQ("", cfg0->module_hash("my"));
+}
+
+/**
+* Modules are stamped with the configuration version in effect
+* when their config is stored. Published vectors are immutable.
+*/
+TEST_F(ConfigManagerTest, version_vector)
+{
+    boost::property_tree::ptree my_module_cfg;
+
+    auto v0 = cfg0->version_vector();
+    ASSERT_EQ(0, v0->version);
+    ASSERT_EQ(0, v0->modules.size());
+
+    cfg0->config_version(42);
+    cfg0->store_config("my", my_module_cfg);
+    cfg0->incr_version();
+
+    auto v1 = cfg0->version_vector();
+    ASSERT_EQ(43, v1->version);
+    ASSERT_EQ(43, cfg0->config_version());
+    ASSERT_EQ(0, v1->general);
+    ASSERT_EQ(42, v1->modules.at("my"));
+    ASSERT_EQ(0, v0->version);
+    ASSERT_EQ(0, v0->modules.size());
+
+    cfg0->remove_config("my");
+    ASSERT_EQ(0, cfg0->version_vector()->modules.count("my"));
+    ASSERT_EQ(1, v1->modules.count("my"));
+}
+
 TEST_F(ConfigManagerTest, access_cfg)
 {
     auto network_cfg = cfg1->kconfig().get_child("network");
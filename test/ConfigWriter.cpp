@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/config/ConfigWriter.hpp"
+#include "helper/ScratchDirectory.hpp"
+#include "tools/unixfs.hpp"
+#include "gtest/gtest.h"
+#include <unistd.h>
+
+using namespace Leosac::Tools;
+
+namespace Leosac
+{
+namespace Test
+{
+class ConfigWriterTest : public ::testing::Test
+{
+  public:
+    ConfigWriterTest()
+        : directory_("configwriter")
+    {
+        path_ = directory_.path("kernel.xml");
+    }
+
+  protected:
+    static boost::property_tree::ptree tree(const std::string &value)
+    {
+        boost::property_tree::ptree tree;
+        tree.put("kernel.instance_name", value);
+        return tree;
+    }
+
+    Helper::ScratchDirectory directory_;
+    std::string path_;
+};
+
+TEST_F(ConfigWriterTest, saveAndFlush)
+{
+    ConfigWriter writer;
+
+    writer.save(path_, tree("first"));
+    ASSERT_TRUE(writer.flush());
+    auto content = UnixFs::readAll(path_);
+    ASSERT_NE(std::string::npos,
+              content.find("<instance_name>first</instance_name>"));
+
+    writer.save(path_, tree("second"));
+    writer.save(path_, tree("third"));
+    ASSERT_TRUE(writer.flush());
+    content = UnixFs::readAll(path_);
+    ASSERT_EQ(std::string::npos, content.find("first"));
+    ASSERT_NE(std::string::npos,
+              content.find("<instance_name>third</instance_name>"));
+}
+
+TEST_F(ConfigWriterTest, unchangedTreeIsNotWritten)
+{
+    ConfigWriter writer;
+
+    writer.save(path_, tree("value"));
+    ASSERT_TRUE(writer.flush());
+
+    UnixFs::writeAtomically(path_, "modified behind our back");
+    writer.save(path_, tree("value"));
+    ASSERT_TRUE(writer.flush());
+    ASSERT_EQ("modified behind our back", UnixFs::readAll(path_));
+}
+
+TEST_F(ConfigWriterTest, failureIsReported)
+{
+    ConfigWriter writer;
+    auto bad_path = directory_.path("missing/kernel.xml");
+
+    writer.save(bad_path, tree("value"));
+    ASSERT_FALSE(writer.flush());
+
+    // Other files don't clear the failure.
+    writer.save(path_, tree("value"));
+    ASSERT_FALSE(writer.flush());
+
+    // Writing the file successfully does.
+    mkdir(directory_.path("missing").c_str(), 0755);
+    writer.save(bad_path, tree("value"));
+    ASSERT_TRUE(writer.flush());
+    ASSERT_TRUE(UnixFs::fileExists(bad_path));
+}
+
+TEST_F(ConfigWriterTest, destructorWaitsForWrites)
+{
+    {
+        ConfigWriter writer;
+        writer.save(path_, tree("value"));
+    }
+    ASSERT_NE(std::string::npos,
+              UnixFs::readAll(path_).find("<instance_name>value</instance_name>"));
+}
+}
+}
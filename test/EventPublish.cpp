@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modules/event-publish/EventPublish.h"
+#include "gtest/gtest.h"
+#include <cstring>
+
+using namespace Leosac::Module::EventPublish;
+
+namespace Leosac
+{
+namespace Test
+{
+namespace
+{
+bool decode(const std::vector<EventPublish::WiegandFormat> &formats,
+            const char *card, int bits, uint64_t &number)
+{
+    return EventPublish::decode(formats, card, std::strlen(card), bits, number);
+}
+}
+
+TEST(EventPublish, DecodeDefaultFormat)
+{
+    std::vector<EventPublish::WiegandFormat> formats = {{35, 1, 20}};
+    uint64_t number = 0;
+
+    // Byte aligned frame, or only the significant digits.
+    ASSERT_TRUE(decode(formats, "a0:00:48:d1:60", 35, number));
+    ASSERT_EQ(0x12345u, number);
+    number = 0;
+    ASSERT_TRUE(decode(formats, "a0:00:48:d1:6", 35, number));
+    ASSERT_EQ(0x12345u, number);
+    number = 0;
+    ASSERT_TRUE(decode(formats, "A00048D160", 35, number));
+    ASSERT_EQ(0x12345u, number);
+}
+
+TEST(EventPublish, DecodeSelectsFormatFromBits)
+{
+    std::vector<EventPublish::WiegandFormat> formats = {{35, 1, 20},
+                                                        {26, 1, 24}};
+    uint64_t number = 0;
+
+    ASSERT_TRUE(decode(formats, "d5:e6:f7:80", 26, number));
+    ASSERT_EQ(0xABCDEFu, number);
+    ASSERT_TRUE(decode(formats, "a0:00:48:d1:60", 35, number));
+    ASSERT_EQ(0x12345u, number);
+}
+
+TEST(EventPublish, DecodeRejectsInvalidFrames)
+{
+    std::vector<EventPublish::WiegandFormat> formats = {{35, 1, 20}};
+    uint64_t number = 42;
+
+    // No format for this size.
+    ASSERT_FALSE(decode(formats, "d5:e6:f7:80", 26, number));
+    // Not hexadecimal.
+    ASSERT_FALSE(decode(formats, "a0:00:4g:d1:60", 35, number));
+    // Fewer digits than bits.
+    ASSERT_FALSE(decode(formats, "a0:00:48", 35, number));
+    // More digits than fit in 64 bits.
+    ASSERT_FALSE(decode(formats, "00:00:00:00:00:00:00:00:00", 35, number));
+    ASSERT_FALSE(decode(formats, "", 35, number));
+    ASSERT_EQ(42u, number);
+}
+}
+}
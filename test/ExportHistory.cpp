@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/audit/AuditFactory.hpp"
+#include "core/audit/IWSAPICall.hpp"
+#include "core/audit/StatsRollup.hpp"
+#include "core/auth/ChangeLog.hpp"
+#include "core/tasks/ExportHistory.hpp"
+#include "gtest/gtest.h"
+#include "helper/ScratchDirectory.hpp"
+#include "tools/JSONUtils.hpp"
+#include <fstream>
+#include <odb/schema-catalog.hxx>
+#include <odb/sqlite/database.hxx>
+#include <odb/transaction.hxx>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using namespace Leosac::Audit;
+using Leosac::Tasks::ExportHistory;
+
+namespace Leosac
+{
+namespace Test
+{
+class ExportHistoryTest : public ::testing::Test
+{
+  public:
+    ExportHistoryTest()
+        : directory_("export")
+    {
+        db_ = std::make_shared<odb::sqlite::database>(
+            directory_.path("audit.db"), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        odb::transaction t(db_->begin());
+        odb::schema_catalog::create_schema(*db_, "core");
+        StatsRollup::ensure_table(*db_);
+        Auth::ChangeLog::ensure_table(*db_);
+        t.commit();
+
+        // One more than a batch, so that the export crosses a batch boundary.
+        for (size_t i = 0; i < ExportHistory::batch_size + 1; ++i)
+        {
+            auto call = Factory::WSAPICall(db_);
+            odb::transaction t2(db_->begin());
+            call->event_mask(EventType::WSAPI_CALL);
+            call->method("method-" + std::to_string(i));
+            call->finalize();
+            t2.commit();
+            ids_.push_back(call->id());
+        }
+    }
+
+  protected:
+    static bool exists(const std::string &path)
+    {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0;
+    }
+
+    /**
+     * Read `path`, which must be gzip'd if `compressed`, line by line.
+     */
+    static std::vector<std::string> lines(const std::string &path, bool compressed)
+    {
+        std::vector<std::string> out;
+        if (compressed)
+        {
+            gzFile gz = gzopen(path.c_str(), "rb");
+            EXPECT_TRUE(gz);
+            char buffer[4096];
+            while (gz && gzgets(gz, buffer, sizeof(buffer)))
+            {
+                std::string line(buffer);
+                if (!line.empty() && line.back() == '\n')
+                    line.pop_back();
+                out.push_back(line);
+            }
+            if (gz)
+                gzclose(gz);
+        }
+        else
+        {
+            std::ifstream in(path);
+            std::string line;
+            while (std::getline(in, line))
+                out.push_back(line);
+        }
+        return out;
+    }
+
+    Helper::ScratchDirectory directory_;
+    DBPtr db_;
+    std::vector<AuditEntryId> ids_;
+};
+
+TEST_F(ExportHistoryTest, exportAcrossBatches)
+{
+    auto path = directory_.path("audit.ndjson");
+    ExportHistory task(db_, ExportHistory::Source::AUDIT,
+                       ExportHistory::Format::NDJSON, false, path);
+    task.run();
+    ASSERT_TRUE(task.succeed());
+    ASSERT_EQ(ids_.size(), task.total());
+    ASSERT_EQ(ids_.size(), task.exported());
+    ASSERT_TRUE(exists(path));
+    ASSERT_FALSE(exists(path + ".part"));
+
+    // Every entry exactly once, in id order.
+    auto rows = lines(path, false);
+    ASSERT_EQ(ids_.size(), rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        auto entry = json::parse(rows[i]);
+        ASSERT_EQ(ids_[i], entry.at("id").get<AuditEntryId>());
+        ASSERT_EQ("audit-wsapicall-event", entry.at("type").get<std::string>());
+        ASSERT_EQ("method-" + std::to_string(i),
+                  entry.at("attributes").at("method").get<std::string>());
+    }
+}
+
+TEST_F(ExportHistoryTest, compressedCSV)
+{
+    auto path = directory_.path("audit.csv.gz");
+    ExportHistory task(db_, ExportHistory::Source::AUDIT, ExportHistory::Format::CSV,
+                       true, path);
+    task.run();
+    ASSERT_TRUE(task.succeed());
+    ASSERT_EQ(ids_.size(), task.exported());
+
+    auto rows = lines(path, true);
+    ASSERT_EQ(ids_.size() + 1, rows.size());
+    ASSERT_EQ("id,timestamp,type,author_id,description", rows[0]);
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+        ASSERT_EQ(std::to_string(ids_[i]) + ',',
+                  rows[i + 1].substr(0, std::to_string(ids_[i]).size() + 1));
+    }
+}
+
+TEST_F(ExportHistoryTest, failedExportRemovesPartFile)
+{
+    // Loading the entries now fails, after the output file was opened.
+    {
+        odb::transaction t(db_->begin());
+        db_->execute("DROP TABLE \"WSAPICall\"");
+        t.commit();
+    }
+
+    auto path = directory_.path("audit.ndjson");
+    ExportHistory task(db_, ExportHistory::Source::AUDIT,
+                       ExportHistory::Format::NDJSON, false, path);
+    task.run();
+    ASSERT_FALSE(task.succeed());
+    ASSERT_TRUE(task.get_exception());
+    ASSERT_FALSE(exists(path));
+    ASSERT_FALSE(exists(path + ".part"));
+}
+
+TEST_F(ExportHistoryTest, failedRenameRemovesPartFile)
+{
+    // A non-empty directory cannot be replaced by a file.
+    auto path = directory_.path("busy");
+    ASSERT_EQ(0, ::mkdir(path.c_str(), 0700));
+    std::ofstream(path + "/file") << "busy";
+
+    ExportHistory task(db_, ExportHistory::Source::AUDIT,
+                       ExportHistory::Format::NDJSON, false, path);
+    task.run();
+    ASSERT_FALSE(task.succeed());
+    ASSERT_FALSE(task.get_exception());
+    ASSERT_TRUE(exists(path + "/file"));
+    ASSERT_FALSE(exists(path + ".part"));
+}
+}
+}
@@ -0,0 +1,424 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modules/ws-notifier/HttpEngine.hpp"
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <curl/curl.h>
+#include <functional>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace Leosac::Module::WSNotifier;
+
+namespace Leosac
+{
+namespace Test
+{
+/**
+ * A minimal HTTP server, listening on a random port of the loopback
+ * interface. It serves any number of keep-alive connections and records
+ * the requests it receives.
+ *
+ * While `hold` is set, requests are recorded but not answered.
+ */
+class FakeHTTPServer
+{
+  public:
+    struct Request
+    {
+        /**
+         * Index of the connection the request was received on.
+         */
+        int connection;
+        std::string content_type;
+        std::string body;
+    };
+
+    FakeHTTPServer()
+        : stop_(false)
+        , hold_(false)
+        , connections_(0)
+    {
+        sockaddr_in addr{};
+        socklen_t len        = sizeof(addr);
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0 || bind(fd_, reinterpret_cast<sockaddr *>(&addr), len) ||
+            listen(fd_, 16) ||
+            getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len))
+            throw std::runtime_error("Cannot start fake HTTP server.");
+        port_   = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~FakeHTTPServer()
+    {
+        stop_ = true;
+        thread_.join();
+        for (const auto &client : clients_)
+            close(client.fd);
+        close(fd_);
+    }
+
+    TargetInfo target() const
+    {
+        TargetInfo info;
+        info.url_             = "http://127.0.0.1:" + std::to_string(port_) + "/";
+        info.connect_timeout_ = 1000;
+        info.request_timeout_ = 5000;
+        info.verify_host_     = true;
+        info.verify_peer_     = true;
+        info.max_in_flight_   = 1;
+        info.queue_size_      = 16;
+        info.batch_delay_     = 0;
+        info.batch_size_      = 1;
+        return info;
+    }
+
+    void hold(bool hold)
+    {
+        hold_ = hold;
+    }
+
+    int connections() const
+    {
+        return connections_;
+    }
+
+    std::vector<Request> requests() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    std::vector<std::string> bodies() const
+    {
+        std::vector<std::string> bodies;
+        for (const auto &request : requests())
+            bodies.push_back(request.body);
+        return bodies;
+    }
+
+  private:
+    struct Client
+    {
+        int fd;
+        int connection;
+        std::string buffer;
+        /**
+         * Number of requests received but not answered yet.
+         */
+        int unanswered;
+    };
+
+    /**
+     * Returns the value of the `name` header, or an empty string.
+     */
+    static std::string header(const std::string &head, const std::string &name)
+    {
+        size_t pos = 0;
+        while ((pos = head.find("\r\n", pos)) != std::string::npos)
+        {
+            pos += 2;
+            if (strncasecmp(head.c_str() + pos, name.c_str(), name.size()) == 0 &&
+                head.compare(pos + name.size(), 2, ": ") == 0)
+            {
+                auto start = pos + name.size() + 2;
+                return head.substr(start, head.find("\r\n", start) - start);
+            }
+        }
+        return "";
+    }
+
+    /**
+     * Record the complete requests buffered for `client`.
+     */
+    void parse(Client &client)
+    {
+        size_t end;
+        while ((end = client.buffer.find("\r\n\r\n")) != std::string::npos)
+        {
+            auto head   = client.buffer.substr(0, end + 2);
+            auto length = header(head, "Content-Length");
+            size_t size = length.empty() ? 0 : std::stoul(length);
+            if (client.buffer.size() < end + 4 + size)
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            requests_.push_back({client.connection, header(head, "Content-Type"),
+                                 client.buffer.substr(end + 4, size)});
+            client.buffer.erase(0, end + 4 + size);
+            ++client.unanswered;
+        }
+    }
+
+    void answer(Client &client)
+    {
+        static const std::string response =
+            "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        for (; client.unanswered > 0; --client.unanswered)
+            send(client.fd, response.data(), response.size(), MSG_NOSIGNAL);
+    }
+
+    void run()
+    {
+        while (!stop_)
+        {
+            std::vector<pollfd> pfds{{fd_, POLLIN, 0}};
+            for (const auto &client : clients_)
+                pfds.push_back({client.fd, POLLIN, 0});
+            if (poll(pfds.data(), pfds.size(), 20) < 0)
+                continue;
+
+            for (size_t i = clients_.size(); i > 0; --i)
+            {
+                auto &client = clients_[i - 1];
+                if (pfds[i].revents)
+                {
+                    char buffer[4096];
+                    auto ret = recv(client.fd, buffer, sizeof(buffer), 0);
+                    if (ret <= 0)
+                    {
+                        close(client.fd);
+                        clients_.erase(clients_.begin() + (i - 1));
+                        continue;
+                    }
+                    client.buffer.append(buffer, ret);
+                    parse(client);
+                }
+                if (!hold_)
+                    answer(client);
+            }
+
+            if (pfds[0].revents)
+            {
+                int fd = accept(fd_, nullptr, nullptr);
+                if (fd >= 0)
+                    clients_.push_back({fd, connections_++, "", 0});
+            }
+        }
+    }
+
+    std::atomic<bool> stop_;
+    std::atomic<bool> hold_;
+    std::atomic<int> connections_;
+    int fd_;
+    uint16_t port_;
+    std::thread thread_;
+    std::vector<Client> clients_;
+
+    mutable std::mutex mutex_;
+    std::vector<Request> requests_;
+};
+
+class HttpEngineTest : public ::testing::Test
+{
+  public:
+    HttpEngineTest()
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+
+    ~HttpEngineTest()
+    {
+        curl_global_cleanup();
+    }
+
+  protected:
+    static Notification notification(int id)
+    {
+        return {"id=" + std::to_string(id), "{\"id\":" + std::to_string(id) + "}"};
+    }
+
+    /**
+     * Drive `engine` the way the module does, until `done` returns true
+     * or `timeout` expires. Returns the last value of `done`.
+     */
+    static bool run(HttpEngine &engine, const std::function<bool()> &done,
+                    std::chrono::milliseconds timeout = std::chrono::seconds(5))
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            engine.update();
+            if (done())
+                return true;
+            long wait = engine.poll_timeout();
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(wait < 0 || wait > 10 ? 10 : wait));
+        }
+        return done();
+    }
+
+    static bool run_until_idle(HttpEngine &engine)
+    {
+        return run(engine, [&]() { return engine.idle(); });
+    }
+};
+
+TEST_F(HttpEngineTest, reusesConnection)
+{
+    FakeHTTPServer server;
+    HttpEngine engine({server.target()});
+
+    for (int i = 0; i < 3; ++i)
+        engine.post(notification(i));
+    ASSERT_TRUE(run_until_idle(engine));
+    engine.post(notification(3));
+    ASSERT_TRUE(run_until_idle(engine));
+
+    auto requests = server.requests();
+    ASSERT_EQ(std::vector<std::string>({"id=0", "id=1", "id=2", "id=3"}),
+              server.bodies());
+    ASSERT_EQ(1, server.connections());
+    for (const auto &request : requests)
+        ASSERT_EQ(0, request.connection);
+}
+
+TEST_F(HttpEngineTest, limitsRequestsInFlight)
+{
+    FakeHTTPServer server;
+    auto target           = server.target();
+    target.max_in_flight_ = 2;
+    HttpEngine engine({target});
+
+    server.hold(true);
+    for (int i = 0; i < 5; ++i)
+        engine.post(notification(i));
+    ASSERT_TRUE(run(engine, [&]() { return server.requests().size() == 2; }));
+    run(engine, []() { return false; }, std::chrono::milliseconds(200));
+    ASSERT_EQ(2, server.requests().size());
+    ASSERT_FALSE(engine.idle());
+
+    server.hold(false);
+    ASSERT_TRUE(run_until_idle(engine));
+    ASSERT_EQ(5, server.requests().size());
+    ASSERT_EQ(2, server.connections());
+}
+
+TEST_F(HttpEngineTest, dropsOldestWhenFull)
+{
+    FakeHTTPServer server;
+    auto target        = server.target();
+    target.queue_size_ = 2;
+    HttpEngine engine({target});
+
+    for (int i = 0; i < 4; ++i)
+        engine.post(notification(i));
+    ASSERT_TRUE(run_until_idle(engine));
+    ASSERT_EQ(std::vector<std::string>({"id=2", "id=3"}), server.bodies());
+}
+
+TEST_F(HttpEngineTest, deadTargetDoesntDelayLiveOne)
+{
+    FakeHTTPServer dead;
+    FakeHTTPServer live;
+    dead.hold(true);
+    HttpEngine engine({dead.target(), live.target()});
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; ++i)
+        engine.post(notification(i));
+    ASSERT_TRUE(run(engine, [&]() { return live.requests().size() == 3; }));
+
+    // Well before the dead target's request times out.
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    ASSERT_EQ(std::vector<std::string>({"id=0", "id=1", "id=2"}), live.bodies());
+    ASSERT_EQ(1, dead.requests().size());
+    ASSERT_FALSE(engine.idle());
+}
+
+TEST_F(HttpEngineTest, pollTimeout)
+{
+    FakeHTTPServer server;
+    HttpEngine engine({server.target()});
+    ASSERT_EQ(-1, engine.poll_timeout());
+
+    engine.post(notification(0));
+    ASSERT_LE(0, engine.poll_timeout());
+    ASSERT_GE(10, engine.poll_timeout());
+
+    server.hold(true);
+    engine.update();
+    ASSERT_TRUE(run(engine, [&]() { return server.requests().size() == 1; }));
+    // In flight: come back soon to pick up the response.
+    ASSERT_LE(0, engine.poll_timeout());
+    ASSERT_GE(10, engine.poll_timeout());
+
+    server.hold(false);
+    ASSERT_TRUE(run_until_idle(engine));
+    ASSERT_EQ(-1, engine.poll_timeout());
+}
+
+TEST_F(HttpEngineTest, batchFlushedWhenFull)
+{
+    FakeHTTPServer server;
+    auto target         = server.target();
+    target.batch_delay_ = 60000;
+    target.batch_size_  = 2;
+    HttpEngine engine({target});
+
+    for (int i = 0; i < 5; ++i)
+        engine.post(notification(i));
+    ASSERT_TRUE(run(engine, [&]() { return server.requests().size() == 2; }));
+
+    // The last notification waits for a full batch, or for the delay.
+    run(engine, []() { return false; }, std::chrono::milliseconds(200));
+    ASSERT_FALSE(engine.idle());
+    auto requests = server.requests();
+    ASSERT_EQ(2, requests.size());
+    ASSERT_EQ("[{\"id\":0},{\"id\":1}]", requests[0].body);
+    ASSERT_EQ("[{\"id\":2},{\"id\":3}]", requests[1].body);
+    ASSERT_EQ("application/json", requests[0].content_type);
+
+    engine.post(notification(5));
+    ASSERT_TRUE(run_until_idle(engine));
+    ASSERT_EQ("[{\"id\":4},{\"id\":5}]", server.requests().at(2).body);
+}
+
+TEST_F(HttpEngineTest, batchFlushedAfterDelay)
+{
+    FakeHTTPServer server;
+    auto target         = server.target();
+    target.batch_delay_ = 300;
+    target.batch_size_  = 10;
+    HttpEngine engine({target});
+
+    auto start = std::chrono::steady_clock::now();
+    engine.post(notification(0));
+    engine.post(notification(1));
+    ASSERT_TRUE(run_until_idle(engine));
+
+    ASSERT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(300));
+    ASSERT_EQ(std::vector<std::string>({"[{\"id\":0},{\"id\":1}]"}),
+              server.bodies());
+    ASSERT_EQ("application/json", server.requests().at(0).content_type);
+}
+}
+}
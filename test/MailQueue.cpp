@@ -0,0 +1,292 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modules/smtp/MailQueue.hpp"
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <future>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace Leosac::Module::SMTP;
+
+namespace Leosac
+{
+namespace Test
+{
+/**
+ * A minimal SMTP server, listening on a random port of the loopback
+ * interface. It serves one connection at a time and records the subject
+ * of the mails it receives.
+ *
+ * A `silent` server accepts connections but never answers.
+ */
+class FakeSMTPServer
+{
+  public:
+    explicit FakeSMTPServer(bool silent = false)
+        : silent_(silent)
+        , stop_(false)
+        , connections_(0)
+    {
+        sockaddr_in addr{};
+        socklen_t len        = sizeof(addr);
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0 || bind(fd_, reinterpret_cast<sockaddr *>(&addr), len) ||
+            listen(fd_, 4) ||
+            getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len))
+            throw std::runtime_error("Cannot start fake SMTP server.");
+        port_   = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~FakeSMTPServer()
+    {
+        stop_ = true;
+        thread_.join();
+        close(fd_);
+    }
+
+    SMTPServerInfo info() const
+    {
+        SMTPServerInfo info;
+        info.url        = "smtp://127.0.0.1:" + std::to_string(port_);
+        info.from       = "leosac@localhost";
+        info.ms_timeout = 5000;
+        return info;
+    }
+
+    int connections() const
+    {
+        return connections_;
+    }
+
+    std::vector<std::string> subjects() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return subjects_;
+    }
+
+  private:
+    /**
+     * Wait until `fd` is readable. Returns false if the server is
+     * stopping.
+     */
+    bool wait_readable(int fd)
+    {
+        pollfd pfd{fd, POLLIN, 0};
+        while (!stop_)
+        {
+            if (poll(&pfd, 1, 20) > 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool read_line(int fd, std::string &line)
+    {
+        char c;
+        line.clear();
+        while (wait_readable(fd) && recv(fd, &c, 1, 0) == 1)
+        {
+            line += c;
+            if (line.size() >= 2 && line.compare(line.size() - 2, 2, "\r\n") == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void reply(int fd, const std::string &str)
+    {
+        send(fd, str.data(), str.size(), MSG_NOSIGNAL);
+    }
+
+    void serve(int fd)
+    {
+        std::string line;
+        if (silent_)
+        {
+            while (read_line(fd, line))
+                ;
+            return;
+        }
+
+        reply(fd, "220 fake\r\n");
+        while (read_line(fd, line))
+        {
+            if (line == "DATA\r\n")
+            {
+                reply(fd, "354 go ahead\r\n");
+                while (read_line(fd, line) && line != ".\r\n")
+                {
+                    if (line.compare(0, 9, "Subject: ") == 0)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        subjects_.push_back(line.substr(9, line.size() - 11));
+                    }
+                }
+                reply(fd, "250 queued\r\n");
+            }
+            else if (line == "QUIT\r\n")
+            {
+                reply(fd, "221 bye\r\n");
+                return;
+            }
+            else
+                reply(fd, "250 ok\r\n");
+        }
+    }
+
+    void run()
+    {
+        while (wait_readable(fd_))
+        {
+            int client = accept(fd_, nullptr, nullptr);
+            if (client < 0)
+                continue;
+            ++connections_;
+            serve(client);
+            close(client);
+        }
+    }
+
+    bool silent_;
+    std::atomic<bool> stop_;
+    std::atomic<int> connections_;
+    int fd_;
+    uint16_t port_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::string> subjects_;
+};
+
+class MailQueueTest : public ::testing::Test
+{
+  public:
+    MailQueueTest()
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        options_ = {16, std::chrono::milliseconds(0), 1};
+    }
+
+    ~MailQueueTest()
+    {
+        curl_global_cleanup();
+    }
+
+  protected:
+    static MailInfo mail(const std::string &title)
+    {
+        MailInfo mail;
+        mail.to    = {"admin@localhost"};
+        mail.title = title;
+        mail.body  = "body";
+        return mail;
+    }
+
+    /**
+     * Push a mail and wait until the queue is done with it.
+     */
+    static bool send(MailQueue &queue, const std::string &title)
+    {
+        std::promise<bool> promise;
+        auto result = promise.get_future();
+        queue.push(mail(title), [&](bool success) { promise.set_value(success); });
+        return result.get();
+    }
+
+    MailQueue::Options options_;
+};
+
+TEST_F(MailQueueTest, reusesConnection)
+{
+    FakeSMTPServer server;
+    MailQueue queue(options_, {server.info()});
+
+    ASSERT_TRUE(send(queue, "first"));
+    ASSERT_TRUE(send(queue, "second"));
+    ASSERT_TRUE(send(queue, "third"));
+
+    ASSERT_EQ(std::vector<std::string>({"first", "second", "third"}),
+              server.subjects());
+    ASSERT_EQ(1, server.connections());
+}
+
+TEST_F(MailQueueTest, triesNextServer)
+{
+    FakeSMTPServer server;
+    SMTPServerInfo unreachable = server.info();
+    unreachable.url            = "smtp://127.0.0.1:1";
+    MailQueue queue(options_, {unreachable, server.info()});
+
+    ASSERT_TRUE(send(queue, "failover"));
+    ASSERT_EQ(std::vector<std::string>({"failover"}), server.subjects());
+}
+
+TEST_F(MailQueueTest, dropsMailsWhenFull)
+{
+    FakeSMTPServer server(true);
+    std::atomic<int> failed(0);
+    auto count_failure = [&](bool success) {
+        if (!success)
+            ++failed;
+    };
+
+    // Curl waits for the server to answer QUIT when it shuts down.
+    auto info            = server.info();
+    info.ms_timeout      = 1000;
+    options_.queue_size_ = 3;
+    {
+        MailQueue queue(options_, {info});
+        for (int i = 0; i < 3; ++i)
+            ASSERT_TRUE(queue.push(mail("queued"), count_failure));
+        ASSERT_FALSE(queue.push(mail("dropped")));
+        ASSERT_FALSE(queue.push(mail("dropped"), count_failure));
+        ASSERT_EQ(1, failed);
+    }
+    // Mails that weren't sent are given up on at shutdown.
+    ASSERT_EQ(4, failed);
+    ASSERT_TRUE(server.subjects().empty());
+}
+
+TEST_F(MailQueueTest, mergesBursts)
+{
+    FakeSMTPServer server;
+    options_.digest_delay_ = std::chrono::milliseconds(200);
+    options_.digest_size_  = 3;
+    {
+        MailQueue queue(options_, {server.info()});
+        for (int i = 0; i < 4; ++i)
+            ASSERT_TRUE(queue.push(mail("alert " + std::to_string(i))));
+        // The first mail goes right away, the next 3 fill a digest.
+        for (int i = 0; i < 100 && server.subjects().size() < 2; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    ASSERT_EQ(std::vector<std::string>({"alert 0", "alert 1 (and 2 more)"}),
+              server.subjects());
+}
+}
+}
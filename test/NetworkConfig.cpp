@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/netconfig/networkconfig.hpp"
+#include "helper/ScratchDirectory.hpp"
+#include "tools/unixfs.hpp"
+#include "gtest/gtest.h"
+
+using namespace Leosac::Tools;
+
+namespace Leosac
+{
+namespace Test
+{
+class NetworkConfigTest : public ::testing::Test
+{
+  public:
+    NetworkConfigTest()
+        : directory_("netconfig")
+    {
+        cfg_.put("enabled", true);
+        cfg_.put("interface", "eth0");
+        cfg_.put("dhcp", false);
+        cfg_.put("netmask", "255.255.255.0");
+        cfg_.put("default_ip", "192.168.0.10");
+        cfg_.put("gateway", "192.168.0.1");
+        cfg_.put("interfaces_file", directory_.path("interfaces"));
+    }
+
+  protected:
+    Helper::ScratchDirectory directory_;
+    boost::property_tree::ptree cfg_;
+};
+
+TEST_F(NetworkConfigTest, staticInterfaces)
+{
+    cfg_.put("ip", "192.168.0.42");
+    NetworkConfig config(cfg_);
+
+    ASSERT_EQ("# This file was auto-generated\n"
+              "auto lo\n"
+              "iface lo inet loopback\n"
+              "\n"
+              "auto eth0\n"
+              "allow-hotplug eth0\n"
+              "iface eth0 inet static\n"
+              "    address 192.168.0.42\n"
+              "    netmask 255.255.255.0\n"
+              "    gateway 192.168.0.1\n",
+              config.interfaces());
+}
+
+TEST_F(NetworkConfigTest, defaultIp)
+{
+    NetworkConfig config(cfg_);
+    ASSERT_NE(std::string::npos, config.interfaces().find("address 192.168.0.10\n"));
+}
+
+TEST_F(NetworkConfigTest, dhcpInterfaces)
+{
+    cfg_.put("dhcp", true);
+    NetworkConfig config(cfg_);
+
+    auto interfaces = config.interfaces();
+    ASSERT_NE(std::string::npos, interfaces.find("iface eth0 inet dhcp\n"));
+    ASSERT_EQ(std::string::npos, interfaces.find("address"));
+}
+
+TEST_F(NetworkConfigTest, disabledDoesNotWrite)
+{
+    cfg_.put("enabled", false);
+    NetworkConfig config(cfg_);
+
+    config.reload();
+    ASSERT_FALSE(UnixFs::fileExists(directory_.path("interfaces")));
+}
+}
+}
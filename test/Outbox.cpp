@@ -0,0 +1,149 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "helper/ScratchDirectory.hpp"
+#include "tools/Outbox.hpp"
+#include "gtest/gtest.h"
+#include <fstream>
+#include <unistd.h>
+
+using namespace Leosac::Tools;
+
+namespace Leosac
+{
+namespace Test
+{
+class OutboxTest : public ::testing::Test
+{
+  public:
+    OutboxTest()
+        : directory_("outbox")
+    {
+        options_ = {1024 * 1024, std::chrono::hours(1), 4096};
+    }
+
+  protected:
+    Helper::ScratchDirectory directory_;
+    Outbox::Options options_;
+};
+
+TEST_F(OutboxTest, appendAndRead)
+{
+    Outbox outbox(directory_.path(), options_);
+    std::vector<Outbox::Record> records;
+
+    ASSERT_EQ(0, outbox.append("first"));
+    ASSERT_EQ(1, outbox.append(""));
+    ASSERT_EQ(2, outbox.append("third"));
+    ASSERT_EQ(3, outbox.end());
+
+    ASSERT_EQ(2, outbox.read(1, 10, records));
+    ASSERT_EQ(1, records[0].seq_);
+    ASSERT_EQ("", records[0].payload_);
+    ASSERT_EQ(2, records[1].seq_);
+    ASSERT_EQ("third", records[1].payload_);
+
+    records.clear();
+    ASSERT_EQ(1, outbox.read(0, 1, records));
+    ASSERT_EQ("first", records[0].payload_);
+    ASSERT_EQ(0, outbox.read(3, 10, records));
+}
+
+TEST_F(OutboxTest, offsetsSurviveReopening)
+{
+    {
+        Outbox outbox(directory_.path(), options_);
+        outbox.append("before");
+        ASSERT_EQ(1, outbox.offset("http://target/"));
+        outbox.append("a");
+        outbox.append("b");
+        outbox.commit("http://target/", 2);
+    }
+    Outbox outbox(directory_.path(), options_);
+    std::vector<Outbox::Record> records;
+
+    ASSERT_EQ(3, outbox.end());
+    ASSERT_EQ(2, outbox.offset("http://target/"));
+    ASSERT_EQ(1, outbox.read(outbox.offset("http://target/"), 10, records));
+    ASSERT_EQ("b", records[0].payload_);
+}
+
+TEST_F(OutboxTest, consumersDontCollide)
+{
+    Outbox outbox(directory_.path(), options_);
+    outbox.append("a");
+    outbox.append("b");
+
+    ASSERT_EQ(2, outbox.offset("ws-http://host/a"));
+    ASSERT_EQ(2, outbox.offset("ws-http://host_a"));
+    outbox.commit("ws-http://host/a", 0);
+    ASSERT_EQ(0, outbox.offset("ws-http://host/a"));
+    ASSERT_EQ(2, outbox.offset("ws-http://host_a"));
+}
+
+TEST_F(OutboxTest, tornRecordIsDiscarded)
+{
+    {
+        Outbox outbox(directory_.path(), options_);
+        outbox.append("complete");
+        outbox.append("torn");
+    }
+    auto path = directory_.path("00000000000000000000.seg");
+    ASSERT_EQ(0, truncate(path.c_str(), 8 + 8 + 8 + 2));
+
+    Outbox outbox(directory_.path(), options_);
+    std::vector<Outbox::Record> records;
+    ASSERT_EQ(1, outbox.end());
+    ASSERT_EQ(1, outbox.read(0, 10, records));
+    ASSERT_EQ("complete", records[0].payload_);
+    ASSERT_EQ(1, outbox.append("next"));
+}
+
+TEST_F(OutboxTest, retention)
+{
+    options_.max_size_     = 3000;
+    options_.segment_size_ = 1000;
+    Outbox outbox(directory_.path(), options_);
+    std::string payload(92, 'x');
+    std::vector<Outbox::Record> records;
+
+    // 100 bytes per record, 10 per segment.
+    outbox.offset("consumer");
+    for (int i = 0; i < 25; ++i)
+        outbox.append(payload);
+    ASSERT_EQ(1, outbox.read(0, 1, records));
+    ASSERT_EQ(0, records[0].seq_);
+
+    // Consumed segments go away.
+    outbox.commit("consumer", 10);
+    outbox.sync();
+    records.clear();
+    ASSERT_EQ(1, outbox.read(0, 1, records));
+    ASSERT_EQ(10, records[0].seq_);
+
+    // So do the oldest ones, once the outbox is full.
+    for (int i = 0; i < 30; ++i)
+        outbox.append(payload);
+    records.clear();
+    ASSERT_EQ(1, outbox.read(0, 1, records));
+    ASSERT_EQ(20, records[0].seq_);
+    ASSERT_EQ(55, outbox.end());
+}
+}
+}
@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/credentials/RFIDCard.hpp"
+#include "modules/tcp-notifier/protocols/PushFramedEvents.hpp"
+#include "gtest/gtest.h"
+
+using namespace Leosac::Module::TCPNotifier;
+
+namespace Leosac
+{
+namespace Test
+{
+class PushFramedEventsTest : public ::testing::Test
+{
+  public:
+    PushFramedEventsTest()
+        : timestamp_(std::chrono::milliseconds(0x0102030405))
+    {
+    }
+
+  protected:
+    ProtocolHandler::Event card_event(const std::string &source) const
+    {
+        ProtocolHandler::Event event;
+        event.card_      = std::make_shared<Cred::RFIDCard>("ff:ab:cd:ef", 32);
+        event.source_    = source;
+        event.timestamp_ = timestamp_;
+        event.status_    = 0;
+        return event;
+    }
+
+    ProtocolHandler::Clock::time_point timestamp_;
+};
+
+TEST_F(PushFramedEventsTest, encodeFrame)
+{
+    PushFramedEvents protocol(1024, std::chrono::milliseconds(100));
+
+    auto decision    = card_event("door");
+    decision.card_   = nullptr;
+    decision.status_ = 2;
+    ASSERT_TRUE(protocol.handle_event(card_event("WIEGAND1")).empty());
+    ASSERT_TRUE(protocol.handle_event(decision).empty());
+
+    ByteVector expected = {
+        // Frame header.
+        0x00, 0x00, 0x00, 0x48, 0x00, 0x01, 0x00, 0x02,
+        // Credential record.
+        0x00, 0x20, 0x00, 0x08, 0x00, 0x20, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xab, 0xcd, 0xef,
+        0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+        'W', 'I', 'E', 'G', 'A', 'N', 'D', '1',
+        // Decision record, with a padded source name.
+        0x00, 0x20, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+        'd', 'o', 'o', 'r', 0x00, 0x00, 0x00, 0x00};
+
+    auto frames = protocol.flush(timestamp_ + std::chrono::milliseconds(100));
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ(expected, frames[0]);
+}
+
+TEST_F(PushFramedEventsTest, flushAfterDelay)
+{
+    using std::chrono::milliseconds;
+    PushFramedEvents protocol(1024, milliseconds(100));
+
+    ASSERT_EQ(-1, protocol.flush_timeout(timestamp_));
+    protocol.handle_event(card_event("WIEGAND1"));
+
+    ASSERT_EQ(100, protocol.flush_timeout(timestamp_));
+    ASSERT_EQ(40, protocol.flush_timeout(timestamp_ + milliseconds(60)));
+    ASSERT_TRUE(protocol.flush(timestamp_ + milliseconds(60)).empty());
+    ASSERT_EQ(0, protocol.flush_timeout(timestamp_ + milliseconds(500)));
+    ASSERT_EQ(1, protocol.flush(timestamp_ + milliseconds(100)).size());
+    ASSERT_EQ(-1, protocol.flush_timeout(timestamp_ + milliseconds(100)));
+
+    // A clock going backward doesn't hold the frame back.
+    protocol.handle_event(card_event("WIEGAND1"));
+    ASSERT_EQ(0, protocol.flush_timeout(timestamp_ - milliseconds(500)));
+    ASSERT_EQ(1, protocol.flush(timestamp_ - milliseconds(500)).size());
+}
+
+TEST_F(PushFramedEventsTest, frameSizeLimit)
+{
+    // Room for the header and 2 records.
+    PushFramedEvents protocol(8 + 2 * 32, std::chrono::milliseconds(100));
+
+    ASSERT_TRUE(protocol.handle_event(card_event("WIEGAND1")).empty());
+    auto frames = protocol.handle_event(card_event("WIEGAND1"));
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ(72, frames[0].size());
+    ASSERT_EQ(2, frames[0][7]);
+
+    // This one doesn't fit with the next one.
+    ASSERT_TRUE(protocol.handle_event(card_event("WIEGAND1")).empty());
+    frames = protocol.handle_event(card_event("a longer source name"));
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ(40, frames[0].size());
+    ASSERT_EQ(1, frames[0][7]);
+}
+
+TEST_F(PushFramedEventsTest, noDelay)
+{
+    PushFramedEvents protocol(1024, std::chrono::milliseconds(0));
+
+    auto frames = protocol.handle_event(card_event("WIEGAND1"));
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ(40, frames[0].size());
+    ASSERT_EQ(-1, protocol.flush_timeout(timestamp_));
+}
+}
+}
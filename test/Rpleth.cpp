@@ -24,6 +24,7 @@
 #include "modules/rpleth/RplethModule.hpp"
 #include "modules/rpleth/rplethprotocol.hpp"
 #include "tools/log.hpp"
+#include <algorithm>
 #include <memory>
 
 using namespace Leosac::Module::Rpleth;
@@ -74,7 +75,7 @@ class RplethTest : public Helper::TestHelper
     */
     CircularBuffer ciruclar_buf_;
 
-    zmqpp::socket connect_to_rpleth()
+    zmqpp::socket connect_to_rpleth(std::string *identity = nullptr)
     {
         zmqpp::message msg;
         std::string connection_identity, data;
@@ -86,9 +87,37 @@ class RplethTest : public Helper::TestHelper
         assert(msg.parts() == 2);
         msg >> connection_identity;
         assert(msg.size(1) == 0);
+        if (identity)
+            *identity = connection_identity;
         return std::move(client);
     }
 
+    /**
+    * Send a command to the rpleth server and return its response.
+    */
+    RplethPacket send_command(zmqpp::socket &client, const std::string &identity,
+                              Byte type, Byte command, const std::string &data)
+    {
+        RplethPacket packet(RplethPacket::Sender::Client);
+        packet.type    = type;
+        packet.command = command;
+        packet.data    = std::vector<Byte>(data.begin(), data.end());
+        packet.dataLen = packet.data.size();
+
+        std::array<uint8_t, 512> buf;
+        std::size_t size =
+            RplethProtocol::encodeCommand(packet, &buf[0], buf.size());
+        zmqpp::message msg;
+        msg << identity;
+        msg.add_raw(&buf[0], size);
+        client.send(msg);
+
+        std::string connection_identity, response;
+        client.receive(msg);
+        msg >> connection_identity >> response;
+        return extract_packet(response);
+    }
+
     /**
     * Check that we can read a rpleth from the socket and check that its valid.
     */
@@ -137,6 +166,133 @@ TEST(Rpleth, TestConvertCard)
     ASSERT_EQ(card_binary, out);
 }
 
+TEST(Rpleth, TestDecodeFromCircularBuffer)
+{
+    CircularBuffer buffer(16);
+    RplethPacket packet(RplethPacket::Sender::Client);
+    std::array<uint8_t, 16> raw;
+
+    packet.type    = RplethProtocol::HID;
+    packet.command = RplethProtocol::SendCards;
+    packet.data    = std::vector<Byte>({'0', '1', '|', '0', '2', '|'});
+    packet.dataLen = packet.data.size();
+    std::size_t size = RplethProtocol::encodeCommand(packet, &raw[0], raw.size());
+    ASSERT_EQ(10, size);
+
+    // Each packet starts further in the buffer: the payload of the second one
+    // wraps around its end.
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(size, buffer.write(&raw[0], size));
+        RplethPacket decoded = RplethProtocol::decodeCommand(buffer);
+        ASSERT_TRUE(decoded.isGood);
+        ASSERT_EQ(RplethProtocol::Success, decoded.status);
+        ASSERT_EQ(packet.data, decoded.data);
+        ASSERT_EQ(0, buffer.toRead());
+
+        // The payload is copied only when it wraps: copies of a packet that
+        // refers to the buffer refer to it too.
+        RplethPacket copy = decoded;
+        ASSERT_EQ(packet.data, copy.data);
+        if (i == 1)
+            ASSERT_NE(decoded.data.data(), copy.data.data());
+        else
+            ASSERT_EQ(decoded.data.data(), copy.data.data());
+    }
+}
+
+TEST(Rpleth, TestCardSet)
+{
+    CardKey key;
+    std::vector<Byte> text;
+
+    ASSERT_TRUE(CardSet::pack("00:00:0a:FF", key));
+    ASSERT_EQ(0x0aff, key.value_);
+    ASSERT_EQ(8, +key.digits_);
+    CardSet::append_text("00:00:0a:FF", text);
+    ASSERT_EQ("00000aFF", std::string(text.begin(), text.end()));
+
+    ASSERT_FALSE(CardSet::pack("", key));
+    ASSERT_FALSE(CardSet::pack("::", key));
+    ASSERT_FALSE(CardSet::pack("12zz", key));
+    ASSERT_FALSE(CardSet::pack("0123456789abcdef0", key));
+    ASSERT_TRUE(CardSet::pack("0123456789abcdef", key));
+
+    // Leading zeros are significant.
+    CardKey other;
+    ASSERT_TRUE(CardSet::pack("0aff", other));
+    ASSERT_FALSE(key == other);
+
+    // Cards keep the text they were pushed as. Invalid entries are kept
+    // too, but match nothing.
+    CardSet cards;
+    std::string list = "0B|0a||zz|0b|0:C|";
+    auto data = reinterpret_cast<const Byte *>(list.data());
+    ASSERT_EQ(1, cards.assign(data, data + list.size()));
+    ASSERT_EQ(4, cards.size());
+    ASSERT_EQ(std::vector<std::string>({"0B", "0a", "zz", "0:C"}), cards.texts());
+    ASSERT_EQ(0, +cards.cards()[2].digits_);
+
+    ASSERT_TRUE(CardSet::pack("0c", key));
+    ASSERT_TRUE(cards.contains(key));
+    ASSERT_EQ("0:C", *cards.text(key));
+    ASSERT_FALSE(cards.insert(key, "0c"));
+    ASSERT_TRUE(CardSet::pack("c", key));
+    ASSERT_FALSE(cards.contains(key));
+    ASSERT_EQ(nullptr, cards.text(key));
+    ASSERT_FALSE(cards.contains(CardKey{0, 0}));
+}
+
+/**
+* Look up each card read in a large list of pushed cards, and check the
+* present and absent lists against a plain linear search.
+*/
+TEST_F(RplethTest, TestCardLookupLargeList)
+{
+    const int nb_pushed = 20000;
+    const int nb_read   = 2000;
+    auto card_text = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%08x", i * 7);
+        return std::string(buf);
+    };
+
+    std::string pushed;
+    std::vector<std::string> pushed_texts;
+    for (int i = 0; i < nb_pushed; ++i)
+    {
+        pushed_texts.push_back(card_text(i));
+        pushed += pushed_texts.back() + '|';
+    }
+
+    CardSet set_pushed, set_read;
+    auto data = reinterpret_cast<const Byte *>(pushed.data());
+    ASSERT_EQ(0, set_pushed.assign(data, data + pushed.size()));
+    ASSERT_EQ(nb_pushed, set_pushed.size());
+
+    // Reads alternate between pushed cards and unknown ones.
+    for (int i = 0; i < nb_read; ++i)
+    {
+        auto card = card_text(i % 2 ? i * 5 : nb_pushed + i);
+        bool expected = std::find(pushed_texts.begin(), pushed_texts.end(),
+                                  card) != pushed_texts.end();
+        CardKey key;
+        ASSERT_TRUE(CardSet::pack(card, key));
+        ASSERT_EQ(expected, set_pushed.contains(key)) << card;
+        if (expected)
+            set_read.insert(key, card);
+    }
+    ASSERT_EQ(nb_read / 2, set_read.size());
+
+    size_t absent = 0;
+    for (const auto &card : set_pushed.cards())
+    {
+        if (!set_read.contains(card))
+            ++absent;
+    }
+    ASSERT_EQ(nb_pushed - nb_read / 2, absent);
+}
+
 /**
 * Check that a rpleth receive cards that are read.
 */
@@ -180,5 +336,53 @@ TEST_F(RplethTest, TestReceiveStreamCards2)
     // nothing to read anymore
     ASSERT_FALSE(client.receive(msg, true));
 }
+/**
+* Push a list of cards, read some of them and check the present and
+* absent lists.
+*/
+TEST_F(RplethTest, TestSendAndReceiveCards)
+{
+    std::string identity, cards;
+    zmqpp::socket client = connect_to_rpleth(&identity);
+
+    // Nearly as many cards as a packet can hold. Cards are echoed as they
+    // were pushed, invalid ones included.
+    for (int i = 1; i <= 26; ++i)
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%08x|", i);
+        cards += buf;
+    }
+    cards += "0000001B|zz|";
+    auto response = send_command(client, identity, RplethProtocol::HID,
+                                 RplethProtocol::SendCards, cards);
+    ASSERT_TRUE(response.isGood);
+    ASSERT_EQ(RplethProtocol::Success, response.status);
+
+    for (auto card : {"00:00:00:03", "00:00:00:1b", "00:00:00:03", "00:00:00:ff"})
+    {
+        bus_push_.send(zmqpp::message() << "S_WIEGAND1"
+                                        << Leosac::Auth::SourceType::SIMPLE_WIEGAND
+                                        << card << 32);
+        // Card are also streamed to the client.
+        zmqpp::message msg;
+        client.receive(msg);
+    }
+
+    response = send_command(client, identity, RplethProtocol::HID,
+                            RplethProtocol::ReceiveCardsWaited, "\x01");
+    ASSERT_TRUE(response.isGood);
+    ASSERT_EQ("00000003|0000001B|",
+              std::string(response.data.begin(), response.data.end()));
+
+    response = send_command(client, identity, RplethProtocol::HID,
+                            RplethProtocol::ReceiveCardsWaited, std::string(1, 0));
+    ASSERT_TRUE(response.isGood);
+    std::string absent(response.data.begin(), response.data.end());
+    ASSERT_EQ(25 * 9 + 3, absent.size());
+    ASSERT_EQ(0, absent.find("00000001|00000002|00000004|"));
+    ASSERT_EQ(std::string::npos, absent.find("0000001B"));
+    ASSERT_EQ(absent.size() - 12, absent.find("0000001a|zz|"));
+}
 }
 }
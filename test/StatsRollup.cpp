@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/audit/StatsRollup.hpp"
+#include "gtest/gtest.h"
+#include "helper/ScratchDirectory.hpp"
+#include <odb/sqlite/database.hxx>
+#include <odb/transaction.hxx>
+
+using namespace Leosac::Audit;
+using boost::posix_time::from_time_t;
+
+namespace Leosac
+{
+namespace Test
+{
+class StatsRollupTest : public ::testing::Test
+{
+  public:
+    StatsRollupTest()
+        : directory_("stats")
+        , db_(std::make_shared<odb::sqlite::database>(
+              directory_.path("stats.db"),
+              SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE))
+    {
+        odb::transaction t(db_->begin());
+        StatsRollup::ensure_table(*db_);
+        t.commit();
+    }
+
+  protected:
+    /**
+     * Start of an hour, as a UNIX timestamp.
+     */
+    static constexpr long long hour = 1499997600;
+
+    std::vector<StatsRollupRow> fetch(const std::string &metric,
+                                      const std::string &dimension)
+    {
+        odb::transaction t(db_->begin());
+        auto rows = StatsRollup::fetch(*db_, metric, dimension, 0, hour + 86400);
+        t.commit();
+        return rows;
+    }
+
+    std::vector<StatsRollupRow> aggregate(long long from, long long to,
+                                          long long resolution)
+    {
+        odb::transaction t(db_->begin());
+        auto rows = StatsRollup::aggregate(*db_, "access.granted", "door", from, to,
+                                           resolution);
+        t.commit();
+        return rows;
+    }
+
+    void record_access(long long when, const std::string &door, bool granted)
+    {
+        odb::transaction t(db_->begin());
+        StatsRollup::record_access(*db_, from_time_t(when), door, "toto", granted);
+        t.commit();
+    }
+
+    Helper::ScratchDirectory directory_;
+    DBPtr db_;
+};
+
+constexpr long long StatsRollupTest::hour;
+
+TEST_F(StatsRollupTest, bucketOf)
+{
+    ASSERT_EQ(hour, StatsRollup::bucket_of(from_time_t(hour)));
+    ASSERT_EQ(hour, StatsRollup::bucket_of(from_time_t(hour + 3599)));
+    ASSERT_EQ(hour + 3600, StatsRollup::bucket_of(from_time_t(hour + 3600)));
+
+    // `hour` is 2017-07-14 02:00:00 UTC, whatever the local timezone.
+    boost::posix_time::ptime when(boost::gregorian::date(2017, 7, 14),
+                                  boost::posix_time::time_duration(2, 59, 59));
+    ASSERT_EQ(hour, StatsRollup::bucket_of(when));
+}
+
+TEST_F(StatsRollupTest, countersAcrossBucketBoundary)
+{
+    record_access(hour + 3598, "front", true);
+    record_access(hour + 3599, "front", true);
+    record_access(hour + 3600, "front", true);
+    record_access(hour + 3600, "back", false);
+
+    auto rows = fetch("access.granted", "door");
+    ASSERT_EQ(2, rows.size());
+    ASSERT_EQ(hour, rows[0].bucket);
+    ASSERT_EQ("front", rows[0].key);
+    ASSERT_EQ(2, rows[0].count);
+    ASSERT_EQ(hour + 3600, rows[1].bucket);
+    ASSERT_EQ("front", rows[1].key);
+    ASSERT_EQ(1, rows[1].count);
+
+    rows = fetch("access.granted", "user");
+    ASSERT_EQ(2, rows.size());
+    ASSERT_EQ("toto", rows[0].key);
+    ASSERT_EQ(2, rows[0].count);
+    ASSERT_EQ(1, rows[1].count);
+
+    rows = fetch("access.denied", "door");
+    ASSERT_EQ(1, rows.size());
+    ASSERT_EQ(hour + 3600, rows[0].bucket);
+    ASSERT_EQ("back", rows[0].key);
+    ASSERT_EQ(1, rows[0].count);
+}
+
+TEST_F(StatsRollupTest, batchAddsToExistingCounters)
+{
+    record_access(hour, "front", true);
+
+    StatsBatch batch;
+    ASSERT_TRUE(batch.empty());
+    batch.record_access(from_time_t(hour + 10), "front", "toto", true);
+    batch.record_access(from_time_t(hour + 3599), "front", "toto", true);
+    batch.record_access(from_time_t(hour + 3600), "front", "toto", true);
+    batch.record_access(from_time_t(hour + 3600), "it's", "toto", true);
+    ASSERT_FALSE(batch.empty());
+    {
+        odb::transaction t(db_->begin());
+        batch.write(*db_);
+        t.commit();
+    }
+
+    auto rows = fetch("access.granted", "door");
+    ASSERT_EQ(3, rows.size());
+    ASSERT_EQ(hour, rows[0].bucket);
+    ASSERT_EQ("front", rows[0].key);
+    ASSERT_EQ(3, rows[0].count);
+    ASSERT_EQ(hour + 3600, rows[1].bucket);
+    ASSERT_EQ("front", rows[1].key);
+    ASSERT_EQ(1, rows[1].count);
+    ASSERT_EQ("it's", rows[2].key);
+    ASSERT_EQ(1, rows[2].count);
+
+    rows = fetch("access.granted", "user");
+    ASSERT_EQ(2, rows.size());
+    ASSERT_EQ(3, rows[0].count);
+    ASSERT_EQ(2, rows[1].count);
+}
+
+TEST_F(StatsRollupTest, aggregate)
+{
+    record_access(hour - 1, "front", true);
+    record_access(hour, "front", true);
+    record_access(hour + 3600, "front", true);
+    record_access(hour + 3600, "back", true);
+    record_access(hour + 7200, "front", true);
+    record_access(hour + 3 * 3600, "front", true);
+
+    // Hourly: same as the stored rollups, `from` rounded down.
+    auto rows = aggregate(hour + 10, hour + 3 * 3600, 3600);
+    ASSERT_EQ(4, rows.size());
+    ASSERT_EQ(hour, rows[0].bucket);
+    ASSERT_EQ(1, rows[0].count);
+    ASSERT_EQ(hour + 3600, rows[1].bucket);
+    ASSERT_EQ("back", rows[1].key);
+    ASSERT_EQ(hour + 3600, rows[2].bucket);
+    ASSERT_EQ("front", rows[2].key);
+    ASSERT_EQ(hour + 7200, rows[3].bucket);
+
+    // Two hours: buckets aligned on `from`, the last one partial.
+    rows = aggregate(hour, hour + 3 * 3600, 7200);
+    ASSERT_EQ(3, rows.size());
+    ASSERT_EQ(hour, rows[0].bucket);
+    ASSERT_EQ("back", rows[0].key);
+    ASSERT_EQ(1, rows[0].count);
+    ASSERT_EQ(hour, rows[1].bucket);
+    ASSERT_EQ("front", rows[1].key);
+    ASSERT_EQ(2, rows[1].count);
+    ASSERT_EQ(hour + 7200, rows[2].bucket);
+    ASSERT_EQ("front", rows[2].key);
+    ASSERT_EQ(1, rows[2].count);
+}
+}
+}
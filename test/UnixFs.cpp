@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "helper/ScratchDirectory.hpp"
+#include "tools/unixfs.hpp"
+#include "gtest/gtest.h"
+#include <sys/stat.h>
+
+using namespace Leosac::Tools;
+
+namespace Leosac
+{
+namespace Test
+{
+class UnixFsTest : public ::testing::Test
+{
+  public:
+    UnixFsTest()
+        : directory_("unixfs")
+    {
+    }
+
+  protected:
+    std::string path(const std::string &name) const
+    {
+        return directory_.path(name);
+    }
+
+    mode_t mode(const std::string &name) const
+    {
+        struct stat st;
+        if (stat(path(name).c_str(), &st) != 0)
+            return 0;
+        return st.st_mode & 07777;
+    }
+
+    Helper::ScratchDirectory directory_;
+};
+
+TEST_F(UnixFsTest, writeAtomically)
+{
+    UnixFs::writeAtomically(path("file"), "first");
+    ASSERT_EQ("first", UnixFs::readAll(path("file")));
+
+    chmod(path("file").c_str(), 0640);
+    UnixFs::writeAtomically(path("file"), "second");
+    ASSERT_EQ("second", UnixFs::readAll(path("file")));
+    ASSERT_EQ(0640, mode("file"));
+
+    UnixFs::writeAtomically(path("file"), "");
+    ASSERT_EQ("", UnixFs::readAll(path("file")));
+
+    // No temporary file is left behind.
+    ASSERT_EQ(UnixFs::FileList({path("file")}),
+              UnixFs::listFiles(directory_.path()));
+}
+
+TEST_F(UnixFsTest, writeAtomicallyFailure)
+{
+    ASSERT_THROW(UnixFs::writeAtomically(path("missing/file"), "content"),
+                 FsException);
+    ASSERT_TRUE(UnixFs::listFiles(directory_.path()).empty());
+}
+
+TEST_F(UnixFsTest, copyFile)
+{
+    std::string content;
+    for (int i = 0; i < 100000; ++i)
+        content += std::to_string(i) + '\n';
+    UnixFs::writeAtomically(path("source"), content);
+    UnixFs::writeAtomically(path("dest"), "old content");
+    chmod(path("dest").c_str(), 0600);
+
+    UnixFs::copyFile(path("source"), path("dest"));
+    ASSERT_EQ(content, UnixFs::readAll(path("dest")));
+    ASSERT_EQ(0600, mode("dest"));
+
+    UnixFs::copyFile(path("source"), path("new"));
+    ASSERT_EQ(content, UnixFs::readAll(path("new")));
+    ASSERT_EQ(3, UnixFs::listFiles(directory_.path()).size());
+}
+
+TEST_F(UnixFsTest, copyFileFailure)
+{
+    UnixFs::writeAtomically(path("dest"), "old content");
+
+    ASSERT_THROW(UnixFs::copyFile(path("missing"), path("dest")), FsException);
+    ASSERT_THROW(UnixFs::copyFile(path("dest"), path("missing/dest")),
+                 FsException);
+    ASSERT_EQ("old content", UnixFs::readAll(path("dest")));
+    ASSERT_EQ(UnixFs::FileList({path("dest")}),
+              UnixFs::listFiles(directory_.path()));
+}
+}
+}
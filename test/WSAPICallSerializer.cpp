@@ -0,0 +1,130 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/SecurityContext.hpp"
+#include "core/audit/AuditFactory.hpp"
+#include "core/audit/IWSAPICall.hpp"
+#include "core/audit/StatsRollup.hpp"
+#include "core/audit/WSAPICall.hpp"
+#include "core/audit/WSAPICall_odb.h"
+#include "core/audit/serializers/WSAPICallSerializer.hpp"
+#include "core/auth/ChangeLog.hpp"
+#include "core/auth/User.hpp"
+#include "core/auth/User_odb.h"
+#include "helper/ScratchDirectory.hpp"
+#include "gtest/gtest.h"
+#include <odb/schema-catalog.hxx>
+#include <odb/sqlite/database.hxx>
+#include <odb/transaction.hxx>
+
+using namespace Leosac::Audit;
+
+namespace Leosac
+{
+namespace Test
+{
+class WSAPICallSerializerTest : public ::testing::Test
+{
+  public:
+    WSAPICallSerializerTest()
+        : directory_("wsapicall")
+    {
+        db_ = std::make_shared<odb::sqlite::database>(
+            directory_.path("audit.db"), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        odb::transaction t(db_->begin());
+        odb::schema_catalog::create_schema(*db_, "core");
+        StatsRollup::ensure_table(*db_);
+        Auth::ChangeLog::ensure_table(*db_);
+        t.commit();
+    }
+
+  protected:
+    IWSAPICallPtr api_call(Auth::UserPtr author)
+    {
+        auto call = Factory::WSAPICall(db_);
+        odb::transaction t(db_->begin());
+        call->event_mask(EventType::WSAPI_CALL);
+        call->method("user.read");
+        call->uuid("c0ffee");
+        call->status_code(APIStatusCode::PERMISSION_DENIED);
+        call->status_string("Nope");
+        call->source_endpoint("127.0.0.1:4242");
+        if (author)
+            call->author(author);
+        call->finalize();
+        t.commit();
+        return call;
+    }
+
+    /**
+     * Serialize `call` through both paths, and check that they agree.
+     */
+    void check_same_json(const IWSAPICall &call)
+    {
+        auto &sc = SystemSecurityContext::instance();
+
+        // The description loads the author: stay in the transaction.
+        odb::transaction t(db_->begin());
+        auto expected = Serializer::WSAPICallJSON::serialize(call, sc);
+        using Query   = odb::query<WSAPICallRow>;
+        auto rows   = db_->query<WSAPICallRow>(Query("\"AuditEntry\".\"id\" =" +
+                                                     Query::_val(call.id())));
+        auto row = rows.begin();
+        ASSERT_NE(rows.end(), row);
+        ASSERT_EQ(expected, Serializer::WSAPICallJSON::serialize(*row, sc));
+        t.commit();
+    }
+
+    Helper::ScratchDirectory directory_;
+    DBPtr db_;
+};
+
+TEST_F(WSAPICallSerializerTest, rowMatchesEntry)
+{
+    auto user = std::make_shared<Auth::User>();
+    user->username("toto");
+    {
+        odb::transaction t(db_->begin());
+        db_->persist(user);
+        t.commit();
+    }
+    auto call = api_call(user);
+
+    odb::transaction t(db_->begin());
+    auto json = Serializer::WSAPICallJSON::serialize(
+        *call, SystemSecurityContext::instance());
+    ASSERT_EQ("audit-wsapicall-event", json.at("type"));
+    ASSERT_EQ("user.read", json.at("attributes").at("method"));
+    ASSERT_EQ(user->id(), json.at("relationships")
+                              .at("author")
+                              .at("data")
+                              .at("id")
+                              .get<Auth::UserId>());
+    t.commit();
+
+    check_same_json(*call);
+}
+
+TEST_F(WSAPICallSerializerTest, rowMatchesAnonymousEntry)
+{
+    auto call = api_call(nullptr);
+    check_same_json(*call);
+}
+}
+}
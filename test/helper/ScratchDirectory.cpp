@@ -0,0 +1,68 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScratchDirectory.hpp"
+#include "exception/fsexception.hpp"
+#include "tools/log.hpp"
+#include "tools/unixsyscall.hpp"
+#include <cerrno>
+#include <ftw.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace Leosac::Test::Helper;
+using Leosac::Tools::UnixSyscall;
+
+namespace
+{
+int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    if (::remove(path) != 0)
+        WARN(UnixSyscall::getErrorString("remove", errno) << ": " << path);
+    // Keep going: remove as much as possible.
+    return 0;
+}
+}
+
+ScratchDirectory::ScratchDirectory(const std::string &prefix)
+{
+    std::string tmpl = "/tmp/leosac-" + prefix + "-XXXXXX";
+    std::vector<char> buf(tmpl.begin(), tmpl.end());
+    buf.push_back('\0');
+    if (!mkdtemp(buf.data()))
+        throw FsException(UnixSyscall::getErrorString("mkdtemp", errno) + ": " +
+                          tmpl);
+    path_ = buf.data();
+}
+
+ScratchDirectory::~ScratchDirectory()
+{
+    // Children first, and don't follow symbolic links.
+    nftw(path_.c_str(), &remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+const std::string &ScratchDirectory::path() const
+{
+    return path_;
+}
+
+std::string ScratchDirectory::path(const std::string &name) const
+{
+    return path_ + "/" + name;
+}
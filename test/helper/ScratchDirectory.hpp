@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2014-2016 Leosac
+
+    This file is part of Leosac.
+
+    Leosac is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leosac is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace Leosac
+{
+namespace Test
+{
+namespace Helper
+{
+/**
+* A temporary directory for tests that need to write files.
+*
+* The directory is created under /tmp, and removed with its content
+* when the object is destroyed.
+*/
+class ScratchDirectory
+{
+  public:
+    /**
+    * Create a new directory, whose name starts with `leosac-<prefix>-`.
+    *
+    * Throws FsException if the directory cannot be created.
+    */
+    explicit ScratchDirectory(const std::string &prefix);
+
+    ~ScratchDirectory();
+
+    ScratchDirectory(const ScratchDirectory &) = delete;
+    ScratchDirectory &operator=(const ScratchDirectory &) = delete;
+
+    const std::string &path() const;
+
+    /**
+    * Path of `name` in the directory.
+    */
+    std::string path(const std::string &name) const;
+
+  private:
+    std::string path_;
+};
+}
+}
+}